@@ -0,0 +1,119 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "CborMsgpackCodec.h"
+#include "TestSchema.h"
+
+#include <benchmark/benchmark.h>
+#include <google/protobuf/text_format.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <memory>
+#include <string>
+
+namespace
+{
+  enum Format { JSON, CBOR, MESSAGEPACK };
+
+  struct Fixture
+  {
+    std::shared_ptr<const ProtobufSchema>      schema;
+    std::unique_ptr<google::protobuf::Message> message;
+
+    Fixture()
+      : schema(test_schema::build())
+      , message(schema->prototype->New())
+    {
+      google::protobuf::TextFormat::ParseFromString(R"(
+        id: 42 stamp: 1700000000000000 count: 7 value: 21.5 ratio: 0.75 valid: true name: "temperature/engine"
+        data: "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+        mode: MODE_ON position { x: 1.5 y: -3.25 } values: [1, 2, 3, 4, 5, 6, 7, 8, 100000, -100000]
+        track { x: 1 y: 2 } track { x: 3 y: 4 } track { x: 5 y: 6 } counters { key: "ok" value: 10 } counters { key: "error" value: 1 }
+      )", message.get());
+    }
+  };
+
+  const Fixture& fixture()
+  {
+    static Fixture instance;
+    return instance;
+  }
+
+  void encode(const google::protobuf::Message& message, Format format, std::string& output)
+  {
+    if (format == JSON)
+    {
+      output.clear();
+      google::protobuf::util::MessageToJsonString(message, &output);
+    }
+    else
+    {
+      CborMsgpackCodec::encode(message, format == CBOR ? CborMsgpackCodec::CBOR : CborMsgpackCodec::MESSAGEPACK, output);
+    }
+  }
+
+  bool decode(const std::string& data, Format format, google::protobuf::Message& message)
+  {
+    message.Clear();
+    if (format == JSON)
+    {
+      return google::protobuf::util::JsonStringToMessage(data, &message).ok();
+    }
+    std::string error;
+    return CborMsgpackCodec::decode(data.data(), data.size(), format == CBOR ? CborMsgpackCodec::CBOR : CborMsgpackCodec::MESSAGEPACK, message, error);
+  }
+
+  /** Encodes the same message again and again, the size counter is the encoded size in bytes */
+  void BM_Encode(benchmark::State& state, Format format)
+  {
+    const auto& message = *fixture().message;
+    std::string output;
+    for (auto _ : state)
+    {
+      encode(message, format, output);
+      benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["size"] = static_cast<double>(output.size());
+  }
+
+  void BM_Decode(benchmark::State& state, Format format)
+  {
+    std::string data;
+    encode(*fixture().message, format, data);
+    std::unique_ptr<google::protobuf::Message> message(fixture().schema->prototype->New());
+    for (auto _ : state)
+    {
+      if (!decode(data, format, *message))
+      {
+        state.SkipWithError("decoding failed");
+        break;
+      }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["size"] = static_cast<double>(data.size());
+  }
+}
+
+BENCHMARK_CAPTURE(BM_Encode, json,    JSON);
+BENCHMARK_CAPTURE(BM_Encode, cbor,    CBOR);
+BENCHMARK_CAPTURE(BM_Encode, msgpack, MESSAGEPACK);
+BENCHMARK_CAPTURE(BM_Decode, json,    JSON);
+BENCHMARK_CAPTURE(BM_Decode, cbor,    CBOR);
+BENCHMARK_CAPTURE(BM_Decode, msgpack, MESSAGEPACK);
@@ -0,0 +1,96 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "PayloadTranscoder.h"
+#include "TestSchema.h"
+
+#include <benchmark/benchmark.h>
+#include <google/protobuf/text_format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const size_t TOPIC_COUNT = 64;
+  const size_t BATCH_SIZE  = 10000;
+
+  std::string samplePayload()
+  {
+    auto schema = test_schema::build();
+    std::unique_ptr<google::protobuf::Message> message(schema->prototype->New());
+    google::protobuf::TextFormat::ParseFromString(R"(
+      id: 42 stamp: 1700000000000000 count: 7 value: 21.5 ratio: 0.75 valid: true name: "temperature/engine"
+      mode: MODE_ON position { x: 1.5 y: -3.25 } values: [1, 2, 3, 4, 5, 6, 7, 8]
+      track { x: 1 y: 2 } track { x: 3 y: 4 } counters { key: "ok" value: 10 } counters { key: "error" value: 1 }
+    )", message.get());
+    return message->SerializeAsString();
+  }
+
+  /**
+   * Converts batches of messages on 64 topics with 1, 2, 4 ... workers. The
+   * msgs/s per core counter is the throughput divided by the number of cores
+   * the workers can use.
+   */
+  void BM_Transcode(benchmark::State& state, PayloadTranscoder::OutputFormat format)
+  {
+    const size_t worker_count = static_cast<size_t>(state.range(0));
+    std::atomic<uint64_t> published(0);
+    PayloadTranscoder transcoder(worker_count, 1024,
+      [&published](const std::string&, const std::string&, int, bool, const std::chrono::steady_clock::time_point&) { published++; },
+      [](const std::string&, const google::protobuf::Message&) {});
+
+    const std::string descriptor = test_schema::descriptor();
+    std::vector<std::string> topics;
+    for (size_t i = 0; i < TOPIC_COUNT; i++)
+    {
+      topics.push_back("sensor_" + std::to_string(i));
+      transcoder.setDescriptor(topics.back(), "proto:test.Sample", descriptor);
+    }
+    const std::string payload = samplePayload();
+
+    uint64_t expected = 0;
+    for (auto _ : state)
+    {
+      for (size_t i = 0; i < BATCH_SIZE; i++)
+      {
+        const std::string& topic = topics[i % TOPIC_COUNT];
+        while (!transcoder.transcode(topic, topic, format, payload.data(), payload.size(), 0, false))
+        {
+          std::this_thread::yield();
+        }
+      }
+      expected += BATCH_SIZE;
+      while (published < expected)
+      {
+        std::this_thread::yield();
+      }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(expected));
+    state.SetBytesProcessed(static_cast<int64_t>(expected * payload.size()));
+    const size_t core_count = std::min<size_t>(worker_count, std::max(std::thread::hardware_concurrency(), 1u));
+    state.counters["msgs/s per core"] = benchmark::Counter(static_cast<double>(expected) / static_cast<double>(core_count), benchmark::Counter::kIsRate);
+  }
+}
+
+BENCHMARK_CAPTURE(BM_Transcode, json, PayloadTranscoder::JSON)->RangeMultiplier(2)->Range(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,146 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "SendScheduler.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/*
+ * Time in the send queue of a small message per priority class while the
+ * link is saturated: four low priority topics have a backlog of 1 KiB
+ * messages for about 16 s, the bandwidth is limited to 8 Mbit/s, and the
+ * publish of the scheduler returns at once, like mosquitto taking the message.
+ * The time from queueing a probe message until its publish is the latency of
+ * its class. The backlog stays below the queue limit, a full queue would drop
+ * the low priority probes.
+ */
+namespace
+{
+  const uint64_t BANDWIDTH_BITS = 8 * 1000 * 1000;
+  const size_t   BULK_SIZE      = 1024;
+  const int      BULK_TOPICS    = 4;
+  const int      BULK_MESSAGES  = 4096;   // per topic
+
+  class LoadedScheduler
+  {
+  public:
+    explicit LoadedScheduler(SendScheduler::Priority probe_priority)
+      : next_mid(1)
+      , is_probe_sent(false)
+    {
+      SendScheduler::Output output;
+      output.publish = [this](const std::string& topic, const char*, size_t, int qos, bool, const std::chrono::steady_clock::time_point&, int& mid, int& sent_qos)
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        mid      = next_mid++;
+        sent_qos = qos;
+        if (topic == "probe")
+        {
+          probe_sent    = std::chrono::steady_clock::now();
+          is_probe_sent = true;
+          cv.notify_all();
+        }
+        return PUBLISH_SENT;
+      };
+      output.is_connected = []() { return true; };
+      output.is_storing   = []() { return false; };
+      output.is_idle      = []() { return true; };
+      scheduler.reset(new SendScheduler(2 * BULK_TOPICS * BULK_MESSAGES * BULK_SIZE, 1, output));
+
+      std::map<std::string, SendScheduler::Route> routes;
+      routes["probe"] = { "probe", probe_priority, 0, 1 };
+      for (int i = 0; i < BULK_TOPICS; i++)
+      {
+        const std::string topic = "bulk/" + std::to_string(i);
+        routes[topic] = { topic, SendScheduler::LOW, 0, 1 };
+      }
+      scheduler->setRoutes(routes);
+      scheduler->setBandwidthLimit(BANDWIDTH_BITS, 4 * BULK_SIZE);
+    }
+
+    /** @brief Queues the backlog of the bulk topics */
+    void addLoad()
+    {
+      const std::string bulk(BULK_SIZE, 'x');
+      for (int message = 0; message < BULK_MESSAGES; message++)
+      {
+        for (int i = 0; i < BULK_TOPICS; i++)
+        {
+          scheduler->queue("bulk/" + std::to_string(i), bulk.data(), bulk.size(), 1, false, std::chrono::steady_clock::time_point::max());
+        }
+      }
+    }
+
+    /** @return the time the probe message waited in the queue, negative if it was not sent within a second */
+    double sendProbe()
+    {
+      const std::string probe(64, 'p');
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        is_probe_sent = false;
+      }
+      const auto queued = std::chrono::steady_clock::now();
+      scheduler->queue("probe", probe.data(), probe.size(), 1, false, std::chrono::steady_clock::time_point::max());
+      std::unique_lock<std::mutex> lock(mtx);
+      if (!cv.wait_for(lock, std::chrono::seconds(1), [this]() { return is_probe_sent; }))
+      {
+        return -1;
+      }
+      return std::chrono::duration<double>(probe_sent - queued).count();
+    }
+
+    std::unique_ptr<SendScheduler> scheduler;
+
+  private:
+    std::mutex                               mtx;
+    std::condition_variable                  cv;
+    int                                      next_mid;
+    bool                                     is_probe_sent;
+    std::chrono::steady_clock::time_point    probe_sent;
+  };
+
+  void BM_QueueLatencyUnderLoad(benchmark::State& state, SendScheduler::Priority probe_priority)
+  {
+    LoadedScheduler loaded(probe_priority);
+    loaded.addLoad();
+    for (auto _ : state)
+    {
+      const double latency = loaded.sendProbe();
+      if (latency < 0)
+      {
+        state.SkipWithError("the probe message was not sent");
+        break;
+      }
+      state.SetIterationTime(latency);
+    }
+    loaded.scheduler->stop();
+    state.SetItemsProcessed(state.iterations());
+  }
+}
+
+BENCHMARK_CAPTURE(BM_QueueLatencyUnderLoad, high,   SendScheduler::HIGH)->UseManualTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_QueueLatencyUnderLoad, normal, SendScheduler::NORMAL)->UseManualTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_QueueLatencyUnderLoad, low,    SendScheduler::LOW)->UseManualTime()->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,158 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Round trips of a message over the transports to a co-located broker: TCP
+ * over the loopback interface, with and without Nagle's algorithm (tcp_nodelay),
+ * and a unix domain socket (unix_socket). The peer echoes every message, like
+ * a broker delivering a message back to its publisher, so the broker's own
+ * processing time is not part of the numbers.
+ */
+namespace
+{
+  enum Transport { TRANSPORT_TCP, TRANSPORT_TCP_NODELAY, TRANSPORT_UNIX };
+
+  bool transfer(int sock, char* data, size_t size, bool send_data)
+  {
+    size_t done = 0;
+    while (done < size)
+    {
+      const ssize_t result = send_data ? ::send(sock, data + done, size - done, MSG_NOSIGNAL) : ::recv(sock, data + done, size - done, 0);
+      if (result <= 0)
+      {
+        return false;
+      }
+      done += static_cast<size_t>(result);
+    }
+    return true;
+  }
+
+  class EchoPeer
+  {
+  public:
+    EchoPeer(Transport transport, size_t message_size)
+      : client(-1)
+      , is_connected(false)
+    {
+      int listener = -1;
+      std::string unix_path;
+      if (transport == TRANSPORT_UNIX)
+      {
+        char path[] = "/tmp/transport_benchmark_XXXXXX";
+        close(mkstemp(path));
+        unlink(path);
+        unix_path = path;
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+        listen(listener, 1);
+        client = socket(AF_UNIX, SOCK_STREAM, 0);
+        is_connected = connect(client, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+      }
+      else
+      {
+        struct sockaddr_in address = {};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        bind(listener, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+        getsockname(listener, reinterpret_cast<struct sockaddr*>(&address), &length);
+        listen(listener, 1);
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        is_connected = connect(client, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+      }
+      const int server = is_connected ? accept(listener, NULL, NULL) : -1;
+      close(listener);
+      if (!unix_path.empty())
+      {
+        unlink(unix_path.c_str());
+      }
+      if (transport == TRANSPORT_TCP_NODELAY)
+      {
+        int value = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+        setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+      }
+
+      thread = std::thread([server, message_size]()
+      {
+        std::vector<char> buffer(message_size);
+        while (transfer(server, buffer.data(), buffer.size(), false) && transfer(server, buffer.data(), buffer.size(), true))
+        {
+        }
+        close(server);
+      });
+    }
+
+    ~EchoPeer()
+    {
+      shutdown(client, SHUT_RDWR);
+      thread.join();
+      close(client);
+    }
+
+    int  client;
+    bool is_connected;
+
+  private:
+    std::thread thread;
+  };
+
+  void BM_RoundTrip(benchmark::State& state, Transport transport)
+  {
+    const size_t message_size = static_cast<size_t>(state.range(0));
+    EchoPeer peer(transport, message_size);
+    if (!peer.is_connected)
+    {
+      state.SkipWithError("the connection failed");
+      return;
+    }
+    std::vector<char> buffer(message_size, 'x');
+    for (auto _ : state)
+    {
+      if (!transfer(peer.client, buffer.data(), buffer.size(), true) || !transfer(peer.client, buffer.data(), buffer.size(), false))
+      {
+        state.SkipWithError("the connection failed");
+        break;
+      }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * message_size * 2));
+  }
+}
+
+BENCHMARK_CAPTURE(BM_RoundTrip, tcp,         TRANSPORT_TCP)->RangeMultiplier(16)->Range(64, 64 << 10)->UseRealTime();
+BENCHMARK_CAPTURE(BM_RoundTrip, tcp_nodelay, TRANSPORT_TCP_NODELAY)->RangeMultiplier(16)->Range(64, 64 << 10)->UseRealTime();
+BENCHMARK_CAPTURE(BM_RoundTrip, unix_socket, TRANSPORT_UNIX)->RangeMultiplier(16)->Range(64, 64 << 10)->UseRealTime();
@@ -22,18 +22,166 @@
 #include "ecal/pb/ecal.pb.h"
 #include <fstream>
 #include<iostream>
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/socket.h>   // setsockopt
+#include <netinet/in.h>   // IPPROTO_TCP
+#include <netinet/tcp.h>  // TCP_KEEPIDLE, TCP_KEEPINTVL, TCP_KEEPCNT
+
+// eCAL::Initialize / Finalize and mosquitto_lib_init / cleanup are reference counted, but not thread safe,
+// and the bridges are created in parallel
+static std::mutex library_init_mtx;
+
+// eCAL keeps one registration callback per process, so a single dispatcher forwards the registrations to every bridge that needs descriptors
+static std::mutex        registration_mtx;
+static std::set<Bridge*> registration_listeners;
+
+// a message published to an echo topic is recognized if the broker sends it back within this time (MQTT v3)
+static const std::chrono::seconds ECHO_WINDOW(5);
+static const size_t ECHO_FINGERPRINTS = 65536;
+
+// how long a deliberate disconnect waits for the PUBACK of the Sparkplug NDEATH
+static const std::chrono::milliseconds DEATH_ACK_TIMEOUT(1000);
+
+// a random positive id per bridge, the eCAL publishers of other processes send 0
+static long long randomOriginId()
+{
+	std::random_device random;
+	const uint64_t id = (static_cast<uint64_t>(random()) << 32) | random();
+	return static_cast<long long>(id >> 1) | 1;
+}
+
+// FNV-1a over the topic and the payload
+static uint64_t fingerprint(const std::string& topic, int payloadlen, const void* payload)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	auto add = [&hash](const uint8_t* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	// including the terminating zero, which separates the topic from the payload
+	add(reinterpret_cast<const uint8_t*>(topic.c_str()), topic.size() + 1);
+	add(static_cast<const uint8_t*>(payload), static_cast<size_t>(payloadlen));
+	return hash;
+}
+
+/** @return true if the payloads of the MQTT -> eCAL route are decoded as protobuf messages, to convert or to filter them */
+/** @return the topics and qos of a subscription file, one "<qos> <topic>" per line; empty if the file does not exist */
+static std::map<std::string, int> readSubscriptions(const std::string& path)
+{
+	std::map<std::string, int> topics;
+	if (path.empty())
+	{
+		return topics;
+	}
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t separator = line.find(' ');
+		if (separator != std::string::npos && separator + 1 < line.size())
+		{
+			topics[line.substr(separator + 1)] = std::atoi(line.substr(0, separator).c_str());
+		}
+	}
+	return topics;
+}
+
+/** @brief Replaces the subscription file, a crash while writing leaves the previous one */
+static bool writeSubscriptions(const std::string& path, const std::map<std::string, int>& topics)
+{
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::trunc);
+		for (auto const& topic : topics)
+		{
+			file << topic.second << ' ' << topic.first << '\n';
+		}
+		file.flush();
+		if (!file)
+		{
+			return false;
+		}
+	}
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+static bool isIngestRoute(const MqttTopic& topic)
+{
+	return topic.input_format != "binary" || !topic.filter.empty();
+}
+
+/** @return true if the eCAL -> MQTT route selects fields, filters or aggregates its messages, which needs the descriptor of the channel */
+static bool isProjectionRoute(const EcalTopic& topic)
+{
+	return !topic.fields.empty() || !topic.filter.empty() || !topic.aggregate_fields.empty();
+}
+
+/** @return true if the projection, filter and aggregator compiled for one route can be used for the other */
+static bool isSameProjection(const EcalTopic& a, const EcalTopic& b)
+{
+	return a.ecal_topic_name == b.ecal_topic_name && a.fields == b.fields && a.filter == b.filter && a.aggregate_fields == b.aggregate_fields
+		&& a.aggregate_window_ms == b.aggregate_window_ms && a.aggregate_step_ms == b.aggregate_step_ms && a.aggregate_functions == b.aggregate_functions;
+}
 
 Bridge::Bridge(int argc, char** argv,const Broker& broker, const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics, const GeneralSettings& general_settings, bool verbose)
-	: mosquittopp(broker.id.c_str(), true /* clean session */)
+	: MqttClient(broker.id.c_str(), broker.clean_session)
 	, general_settings(general_settings)
-	, mqtt2ecal_topics(mqtt2ecal_topics)
-	, ecal2mqtt_topics(ecal2mqtt_topics)
 	, broker_settings(broker)
-	, mqtt_desc_thread(&Bridge::descriptorUpdateLoop, this)
-	, mqtt_desc_thread_active(true)
+	, routes(std::make_shared<Routes>(mqtt2ecal_topics, ecal2mqtt_topics))
+	, mqtt_desc_thread_active(false)
+	, timer_thread_active(false)
+	, is_timer_changed(false)
+	, is_registration_callback_added(false)
 	, is_initialized(false)
+	, is_ecal_initialized(false)
+	, is_session_present(false)
 	, is_connected_to_mqtt_broker(false)
 	, loop_started(false)
+	, is_switching_endpoint(false)
+	, dropped_publish_counter(0)
+	, failed_publish_counter(0)
+	, is_qos_adaptive(false)
+	, qos_level(0)
+	, ack_latency(0)
+	, qos_level_since(std::chrono::steady_clock::now())
+	, calm_since(std::chrono::steady_clock::time_point::max())
+	, qos_level_time()
+	, qos_downgrades(0)
+	, qos_restores(0)
+	, downgraded_messages(0)
+	, death_mid(0)
+	, is_death_acknowledged(false)
+	, sender_id(std::random_device()())
+	, delivery(sender_id)
+	, ecal_origin_id(randomOriginId())
+	, is_echo_check_needed(false)
+	, suppressed_ecal_count(0)
+	, suppressed_mqtt_count(0)
+	, expired_on_receive(0)
+	, expired_at_publish(0)
+	, broker_max_packet_size(0)
+	, is_subscription_complete(false)
+	, is_first_connack(true)
+	, created(std::chrono::steady_clock::now())
+	, ecal_init_ms(-1)
+	, mqtt_init_ms(-1)
+	, connect_ms(-1)
+	, subscribe_ms(-1)
+	, is_waiting_for_first_message(false)
+	, reconnect_to_first_message_ms(-1)
 	, mqtt_rx_counter(0)
 	, ecal_rx_counter(0)
 	, verbose(verbose)
@@ -43,9 +191,131 @@ Bridge::Bridge(int argc, char** argv,const Broker& broker, const std::vector<Mqt
 
 void Bridge::initialize(int argc, char** argv)
 {
-	if (initEcal(argc, argv) == true && initMqtt() == true)
+	SendScheduler::Output output;
+	output.publish = [this](const std::string& topic, const char* data, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline, int& mid, int& sent_qos)
+	{
+		return publishToMqtt(topic, static_cast<int>(size), data, qos, retain, deadline, &mid, &sent_qos);
+	};
+	if (!broker_settings.store_directory.empty())
+	{
+		output.store = [this](const std::string& topic, const char* data, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)
+		{
+			store_replay->append(topic, data, size, qos, retain, deadline);
+		};
+	}
+	output.is_connected = [this]() { return is_connected_to_mqtt_broker.load(); };
+	// as long as there is a backlog, new messages are stored behind it to keep the order
+	output.is_storing   = [this]() { return store_replay && (!is_connected_to_mqtt_broker || store_replay->hasBacklog()); };
+	output.is_idle      = [this]()
+	{
+		std::lock_guard<std::mutex> lock(flow_control_mtx);
+		return getQueueDepthLocked() == 0;
+	};
+	// the send thread is started once the bandwidth limit or a route needs it
+	send_scheduler.reset(new SendScheduler(static_cast<size_t>(broker_settings.send_queue_limit), sender_id, output));
+	send_scheduler->setBandwidthLimit(broker_settings.bandwidth_limit, broker_settings.bandwidth_burst);
+
+	FailoverMonitor::Link link;
+	link.is_connected    = [this]() { return is_connected_to_mqtt_broker.load(); };
+	link.ping            = [this](int& mid) { return publish(&mid, broker_settings.health_check_topic.c_str(), 0, NULL, 1, false) == MOSQ_ERR_SUCCESS; };
+	link.switch_endpoint = [this]() { switchEndpoint(); };
+	failover.reset(new FailoverMonitor(broker_settings.endpoints, broker_settings.health_check_interval, broker_settings.health_check_timeout, broker_settings.failback_interval, link));
+	if (!broker_settings.sparkplug_edge_node_id.empty())
+	{
+		// Sparkplug messages belong to one connection (births, seq numbers), so they are never stored for later
+		sparkplug.reset(new SparkplugNode(broker_settings.sparkplug_group_id, broker_settings.sparkplug_edge_node_id,
+			[this](const std::string& topic, const std::string& payload)
+			{
+				if (is_connected_to_mqtt_broker)
+				{
+					publishToMqtt(topic, static_cast<int>(payload.size()), payload.data(), 0, false);
+				}
+			}));
+	}
+
+	auto phase_started = std::chrono::steady_clock::now();
+	bool ecal_initialized = initEcal(argc, argv);
+	ecal_init_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - phase_started).count());
+
+	phase_started = std::chrono::steady_clock::now();
+	bool mqtt_initialized = ecal_initialized && initStore() && initMqtt();
+	mqtt_init_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - phase_started).count());
+
+	if (mqtt_initialized)
 	{
 		is_initialized = true;
+		// the thread uses the routes and the MQTT connection, so it is started once both are set up
+		mqtt_desc_thread_active = true;
+		mqtt_desc_thread = std::thread(&Bridge::descriptorUpdateLoop, this);
+		timer_thread_active = true;
+		timer_thread = std::thread(&Bridge::timerLoop, this);
+		if (store_replay)
+		{
+			store_replay->start();
+		}
+		if (broker_settings.health_check_interval > 0)
+		{
+			failover->start();
+		}
+	}
+}
+
+bool Bridge::initStore()
+{
+	if (broker_settings.store_directory.empty())
+	{
+		return true;
+	}
+	const std::string directory = broker_settings.store_directory + "/" + broker_settings.name;
+	std::unique_ptr<MessageStore> message_store(new MessageStore(directory,
+		static_cast<size_t>(broker_settings.store_segment_size),
+		broker_settings.store_max_bytes,
+		broker_settings.store_max_age,
+		broker_settings.store_compaction == "latest_per_topic"));
+	if (!message_store->open())
+	{
+		printError("Failed to open message store in " + directory, errno);
+		return false;
+	}
+	printVerbose("Opened message store in " + directory + ", " + std::to_string(message_store->getBacklogCount()) + " messages waiting to be sent");
+	store_replay.reset(new StoreReplay(std::move(message_store), broker_settings.store_replay_rate, send_scheduler->getBandwidth(),
+		[this](const std::string& topic, const char* data, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)
+		{
+			return publishToMqtt(topic, static_cast<int>(size), data, qos, retain, deadline);
+		},
+		[this]() { return is_connected_to_mqtt_broker.load(); }));
+	return true;
+}
+
+void Bridge::addRegistrationListener()
+{
+	std::lock_guard<std::mutex> lock(registration_mtx);
+	if (registration_listeners.empty())
+	{
+		eCAL::Process::AddRegistrationCallback(reg_event_publisher, &Bridge::dispatchPublisherRegistration);
+	}
+	registration_listeners.insert(this);
+	is_registration_callback_added = true;
+}
+
+void Bridge::removeRegistrationListener()
+{
+	// a registration that is dispatched right now holds the lock, so the bridge is not used after this returns
+	std::lock_guard<std::mutex> lock(registration_mtx);
+	registration_listeners.erase(this);
+	if (registration_listeners.empty())
+	{
+		eCAL::Process::RemRegistrationCallback(reg_event_publisher);
+	}
+	is_registration_callback_added = false;
+}
+
+void Bridge::dispatchPublisherRegistration(const char* sample_, int sample_size_)
+{
+	std::lock_guard<std::mutex> lock(registration_mtx);
+	for (Bridge* bridge : registration_listeners)
+	{
+		bridge->onPublisherRegistration(sample_, sample_size_);
 	}
 }
 
@@ -62,11 +332,22 @@ void Bridge::onPublisherRegistration(const char* sample_, int sample_size_)
 
 		bool found_descriptor = false;
 		bool found_type       = false;
+		bool found_transcoded = false;
+		bool found_projected  = false;
 
-		for (auto topic : ecal2mqtt_topics)
+		auto current_routes = getRoutes();
+		for (auto const& topic : current_routes->ecal2mqtt_topics)
 		{
 			if (topic_name == topic.ecal_topic_name)
 			{
+				if (topic.output_format != "binary")
+				{
+					found_transcoded = true;
+				}
+				if (isProjectionRoute(topic))
+				{
+					found_projected = true;
+				}
 				if (!topic.mqtt_out_descriptor.empty())
  				{
 					found_descriptor = true;
@@ -91,6 +372,15 @@ void Bridge::onPublisherRegistration(const char* sample_, int sample_size_)
 			std::lock_guard<std::mutex> lock(mqtt_type_mtx);
 			mqtt_type_topics[current_type_topic.mqtt_out_type_name] = sample.topic().ttype();
 		}
+		if (found_transcoded)
+		{
+			// the transcoder caches the message factory by descriptor, so this is cheap for known types
+			transcoder->setDescriptor(topic_name, sample.topic().ttype(), sample.topic().tdesc());
+		}
+		if (found_projected)
+		{
+			updateProjections(topic_name, sample.topic().ttype(), sample.topic().tdesc());
+		}
 	}
 }
 
@@ -100,74 +390,44 @@ bool Bridge::initEcal(int argc, char** argv)
 	printVerbose(add_spacing("eCAL settings"));
 	printVerbose("Process name: " + general_settings.ecal_process_name);
 
-	if (eCAL::Initialize(argc, argv, general_settings.ecal_process_name.c_str()) == -1)
-	{
-		printError("Failed to initialize eCAL");
-		return false;
-	}
-	// Create eCAL Subscribers
-	auto callback = std::bind(&Bridge::ecalMessageReceived, this, std::placeholders::_1, std::placeholders::_2);
-	for (auto topic : ecal2mqtt_topics)
-	{
-		eCAL::CSubscriber* sub = new eCAL::CSubscriber(topic.ecal_topic_name);
-		sub->AddReceiveCallback(callback);
-		ecal_subscribers.push_back(sub);
-		printVerbose("Creating eCAL subscriber : " + topic.ecal_topic_name);
-	}
-	// Create eCAL Publishers
-	for (auto topic : mqtt2ecal_topics)
 	{
-		std::string topic_type = "";
-
-		if (!topic.static_ecal_type_name.empty())
+		std::lock_guard<std::mutex> lock(library_init_mtx);
+		if (eCAL::Initialize(argc, argv, general_settings.ecal_process_name.c_str()) == -1)
 		{
-			topic_type = topic.static_ecal_type_name;
+			printError("Failed to initialize eCAL");
+			return false;
 		}
-
-		printVerbose("Creating eCAL publisher : " + topic.ecal_out_topic_name + " (" + topic_type + ")");
-		ecal_publishers[topic.ecal_out_topic_name] = (new eCAL::CPublisher(topic.ecal_out_topic_name, topic_type, ""));
 	}
+	// Create eCAL Subscribers and Publishers, the routes given to the constructor do not have any yet
+	auto initial_routes = getRoutes();
+	updateRoutes(initial_routes->mqtt2ecal_topics, initial_routes->ecal2mqtt_topics);
 
-	for (auto topic : ecal2mqtt_topics)
-	{
-		if (!topic.mqtt_out_descriptor.empty())
-		{
-			// If we need to send a descriptor info via MQTT we need a monitoring info to get the descriptor string, so we work with a event + registration callback
-			eCAL::Process::AddRegistrationCallback(reg_event_publisher, std::bind(&Bridge::onPublisherRegistration, this, std::placeholders::_1, std::placeholders::_2));
-			break;
-		}
-	}
+	// from now on MQTT messages can be forwarded; a resumed session may deliver queued messages right after the CONNACK
+	is_ecal_initialized = true;
 	return true;
 }
 
 void Bridge::descriptorUpdateLoop()
 {
-	bool found = false;
-	for (auto topic : ecal2mqtt_topics)
-	{
-		if (!topic.mqtt_out_descriptor.empty() || !topic.mqtt_out_type_name.empty())
-		{
-			found = true;
-		}
-	}
-	if (found)
+	// the routes may change on a reload, so the thread runs even if no route needs descriptors at the moment
 	{
 		while (mqtt_desc_thread_active == true)
 		{
 			// Iterate through
 			if (is_initialized && is_connected_to_mqtt_broker)
 			{
+				auto current_routes = getRoutes();
 				std::lock_guard<std::mutex> lock_desc(mqtt_desc_mtx);
 
 				// iterate through descriptors
 				for (auto const& mqtt_topic : mqtt_descriptor_topics)
 				{
 					// iterate through topics, find the corresponding one and publish it to mqtt
-					for (auto topic : ecal2mqtt_topics)
+					for (auto const& topic : current_routes->ecal2mqtt_topics)
 					{
 						if (topic.mqtt_out_descriptor == mqtt_topic.first)
 						{
-							publish(NULL, mqtt_topic.first.c_str(), static_cast<int>(mqtt_topic.second.size()), mqtt_topic.second.data(), topic.qos, topic.retain_flag);
+							publishToMqtt(mqtt_topic.first, static_cast<int>(mqtt_topic.second.size()), mqtt_topic.second.data(), topic.qos, topic.retain_flag);
 							std::this_thread::sleep_for(std::chrono::milliseconds(10));
 							break;
 						}
@@ -179,11 +439,11 @@ void Bridge::descriptorUpdateLoop()
 				for (auto const& mqtt_topic : mqtt_type_topics)
 				{
 					// iterate through topics, find the corresponding one and publish it to mqtt
-					for (auto topic : ecal2mqtt_topics)
+					for (auto const& topic : current_routes->ecal2mqtt_topics)
 					{
 						if (topic.mqtt_out_type_name == mqtt_topic.first)
 						{
-							publish(NULL, mqtt_topic.first.c_str(), static_cast<int>(mqtt_topic.second.size()), mqtt_topic.second.data(), topic.qos, topic.retain_flag);
+							publishToMqtt(mqtt_topic.first, static_cast<int>(mqtt_topic.second.size()), mqtt_topic.second.data(), topic.qos, topic.retain_flag);
 							std::this_thread::sleep_for(std::chrono::milliseconds(10));
 							break;
 						}
@@ -201,14 +461,31 @@ void Bridge::descriptorUpdateLoop()
 /* reconnect is the same as connect except for resetting the values (which are const here so it's ok)*/
 bool Bridge::connectOrReconnect(bool ignore_error)
 {
+	const BrokerEndpoint& endpoint = failover->getCurrentEndpoint();
+	// mosquitto connects to a unix domain socket if the port is 0 and the host is the socket path
+	const char* host = endpoint.unix_socket.size() > 0 ? endpoint.unix_socket.c_str() : endpoint.host.c_str();
+	const int   port = endpoint.unix_socket.size() > 0 ? 0 : endpoint.port;
+	const char* bind_ip = (endpoint.unix_socket.empty() && broker_settings.bind_ip.size() > 0) ? broker_settings.bind_ip.c_str() : NULL;
+
 	int connect_err = MOSQ_ERR_CONN_PENDING;
-	if (broker_settings.bind_ip.size() > 0)
+	if (general_settings.mqtt_protocol_version == "v5")
 	{
-		connect_err = connect(broker_settings.host.c_str(), broker_settings.port, broker_settings.keep_alive, broker_settings.bind_ip.c_str());
+		// the session expiry interval is a CONNECT property, which is only available with the (blocking) v5 connect
+		mosquitto_property* properties = NULL;
+		if (broker_settings.session_expiry_interval > 0)
+		{
+			mosquitto_property_add_int32(&properties, MQTT_PROP_SESSION_EXPIRY_INTERVAL, broker_settings.session_expiry_interval);
+		}
+		connect_err = connect_v5(host, port, broker_settings.keep_alive, bind_ip, properties);
+		mosquitto_property_free_all(&properties);
+	}
+	else if (bind_ip != NULL)
+	{
+		connect_err = connect(host, port, broker_settings.keep_alive, bind_ip);
 	}
 	else
 	{
-		connect_err = connect_async(broker_settings.host.c_str(), broker_settings.port, broker_settings.keep_alive);
+		connect_err = connect_async(host, port, broker_settings.keep_alive);
 	}
 	if (connect_err != MOSQ_ERR_SUCCESS)
 	{
@@ -225,9 +502,70 @@ bool Bridge::connectOrReconnect(bool ignore_error)
 
 	}
 	printVerbose("Successfully connect_async", connect_err);
+	// the socket exists once the connect was started, the options are applied before the first packets are sent
+	applySocketOptions();
 	return true;
 }
 
+void Bridge::applySocketOptions()
+{
+	// unix domain sockets have neither Nagle nor TCP keepalive, the buffer sizes still apply
+	int sock = socket();
+	if (sock < 0)
+	{
+		return;
+	}
+	if (broker_settings.socket_send_buffer > 0)
+	{
+		int value = broker_settings.socket_send_buffer;
+		if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &value, sizeof(value)) != 0)
+		{
+			printError("Failed to set socket send buffer size", errno);
+		}
+	}
+	if (broker_settings.socket_receive_buffer > 0)
+	{
+		int value = broker_settings.socket_receive_buffer;
+		if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)) != 0)
+		{
+			printError("Failed to set socket receive buffer size", errno);
+		}
+	}
+	if (broker_settings.tcp_keepalive && failover->getCurrentEndpoint().unix_socket.empty())
+	{
+		int value = 1;
+		if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof(value)) != 0)
+		{
+			printError("Failed to enable TCP keepalive", errno);
+			return;
+		}
+		if (broker_settings.tcp_keepalive_idle > 0)
+		{
+			value = broker_settings.tcp_keepalive_idle;
+			if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &value, sizeof(value)) != 0)
+			{
+				printError("Failed to set TCP keepalive idle time", errno);
+			}
+		}
+		if (broker_settings.tcp_keepalive_interval > 0)
+		{
+			value = broker_settings.tcp_keepalive_interval;
+			if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &value, sizeof(value)) != 0)
+			{
+				printError("Failed to set TCP keepalive interval", errno);
+			}
+		}
+		if (broker_settings.tcp_keepalive_count > 0)
+		{
+			value = broker_settings.tcp_keepalive_count;
+			if (setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &value, sizeof(value)) != 0)
+			{
+				printError("Failed to set TCP keepalive probe count", errno);
+			}
+		}
+	}
+}
+
 bool Bridge::exclusiveLoopStart()
 {
 	if (loop_started == false)
@@ -293,10 +631,14 @@ bool Bridge::initMqtt()
 	printVerbose("Host                           " + broker_settings.host);
 	printVerbose("Port                           " + std::to_string(broker_settings.port));
 	printVerbose("Keep alive                     " + std::to_string(broker_settings.keep_alive));
+	printVerbose("Max in-flight messages         " + std::to_string(broker_settings.max_inflight_messages));
+	printVerbose("Max queued messages            " + std::to_string(broker_settings.max_queued_messages));
 	printVerbose("Default qos                    " + std::to_string(broker_settings.default_qos));
 	printVerbose("Default retain flag            " + std::to_string(broker_settings.default_retain_flag));
 	printVerbose("ID                             " + broker_settings.id);
 	printVerbose("Randomize ID                   " + std::to_string(broker_settings.randomize_id));
+	printVerbose("Clean session                  " + std::to_string(broker_settings.clean_session));
+	printVerbose("Session expiry interval        " + std::to_string(broker_settings.session_expiry_interval));
 	printVerbose("Hide secrets                   " + std::to_string(general_settings.hide_secrets));
 	printVerbose("Username                       " + broker_settings.user);
 	if (general_settings.hide_secrets == true)
@@ -356,6 +698,19 @@ bool Bridge::initMqtt()
 		}
 	}
 	printVerbose("Binding IP                     " + broker_settings.bind_ip);
+	printVerbose("Unix socket                    " + broker_settings.unix_socket);
+	for (size_t i = 1; i < broker_settings.endpoints.size(); i++)
+	{
+		const auto& endpoint = broker_settings.endpoints[i];
+		printVerbose("Fallback endpoint              " + (endpoint.unix_socket.empty() ? endpoint.host + ":" + std::to_string(endpoint.port) : endpoint.unix_socket));
+	}
+	printVerbose("Health check interval          " + std::to_string(broker_settings.health_check_interval));
+	printVerbose("Health check timeout           " + std::to_string(broker_settings.health_check_timeout));
+	printVerbose("Failback interval              " + std::to_string(broker_settings.failback_interval));
+	printVerbose("TCP no delay                   " + std::to_string(broker_settings.tcp_nodelay));
+	printVerbose("Socket send buffer             " + std::to_string(broker_settings.socket_send_buffer));
+	printVerbose("Socket receive buffer          " + std::to_string(broker_settings.socket_receive_buffer));
+	printVerbose("TCP keepalive                  " + std::to_string(broker_settings.tcp_keepalive));
 	printVerbose("Ignore error on first connect  " + std::to_string(broker_settings.ignore_error_first_connect));
 
 	printVerbose("************************************************************************");
@@ -363,7 +718,11 @@ bool Bridge::initMqtt()
 
 	//************************ Initialize mosquitto lib *************************************/
 	printVerbose("Initializing mosqpp lib");
-	auto connect_err = mosqpp::lib_init();
+	int connect_err;
+	{
+		std::lock_guard<std::mutex> lock(library_init_mtx);
+		connect_err = mosquitto_lib_init();
+	}
 	if (connect_err != MOSQ_ERR_SUCCESS)
 	{
 		printError("Failed initialize mosqpp lib", connect_err, MOSQ_STR_ERROR);
@@ -375,7 +734,7 @@ bool Bridge::initMqtt()
 	int major = 0;
 	int minor = 0;
 	int revision = 0;
-	connect_err = mosqpp::lib_version(&major, &minor, &revision);
+	connect_err = mosquitto_lib_version(&major, &minor, &revision);
 	if (connect_err == 0)
 	{
 		printError("Failed to get lib version");
@@ -389,6 +748,10 @@ bool Bridge::initMqtt()
 	{
 		mqtt_version = MQTT_PROTOCOL_V311;
 	}
+	else if (general_settings.mqtt_protocol_version == "v5")
+	{
+		mqtt_version = MQTT_PROTOCOL_V5;
+	}
 	else if (general_settings.mqtt_protocol_version == "v3.1")
 	{
 		mqtt_version = MQTT_PROTOCOL_V31;
@@ -534,8 +897,49 @@ bool Bridge::initMqtt()
 		printVerbose("Sucessfully set TLS PSK", connect_err);
 	}
 
+	//************************ flow control *************************************/
+	connect_err = max_inflight_messages_set(static_cast<unsigned int>(broker_settings.max_inflight_messages));
+	if (connect_err != MOSQ_ERR_SUCCESS)
+	{
+		printError("Failed to set the maximum number of in-flight messages", connect_err, MOSQ_STR_ERROR);
+		return false;
+	}
+	if (broker_settings.receive_maximum > 0)
+	{
+		connect_err = int_option(MOSQ_OPT_RECEIVE_MAXIMUM, broker_settings.receive_maximum);
+		if (connect_err != MOSQ_ERR_SUCCESS)
+		{
+			printError("Failed to set receive maximum", connect_err, MOSQ_STR_ERROR);
+			return false;
+		}
+	}
+
+	//************************ TCP no delay *************************************/
+	if (broker_settings.tcp_nodelay)
+	{
+		connect_err = int_option(MOSQ_OPT_TCP_NODELAY, 1);
+		if (connect_err != MOSQ_ERR_SUCCESS)
+		{
+			printError("Failed to disable Nagle's algorithm", connect_err, MOSQ_STR_ERROR);
+			return false;
+		}
+		printVerbose("Successfully disabled Nagle's algorithm", connect_err);
+	}
+
+	//************************ Sparkplug B death certificate *************************************/
+	if (sparkplug)
+	{
+		connect_err = armDeath();
+		if (connect_err != MOSQ_ERR_SUCCESS)
+		{
+			printError("Failed to set the Sparkplug NDEATH will", connect_err, MOSQ_STR_ERROR);
+			return false;
+		}
+		printVerbose("Sparkplug edge node: " + broker_settings.sparkplug_group_id + "/" + broker_settings.sparkplug_edge_node_id);
+	}
+
 	//************************ host ip and port *************************************/
-	if ((broker_settings.host.size() == 0) || (broker_settings.port == 0))
+	if (broker_settings.endpoints.empty())
 	{
 		printError("Failed to connect_async: Host and / or port info missing");
 		return false;
@@ -559,12 +963,18 @@ bool Bridge::tryReconnectMqtt()
 	mqtt_rx_counter = 0;
 
 	/************************ reconnecting to broker *************************************/
-	if ((broker_settings.host.size() == 0) || (broker_settings.port == 0))
+	if (broker_settings.endpoints.empty())
 	{
 	  printError("Failed to reconnect: Host and / or port info missing");
 	  return false;
 	}
 	printVerbose("Reconnecting...");
+	std::lock_guard<std::mutex> lock(connection_mtx);
+	if (is_switching_endpoint)
+	{
+		// the failover connects to the next endpoint
+		return false;
+	}
 	if (connectOrReconnect() == false)
 	{
 	  return false;
@@ -575,9 +985,28 @@ bool Bridge::tryReconnectMqtt()
 }
 
 // on MQTT Message
-void Bridge::on_message(const struct mosquitto_message* message)
+void Bridge::on_message(const struct mosquitto_message* message, const mosquitto_property* /*props*/)
 {
-	if ((is_initialized == false) || (is_connected_to_mqtt_broker == false))
+	if ((is_ecal_initialized == false) || (is_connected_to_mqtt_broker == false))
+	{
+		return;
+	}
+	if (is_waiting_for_first_message.exchange(false))
+	{
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - connected_since);
+		reconnect_to_first_message_ms = static_cast<int>(duration.count());
+		printVerbose("First MQTT message received " + std::to_string(reconnect_to_first_message_ms) + " ms after connecting");
+	}
+	if (sparkplug && sparkplug->getCommandTopic() == message->topic)
+	{
+		if (SparkplugNode::isRebirthRequest(message->payload, static_cast<size_t>(message->payloadlen)))
+		{
+			printVerbose("Sparkplug rebirth requested");
+			sparkplug->publishBirth();
+		}
+		return;
+	}
+	if (is_echo_check_needed && isEcho(message->topic, message->payloadlen, message->payload))
 	{
 		return;
 	}
@@ -589,7 +1018,14 @@ void Bridge::on_message(const struct mosquitto_message* message)
 	bool found_type       = false;
 	bool found_payload    = false;
 
-	for (auto topic : mqtt2ecal_topics)
+	auto current_routes = getRoutes();
+	auto nack_route = current_routes->nack_routes.find(message->topic);
+	if (nack_route != current_routes->nack_routes.end())
+	{
+		retransmit(nack_route->second, message->payload, message->payloadlen);
+		return;
+	}
+	for (auto const& topic : current_routes->mqtt2ecal_topics)
 	{
 		if (topic.mqtt_ecal_type_descriptor == std::string(message->topic))
 		{
@@ -612,29 +1048,47 @@ void Bridge::on_message(const struct mosquitto_message* message)
 	{
 		std::string descriptor(static_cast<char*>(message->payload), message->payloadlen);
 		auto hash = hasher(descriptor);
+		std::lock_guard<std::mutex> lock(from_mqtt_hash_mtx);
 		auto current_topic_hash = from_mqtt_desc_hash.find(std::string(message->topic));
 
 		if (current_topic_hash == from_mqtt_desc_hash.end() || current_topic_hash->second != hash)
 		{
 			from_mqtt_desc_hash[message->topic] = hash;
-			auto pub_it = ecal_publishers.find(current_topic.ecal_out_topic_name);
-			if (pub_it != ecal_publishers.end())
+			auto pub_it = current_routes->ecal_publishers.find(current_topic.ecal_out_topic_name);
+			if (pub_it != current_routes->ecal_publishers.end())
 			{
 				pub_it->second->SetDescription(descriptor);
 			}
+			// a descriptor file takes precedence over the descriptor received via MQTT
+			if (isIngestRoute(current_topic) && current_topic.descriptor_file.empty())
+			{
+				std::string error;
+				auto converter = createIngestConverter(current_topic.input_format, current_topic.static_ecal_type_name, descriptor, current_topic.filter, error);
+				if (!converter)
+				{
+					printError("Descriptor received on " + std::string(message->topic) + " cannot be used for route " + current_topic.name + ": " + error);
+				}
+				std::lock_guard<std::mutex> ingest_lock(ingest_mtx);
+				auto route = ingest_routes.find(current_topic.name);
+				if (route != ingest_routes.end() && converter)
+				{
+					route->second.converter = std::move(converter);
+				}
+			}
 		}
 	}
 	else if (found_type)
 	{
 		std::string topic_type(static_cast<char*>(message->payload), message->payloadlen);
 		auto hash = hasher(topic_type);
+		std::lock_guard<std::mutex> lock(from_mqtt_hash_mtx);
 		auto current_topic_hash = from_mqtt_type_hash.find(std::string(message->topic));
 
 		if (current_topic_hash == from_mqtt_type_hash.end() || current_topic_hash->second != hash)
 		{
 			from_mqtt_type_hash[message->topic] = hash;
-			auto pub_it = ecal_publishers.find(current_topic.ecal_out_topic_name);
-			if (pub_it != ecal_publishers.end())
+			auto pub_it = current_routes->ecal_publishers.find(current_topic.ecal_out_topic_name);
+			if (pub_it != current_routes->ecal_publishers.end())
 			{
 				pub_it->second->SetTypeName(topic_type);
 			}
@@ -642,160 +1096,1808 @@ void Bridge::on_message(const struct mosquitto_message* message)
 	}
 	else if (found_payload)
 	{
-		auto pub_it = ecal_publishers.find(current_topic.ecal_out_topic_name);
-		if (pub_it != ecal_publishers.end())
+		auto pub_it = current_routes->ecal_publishers.find(current_topic.ecal_out_topic_name);
+		if (pub_it != current_routes->ecal_publishers.end())
 		{
 			mqtt_rx_counter++;
-			pub_it->second->Send(message->payload, message->payloadlen);
-		}
-	}
-}
-
-// on MQTT Connect
-void Bridge::on_connect(int rc)
-{
-	printVerbose("on_connect rc: " + std::to_string(rc));
-	switch (rc)
-	{
-	case 0:
-	{
-		printVerbose("Successfully connected to MQTT Broker");
-		// Connect the "normal" mqtt subscriber
-		for (auto topic : mqtt2ecal_topics)
-		{
-			int subscribe_err = subscribe(NULL, topic.mqtt_payload_name.c_str(), topic.qos);
-			if (subscribe_err == MOSQ_ERR_SUCCESS)
+			const void* payload    = message->payload;
+			int         payloadlen = message->payloadlen;
+			if (current_topic.reassemble_chunks)
 			{
-				printVerbose("Successfully subscribed MQTT topic: " + topic.mqtt_payload_name);
+				// only complete messages are published, chunks of different messages may arrive interleaved
+				const char* complete = nullptr;
+				size_t      complete_size = 0;
+				if (!reassembler->add(message->topic, static_cast<const char*>(message->payload), static_cast<size_t>(message->payloadlen), complete, complete_size))
+				{
+					return;
+				}
+				payload    = complete;
+				payloadlen = static_cast<int>(complete_size);
 			}
-			else
+			// without a sequence number only the payload tells a redelivery apart
+			if (current_topic.deduplicate && !current_topic.envelope && delivery.isDuplicate(current_topic, fingerprint(message->topic, payloadlen, payload)))
 			{
-				printError("Failed to subscribe to mqtt topic \"" + topic.mqtt_payload_name + "\"", subscribe_err, MOSQ_STR_ERROR);
 				return;
 			}
-		}
-		// Connect the "descriptor" mqtt subscriber
-		for (auto topic : mqtt2ecal_topics)
-		{
-			if (topic.mqtt_ecal_type_descriptor.size() > 0)
+			long long send_time = -1;
+			if (current_topic.envelope)
 			{
-				int subscribe_err = subscribe(NULL, topic.mqtt_ecal_type_descriptor.c_str(), topic.qos);
-				if (subscribe_err == MOSQ_ERR_SUCCESS)
-				{
-					printVerbose("Successfully subscribed MQTT topic: " + topic.mqtt_ecal_type_descriptor);
-				}
-				else
+				// the envelope is put in front of the whole message, so it is removed after the reassembly
+				MessageEnvelope envelope;
+				bool is_nack_due = false;
+				Nack nack;
+				const DeliveryTracker::Verdict verdict = delivery.unwrap(current_topic, payload, static_cast<size_t>(payloadlen), eCAL::Time::GetMicroSeconds(), envelope, is_nack_due, nack);
+				if (verdict == DeliveryTracker::INVALID)
 				{
-					printError("Failed to subscribe to mqtt topic \"" + topic.mqtt_ecal_type_descriptor + "\"", subscribe_err, MOSQ_STR_ERROR);
 					return;
 				}
-			}
-		}
-		// Connect the "type" mqtt subscriber
-		for (auto topic : mqtt2ecal_topics)
-		{
-			if (topic.mqtt_ecal_type_name.size() > 0)
-			{
-				int subscribe_err = subscribe(NULL, topic.mqtt_ecal_type_name.c_str(), topic.qos);
-				if (subscribe_err == MOSQ_ERR_SUCCESS)
+				if (is_nack_due)
 				{
-					printVerbose("Successfully subscribed MQTT topic: " + topic.mqtt_ecal_type_name);
+					sendNack(current_topic.nack_topic, nack);
 				}
-				else
+				if (verdict == DeliveryTracker::DUPLICATE && current_topic.deduplicate)
 				{
-					printError("Failed to subscribe to mqtt topic \"" + topic.mqtt_ecal_type_name + "\"", subscribe_err, MOSQ_STR_ERROR);
 					return;
 				}
+				payload    = static_cast<const char*>(payload) + MessageEnvelope::SIZE;
+				payloadlen = payloadlen - static_cast<int>(MessageEnvelope::SIZE);
+				send_time  = envelope.send_time;
+			}
+			if (isIngestRoute(current_topic))
+			{
+				publishConvertedToEcal(current_topic.name, *pub_it->second, payload, payloadlen, send_time);
+			}
+			else
+			{
+				pub_it->second->Send(payload, payloadlen, send_time);
 			}
 		}
-		is_connected_to_mqtt_broker = true;
-		break;
 	}
-	case 1:
+}
+
+void Bridge::publishConvertedToEcal(const std::string& route_name, const eCAL::CPublisher& publisher, const void* payload, int payloadlen, long long send_time)
+{
+	std::lock_guard<std::mutex> lock(ingest_mtx);
+	auto route = ingest_routes.find(route_name);
+	if (route == ingest_routes.end())
 	{
-		printError("Connection refused while connecting to MQTT Broker (unacceptable protocol version)");
-		break;
+		return;
 	}
-	case 2:
+	IngestRoute& ingest = route->second;
+	if (!ingest.converter)
 	{
-		printError("Connection refused while connecting to MQTT Broker (identifier rejected)");
-		break;
+		ingest.dropped_no_descriptor++;
+		return;
 	}
-	case 3:
+
+	auto started = std::chrono::steady_clock::now();
+	IngestConverter& converter = *ingest.converter;
+	const char* message = static_cast<const char*>(payload);
+	size_t      size    = static_cast<size_t>(payloadlen);
+	bool converted = false;
+	std::string error;
+	if (ingest.input_format == "binary")
 	{
-		printError("Connection refused while connecting to MQTT Broker (broker unavailable)");
-		break;
+		// only filtered, the payload is the protobuf message already
+		converted = true;
 	}
-	case 4:
+	else if (converter.json_encoder)
 	{
-		printError("Connection refused while connecting to MQTT Broker (bad user name or password)");
-		break;
+		converted = converter.json_encoder->encode(static_cast<const char*>(payload), static_cast<size_t>(payloadlen), ingest_buffer);
+		if (!converted)
+		{
+			error = converter.json_encoder->getError();
+		}
 	}
-	case 5:
+	else
 	{
-		printError("Connection refused while connecting to MQTT Broker (not authorised)");
-		break;
+		converter.message->Clear();
+		converted = CborMsgpackCodec::decode(static_cast<const char*>(payload), static_cast<size_t>(payloadlen), converter.binary_format, *converter.message, error)
+			&& converter.message->SerializeToString(&ingest_buffer);
 	}
-	default:
+	if (!converted)
+	{
+		ingest.parse_errors++;
+		ingest.last_error = error;
+		return;
+	}
+	if (ingest.input_format != "binary")
+	{
+		ingest.latency.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+		ingest.converted_count++;
+		message = ingest_buffer.data();
+		size    = ingest_buffer.size();
+	}
+
+	if (converter.filter)
+	{
+		bool matches = false;
+		if (!converter.filter->evaluate(message, size, matches))
+		{
+			ingest.parse_errors++;
+			ingest.last_error = "malformed protobuf message";
+			return;
+		}
+		if (!matches)
+		{
+			ingest.filtered_count++;
+			return;
+		}
+		ingest.passed_count++;
+	}
+	publisher.Send(message, size, send_time);
+}
+
+std::unique_ptr<Bridge::IngestConverter> Bridge::createIngestConverter(const std::string& input_format, const std::string& type_name, const std::string& descriptor, const std::string& filter, std::string& error)
+{
+	std::unique_ptr<IngestConverter> converter(new IngestConverter());
+	converter->schema = ProtobufSchema::build(type_name, descriptor);
+	if (!converter->schema)
+	{
+		error = "the descriptor does not contain " + type_name;
+		return nullptr;
+	}
+	if (!filter.empty())
+	{
+		converter->filter = FilterExpression::compile(converter->schema, filter, error);
+		if (!converter->filter)
+		{
+			error = "invalid filter: " + error;
+			return nullptr;
+		}
+	}
+	if (input_format == "binary")
+	{
+		// the payload is only filtered
+	}
+	else if (input_format == "json")
+	{
+		converter->json_encoder.reset(new JsonProtobufEncoder(converter->schema));
+	}
+	else if (CborMsgpackCodec::parseFormat(input_format, converter->binary_format))
+	{
+		converter->message.reset(converter->schema->prototype->New());
+	}
+	else
+	{
+		error = "unknown input_format " + input_format;
+		return nullptr;
+	}
+	return converter;
+}
+
+// on MQTT Connect
+void Bridge::on_connect(int rc, int flags, const mosquitto_property* props)
+{
+	printVerbose("on_connect rc: " + std::to_string(rc) + ", flags: " + std::to_string(flags));
+	switch (rc)
+	{
+	case 0:
+	{
+		printVerbose("Successfully connected to MQTT Broker");
+		// again for the sockets of the automatic reconnects
+		applySocketOptions();
+
+		connected_since = std::chrono::steady_clock::now();
+		is_waiting_for_first_message = true;
+		failover->onConnected();
+
+		// SUBSCRIBE packets must not exceed the maximum packet size the broker reports (MQTT v5)
+		uint32_t max_packet_size = 0;
+		mosquitto_property_read_int32(props, MQTT_PROP_MAXIMUM_PACKET_SIZE, &max_packet_size, false);
+		broker_max_packet_size = max_packet_size;
+
+		// With a persistent session the broker still knows our subscriptions (and has queued the messages for them)
+		is_session_present = (broker_settings.clean_session == false) && ((flags & 0x01) != 0);
+		{
+			std::lock_guard<std::mutex> lock(subscription_mtx);
+			is_subscription_complete = false;
+			if (is_session_present && !is_first_connack)
+			{
+				printVerbose("Broker resumed the previous session, only changed subscriptions are sent");
+			}
+			else
+			{
+				pending_subscriptions.clear();
+				subscription_results.clear();
+				subscribed_topics.clear();
+			}
+			if (is_session_present && is_first_connack)
+			{
+				// the session was created by a previous run of the bridge, maybe with other routes: every topic is subscribed again
+				// and the topics of the previous run that are no longer used are unsubscribed
+				printVerbose("Broker resumed the session of a previous run, all subscriptions are sent");
+				subscribed_topics = readSubscriptions(getSubscriptionFile());
+				for (auto& topic : subscribed_topics)
+				{
+					topic.second = -1;
+				}
+			}
+			is_first_connack = false;
+		}
+		// set before subscribing, so a concurrent route update cannot miss this connection
+		is_connected_to_mqtt_broker = true;
+		send_scheduler->wake();
+		updateSubscriptions();
+		if (sparkplug)
+		{
+			sparkplug->publishBirth();
+		}
+		if (connect_ms < 0)
+		{
+			connect_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(connected_since - created).count());
+		}
+		{
+			std::lock_guard<std::mutex> lock(subscription_mtx);
+			if (pending_subscriptions.empty())
+			{
+				subscriptionsCompleteLocked();
+			}
+		}
+		if (store_replay)
+		{
+			store_replay->wake();
+		}
+		break;
+	}
+	case 1:
+	{
+		printError("Connection refused while connecting to MQTT Broker (unacceptable protocol version)");
+		break;
+	}
+	case 2:
+	{
+		printError("Connection refused while connecting to MQTT Broker (identifier rejected)");
+		break;
+	}
+	case 3:
+	{
+		printError("Connection refused while connecting to MQTT Broker (broker unavailable)");
+		break;
+	}
+	case 4:
+	{
+		printError("Connection refused while connecting to MQTT Broker (bad user name or password)");
+		break;
+	}
+	case 5:
+	{
+		printError("Connection refused while connecting to MQTT Broker (not authorised)");
+		break;
+	}
+	default:
 	{
 		printError("Connection Error unknown: " + std::to_string(rc));
 		break;
 	}
 	}
 }
-//
-//// on MQTT Disconnect
-void Bridge::on_disconnect(int rc)
+std::map<std::string, int> Bridge::getSubscriptionTopics(const Routes& routes) const
+{
+	// a topic used by several routes is subscribed once with the highest qos
+	std::map<std::string, int> topics;
+	for (auto const& topic : routes.mqtt2ecal_topics)
+	{
+		for (auto const& name : { topic.mqtt_payload_name, topic.mqtt_ecal_type_descriptor, topic.mqtt_ecal_type_name })
+		{
+			if (name.empty())
+			{
+				continue;
+			}
+			auto it = topics.find(name);
+			if (it == topics.end() || it->second < topic.qos)
+			{
+				topics[name] = topic.qos;
+			}
+		}
+	}
+	if (sparkplug)
+	{
+		topics.insert({ sparkplug->getCommandTopic(), 0 });
+	}
+	// a lost NACK is sent again after the nack_interval of the receiver
+	for (auto const& route : routes.nack_routes)
+	{
+		topics.insert({ route.first, 0 });
+	}
+	return topics;
+}
+
+std::vector<std::vector<std::string>> Bridge::splitIntoPackets(const std::vector<std::string>& topics, size_t bytes_per_topic) const
+{
+	// (UN)SUBSCRIBE packets must not exceed the maximum packet size of the broker, which is
+	// reported in the CONNACK (MQTT v5) or configured by the user
+	size_t max_packet_size = 268435455; // largest packet size the MQTT remaining length can encode
+	if (broker_settings.max_packet_size > 0)
+	{
+		max_packet_size = static_cast<size_t>(broker_settings.max_packet_size);
+	}
+	if (broker_max_packet_size > 0)
+	{
+		max_packet_size = std::min(max_packet_size, static_cast<size_t>(broker_max_packet_size));
+	}
+	// fixed header (5 bytes at most), packet identifier (2 bytes) and v5 property length (1 byte)
+	const size_t packet_overhead = 8;
+
+	std::vector<std::vector<std::string>> packets;
+	size_t packet_size = packet_overhead;
+	for (auto const& topic : topics)
+	{
+		if (packets.empty() || (!packets.back().empty() && packet_size + topic.size() + bytes_per_topic > max_packet_size))
+		{
+			packets.emplace_back();
+			packet_size = packet_overhead;
+		}
+		packets.back().push_back(topic);
+		packet_size += topic.size() + bytes_per_topic;
+	}
+	return packets;
+}
+
+void Bridge::updateSubscriptions()
+{
+	std::lock_guard<std::mutex> lock(subscription_mtx);
+	auto topics = getSubscriptionTopics(*getRoutes());
+
+	// group the new topics by qos, as one SUBSCRIBE request of mosquitto carries a single qos
+	std::map<int, std::vector<std::string>> topics_by_qos;
+	for (auto const& topic : topics)
+	{
+		auto subscribed = subscribed_topics.find(topic.first);
+		if (subscribed == subscribed_topics.end() || subscribed->second != topic.second)
+		{
+			topics_by_qos[topic.second].push_back(topic.first);
+		}
+	}
+	std::vector<std::string> unused_topics;
+	for (auto const& topic : subscribed_topics)
+	{
+		if (topics.count(topic.first) == 0)
+		{
+			unused_topics.push_back(topic.first);
+		}
+	}
+
+	if (!topics_by_qos.empty() && pending_subscriptions.empty())
+	{
+		subscribe_started = std::chrono::steady_clock::now();
+	}
+	// the broker does not send our own messages back (MQTT v5)
+	const int subscription_options = broker_settings.suppress_loops && general_settings.mqtt_protocol_version == "v5" ? MQTT_SUB_OPT_NO_LOCAL : 0;
+	for (auto const& qos_topics : topics_by_qos)
+	{
+		// every entry needs a 2 byte length, the topic and 1 byte options
+		for (auto const& packet : splitIntoPackets(qos_topics.second, 3))
+		{
+			std::vector<char*> batch;
+			for (auto const& topic : packet)
+			{
+				batch.push_back(const_cast<char*>(topic.c_str()));
+			}
+
+			int mid = 0;
+			int subscribe_err = subscribe_multiple(&mid, static_cast<int>(batch.size()), batch.data(), qos_topics.first, subscription_options);
+			if (subscribe_err == MOSQ_ERR_SUCCESS)
+			{
+				pending_subscriptions[mid] = packet;
+				printVerbose("Sent subscription request for " + std::to_string(batch.size()) + " MQTT topics with qos " + std::to_string(qos_topics.first));
+			}
+			else
+			{
+				// keep going, the remaining batches may still succeed
+				for (auto const& topic : packet)
+				{
+					subscription_results[topic] = SUBACK_FAILURE;
+				}
+				printError("Failed to subscribe to " + std::to_string(batch.size()) + " MQTT topics starting with \"" + packet.front() + "\"", subscribe_err, MOSQ_STR_ERROR);
+			}
+		}
+	}
+
+	// every entry needs a 2 byte length and the topic
+	for (auto const& packet : splitIntoPackets(unused_topics, 2))
+	{
+		std::vector<char*> batch;
+		for (auto const& topic : packet)
+		{
+			batch.push_back(const_cast<char*>(topic.c_str()));
+			subscription_results.erase(topic);
+		}
+
+		int unsubscribe_err = unsubscribe_multiple(NULL, static_cast<int>(batch.size()), batch.data());
+		if (unsubscribe_err == MOSQ_ERR_SUCCESS)
+		{
+			printVerbose("Sent unsubscribe request for " + std::to_string(batch.size()) + " MQTT topics");
+		}
+		else
+		{
+			printError("Failed to unsubscribe from " + std::to_string(batch.size()) + " MQTT topics starting with \"" + packet.front() + "\"", unsubscribe_err, MOSQ_STR_ERROR);
+		}
+	}
+	if (!pending_subscriptions.empty())
+	{
+		is_subscription_complete = false;
+	}
+	const std::string subscription_file = getSubscriptionFile();
+	if (!subscription_file.empty() && topics != subscribed_topics && !writeSubscriptions(subscription_file, topics))
+	{
+		printError("Failed to write the subscriptions to " + subscription_file, errno);
+	}
+	subscribed_topics = topics;
+}
+
+std::string Bridge::getSubscriptionFile() const
+{
+	if (broker_settings.clean_session || broker_settings.store_directory.empty())
+	{
+		return std::string();
+	}
+	return broker_settings.store_directory + "/" + broker_settings.name + "/subscriptions";
+}
+
+void Bridge::updateRoutes(const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics)
+{
+	// the transcoder has to exist before the first converting route is visible to the callbacks
+	bool uses_transcoder = std::any_of(ecal2mqtt_topics.begin(), ecal2mqtt_topics.end(), [](const EcalTopic& topic) { return topic.output_format != "binary"; });
+	if (uses_transcoder && !transcoder)
+	{
+		transcoder.reset(new PayloadTranscoder(static_cast<size_t>(broker_settings.json_worker_threads), static_cast<size_t>(broker_settings.json_queue_size),
+			[this](const std::string& mqtt_topic, const std::string& payload, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)
+			{
+				forwardToMqtt(mqtt_topic, static_cast<int>(payload.size()), payload.data(), qos, retain, deadline);
+			},
+			[this](const std::string& device_id, const google::protobuf::Message& message)
+			{
+				if (sparkplug)
+				{
+					sparkplug->update(device_id, message);
+				}
+			}));
+	}
+
+	// the reassembler has to exist before the first reassembling route is visible to the callbacks
+	bool reassembles = std::any_of(mqtt2ecal_topics.begin(), mqtt2ecal_topics.end(), [](const MqttTopic& topic) { return topic.reassemble_chunks; });
+	if (reassembles && !reassembler)
+	{
+		reassembler.reset(new ChunkReassembler(std::chrono::milliseconds(broker_settings.chunk_timeout), static_cast<size_t>(broker_settings.chunk_memory_limit)));
+	}
+	std::map<std::string, SendScheduler::Route> send_routes;   // by MQTT topic
+	for (auto const& topic : ecal2mqtt_topics)
+	{
+		if (topic.output_format != "sparkplug")
+		{
+			send_routes[topic.mqtt_out_payload_name] = { topic.name, SendScheduler::parsePriority(topic.priority), static_cast<size_t>(topic.chunk_size), topic.weight };
+		}
+	}
+	send_scheduler->setRoutes(send_routes);
+
+	auto old_routes = getRoutes();
+	auto new_routes = std::make_shared<Routes>(mqtt2ecal_topics, ecal2mqtt_topics);
+	checkLoops(*new_routes);
+	is_echo_check_needed = broker_settings.suppress_loops && general_settings.mqtt_protocol_version != "v5" && !new_routes->echo_topics.empty();
+	for (auto const& topic : ecal2mqtt_topics)
+	{
+		if (topic.adaptive_qos && topic.output_format != "sparkplug")
+		{
+			new_routes->adaptive_qos_topics.insert(topic.mqtt_out_payload_name);
+		}
+	}
+	is_qos_adaptive = !new_routes->adaptive_qos_topics.empty() && (broker_settings.qos_downgrade_outstanding > 0 || broker_settings.qos_downgrade_latency > 0);
+	for (auto const& topic : ecal2mqtt_topics)
+	{
+		if (!topic.nack_topic.empty())
+		{
+			new_routes->nack_routes[topic.nack_topic] = topic;
+		}
+	}
+	// the buffers and payload hashes of routes that no longer retransmit or deduplicate are released
+	delivery.retainRoutes(mqtt2ecal_topics, ecal2mqtt_topics);
+
+	// routes converting their payload to protobuf: the converters of unchanged routes are kept, the descriptor files of the others are loaded before the lock is taken
+	auto isUnchangedIngestRoute = [&old_routes](const MqttTopic& topic)
+	{
+		return std::any_of(old_routes->mqtt2ecal_topics.begin(), old_routes->mqtt2ecal_topics.end(), [&topic](const MqttTopic& old_topic)
+			{
+				return old_topic.name == topic.name && old_topic.input_format == topic.input_format && old_topic.filter == topic.filter
+					&& old_topic.static_ecal_type_name == topic.static_ecal_type_name && old_topic.descriptor_file == topic.descriptor_file;
+			});
+	};
+	std::vector<std::string> changed_ingest_routes;
+	std::map<std::string, std::unique_ptr<IngestConverter>> new_converters;
+	std::map<std::string, std::string> file_descriptors;  // by eCAL channel
+	for (auto const& topic : mqtt2ecal_topics)
+	{
+		if (!isIngestRoute(topic) || isUnchangedIngestRoute(topic))
+		{
+			continue;
+		}
+		changed_ingest_routes.push_back(topic.name);
+		if (topic.descriptor_file.empty())
+		{
+			continue;
+		}
+		std::ifstream file(topic.descriptor_file, std::ios::binary);
+		std::string descriptor((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		std::string error = "the file cannot be read";
+		auto converter = file.is_open() ? createIngestConverter(topic.input_format, topic.static_ecal_type_name, descriptor, topic.filter, error) : nullptr;
+		if (!converter)
+		{
+			printError("Descriptor file " + topic.descriptor_file + " of route " + topic.name + " cannot be used: " + error);
+			continue;
+		}
+		file_descriptors[topic.ecal_out_topic_name] = descriptor;
+		new_converters[topic.name] = std::move(converter);
+	}
+	{
+		// installed before the routes are swapped, so the callbacks find them for every converting route
+		std::lock_guard<std::mutex> lock(ingest_mtx);
+		std::map<std::string, IngestRoute> updated_routes;
+		for (auto const& topic : mqtt2ecal_topics)
+		{
+			if (!isIngestRoute(topic))
+			{
+				continue;
+			}
+			if (std::find(changed_ingest_routes.begin(), changed_ingest_routes.end(), topic.name) == changed_ingest_routes.end())
+			{
+				updated_routes[topic.name] = std::move(ingest_routes[topic.name]);
+				continue;
+			}
+			IngestRoute& route = updated_routes[topic.name];
+			route.input_format          = topic.input_format;
+			route.static_ecal_type_name = topic.static_ecal_type_name;
+			route.descriptor_file       = topic.descriptor_file;
+			route.filter                = topic.filter;
+			route.converter             = std::move(new_converters[topic.name]);
+		}
+		ingest_routes.swap(updated_routes);
+	}
+
+	// Keep the eCAL publishers of unchanged channels, so their subscribers do not notice the update
+	std::vector<std::string> new_publishers;
+	for (auto const& topic : mqtt2ecal_topics)
+	{
+		if (new_routes->ecal_publishers.count(topic.ecal_out_topic_name) > 0)
+		{
+			continue;
+		}
+		auto old_publisher = old_routes->ecal_publishers.find(topic.ecal_out_topic_name);
+		bool same_type = std::any_of(old_routes->mqtt2ecal_topics.begin(), old_routes->mqtt2ecal_topics.end(), [&topic](const MqttTopic& old_topic)
+			{
+				return old_topic.ecal_out_topic_name == topic.ecal_out_topic_name && old_topic.static_ecal_type_name == topic.static_ecal_type_name;
+			});
+		if (old_publisher != old_routes->ecal_publishers.end() && same_type)
+		{
+			new_routes->ecal_publishers[topic.ecal_out_topic_name] = old_publisher->second;
+			continue;
+		}
+		printVerbose("Creating eCAL publisher : " + topic.ecal_out_topic_name + " (" + topic.static_ecal_type_name + ")");
+		auto publisher = std::make_shared<eCAL::CPublisher>(topic.ecal_out_topic_name, topic.static_ecal_type_name, "");
+		if (broker_settings.suppress_loops)
+		{
+			publisher->SetID(ecal_origin_id);
+		}
+		new_routes->ecal_publishers[topic.ecal_out_topic_name] = publisher;
+		new_publishers.push_back(topic.ecal_out_topic_name);
+	}
+	for (auto const& descriptor : file_descriptors)
+	{
+		new_routes->ecal_publishers[descriptor.first]->SetDescription(descriptor.second);
+	}
+	for (auto const& publisher : old_routes->ecal_publishers)
+	{
+		if (new_routes->ecal_publishers.count(publisher.first) == 0)
+		{
+			printVerbose("Removing eCAL publisher : " + publisher.first);
+		}
+	}
+	{
+		// a new publisher (or payload converter) has to get the type and descriptor from MQTT again, even if they did not change
+		std::lock_guard<std::mutex> lock(from_mqtt_hash_mtx);
+		for (auto const& topic : mqtt2ecal_topics)
+		{
+			if (std::find(new_publishers.begin(), new_publishers.end(), topic.ecal_out_topic_name) != new_publishers.end()
+				|| std::find(changed_ingest_routes.begin(), changed_ingest_routes.end(), topic.name) != changed_ingest_routes.end())
+			{
+				from_mqtt_desc_hash.erase(topic.mqtt_ecal_type_descriptor);
+				from_mqtt_type_hash.erase(topic.mqtt_ecal_type_name);
+			}
+		}
+	}
+
+	{
+		// routes selecting fields, filtering or aggregating keep their projection, filter and open windows if these did not change, the others are compiled with the next registration of their publisher
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		std::map<std::string, ProjectionRoute> updated_projections;
+		for (auto const& topic : ecal2mqtt_topics)
+		{
+			if (!isProjectionRoute(topic))
+			{
+				continue;
+			}
+			auto old_projection = projection_routes.find(topic.name);
+			if (old_projection != projection_routes.end() && isSameProjection(old_projection->second.topic, topic))
+			{
+				updated_projections[topic.name] = std::move(old_projection->second);
+				updated_projections[topic.name].topic = topic;
+				continue;
+			}
+			updated_projections[topic.name].topic = topic;
+		}
+		projection_routes.swap(updated_projections);
+	}
+
+	if (sparkplug)
+	{
+		// known before the routes are swapped, so the first message of a new device is not lost
+		std::map<std::string, std::map<std::string, double>> devices;
+		for (auto const& topic : ecal2mqtt_topics)
+		{
+			if (topic.output_format == "sparkplug")
+			{
+				devices[topic.sparkplug_device_id] = topic.sparkplug_deadbands;
+			}
+		}
+		sparkplug->setDevices(devices);
+	}
+
+	// swap in the new routes; the old publishers are destroyed once the last callback using them is done
+	{
+		std::lock_guard<std::mutex> lock(routes_mtx);
+		routes = new_routes;
+	}
+	old_routes.reset();
+	wakeTimer();
+
+	// eCAL subscribers, one per channel
+	std::map<std::string, bool> ecal_channels;
+	for (auto const& topic : ecal2mqtt_topics)
+	{
+		ecal_channels[topic.ecal_topic_name] = true;
+	}
+	for (auto it = ecal_subscribers.begin(); it != ecal_subscribers.end();)
+	{
+		if (ecal_channels.count(it->first) == 0)
+		{
+			printVerbose("Removing eCAL subscriber : " + it->first);
+			delete it->second;
+			it = ecal_subscribers.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+	auto callback = std::bind(&Bridge::ecalMessageReceived, this, std::placeholders::_1, std::placeholders::_2);
+	for (auto const& channel : ecal_channels)
+	{
+		if (ecal_subscribers.count(channel.first) == 0)
+		{
+			eCAL::CSubscriber* sub = new eCAL::CSubscriber(channel.first);
+			sub->AddReceiveCallback(callback);
+			ecal_subscribers[channel.first] = sub;
+			printVerbose("Creating eCAL subscriber : " + channel.first);
+		}
+	}
+
+	if (!is_registration_callback_added)
+	{
+		for (auto const& topic : ecal2mqtt_topics)
+		{
+			if (!topic.mqtt_out_descriptor.empty() || topic.output_format != "binary" || isProjectionRoute(topic))
+			{
+				// If we need to send a descriptor info via MQTT or convert, project, filter or aggregate the payload we need a monitoring info to get the descriptor string, so we work with a event + registration callback
+				addRegistrationListener();
+				break;
+			}
+		}
+	}
+
+	// while disconnected, the subscriptions are updated on the next connect
+	if (is_connected_to_mqtt_broker)
+	{
+		updateSubscriptions();
+	}
+}
+
+std::shared_ptr<const Bridge::Routes> Bridge::getRoutes() const
+{
+	std::lock_guard<std::mutex> lock(routes_mtx);
+	return routes;
+}
+
+bool Bridge::hasSettings(const Broker& broker, const GeneralSettings& general_settings_) const
+{
+	return broker_settings == broker
+		&& general_settings.mqtt_protocol_version == general_settings_.mqtt_protocol_version
+		&& general_settings.ecal_process_name == general_settings_.ecal_process_name;
+}
+
+void Bridge::on_subscribe(int mid, int qos_count, const int* granted_qos)
+{
+	std::lock_guard<std::mutex> lock(subscription_mtx);
+	auto pending = pending_subscriptions.find(mid);
+	if (pending == pending_subscriptions.end())
+	{
+		return;
+	}
+
+	// the SUBACK holds one result per topic, in the order of the request
+	for (int i = 0; i < qos_count && i < static_cast<int>(pending->second.size()); i++)
+	{
+		subscription_results[pending->second[i]] = granted_qos[i];
+		if (granted_qos[i] >= SUBACK_FAILURE)
+		{
+			printError("Broker rejected the subscription of MQTT topic \"" + pending->second[i] + "\"", granted_qos[i], MOSQ_REASON_ERROR);
+		}
+		else
+		{
+			printVerbose("Successfully subscribed MQTT topic: " + pending->second[i] + " (granted qos " + std::to_string(granted_qos[i]) + ")");
+		}
+	}
+	pending_subscriptions.erase(pending);
+
+	if (pending_subscriptions.empty())
+	{
+		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - subscribe_started);
+		printVerbose("All " + std::to_string(subscription_results.size()) + " MQTT subscriptions acknowledged after " + std::to_string(duration.count()) + " ms");
+		subscriptionsCompleteLocked();
+	}
+}
+
+void Bridge::subscriptionsCompleteLocked()
+{
+	if (subscribe_ms < 0 && connect_ms >= 0)
+	{
+		subscribe_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - connected_since).count());
+	}
+	is_subscription_complete = true;
+	subscription_cv.notify_all();
+}
+
+bool Bridge::waitUntilReady(int timeout_ms)
+{
+	std::unique_lock<std::mutex> lock(subscription_mtx);
+	return subscription_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]()
+		{
+			return is_connected_to_mqtt_broker && is_subscription_complete;
+		});
+}
+
+bool Bridge::isReady() const
+{
+	std::lock_guard<std::mutex> lock(subscription_mtx);
+	return is_connected_to_mqtt_broker && is_subscription_complete;
+}
+
+std::string Bridge::getStartupTimings() const
+{
+	return "eCAL init " + std::to_string(ecal_init_ms) + " ms"
+		+ ", MQTT init " + std::to_string(mqtt_init_ms) + " ms"
+		+ ", connected after " + std::to_string(connect_ms) + " ms"
+		+ ", subscribed " + std::to_string(subscribe_ms) + " ms later";
+}
+
+int Bridge::getFailedSubscriptionCount() const
+{
+	std::lock_guard<std::mutex> lock(subscription_mtx);
+	return static_cast<int>(std::count_if(subscription_results.begin(), subscription_results.end(),
+		[](const std::pair<const std::string, int>& result) { return result.second >= SUBACK_FAILURE; }));
+}
+
+int Bridge::getReconnectToFirstMessageMs() const
+{
+	return reconnect_to_first_message_ms;
+}
+
+// errors that go away by themselves, the other ones come back when the message is sent again
+static bool isTransientPublishError(int publish_err)
+{
+	return publish_err == MOSQ_ERR_NO_CONN || publish_err == MOSQ_ERR_NOMEM;
+}
+
+PublishResult Bridge::publishToMqtt(const std::string& topic, int payloadlen, const void* payload, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline, int* mid_out, int* sent_qos)
+{
+	mosquitto_property* properties = NULL;
+	if (deadline != std::chrono::steady_clock::time_point::max())
+	{
+		const auto remaining = deadline - std::chrono::steady_clock::now();
+		if (remaining <= std::chrono::steady_clock::duration::zero())
+		{
+			expired_at_publish++;
+			return PUBLISH_EXPIRED;
+		}
+		if (general_settings.mqtt_protocol_version == "v5")
+		{
+			// the broker drops the message once the rest of its time (rounded up to seconds) is over
+			const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining + std::chrono::seconds(1) - std::chrono::steady_clock::duration(1));
+			mosquitto_property_add_int32(&properties, MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, static_cast<uint32_t>(seconds.count()));
+		}
+	}
+	if (qos > 0 && is_qos_adaptive)
+	{
+		qos = getAdaptedQos(topic, qos);
+	}
+	if (sent_qos)
+	{
+		*sent_qos = qos;
+	}
+	if (is_echo_check_needed)
+	{
+		// before the publish, the broker may send the message back before publish() returns
+		recordEcho(topic, payloadlen, payload);
+	}
+	if (qos == 0)
+	{
+		int publish_err = publish_v5(mid_out, topic.c_str(), payloadlen, payload, qos, retain, properties);
+		mosquitto_property_free_all(&properties);
+		return getPublishResult(publish_err);
+	}
+
+	// QoS 1/2 messages are tracked until they are acknowledged, which gives us the in-flight + queue depth
+	// the lock is held across the publish, so the acknowledge cannot be processed before the message is tracked
+	std::lock_guard<std::mutex> lock(flow_control_mtx);
+	if (broker_settings.max_queued_messages > 0 && getQueueDepthLocked() >= broker_settings.max_queued_messages)
+	{
+		mosquitto_property_free_all(&properties);
+		dropped_publish_counter++;
+		return PUBLISH_RETRY;
+	}
+	int mid = 0;
+	int publish_err = publish_v5(&mid, topic.c_str(), payloadlen, payload, qos, retain, properties);
+	mosquitto_property_free_all(&properties);
+	if (publish_err != MOSQ_ERR_SUCCESS)
+	{
+		return getPublishResult(publish_err);
+	}
+	outstanding_publishes[mid] = { std::chrono::steady_clock::now(), qos };
+	if (mid_out)
+	{
+		*mid_out = mid;
+	}
+	return PUBLISH_SENT;
+}
+
+PublishResult Bridge::getPublishResult(int publish_err)
+{
+	if (publish_err == MOSQ_ERR_SUCCESS)
+	{
+		return PUBLISH_SENT;
+	}
+	if (isTransientPublishError(publish_err))
+	{
+		return PUBLISH_RETRY;
+	}
+	failed_publish_counter++;
+	return PUBLISH_FAILED;
+}
+
+int Bridge::getQueueDepthLocked() const
+{
+	return static_cast<int>(outstanding_publishes.size()) - getInflightDepthLocked();
+}
+
+int Bridge::getInflightDepthLocked() const
+{
+	// mosquitto sends queued messages as soon as an in-flight slot is free, so the oldest outstanding messages are the in-flight ones
+	int outstanding = static_cast<int>(outstanding_publishes.size());
+	if (broker_settings.max_inflight_messages == 0)
+	{
+		return outstanding;
+	}
+	return std::min(outstanding, broker_settings.max_inflight_messages);
+}
+
+int Bridge::getAdaptedQos(const std::string& topic, int qos)
+{
+	if (getRoutes()->adaptive_qos_topics.count(topic) == 0)
+	{
+		return qos;
+	}
+	std::lock_guard<std::mutex> lock(flow_control_mtx);
+	updateQosLevelLocked(std::chrono::steady_clock::now());
+	const int adapted_qos = std::min(qos, 2 - qos_level);
+	if (adapted_qos < qos)
+	{
+		downgraded_messages++;
+	}
+	return adapted_qos;
+}
+
+void Bridge::updateQosLevelLocked(const std::chrono::steady_clock::time_point& now)
+{
+	if (now < next_qos_check)
+	{
+		return;
+	}
+	next_qos_check = now + std::chrono::milliseconds(100);
+
+	// the oldest unacknowledged message counts as well, its acknowledge may not come at all
+	const auto restore_interval = std::chrono::milliseconds(broker_settings.qos_restore_interval);
+	double latency = now - last_ack < restore_interval ? ack_latency : 0;
+	for (auto const& outstanding : outstanding_publishes)
+	{
+		latency = std::max(latency, static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(now - outstanding.second.sent).count()));
+	}
+	const int outstanding = static_cast<int>(outstanding_publishes.size());
+	auto isCongested = [&](double share)
+	{
+		return (broker_settings.qos_downgrade_outstanding > 0 && outstanding >= broker_settings.qos_downgrade_outstanding * share)
+			|| (broker_settings.qos_downgrade_latency > 0 && latency >= broker_settings.qos_downgrade_latency * 1000.0 * share);
+	};
+
+	int new_level = qos_level;
+	if (isCongested(1.0))
+	{
+		calm_since = std::chrono::steady_clock::time_point::max();
+		if (qos_level < 2 && now - qos_level_since >= std::chrono::seconds(1))
+		{
+			new_level = qos_level + 1;
+		}
+	}
+	else if (isCongested(0.5))
+	{
+		calm_since = std::chrono::steady_clock::time_point::max();
+	}
+	else if (calm_since == std::chrono::steady_clock::time_point::max())
+	{
+		calm_since = now;
+	}
+	else if (qos_level > 0 && now - calm_since >= restore_interval && now - qos_level_since >= restore_interval)
+	{
+		new_level = qos_level - 1;
+	}
+	if (new_level == qos_level)
+	{
+		return;
+	}
+
+	qos_level_time[qos_level] += now - qos_level_since;
+	qos_level_since = now;
+	if (new_level > qos_level)
+	{
+		qos_downgrades++;
+	}
+	else
+	{
+		qos_restores++;
+	}
+	qos_level = new_level;
+	static const char* const levels[] = { "restored", "limited to QoS 1", "limited to QoS 0" };
+	printOutput(std::string("QoS of the routes with adaptive_qos ") + levels[qos_level] + " (waiting for an acknowledge: " + std::to_string(outstanding)
+		+ ", acknowledge latency: " + std::to_string(static_cast<int64_t>(latency / 1000)) + " ms)");
+}
+
+std::string Bridge::getQosStatistics() const
+{
+	if (getRoutes()->adaptive_qos_topics.empty())
+	{
+		return std::string();
+	}
+	std::lock_guard<std::mutex> lock(flow_control_mtx);
+	auto level_time = qos_level_time;
+	level_time[qos_level] += std::chrono::steady_clock::now() - qos_level_since;
+	auto toSeconds = [](const std::chrono::steady_clock::duration& duration)
+	{
+		return std::to_string(std::chrono::duration_cast<std::chrono::seconds>(duration).count()) + " s";
+	};
+	static const char* const levels[] = { "unchanged", "at most QoS 1", "QoS 0" };
+	return std::string("currently ") + levels[qos_level]
+		+ ", time unchanged: " + toSeconds(level_time[0])
+		+ ", at most QoS 1: " + toSeconds(level_time[1])
+		+ ", QoS 0: " + toSeconds(level_time[2])
+		+ ", " + std::to_string(qos_downgrades) + " downgrades, " + std::to_string(qos_restores) + " restores"
+		+ ", " + std::to_string(downgraded_messages) + " messages sent with a lower QoS";
+}
+
+std::string Bridge::getFlowControlStatistics() const
+{
+	std::lock_guard<std::mutex> lock(flow_control_mtx);
+	return "in-flight: " + std::to_string(getInflightDepthLocked())
+		+ ", queued: " + std::to_string(getQueueDepthLocked())
+		+ ", dropped: " + std::to_string(dropped_publish_counter)
+		+ ", failed: " + std::to_string(failed_publish_counter)
+		+ ", PUBACK latency: " + puback_latency.toString()
+		+ ", PUBCOMP latency: " + pubcomp_latency.toString();
+}
+
+void Bridge::on_publish(int mid, int /*reason_code*/)
+{
+	bool is_acknowledged = false;
+	{
+		// QoS 1 messages are completed by the PUBACK, QoS 2 messages by the PUBCOMP
+		std::lock_guard<std::mutex> lock(flow_control_mtx);
+		auto outstanding = outstanding_publishes.find(mid);
+		if (outstanding != outstanding_publishes.end())
+		{
+			auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - outstanding->second.sent).count();
+			if (outstanding->second.qos == 1)
+			{
+				puback_latency.add(latency);
+			}
+			else
+			{
+				pubcomp_latency.add(latency);
+			}
+			outstanding_publishes.erase(outstanding);
+			is_acknowledged = true;
+			ack_latency = last_ack == std::chrono::steady_clock::time_point() ? latency : ack_latency * 0.875 + latency * 0.125;
+			last_ack    = std::chrono::steady_clock::now();
+		}
+	}
+	failover->onPublished(mid);
+	if (is_acknowledged)
+	{
+		// a ping waiting behind a backlog of QoS 1/2 messages is not a broker failure
+		failover->onAcknowledged();
+	}
+	// QoS 0 messages are reported once written to the socket
+	send_scheduler->onPublished(mid);
+	if (sparkplug)
+	{
+		std::lock_guard<std::mutex> lock(death_mtx);
+		if (death_mid != 0 && mid == death_mid)
+		{
+			is_death_acknowledged = true;
+			death_cv.notify_all();
+		}
+	}
+}
+
+void Bridge::switchEndpoint()
+{
+	publishDeath();
+	{
+		// only the state is changed under the lock, the reconnect of the main loop must not wait for the blocking connect
+		std::lock_guard<std::mutex> lock(connection_mtx);
+		is_switching_endpoint = true;
+		is_connected_to_mqtt_broker = false;
+	}
+	// stop the mosquitto loop, otherwise it keeps reconnecting to the old endpoint
+	disconnect();
+	loop_stop(true);
+	// the QoS 0 chunks of the old connection are not reported anymore, the on_disconnect of the stopped loop may not run
+	send_scheduler->onDisconnected();
+	const bool is_connect_started = connectOrReconnect(true);
+
+	std::lock_guard<std::mutex> lock(connection_mtx);
+	loop_started = false;
+	if (is_connect_started)
+	{
+		exclusiveLoopStart();
+	}
+	is_switching_endpoint = false;
+}
+
+void Bridge::publishDeath()
+{
+	if (!sparkplug)
+	{
+		return;
+	}
+	if (is_connected_to_mqtt_broker)
+	{
+		// the PUBACK is matched under the lock, so it cannot arrive before the mid is known
+		const std::string death_payload = sparkplug->getDeathPayload();
+		std::unique_lock<std::mutex> lock(death_mtx);
+		is_death_acknowledged = false;
+		if (publish(&death_mid, sparkplug->getDeathTopic().c_str(), static_cast<int>(death_payload.size()), death_payload.data(), 1, false) == MOSQ_ERR_SUCCESS)
+		{
+			if (!death_cv.wait_for(lock, DEATH_ACK_TIMEOUT, [this]() { return is_death_acknowledged; }))
+			{
+				printError("The Sparkplug NDEATH was not acknowledged within " + std::to_string(DEATH_ACK_TIMEOUT.count()) + " ms");
+			}
+		}
+		death_mid = 0;
+	}
+	// the next connection announces the next bdSeq
+	sparkplug->setOffline();
+	armDeath();
+}
+
+int Bridge::armDeath()
+{
+	const std::string death_payload = sparkplug->getDeathPayload();
+	return will_set(sparkplug->getDeathTopic().c_str(), static_cast<int>(death_payload.size()), death_payload.data(), 1, false);
+}
+
+int Bridge::getLastFailoverMs() const
+{
+	return failover->getLastFailoverMs();
+}
+
+int Bridge::getFailoverCounter() const
+{
+	return failover->getFailoverCounter();
+}
+
+//
+//// on MQTT Disconnect
+void Bridge::on_disconnect(int rc)
+{
+	printVerbose("on_disconnect rc: " + std::to_string(rc));
+	if (rc == 0)
+	{
+		printError("disconnected from mqtt broker");
+	}
+	else
+	{
+		printError("connection to mqtt broker was closed unexpectedly: " + std::to_string(rc));
+	}
+	is_connected_to_mqtt_broker = false;
+	// mosquitto does not report the QoS 0 chunks it could not send anymore
+	send_scheduler->onDisconnected();
+	if (sparkplug)
+	{
+		// the broker has sent the NDEATH of the lost connection, the next one announces the next bdSeq
+		sparkplug->setOffline();
+		armDeath();
+	}
+}
+
+void Bridge::on_log(int level, const char* str)
+{
+	std::string level_str = "[UNKNOWN] ";
+	switch (level)
+	{
+	case MOSQ_LOG_INFO:
+		level_str = "[INFO]    ";
+		break;
+	case MOSQ_LOG_NOTICE:
+		level_str = "[NOTICE]  ";
+		break;
+	case MOSQ_LOG_WARNING:
+		level_str = "[WARNING] ";
+		break;
+	case MOSQ_LOG_ERR:
+		level_str = "[ERROR]   ";
+		break;
+	case MOSQ_LOG_DEBUG:
+		level_str = "[DEBUG]   ";
+		break;
+	default:
+		break;
+	}
+	printVerbose(level_str + std::string(str));
+}
+
+// on eCAL Message
+void Bridge::ecalMessageReceived(const char* topic_name_, const struct eCAL::SReceiveCallbackData* data_)
+{
+	if (!is_initialized) return;
+	if (!is_connected_to_mqtt_broker && !store_replay) return;
+	if (broker_settings.suppress_loops && data_->id == ecal_origin_id)
+	{
+		// sent by one of our own publishers
+		suppressed_ecal_count++;
+		return;
+	}
+	auto current_routes = getRoutes();
+	for (auto const& topic : current_routes->ecal2mqtt_topics)
+	{
+		if (topic.ecal_topic_name == std::string(topic_name_)) {
+			const auto deadline = getDeadline(topic, data_->time);
+			if (topic.aggregate_fields.empty() && deadline <= std::chrono::steady_clock::now())
+			{
+				// delivered late by eCAL, or the clocks of the sender and the bridge differ
+				expired_on_receive++;
+				continue;
+			}
+			const void* payload = data_->buf;
+			size_t      size    = static_cast<size_t>(data_->size);
+			if (!topic.fields.empty() || !topic.filter.empty())
+			{
+				// checked before anything is queued; only the fields used are decoded, the rest of the message is skipped
+				thread_local std::string projected;
+				if (!selectPayload(topic.name, payload, size, projected))
+				{
+					continue;
+				}
+			}
+			if (!topic.aggregate_fields.empty())
+			{
+				// only the aggregates of the closed windows are published
+				thread_local std::vector<std::string> windows;
+				windows.clear();
+				aggregatePayload(topic.name, payload, size, data_->time, windows);
+				for (auto const& window : windows)
+				{
+					// a window is as old as its publish, not as the sample that closed it
+					forwardToMqtt(topic.mqtt_out_payload_name, static_cast<int>(window.size()), window.data(), topic.qos, topic.retain_flag,
+						topic.max_age_ms > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(topic.max_age_ms) : std::chrono::steady_clock::time_point::max());
+				}
+				continue;
+			}
+			PayloadTranscoder::OutputFormat format;
+			if (PayloadTranscoder::parseFormat(topic.output_format, format))
+			{
+				// decoding is done by the transcoder threads, so the eCAL callback is not blocked
+				const std::string& target = format == PayloadTranscoder::SPARKPLUG ? topic.sparkplug_device_id : topic.mqtt_out_payload_name;
+				transcoder->transcode(topic.ecal_topic_name, target, format, payload, size, topic.qos, topic.retain_flag, deadline);
+			}
+			else if (topic.envelope)
+			{
+				thread_local std::string enveloped;
+				delivery.wrap(topic, data_->time, data_->clock, payload, size, enveloped);
+				forwardToMqtt(topic.mqtt_out_payload_name, static_cast<int>(enveloped.size()), enveloped.data(), topic.qos, topic.retain_flag, deadline);
+			}
+			else
+			{
+				forwardToMqtt(topic.mqtt_out_payload_name, static_cast<int>(size), payload, topic.qos, topic.retain_flag, deadline);
+			}
+		}
+	}
+	ecal_rx_counter++;
+}
+
+std::chrono::steady_clock::time_point Bridge::getDeadline(const EcalTopic& topic, int64_t send_time_us)
+{
+	if (topic.max_age_ms <= 0)
+	{
+		return std::chrono::steady_clock::time_point::max();
+	}
+	// the send time is in eCAL time, the queues use the steady clock
+	const int64_t remaining_us = send_time_us + static_cast<int64_t>(topic.max_age_ms) * 1000 - eCAL::Time::GetMicroSeconds();
+	return std::chrono::steady_clock::now() + std::chrono::microseconds(remaining_us);
+}
+
+void Bridge::forwardToMqtt(const std::string& topic, int payloadlen, const void* payload, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)
+{
+	if (deadline <= std::chrono::steady_clock::now())
+	{
+		// e.g. converted too late
+		expired_on_receive++;
+		return;
+	}
+	if (send_scheduler->isUsed())
+	{
+		send_scheduler->queue(topic, payload, static_cast<size_t>(payloadlen), qos, retain, deadline);
+		return;
+	}
+	// as long as there is a backlog, new messages are queued behind it to keep the order
+	if (store_replay && (!is_connected_to_mqtt_broker || store_replay->hasBacklog()))
+	{
+		store_replay->append(topic, payload, static_cast<size_t>(payloadlen), qos, retain, deadline);
+		return;
+	}
+	if (is_connected_to_mqtt_broker)
+	{
+		publishToMqtt(topic, payloadlen, payload, qos, retain, deadline);
+	}
+}
+
+void Bridge::setBandwidthLimit(unsigned long long bits_per_second, unsigned long long burst)
+{
+	send_scheduler->setBandwidthLimit(bits_per_second, burst);
+}
+
+void Bridge::recordEcho(const std::string& topic, int payloadlen, const void* payload)
+{
+	if (getRoutes()->echo_topics.count(topic) == 0)
+	{
+		return;
+	}
+	const uint64_t hash = fingerprint(topic, payloadlen, payload);
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(echo_mtx);
+	echo_fingerprints.emplace_back(now, hash);
+	while (echo_fingerprints.size() > ECHO_FINGERPRINTS || now - echo_fingerprints.front().first > ECHO_WINDOW)
+	{
+		echo_fingerprints.pop_front();
+	}
+}
+
+bool Bridge::isEcho(const std::string& topic, int payloadlen, const void* payload)
 {
-	printVerbose("on_disconnect rc: " + std::to_string(rc));
-	if (rc == 0)
+	if (getRoutes()->echo_topics.count(topic) == 0)
 	{
-		printError("disconnected from mqtt broker");
+		return false;
 	}
-	else
+	const uint64_t hash = fingerprint(topic, payloadlen, payload);
+	const auto now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(echo_mtx);
+	while (!echo_fingerprints.empty() && now - echo_fingerprints.front().first > ECHO_WINDOW)
 	{
-		printError("connection to mqtt broker was closed unexpectedly: " + std::to_string(rc));
+		echo_fingerprints.pop_front();
 	}
-	is_connected_to_mqtt_broker = false;
+	// the broker sends the messages back in order, so the fingerprint is usually one of the first
+	auto echo = std::find_if(echo_fingerprints.begin(), echo_fingerprints.end(), [hash](const std::pair<std::chrono::steady_clock::time_point, uint64_t>& entry) { return entry.second == hash; });
+	if (echo == echo_fingerprints.end())
+	{
+		return false;
+	}
+	echo_fingerprints.erase(echo);
+	suppressed_mqtt_count++;
+	return true;
 }
 
-void Bridge::on_log(int level, const char* str)
+void Bridge::checkLoops(Routes& routes)
 {
-	std::string level_str = "[UNKNOWN] ";
-	switch (level)
+	for (auto const& ecal2mqtt : routes.ecal2mqtt_topics)
 	{
-	case MOSQ_LOG_INFO:
-		level_str = "[INFO]    ";
-		break;
-	case MOSQ_LOG_NOTICE:
-		level_str = "[NOTICE]  ";
-		break;
-	case MOSQ_LOG_WARNING:
-		level_str = "[WARNING] ";
-		break;
-	case MOSQ_LOG_ERR:
-		level_str = "[ERROR]   ";
-		break;
-	case MOSQ_LOG_DEBUG:
-		level_str = "[DEBUG]   ";
-		break;
-	default:
-		break;
+		if (ecal2mqtt.output_format == "sparkplug")
+		{
+			continue;
+		}
+		for (auto const& mqtt2ecal : routes.mqtt2ecal_topics)
+		{
+			bool matches = false;
+			mosquitto_topic_matches_sub(mqtt2ecal.mqtt_payload_name.c_str(), ecal2mqtt.mqtt_out_payload_name.c_str(), &matches);
+			if (!matches)
+			{
+				continue;
+			}
+			routes.echo_topics.insert(ecal2mqtt.mqtt_out_payload_name);
+			if (mqtt2ecal.ecal_out_topic_name != ecal2mqtt.ecal_topic_name)
+			{
+				continue;
+			}
+			const std::string loop = "Routes " + ecal2mqtt.name + " and " + mqtt2ecal.name + " forward eCAL topic " + ecal2mqtt.ecal_topic_name
+				+ " via MQTT topic " + ecal2mqtt.mqtt_out_payload_name + " back to itself";
+			if (broker_settings.suppress_loops)
+			{
+				printOutput(loop + ", the messages of the bridge are not forwarded again");
+			}
+			else
+			{
+				printError(loop + ", every message is forwarded in circles (suppress_loops is disabled)");
+			}
+		}
 	}
-	printVerbose(level_str + std::string(str));
 }
 
-// on eCAL Message
-void Bridge::ecalMessageReceived(const char* topic_name_, const struct eCAL::SReceiveCallbackData* data_)
+std::string Bridge::getChunkStatistics() const
 {
-	if (!is_initialized || !is_connected_to_mqtt_broker) return;
-	for (auto topic : ecal2mqtt_topics)
+	std::string statistics = send_scheduler->getChunkStatistics();
+	if (reassembler)
 	{
-		if (topic.ecal_topic_name == std::string(topic_name_)) {
-			publish(NULL, topic.mqtt_out_payload_name.c_str(), data_->size, data_->buf, topic.qos, topic.retain_flag);
+		statistics += (statistics.empty() ? "" : "; ") + reassembler->getStatistics();
+	}
+	return statistics;
+}
+
+void Bridge::retransmit(const EcalTopic& route, const void* payload, int payloadlen)
+{
+	std::vector<std::string> messages;
+	delivery.collectRetransmits(route.name, payload, static_cast<size_t>(payloadlen), messages);
+	for (auto const& message : messages)
+	{
+		// sent like a new message, a message older than max_age_ms is not sent again
+		MessageEnvelope envelope;
+		envelope.read(message.data(), message.size());
+		forwardToMqtt(route.mqtt_out_payload_name, static_cast<int>(message.size()), message.data(), route.qos, route.retain_flag, getDeadline(route, envelope.send_time));
+	}
+}
+
+void Bridge::sendNack(const std::string& nack_topic, const Nack& nack)
+{
+	thread_local std::string packet;
+	nack.write(packet);
+	publishToMqtt(nack_topic, static_cast<int>(packet.size()), packet.data(), 0, false);
+}
+
+std::chrono::steady_clock::time_point Bridge::sendDueNacks()
+{
+	auto current_routes = getRoutes();
+	const auto now = std::chrono::steady_clock::now();
+	auto next = std::chrono::steady_clock::time_point::max();
+	for (auto const& topic : current_routes->mqtt2ecal_topics)
+	{
+		if (topic.nack_topic.empty())
+		{
+			continue;
+		}
+		next = std::min(next, now + std::chrono::milliseconds(std::max(topic.nack_interval, 1)));
+		Nack nack;
+		if (is_connected_to_mqtt_broker && delivery.getDueNack(topic.name, now, nack))
+		{
+			sendNack(topic.nack_topic, nack);
 		}
 	}
-	ecal_rx_counter++;
+	return next;
+}
+
+std::string Bridge::getExpiryStatistics() const
+{
+	auto current_routes = getRoutes();
+	if (std::none_of(current_routes->ecal2mqtt_topics.begin(), current_routes->ecal2mqtt_topics.end(), [](const EcalTopic& topic) { return topic.max_age_ms > 0; }))
+	{
+		return std::string();
+	}
+	return std::to_string(expired_on_receive) + " on receive, "
+		+ std::to_string(send_scheduler->getExpiredCount()) + " in the send queue, "
+		+ std::to_string(store_replay ? store_replay->getExpiredCount() : 0) + " in the message store, "
+		+ std::to_string(expired_at_publish) + " before the publish";
+}
+
+std::string Bridge::getLoopStatistics() const
+{
+	if (getRoutes()->echo_topics.empty() && suppressed_ecal_count == 0)
+	{
+		return std::string();
+	}
+	return std::to_string(suppressed_ecal_count) + " eCAL messages of the bridge dropped, "
+		+ (general_settings.mqtt_protocol_version == "v5" ? std::string("MQTT messages of the bridge are not sent back (No Local)")
+			: std::to_string(suppressed_mqtt_count) + " MQTT messages of the bridge dropped");
+}
+
+std::string Bridge::getTranscoderStatistics() const
+{
+	return transcoder ? transcoder->getStatistics() : std::string();
+}
+
+bool Bridge::selectPayload(const std::string& route_name, const void*& payload, size_t& size, std::string& buffer)
+{
+	std::shared_ptr<const FieldProjection>  projection;
+	std::shared_ptr<const FilterExpression> filter;
+	{
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		auto route = projection_routes.find(route_name);
+		if (route == projection_routes.end())
+		{
+			return false;
+		}
+		projection = route->second.projection;
+		filter     = route->second.filter_expression;
+		if ((!projection && !route->second.topic.fields.empty()) || (!filter && !route->second.topic.filter.empty()))
+		{
+			route->second.dropped_no_descriptor++;
+			return false;
+		}
+	}
+
+	// the filter refers to the complete message, so it is evaluated before the projection
+	bool matches = true;
+	bool is_valid = !filter || filter->evaluate(static_cast<const char*>(payload), size, matches);
+	const bool is_projected = is_valid && matches && projection;
+	if (is_projected)
+	{
+		is_valid = projection->project(static_cast<const char*>(payload), size, buffer);
+	}
+
+	std::lock_guard<std::mutex> lock(projection_mtx);
+	auto route = projection_routes.find(route_name);
+	if (route == projection_routes.end())
+	{
+		return false;
+	}
+	if (!is_valid)
+	{
+		route->second.parse_errors++;
+		return false;
+	}
+	if (filter)
+	{
+		(matches ? route->second.passed_count : route->second.filtered_count)++;
+	}
+	if (is_projected)
+	{
+		route->second.projected_count++;
+		route->second.bytes_in  += size;
+		route->second.bytes_out += buffer.size();
+		payload = buffer.data();
+		size    = buffer.size();
+	}
+	return matches;
+}
+
+void Bridge::aggregatePayload(const std::string& route_name, const void* payload, size_t size, int64_t time_us, std::vector<std::string>& windows)
+{
+	std::shared_ptr<WindowAggregator> aggregator;
+	{
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		auto route = projection_routes.find(route_name);
+		if (route == projection_routes.end())
+		{
+			return;
+		}
+		aggregator = route->second.aggregator;
+		if (!aggregator)
+		{
+			route->second.dropped_no_descriptor++;
+			return;
+		}
+	}
+	// the aggregator counts malformed messages itself
+	aggregator->add(static_cast<const char*>(payload), size, time_us, windows);
+}
+
+std::chrono::steady_clock::time_point Bridge::flushAggregations()
+{
+	std::vector<std::pair<std::shared_ptr<WindowAggregator>, EcalTopic>> aggregating_routes;
+	{
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		for (auto const& route : projection_routes)
+		{
+			if (route.second.aggregator)
+			{
+				aggregating_routes.push_back(std::make_pair(route.second.aggregator, route.second.topic));
+			}
+		}
+	}
+	const auto now = std::chrono::steady_clock::now();
+	auto next = std::chrono::steady_clock::time_point::max();
+	std::vector<std::string> windows;
+	for (auto const& route : aggregating_routes)
+	{
+		windows.clear();
+		route.first->flushIdle(now, windows);
+		for (auto const& window : windows)
+		{
+			forwardToMqtt(route.second.mqtt_out_payload_name, static_cast<int>(window.size()), window.data(), route.second.qos, route.second.retain_flag,
+				route.second.max_age_ms > 0 ? now + std::chrono::milliseconds(route.second.max_age_ms) : std::chrono::steady_clock::time_point::max());
+		}
+		next = std::min(next, route.first->getIdleDeadline(now));
+	}
+	return next;
+}
+
+void Bridge::timerLoop()
+{
+	std::unique_lock<std::mutex> lock(timer_mtx);
+	while (timer_thread_active)
+	{
+		is_timer_changed = false;
+		lock.unlock();
+		const auto next = std::min(flushAggregations(), sendDueNacks());
+		lock.lock();
+		auto is_woken = [this]() { return !timer_thread_active || is_timer_changed; };
+		if (next == std::chrono::steady_clock::time_point::max())
+		{
+			// neither aggregating routes nor routes with nack_topic, until the routes change
+			timer_cv.wait(lock, is_woken);
+		}
+		else
+		{
+			timer_cv.wait_until(lock, next, is_woken);
+		}
+	}
+}
+
+void Bridge::wakeTimer()
+{
+	std::lock_guard<std::mutex> lock(timer_mtx);
+	is_timer_changed = true;
+	timer_cv.notify_all();
+}
+
+void Bridge::updateProjections(const std::string& ecal_topic_name, const std::string& type_name, const std::string& descriptor)
+{
+	// the publishers register periodically, usually with the same descriptor
+	const size_t hash = hasher(type_name) ^ hasher(descriptor);
+	std::map<std::string, EcalTopic> changed_routes;
+	{
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		for (auto const& route : projection_routes)
+		{
+			if (route.second.topic.ecal_topic_name == ecal_topic_name && route.second.descriptor_hash != hash)
+			{
+				changed_routes[route.first] = route.second.topic;
+			}
+		}
+	}
+	if (changed_routes.empty())
+	{
+		return;
+	}
+
+	auto schema = ProtobufSchema::build(type_name, descriptor);
+	for (auto const& changed_route : changed_routes)
+	{
+		const EcalTopic& topic = changed_route.second;
+		std::string error;
+		std::shared_ptr<const FieldProjection>  projection;
+		std::shared_ptr<const FilterExpression> filter_expression;
+		std::shared_ptr<WindowAggregator>       aggregator;
+		if (!schema)
+		{
+			error = "the descriptor of " + ecal_topic_name + " does not contain " + type_name;
+			printError("Cannot select, filter or aggregate the fields of route " + changed_route.first + ": " + error);
+		}
+		else
+		{
+			if (!topic.fields.empty())
+			{
+				projection = FieldProjection::compile(schema, topic.fields, error);
+				if (!projection)
+				{
+					printError("Cannot select the fields of route " + changed_route.first + ": " + error);
+				}
+			}
+			if (!topic.filter.empty() && error.empty())
+			{
+				filter_expression = FilterExpression::compile(schema, topic.filter, error);
+				if (!filter_expression)
+				{
+					error = "invalid filter: " + error;
+					printError("Cannot apply the filter of route " + changed_route.first + ": " + error);
+				}
+			}
+			if (!topic.aggregate_fields.empty() && error.empty())
+			{
+				int functions = 0;
+				WindowAggregator::parseFunctions(topic.aggregate_functions, functions);
+				const int step_ms = topic.aggregate_step_ms > 0 ? topic.aggregate_step_ms : topic.aggregate_window_ms;
+				aggregator = WindowAggregator::compile(schema, topic.aggregate_fields, int64_t(topic.aggregate_window_ms) * 1000, int64_t(step_ms) * 1000, functions, error);
+				if (!aggregator)
+				{
+					printError("Cannot aggregate the fields of route " + changed_route.first + ": " + error);
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		auto route = projection_routes.find(changed_route.first);
+		if (route != projection_routes.end() && isSameProjection(route->second.topic, topic))
+		{
+			route->second.descriptor_hash   = hash;
+			route->second.projection        = projection;
+			route->second.filter_expression = filter_expression;
+			route->second.aggregator        = aggregator;
+			route->second.error             = error;
+		}
+	}
+	// a new aggregator has windows to close
+	wakeTimer();
+}
+
+std::map<std::string, std::string> Bridge::getProjectionStatistics() const
+{
+	std::map<std::string, std::string> statistics;
+	std::lock_guard<std::mutex> lock(projection_mtx);
+	for (auto const& route : projection_routes)
+	{
+		const ProjectionRoute& projection = route.second;
+		if (projection.topic.fields.empty())
+		{
+			continue;
+		}
+		std::ostringstream ratio;
+		ratio << std::fixed << std::setprecision(1) << (projection.bytes_in > 0 ? 100.0 * static_cast<double>(projection.bytes_out) / static_cast<double>(projection.bytes_in) : 0.0) << "%";
+
+		std::string summary = std::to_string(projection.projected_count) + " projected, "
+			+ std::to_string(projection.bytes_in) + " -> " + std::to_string(projection.bytes_out) + " bytes (" + ratio.str() + "), "
+			+ std::to_string(projection.parse_errors) + " malformed, "
+			+ std::to_string(projection.dropped_no_descriptor) + " without descriptor";
+		if (!projection.error.empty())
+		{
+			summary += ", error: " + projection.error;
+		}
+		statistics[route.first] = summary;
+	}
+	return statistics;
+}
+
+std::string Bridge::getSparkplugStatistics() const
+{
+	return sparkplug ? sparkplug->getStatistics() : std::string();
+}
+
+std::map<std::string, std::string> Bridge::getIngestStatistics() const
+{
+	std::map<std::string, std::string> statistics;
+	std::lock_guard<std::mutex> lock(ingest_mtx);
+	for (auto const& route : ingest_routes)
+	{
+		const IngestRoute& ingest = route.second;
+		if (ingest.input_format == "binary")
+		{
+			continue;
+		}
+		const uint64_t received = ingest.converted_count + ingest.parse_errors;
+		std::ostringstream error_rate;
+		error_rate << std::fixed << std::setprecision(2) << (received > 0 ? 100.0 * static_cast<double>(ingest.parse_errors) / static_cast<double>(received) : 0.0) << "%";
+
+		std::string summary = std::to_string(ingest.converted_count) + " converted, "
+			+ std::to_string(ingest.parse_errors) + " parse errors (" + error_rate.str() + "), "
+			+ std::to_string(ingest.dropped_no_descriptor) + " without descriptor, latency: " + ingest.latency.toString();
+		if (!ingest.last_error.empty())
+		{
+			summary += ", last error: " + ingest.last_error;
+		}
+		statistics[route.first] = summary;
+	}
+	return statistics;
+}
+
+std::map<std::string, std::string> Bridge::getFilterStatistics() const
+{
+	std::map<std::string, std::string> statistics;
+	{
+		std::lock_guard<std::mutex> lock(projection_mtx);
+		for (auto const& route : projection_routes)
+		{
+			const ProjectionRoute& projection = route.second;
+			if (projection.topic.filter.empty())
+			{
+				continue;
+			}
+			std::string summary = std::to_string(projection.passed_count) + " passed, " + std::to_string(projection.filtered_count) + " dropped, "
+				+ std::to_string(projection.parse_errors) + " malformed, " + std::to_string(projection.dropped_no_descriptor) + " without descriptor";
+			if (!projection.error.empty())
+			{
+				summary += ", error: " + projection.error;
+			}
+			statistics[route.first] = summary;
+		}
+	}
+	std::lock_guard<std::mutex> lock(ingest_mtx);
+	for (auto const& route : ingest_routes)
+	{
+		const IngestRoute& ingest = route.second;
+		if (ingest.filter.empty())
+		{
+			continue;
+		}
+		statistics[route.first] = std::to_string(ingest.passed_count) + " passed, " + std::to_string(ingest.filtered_count) + " dropped, "
+			+ std::to_string(ingest.parse_errors) + " malformed, " + std::to_string(ingest.dropped_no_descriptor) + " without descriptor";
+	}
+	return statistics;
+}
+
+std::map<std::string, std::string> Bridge::getAggregationStatistics() const
+{
+	std::map<std::string, std::string> statistics;
+	std::lock_guard<std::mutex> lock(projection_mtx);
+	for (auto const& route : projection_routes)
+	{
+		const ProjectionRoute& projection = route.second;
+		if (projection.topic.aggregate_fields.empty())
+		{
+			continue;
+		}
+		std::string summary = projection.aggregator ? projection.aggregator->getStatistics() : "no descriptor yet";
+		summary += ", " + std::to_string(projection.dropped_no_descriptor) + " without descriptor";
+		if (!projection.error.empty())
+		{
+			summary += ", error: " + projection.error;
+		}
+		statistics[route.first] = summary;
+	}
+	return statistics;
+}
+
+std::vector<std::pair<std::string, std::string>> Bridge::getStatistics() const
+{
+	std::vector<std::pair<std::string, std::string>> statistics;
+	auto add = [&statistics](const std::string& label, const std::string& text)
+	{
+		if (!text.empty())
+		{
+			statistics.emplace_back(label, text);
+		}
+	};
+	auto addRoutes = [&statistics](const std::string& label, const std::map<std::string, std::string>& routes_)
+	{
+		for (auto const& route : routes_)
+		{
+			statistics.emplace_back(label + " " + route.first, route.second);
+		}
+	};
+	auto current_routes = getRoutes();
+	add("flow control", getFlowControlStatistics());
+	add("adaptive QoS", getQosStatistics());
+	add("message store", getStoreStatistics());
+	addRoutes("envelope", delivery.getEnvelopeStatistics(current_routes->mqtt2ecal_topics));
+	addRoutes("duplicates", delivery.getDuplicateStatistics(current_routes->mqtt2ecal_topics));
+	addRoutes("retransmission", delivery.getRetransmitStatistics(current_routes->mqtt2ecal_topics, current_routes->ecal2mqtt_topics));
+	addRoutes("bandwidth", send_scheduler->getShapingStatistics());
+	addRoutes("priority", send_scheduler->getPriorityStatistics());
+	add("loops", getLoopStatistics());
+	add("expired", getExpiryStatistics());
+	add("chunks", getChunkStatistics());
+	add("converted output", getTranscoderStatistics());
+	add("sparkplug", getSparkplugStatistics());
+	addRoutes("selected fields", getProjectionStatistics());
+	addRoutes("converted input", getIngestStatistics());
+	addRoutes("filter", getFilterStatistics());
+	addRoutes("aggregation", getAggregationStatistics());
+	return statistics;
+}
+
+std::string Bridge::getStoreStatistics() const
+{
+	return store_replay ? store_replay->getStatistics() : std::string();
 }
 
 bool Bridge::isInitialized() const
@@ -808,6 +2910,11 @@ bool Bridge::isConnectedToMqttBroker() const
 	return is_connected_to_mqtt_broker;
 }
 
+bool Bridge::isSessionPresent() const
+{
+	return is_session_present;
+}
+
 int Bridge::getMqttRxCounter() const
 {
 	return mqtt_rx_counter;
@@ -820,22 +2927,46 @@ int Bridge::getEcalRxCounter() const
 
 Bridge::~Bridge(void)
 {
+	// the components stay until the mosquitto loop is stopped, its callbacks still reach them
+	failover->stop();
+	{
+		std::lock_guard<std::mutex> lock(timer_mtx);
+		timer_thread_active = false;
+		timer_cv.notify_all();
+	}
+	if (timer_thread.joinable())
+	{
+		timer_thread.join();
+	}
+	if (store_replay)
+	{
+		store_replay->stop();
+	}
+	send_scheduler->stop();
 	mqtt_desc_thread_active = false;
 	is_initialized = false;
-	mqtt_desc_thread.join();
+	if (mqtt_desc_thread.joinable())
+	{
+		mqtt_desc_thread.join();
+	}
+	if (is_registration_callback_added)
+	{
+		removeRegistrationListener();
+	}
+	publishDeath();
 	disconnect();
 	is_connected_to_mqtt_broker = false;
 	loop_stop(true);
-	mosqpp::lib_cleanup();
-	for (auto const& it_publisher : ecal_publishers)
+	for (auto const& subscriber : ecal_subscribers)
 	{
-		delete it_publisher.second;
+		delete subscriber.second;
 	}
+	// no eCAL callback can reach the transcoder anymore
+	transcoder.reset();
+	routes.reset();
 
-	for (eCAL::CSubscriber* subscriber : ecal_subscribers)
-	{
-		delete subscriber;
-	}
+	std::lock_guard<std::mutex> lock(library_init_mtx);
+	mosquitto_lib_cleanup();
 	eCAL::Finalize();
 }
 
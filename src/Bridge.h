@@ -19,7 +19,6 @@
 
 #pragma once
 
-#include <mosquittopp.h>
 #include <mosquitto.h>
 
 #include <iostream>
@@ -32,17 +31,39 @@
 #include <ecal/ecal.h>
 #include <atomic>
 #include <limits>
+#include <memory>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <array>
 
 #include "utils.h"
 #include "yaml-cpp/yaml.h"
 
 #include "Broker.h"
+#include "CborMsgpackCodec.h"
+#include "FieldProjection.h"
+#include "FilterExpression.h"
+#include "WindowAggregator.h"
+#include "JsonProtobufEncoder.h"
+#include "PayloadTranscoder.h"
+#include "SparkplugNode.h"
+#include "ChunkReassembler.h"
+#include "DeliveryTracker.h"
+#include "FailoverMonitor.h"
+#include "SendScheduler.h"
+#include "StoreReplay.h"
+#include "Statistics.h"
+#include "MqttClient.h"
 
 
 enum ErrorTypes {
     MOSQ_STR_ERROR, MOSQ_CONN_ERROR, MOSQ_REASON_ERROR
 };
 
+/** Granted qos values of a SUBACK from this value on are failures (0x80 in MQTT v3.1.1, reason codes >= 0x80 in MQTT v5) */
+static const int SUBACK_FAILURE = 0x80;
+
 /**
  * @brief A Bridge that routes messages from MQTT to eCAL and vice versa.
  *
@@ -50,7 +71,7 @@ enum ErrorTypes {
  * Subscribers and publishers on eCAL and MQTT side are created for a list of
  * topics. Only messages from those topics will be routed to the other side.
  */
-class Bridge : public mosqpp::mosquittopp
+class Bridge : public MqttClient
 {
 public:
   /**
@@ -83,17 +104,87 @@ public:
   void ecalMessageReceived(const char* topic_name, const struct eCAL::SReceiveCallbackData* data);
 
   bool isInitialized() const;
+
+  /**
+   * @brief Waits until the bridge is connected to the broker and all MQTT subscriptions are acknowledged
+   *
+   * @param timeout_ms maximum time to wait
+   * @return true if the bridge is ready
+   */
+  bool waitUntilReady(int timeout_ms);
+  bool isReady() const;
+  /** @return the time needed by the initialization phases of the bridge */
+  std::string getStartupTimings() const;
   bool isConnectedToMqttBroker() const;
+  bool isSessionPresent() const;
+  int  getFailedSubscriptionCount() const;
+  /** @return the time between the last CONNACK and the first MQTT message received afterwards, -1 if none was received yet */
+  int  getReconnectToFirstMessageMs() const;
+  /** @return the time between detecting a broker failure and the CONNACK of the next endpoint of the last failover, -1 if there was none */
+  int  getLastFailoverMs() const;
+  int  getFailoverCounter() const;
+  /**
+   * @brief Collects the statistics of the bridge for the status output
+   *
+   * @return the label and the statistics of every area and route, areas that are not used are left out
+   */
+  std::vector<std::pair<std::string, std::string>> getStatistics() const;
+  /**
+   * @brief Changes the bandwidth_limit of the broker without a reconnect
+   *
+   * @param bits_per_second  0 means unlimited
+   * @param burst            bytes that may be sent at once after an idle time
+   */
+  void setBandwidthLimit(unsigned long long bits_per_second, unsigned long long burst);
   int  getMqttRxCounter() const;
   int  getEcalRxCounter() const;
   bool tryReconnectMqtt();
 
+  /**
+   * @brief Replaces the routes of the bridge, e.g. after the configuration was reloaded
+   *
+   * Only the differences to the current routes are applied: eCAL subscribers
+   * and publishers of unchanged channels are kept, MQTT topics are only
+   * subscribed or unsubscribed if they were added or removed. Messages on
+   * unchanged routes keep flowing during the update.
+   *
+   * @param mqtt2ecal_topics  the new topics to send to eCAL
+   * @param ecal2mqtt_topics  the new topics to send to MQTT
+   */
+  void updateRoutes(const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics);
+
+  /** @return true if the bridge was created with the given settings, i.e. it does not have to be recreated on a reload */
+  bool hasSettings(const Broker& broker, const GeneralSettings& general_settings) const;
+
 private:
+  /**
+   * @brief The routes of the bridge and the eCAL publishers they use.
+   *
+   * A Routes object is never modified. On a reload a new one is built and
+   * swapped in, the callbacks keep using the snapshot they started with.
+   */
+  struct Routes
+  {
+    Routes(const std::vector<MqttTopic>& mqtt2ecal_topics_, const std::vector<EcalTopic>& ecal2mqtt_topics_)
+      : mqtt2ecal_topics(mqtt2ecal_topics_)
+      , ecal2mqtt_topics(ecal2mqtt_topics_)
+    {}
+
+    std::vector<MqttTopic>                                    mqtt2ecal_topics;
+    std::vector<EcalTopic>                                    ecal2mqtt_topics;
+    std::map<std::string, std::shared_ptr<eCAL::CPublisher>>  ecal_publishers;
+    std::set<std::string>                                     echo_topics;   // published by an ecal2mqtt route and subscribed by a mqtt2ecal route
+    std::set<std::string>                                     adaptive_qos_topics;   // published by an ecal2mqtt route with adaptive_qos
+    std::map<std::string, EcalTopic>                          nack_routes;   // ecal2mqtt routes by their nack_topic
+  };
+
   const GeneralSettings                     general_settings;
-  const std::vector<MqttTopic>              mqtt2ecal_topics;
-  const std::vector<EcalTopic>              ecal2mqtt_topics;
   const Broker                              broker_settings;
 
+  mutable std::mutex                        routes_mtx;
+  std::shared_ptr<const Routes>             routes;
+
+  std::mutex                                from_mqtt_hash_mtx;
   std::map<std::string, size_t>             from_mqtt_desc_hash;
   std::map<std::string, size_t>             from_mqtt_type_hash;
 
@@ -106,35 +197,393 @@ private:
   std::thread                               mqtt_desc_thread;
   std::atomic<bool>                         mqtt_desc_thread_active;
 
-  std::vector<eCAL::CSubscriber*>           ecal_subscribers;
-  std::map<std::string, eCAL::CPublisher*>  ecal_publishers;
+  // closes the windows of the aggregating routes at their end and repeats the NACKs of the routes with nack_topic
+  std::thread                               timer_thread;
+  std::mutex                                timer_mtx;
+  std::condition_variable                   timer_cv;
+  bool                                      timer_thread_active;   // guarded by timer_mtx
+  bool                                      is_timer_changed;      // guarded by timer_mtx
+
+  // only used by the thread that creates, updates and destroys the bridge
+  std::map<std::string, eCAL::CSubscriber*> ecal_subscribers;
+  bool                                      is_registration_callback_added;
 
   std::hash<std::string>                    hasher;
 
   std::atomic<bool>                         is_initialized;
+  std::atomic<bool>                         is_ecal_initialized;
+  std::atomic<bool>                         is_session_present;
   std::atomic<bool>                         is_connected_to_mqtt_broker;
   std::atomic<bool>                         loop_started;
+
+  std::mutex                                connection_mtx;
+  bool                                      is_switching_endpoint;   // guarded by connection_mtx, the connect runs outside of it
+  // the endpoint used, the health check and the switches to the other endpoints
+  std::unique_ptr<FailoverMonitor>          failover;
+
+  struct OutstandingPublish
+  {
+    std::chrono::steady_clock::time_point sent;
+    int                                   qos;
+  };
+  mutable std::mutex                        flow_control_mtx;
+  std::unordered_map<int, OutstandingPublish> outstanding_publishes;
+  int                                       dropped_publish_counter;
+  std::atomic<uint64_t>                     failed_publish_counter;
+  LatencyStatistics                         puback_latency;
+  LatencyStatistics                         pubcomp_latency;
+
+  // QoS of the routes with adaptive_qos, guarded by flow_control_mtx
+  std::atomic<bool>                         is_qos_adaptive;
+  int                                       qos_level;          // 0: unchanged, 1: at most QoS 1, 2: QoS 0
+  double                                    ack_latency;        // smoothed, in us
+  std::chrono::steady_clock::time_point     last_ack;
+  std::chrono::steady_clock::time_point     qos_level_since;
+  std::chrono::steady_clock::time_point     calm_since;         // below half of the thresholds since, time_point::max() if not
+  std::chrono::steady_clock::time_point     next_qos_check;
+  std::array<std::chrono::steady_clock::duration, 3> qos_level_time;   // before the current level was entered
+  uint64_t                                  qos_downgrades;
+  uint64_t                                  qos_restores;
+  uint64_t                                  downgraded_messages;
+
+  // created by the first route with an output_format other than binary, never destroyed before the bridge
+  std::unique_ptr<PayloadTranscoder>        transcoder;
+
+  // the Sparkplug B edge node of the routes with output_format sparkplug, only created if the broker has a sparkplug_edge_node_id
+  std::unique_ptr<SparkplugNode>            sparkplug;
+  // the NDEATH published before a deliberate disconnect, the broker discards the will of a clean disconnect
+  std::mutex                                death_mtx;
+  std::condition_variable                   death_cv;
+  int                                       death_mid;
+  bool                                      is_death_acknowledged;
+
+  /** @brief Converts the payloads of one MQTT -> eCAL route to protobuf */
+  struct IngestConverter
+  {
+    std::shared_ptr<const ProtobufSchema>      schema;
+    std::unique_ptr<JsonProtobufEncoder>       json_encoder;   // input_format json
+    std::unique_ptr<google::protobuf::Message> message;        // input_format cbor and msgpack, reused for every payload
+    CborMsgpackCodec::Format                   binary_format;
+    std::shared_ptr<const FilterExpression>    filter;         // set if the route has a filter
+  };
+
+  /**
+   * @brief An MQTT -> eCAL route with an input_format other than binary or with a filter.
+   *
+   * The converter is created once the descriptor of the type is known, either
+   * from the descriptor file of the route or from its MQTT descriptor topic.
+   */
+  struct IngestRoute
+  {
+    std::string                             input_format;
+    std::string                             static_ecal_type_name;
+    std::string                             descriptor_file;
+    std::string                             filter;
+    std::unique_ptr<IngestConverter>        converter;
+    uint64_t                                converted_count;
+    uint64_t                                parse_errors;
+    uint64_t                                dropped_no_descriptor;
+    uint64_t                                passed_count;     // by the filter
+    uint64_t                                filtered_count;
+    LatencyStatistics                       latency;
+    std::string                             last_error;
+
+    IngestRoute() : converted_count(0), parse_errors(0), dropped_no_descriptor(0), passed_count(0), filtered_count(0) {}
+  };
+  /**
+   * @brief An eCAL -> MQTT route that only forwards selected fields, only messages matching a filter or aggregates of its messages.
+   *
+   * The projection, the filter and the aggregator are compiled once the eCAL publisher registered the descriptor of the type.
+   */
+  struct ProjectionRoute
+  {
+    EcalTopic                               topic;
+    size_t                                  descriptor_hash;
+    std::shared_ptr<const FieldProjection>  projection;
+    std::shared_ptr<const FilterExpression> filter_expression;
+    std::shared_ptr<WindowAggregator>       aggregator;
+    uint64_t                                projected_count;
+    uint64_t                                bytes_in;
+    uint64_t                                bytes_out;
+    uint64_t                                passed_count;
+    uint64_t                                filtered_count;
+    uint64_t                                parse_errors;
+    uint64_t                                dropped_no_descriptor;
+    std::string                             error;
+
+    ProjectionRoute() : descriptor_hash(0), projected_count(0), bytes_in(0), bytes_out(0), passed_count(0), filtered_count(0), parse_errors(0), dropped_no_descriptor(0) {}
+  };
+  mutable std::mutex                        projection_mtx;
+  std::map<std::string, ProjectionRoute>    projection_routes;   // by route name
+
+  mutable std::mutex                        ingest_mtx;
+  std::map<std::string, IngestRoute>        ingest_routes;   // by route name
+  std::string                               ingest_buffer;
+
+  // the store and forward buffer, only created if the broker has a store_directory
+  std::unique_ptr<StoreReplay>              store_replay;
+
+  // random per bridge, sent in the chunk headers and envelopes
+  const uint32_t                            sender_id;
+  // the send queue, all messages to MQTT are sent by its thread while a route has a chunk_size, a priority or a weight, or the bandwidth is limited
+  std::unique_ptr<SendScheduler>            send_scheduler;
+  // created by the first route with reassemble_chunks, never destroyed before the bridge
+  std::unique_ptr<ChunkReassembler>         reassembler;
+
+  // the envelopes, retransmissions and duplicates of the routes
+  DeliveryTracker                           delivery;
+
+  // the eCAL messages sent by this bridge carry this id, so they are not forwarded to MQTT again
+  const long long                           ecal_origin_id;
+  // without No Local (MQTT v3) the messages published to the echo topics are recognized by their fingerprint
+  std::atomic<bool>                         is_echo_check_needed;
+  std::mutex                                echo_mtx;
+  std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>> echo_fingerprints;   // ascending by time
+  std::atomic<uint64_t>                     suppressed_ecal_count;
+  std::atomic<uint64_t>                     suppressed_mqtt_count;
+
+  // messages dropped because of the max_age_ms of their route
+  std::atomic<uint64_t>                     expired_on_receive;
+  std::atomic<uint64_t>                     expired_at_publish;
+
+  mutable std::mutex                        subscription_mtx;
+  std::map<int, std::vector<std::string>>   pending_subscriptions;
+  std::map<std::string, int>                subscription_results;
+  std::chrono::steady_clock::time_point     subscribe_started;
+  std::map<std::string, int>                subscribed_topics;
+  std::atomic<uint32_t>                     broker_max_packet_size;
+  bool                                      is_subscription_complete;
+  bool                                      is_first_connack;   // a resumed session may still hold the subscriptions of a previous run
+  std::condition_variable                   subscription_cv;
+
+  const std::chrono::steady_clock::time_point created;
+  std::atomic<int>                          ecal_init_ms;
+  std::atomic<int>                          mqtt_init_ms;
+  std::atomic<int>                          connect_ms;
+  std::atomic<int>                          subscribe_ms;
+
+  std::chrono::steady_clock::time_point     connected_since;
+  std::atomic<bool>                         is_waiting_for_first_message;
+  std::atomic<int>                          reconnect_to_first_message_ms;
+
   int                                       mqtt_rx_counter;
   int                                       ecal_rx_counter;
 
   const bool                                verbose;
  
 
+  /** @return in-flight and queue depth, dropped messages and acknowledge latencies of the QoS 1/2 messages sent to MQTT */
+  std::string getFlowControlStatistics() const;
+  /** @return the current QoS level of the routes with adaptive_qos and the time spent at each level, empty if no route has adaptive_qos */
+  std::string getQosStatistics() const;
+  /** @return backlog and drain time of the store and forward buffer, empty if no store_directory is configured */
+  std::string getStoreStatistics() const;
+  /** @return sent, queued and dropped chunked messages and the reassembly of received ones, empty if no route uses chunks */
+  std::string getChunkStatistics() const;
+  /** @return messages dropped because of the max_age_ms of their route, per stage; empty if no route has one */
+  std::string getExpiryStatistics() const;
+  /** @return messages of the bridge itself that were not forwarded again, empty if no routes loop */
+  std::string getLoopStatistics() const;
+  /** @return number of messages converted to JSON, CBOR or MessagePack, empty if no route converts its output */
+  std::string getTranscoderStatistics() const;
+  /** @return births, data messages and reported metrics of the Sparkplug B edge node, empty if it is not configured */
+  std::string getSparkplugStatistics() const;
+  /** @return per route name: projected messages and the size reduction of the routes that select fields */
+  std::map<std::string, std::string> getProjectionStatistics() const;
+  /** @return per route name: converted messages, parse errors and conversion latency of the routes that convert their input */
+  std::map<std::string, std::string> getIngestStatistics() const;
+  /** @return per route name: passed and dropped messages of the routes with a filter, in both directions */
+  std::map<std::string, std::string> getFilterStatistics() const;
+  /** @return per route name: aggregated samples and published windows of the routes with aggregate_fields */
+  std::map<std::string, std::string> getAggregationStatistics() const;
+
   /**
    * @brief Routes the MQTT message to the according eCAL channel.
    *
    * @param message the MQTT message
    */
-  void on_message(const struct mosquitto_message *message) override;
+  void on_message(const struct mosquitto_message *message, const mosquitto_property *props) override;
+
+  /**
+   * @brief Converts the payload of a route with an input_format other than binary, applies the filter of the route and publishes it to eCAL
+   *
+   * @param route_name  the name of the MQTT -> eCAL route
+   * @param publisher   the eCAL publisher of the route
+   * @param payload     the JSON, CBOR, MessagePack or protobuf payload
+   * @param payloadlen  length of the payload
+   */
+  void publishConvertedToEcal(const std::string& route_name, const eCAL::CPublisher& publisher, const void* payload, int payloadlen, long long send_time = -1);
+
+  /**
+   * @brief Applies the filter of the route to an eCAL message and reduces it to the fields selected by the route
+   *
+   * @param route_name  the name of the eCAL -> MQTT route
+   * @param payload     the serialized protobuf message, points to buffer afterwards if fields were selected
+   * @param size        length of the message, updated with payload
+   * @param buffer      receives the projected message
+   *
+   * @return false if the message has to be dropped, because it does not match the filter, the descriptor is not known yet or the message is malformed
+   */
+  bool selectPayload(const std::string& route_name, const void*& payload, size_t& size, std::string& buffer);
+
+  /**
+   * @brief Adds an eCAL message to the open windows of an aggregating route
+   *
+   * @param route_name  the name of the eCAL -> MQTT route
+   * @param payload     the serialized protobuf message
+   * @param size        length of the message
+   * @param time_us     the eCAL send time of the message
+   * @param windows     receives the JSON documents of the windows closed by the message
+   */
+  void aggregatePayload(const std::string& route_name, const void* payload, size_t size, int64_t time_us, std::vector<std::string>& windows);
+
+  /** @brief Compiles the projections, filters and aggregators of the routes of an eCAL topic, if the descriptor of the topic changed */
+  void updateProjections(const std::string& ecal_topic_name, const std::string& type_name, const std::string& descriptor);
+
+  /**
+   * @brief Builds the converter of a route with an input_format other than binary or with a filter
+   *
+   * @param error receives the reason if the converter cannot be built
+   *
+   * @return nullptr if the descriptor cannot be parsed, does not contain the type or the filter is invalid
+   */
+  static std::unique_ptr<IngestConverter> createIngestConverter(const std::string& input_format, const std::string& type_name, const std::string& descriptor, const std::string& filter, std::string& error);
 
   /**
    * @brief Callback function for the mosquitto connection.
    * This function creates the MQTT Subscribers, as we cannot do that before
-   * the bridge is connected to the broker.
+   * the bridge is connected to the broker. If the broker resumed a persistent
+   * session, only the subscriptions that changed since are sent.
+   *
+   * @param rc    the error code of the connection-attempt
+   * @param flags the CONNACK flags, bit 0 is set if the broker resumed a session
+   * @param props the CONNACK properties (MQTT v5 only)
+   */
+  void on_connect(int rc, int flags, const mosquitto_property *props) override;
+
+  /**
+   * @brief Subscribes the MQTT topics of the current routes that are not subscribed
+   * yet and unsubscribes the ones that are not used anymore.
+   */
+  void updateSubscriptions();
+
+  /** @brief Marks the bridge as ready once all subscriptions after a connect are acknowledged */
+  void subscriptionsCompleteLocked();
+
+  /**
+   * @brief The file that keeps the subscriptions of a persistent session for the next run of the bridge
+   *
+   * @return <store_directory>/<broker name>/subscriptions, empty without clean_session false and a store_directory
+   */
+  std::string getSubscriptionFile() const;
+
+  /** @return all MQTT topics of the given routes with the highest qos any route uses for them, and the Sparkplug NCMD topic */
+  std::map<std::string, int> getSubscriptionTopics(const Routes& routes) const;
+
+  /**
+   * @brief Splits the topics into batches that fit into one (UN)SUBSCRIBE packet
+   *
+   * @param topics          the topic names
+   * @param bytes_per_topic bytes needed per topic in addition to the name
+   */
+  std::vector<std::vector<std::string>> splitIntoPackets(const std::vector<std::string>& topics, size_t bytes_per_topic) const;
+
+  /** @return a snapshot of the current routes */
+  std::shared_ptr<const Routes> getRoutes() const;
+
+  /**
+   * @brief Stores the SUBACK result of every topic of the acknowledged request
    *
-   * @param rc the error code of the connection-attempt
+   * @param mid         the message id of the SUBSCRIBE request
+   * @param qos_count   number of granted qos values
+   * @param granted_qos the granted qos (or failure code) per topic
    */
-  void on_connect(int rc) override;
+  void on_subscribe(int mid, int qos_count, const int *granted_qos) override;
+
+  /**
+   * @brief Publishes a message to MQTT, honoring the max_queued_messages limit
+   *
+   * QoS 1/2 messages are tracked by their message id until @ref on_publish
+   * reports them as acknowledged.
+   *
+   * @param deadline  an expired message is dropped, otherwise the remaining time is sent as Message Expiry Interval (MQTT v5)
+   * @param mid       receives the message id, if not NULL
+   * @param sent_qos  receives the QoS the message was sent with, lower than qos if the adaptive QoS downgraded it, if not NULL
+   */
+  PublishResult publishToMqtt(const std::string& topic, int payloadlen, const void* payload, int qos, bool retain,
+    const std::chrono::steady_clock::time_point& deadline = std::chrono::steady_clock::time_point::max(), int* mid = NULL, int* sent_qos = NULL);
+
+  /** @brief Maps the error of a publish call to its result, counts the errors that do not go away by themselves */
+  PublishResult getPublishResult(int publish_err);
+
+  /** @brief Remembers a message published to an echo topic, so it is recognized when the broker sends it back */
+  void recordEcho(const std::string& topic, int payloadlen, const void* payload);
+
+  /** @return true if the received message is one the bridge published itself, its fingerprint is consumed */
+  bool isEcho(const std::string& topic, int payloadlen, const void* payload);
+
+  /** @brief Sends the messages requested by a NACK received on the nack_topic of the route again */
+  void retransmit(const EcalTopic& route, const void* payload, int payloadlen);
+
+  void sendNack(const std::string& nack_topic, const Nack& nack);
+
+  /** @brief Determines the echo topics of the routes and warns about routes that forward messages in circles */
+  void checkLoops(Routes& routes);
+
+  /** @return the time the message of the route (sent by eCAL at this time) expires, time_point::max() without max_age_ms */
+  static std::chrono::steady_clock::time_point getDeadline(const EcalTopic& topic, int64_t send_time_us);
+
+  /**
+   * @brief Sends a message to MQTT, or appends it to the message store while
+   * the broker is not connected or older messages are still waiting in the store.
+   *
+   * @param deadline  the message is dropped instead of sent after this time
+   */
+  void forwardToMqtt(const std::string& topic, int payloadlen, const void* payload, int qos, bool retain,
+    const std::chrono::steady_clock::time_point& deadline = std::chrono::steady_clock::time_point::max());
+
+  /**
+   * @brief Opens the store and forward buffer, if configured
+   *
+   * @return false if the store directory cannot be used
+   */
+  bool initStore();
+
+  int getInflightDepthLocked() const;
+  int getQueueDepthLocked() const;
+
+  /**
+   * @brief Lowers the QoS of a topic with adaptive_qos while the link is congested
+   *
+   * The congestion is checked at most every 100 ms; the level is lowered at most once per second
+   * and raised once the link was below half of the thresholds for qos_restore_interval.
+   */
+  int getAdaptedQos(const std::string& topic, int qos);
+  void updateQosLevelLocked(const std::chrono::steady_clock::time_point& now);
+
+  /**
+   * @brief Records the acknowledge latency of QoS 1/2 messages and confirms pending health check pings
+   *
+   * @param mid         the message id of the acknowledged message
+   * @param reason_code the PUBACK / PUBCOMP reason code (MQTT v5 only)
+   */
+  void on_publish(int mid, int reason_code) override;
+
+  /**
+   * @brief Drops the current broker connection and connects to the endpoint the failover monitor switched to
+   */
+  void switchEndpoint();
+
+  /**
+   * @brief Publishes the NDEATH of the Sparkplug edge node before a deliberate disconnect and waits for its PUBACK
+   *
+   * Gives up after DEATH_ACK_TIMEOUT. The edge node is set offline and the will
+   * of the next connection is armed with the next bdSeq.
+   */
+  void publishDeath();
+
+  /** @brief Sets the NDEATH with the current bdSeq as will of the next connection */
+  int armDeath();
 
   /**
    * @brief Prints the reason for the disconnect to the console
@@ -178,10 +627,37 @@ private:
   bool initMqtt();
   
 
+  /** @brief Adds the bridge to the bridges that get the registrations of the eCAL publishers */
+  void addRegistrationListener();
+  /** @brief Removes the bridge again, waits for a registration that is passed to it right now */
+  void removeRegistrationListener();
+  /** @brief The registration callback of the process, forwards every registration to all listening bridges */
+  static void dispatchPublisherRegistration(const char* sample_, int sample_size_);
+
   void onPublisherRegistration(const char* sample_, int sample_size_);
 
   void descriptorUpdateLoop();
 
+  /** @brief Closes the idle aggregation windows and repeats the due NACKs, each at the time returned by the functions below */
+  void timerLoop();
+
+  /** @brief Makes the timer thread compute its next wake up again, e.g. after the routes changed */
+  void wakeTimer();
+
+  /**
+   * @brief Publishes the open windows of the aggregating routes that did not receive a message for a window length
+   *
+   * @return when an open window can be closed next, time_point::max() if no route aggregates
+   */
+  std::chrono::steady_clock::time_point flushAggregations();
+
+  /**
+   * @brief Requests the missing messages of the routes with nack_topic again that did not arrive within their nack_interval
+   *
+   * @return when the NACKs are due next at the earliest: after the smallest nack_interval, time_point::max() if no route has a nack_topic
+   */
+  std::chrono::steady_clock::time_point sendDueNacks();
+
   void printVerbose(const std::string & output_, const int status_code_ = std::numeric_limits<int>::max()) const;
   void printError(const std::string & output_, const int errorcode_ = std::numeric_limits<int>::max(), const int error_type = -1) const;
 
@@ -189,6 +665,15 @@ private:
 
   bool connectOrReconnect(bool ignore_error = false);
 
+  /**
+   * @brief Applies the configured socket buffer sizes and TCP keepalive
+   * settings to the socket of the current broker connection.
+   *
+   * mosquitto creates and connects the socket itself, so the options are
+   * applied once the connect was started and again on every CONNACK.
+   */
+  void applySocketOptions();
+
 
   void initialize(int argc, char** argv);
 
@@ -25,10 +25,46 @@ Broker::Broker()
 	user = "ecal2mqtt";
 	id = "1234abcd";
 	randomize_id = false;
+	clean_session = true;
+	session_expiry_interval = 0;
 	default_qos = 0;
 	keep_alive = 60;
+	max_packet_size = 0;
+	max_inflight_messages = 20;
+	max_queued_messages = 0;
+	receive_maximum = 0;
 	default_retain_flag = false;
 
+	health_check_interval = 0;
+	health_check_timeout = 1000;
+	failback_interval = 10000;
+
+	store_segment_size = 16 * 1024 * 1024;
+	store_max_bytes = 256 * 1024 * 1024;
+	store_max_age = 0;
+	store_compaction = "none";
+	store_replay_rate = 100;
+	json_worker_threads = 2;
+	json_queue_size = 10000;
+	send_queue_limit = 64 * 1024 * 1024;
+	bandwidth_limit = 0;
+	bandwidth_burst = 16 * 1024;
+	chunk_memory_limit = 64 * 1024 * 1024;
+	chunk_timeout = 10000;
+	suppress_loops = true;
+	qos_downgrade_outstanding = 0;
+	qos_downgrade_latency = 0;
+	qos_restore_interval = 5000;
+	sparkplug_group_id = "ecal";
+
+	tcp_nodelay = false;
+	socket_send_buffer = 0;
+	socket_receive_buffer = 0;
+	tcp_keepalive = false;
+	tcp_keepalive_idle = 0;
+	tcp_keepalive_interval = 0;
+	tcp_keepalive_count = 0;
+
 	use_ssl = false;
 
 	check_host_name_match = true;
@@ -40,10 +76,121 @@ Broker::Broker()
 	ignore_error_first_connect = false;
 }
 
-bool Broker::CheckValidity()
+bool BrokerEndpoint::operator==(const BrokerEndpoint& other) const
+{
+	return host == other.host && port == other.port && unix_socket == other.unix_socket;
+}
+
+bool Broker::operator==(const Broker& other) const
+{
+	return name == other.name
+		&& user == other.user
+		&& password == other.password
+		&& randomize_id == other.randomize_id
+		&& (randomize_id || id == other.id)
+		&& clean_session == other.clean_session
+		&& session_expiry_interval == other.session_expiry_interval
+		&& default_qos == other.default_qos
+		&& keep_alive == other.keep_alive
+		&& max_packet_size == other.max_packet_size
+		&& max_inflight_messages == other.max_inflight_messages
+		&& max_queued_messages == other.max_queued_messages
+		&& receive_maximum == other.receive_maximum
+		&& default_retain_flag == other.default_retain_flag
+		&& bind_ip == other.bind_ip
+		&& endpoints == other.endpoints
+		&& health_check_interval == other.health_check_interval
+		&& health_check_timeout == other.health_check_timeout
+		&& health_check_topic == other.health_check_topic
+		&& failback_interval == other.failback_interval
+		&& store_directory == other.store_directory
+		&& store_segment_size == other.store_segment_size
+		&& store_max_bytes == other.store_max_bytes
+		&& store_max_age == other.store_max_age
+		&& store_compaction == other.store_compaction
+		&& store_replay_rate == other.store_replay_rate
+		&& json_worker_threads == other.json_worker_threads
+		&& json_queue_size == other.json_queue_size
+		&& send_queue_limit == other.send_queue_limit
+		&& chunk_memory_limit == other.chunk_memory_limit
+		&& chunk_timeout == other.chunk_timeout
+		&& suppress_loops == other.suppress_loops
+		&& qos_downgrade_outstanding == other.qos_downgrade_outstanding
+		&& qos_downgrade_latency == other.qos_downgrade_latency
+		&& qos_restore_interval == other.qos_restore_interval
+		&& sparkplug_group_id == other.sparkplug_group_id
+		&& sparkplug_edge_node_id == other.sparkplug_edge_node_id
+		&& tcp_nodelay == other.tcp_nodelay
+		&& socket_send_buffer == other.socket_send_buffer
+		&& socket_receive_buffer == other.socket_receive_buffer
+		&& tcp_keepalive == other.tcp_keepalive
+		&& tcp_keepalive_idle == other.tcp_keepalive_idle
+		&& tcp_keepalive_interval == other.tcp_keepalive_interval
+		&& tcp_keepalive_count == other.tcp_keepalive_count
+		&& use_ssl == other.use_ssl
+		&& ca_file == other.ca_file
+		&& cert_file == other.cert_file
+		&& key_file == other.key_file
+		&& check_host_name_match == other.check_host_name_match
+		&& tls_version == other.tls_version
+		&& tls_ciphers == other.tls_ciphers
+		&& ssl_use_psk == other.ssl_use_psk
+		&& psk_id == other.psk_id
+		&& psk == other.psk
+		&& psk_ciphers == other.psk_ciphers
+		&& ssl_verify_server == other.ssl_verify_server
+		&& ignore_error_first_connect == other.ignore_error_first_connect;
+}
+
+bool Broker::operator!=(const Broker& other) const
 {
-    // host is mandatory
-	if(host.empty())
+	return !(*this == other);
+}
+
+bool Broker::CheckValidity(const std::string& mqtt_protocol_version)
+{
+    // host is mandatory, unless the broker is reached via a unix domain socket
+	if (endpoints.empty())
+		return false;
+	for (const auto& endpoint : endpoints)
+	{
+		if (endpoint.host.empty() && endpoint.unix_socket.empty())
+			return false;
+	}
+
+	if (health_check_interval < 0 || health_check_timeout <= 0 || failback_interval < 0)
+		return false;
+
+	if (store_segment_size <= 0 || store_max_age < 0 || store_replay_rate < 0)
+		return false;
+	if (store_compaction != "none" && store_compaction != "latest_per_topic")
+		return false;
+
+	if (json_worker_threads < 1 || json_queue_size < 0)
+		return false;
+
+	if (chunk_timeout <= 0)
+		return false;
+
+	if (bandwidth_limit > 0 && bandwidth_burst == 0)
+		return false;
+
+	if (qos_downgrade_outstanding < 0 || qos_downgrade_latency < 0 || qos_restore_interval <= 0)
+		return false;
+
+	// the ids are topic levels of the Sparkplug topics
+	for (const auto& sparkplug_id : { sparkplug_group_id, sparkplug_edge_node_id })
+	{
+		if (sparkplug_id.find_first_of("/+#") != std::string::npos)
+			return false;
+	}
+	if (!sparkplug_edge_node_id.empty() && sparkplug_group_id.empty())
+		return false;
+
+	// socket buffer sizes and keepalive settings must not be negative, 0 means: use the system default
+	if (socket_send_buffer < 0 || socket_receive_buffer < 0)
+		return false;
+	if (tcp_keepalive_idle < 0 || tcp_keepalive_interval < 0 || tcp_keepalive_count < 0)
 		return false;
 
 	// if ssl_use_psk is true, psk_id and psk are mandatory
@@ -53,8 +200,22 @@ bool Broker::CheckValidity()
 			return false;
 	}
 
+	// a persistent session is bound to the client id, so the id must not change between two runs
+	if (!clean_session && randomize_id)
+		return false;
+
+	// MQTT v5 ends a session at the disconnect unless it has an expiry interval, so a persistent session would not persist
+	if (!clean_session && mqtt_protocol_version == "v5" && session_expiry_interval == 0)
+		return false;
+
+	if (max_packet_size < 0)
+		return false;
+
+	if (max_inflight_messages < 0 || max_queued_messages < 0 || receive_maximum < 0 || receive_maximum > 65535)
+		return false;
+
 	// check if default_qos is in range [0,2]
-	if (default_qos < 0 && default_qos > 2)
+	if (default_qos < 0 || default_qos > 2)
 		return false;
 
 	// check if tls_version is valid
@@ -69,129 +230,323 @@ void operator>>(const YAML::Node& node, Broker& broker)
 { 
 	try
 	{
+		// the first key is the name of the broker, the other keys are its settings
+		// every key is visited once, a lookup by key would search the whole map each time
+		bool is_name = true;
 		for (const auto& kv : node)
 		{
-			broker.name = kv.first.as<std::string>();
-			break;
-		}
-		if (node["host"])
-		{
-			if(node["host"].as<std::string>().compare("null") != 0)
-				broker.host = node["host"].as<std::string>();
-		}
-		if (node["port"])
-		{
-			broker.port = node["port"].as<int>();
-		}
-		if (node["user"])
-		{
-			if (node["user"].as<std::string>().compare("null") != 0)
-				broker.user = node["user"].as<std::string>();
-		}
-		if (node["password"])
-		{
-			if (node["password"].as<std::string>().compare("null") != 0)
-				broker.password = node["password"].as<std::string>();
-		}
-		if (node["randomize_id"])
-		{
-			broker.randomize_id = node["randomize_id"].as<bool>();
-		}
-		if (broker.randomize_id)
-		{
-			// if randomize_id is true, randomize in any case
-			srand(static_cast<unsigned int>(time(NULL)));
-			broker.id = std::to_string(rand()) + std::to_string(rand() / 2);
-		}
-		else
-		{
-			// if randomize is false, take given id
-			if (node["id"])
+			const std::string key = kv.first.as<std::string>();
+			if (is_name)
 			{
-				if (node["id"].as<std::string>().compare("null") != 0)
-					broker.id = node["id"].as<std::string>();
+				broker.name = key;
+				is_name = false;
+				continue;
 			}
-			// if no id is given, randomize
-			if (broker.id.empty())
+			if (key == "host")
 			{
-				srand(static_cast<unsigned int>(time(NULL)));
-				broker.id = std::to_string(rand()) + std::to_string(rand() / 2);
+				if(kv.second.as<std::string>().compare("null") != 0)
+					broker.host = kv.second.as<std::string>();
+			}
+			else if (key == "port")
+			{
+				broker.port = kv.second.as<int>();
+			}
+			else if (key == "user")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.user = kv.second.as<std::string>();
+			}
+			else if (key == "password")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.password = kv.second.as<std::string>();
+			}
+			else if (key == "randomize_id")
+			{
+				broker.randomize_id = kv.second.as<bool>();
+			}
+			else if (key == "id")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.id = kv.second.as<std::string>();
+			}
+			else if (key == "clean_session")
+			{
+				broker.clean_session = kv.second.as<bool>();
+			}
+			else if (key == "session_expiry_interval")
+			{
+				broker.session_expiry_interval = kv.second.as<unsigned int>();
+			}
+			else if (key == "default_qos")
+			{
+				broker.default_qos = kv.second.as<int>();
+			}
+			else if (key == "keep_alive")
+			{
+				broker.keep_alive = kv.second.as<int>();
+			}
+			else if (key == "max_packet_size")
+			{
+				broker.max_packet_size = kv.second.as<int>();
+			}
+			else if (key == "max_inflight_messages")
+			{
+				broker.max_inflight_messages = kv.second.as<int>();
+			}
+			else if (key == "max_queued_messages")
+			{
+				broker.max_queued_messages = kv.second.as<int>();
+			}
+			else if (key == "receive_maximum")
+			{
+				broker.receive_maximum = kv.second.as<int>();
+			}
+			else if (key == "default_retain_flag")
+			{
+				broker.default_retain_flag = kv.second.as<bool>();
+			}
+			else if (key == "bind_ip")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.bind_ip = kv.second.as<std::string>();
+			}
+			else if (key == "unix_socket")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.unix_socket = kv.second.as<std::string>();
+			}
+			else if (key == "endpoints")
+			{
+				for (const auto& current_endpoint : kv.second)
+				{
+					BrokerEndpoint endpoint;
+					endpoint.port = 1883;
+					if (current_endpoint["host"])
+					{
+						if (current_endpoint["host"].as<std::string>().compare("null") != 0)
+							endpoint.host = current_endpoint["host"].as<std::string>();
+					}
+					if (current_endpoint["port"])
+					{
+						endpoint.port = current_endpoint["port"].as<int>();
+					}
+					if (current_endpoint["unix_socket"])
+					{
+						if (current_endpoint["unix_socket"].as<std::string>().compare("null") != 0)
+							endpoint.unix_socket = current_endpoint["unix_socket"].as<std::string>();
+					}
+					broker.endpoints.push_back(endpoint);
+				}
+			}
+			else if (key == "health_check_interval")
+			{
+				broker.health_check_interval = kv.second.as<int>();
+			}
+			else if (key == "health_check_timeout")
+			{
+				broker.health_check_timeout = kv.second.as<int>();
+			}
+			else if (key == "health_check_topic")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.health_check_topic = kv.second.as<std::string>();
+			}
+			else if (key == "failback_interval")
+			{
+				broker.failback_interval = kv.second.as<int>();
+			}
+			else if (key == "store_directory")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.store_directory = kv.second.as<std::string>();
+			}
+			else if (key == "store_segment_size")
+			{
+				broker.store_segment_size = kv.second.as<int>();
+			}
+			else if (key == "store_max_bytes")
+			{
+				broker.store_max_bytes = kv.second.as<unsigned long long>();
+			}
+			else if (key == "store_max_age")
+			{
+				broker.store_max_age = kv.second.as<int>();
+			}
+			else if (key == "store_compaction")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.store_compaction = kv.second.as<std::string>();
+			}
+			else if (key == "store_replay_rate")
+			{
+				broker.store_replay_rate = kv.second.as<int>();
+			}
+			else if (key == "json_worker_threads")
+			{
+				broker.json_worker_threads = kv.second.as<int>();
+			}
+			else if (key == "json_queue_size")
+			{
+				broker.json_queue_size = kv.second.as<int>();
+			}
+			else if (key == "send_queue_limit")
+			{
+				broker.send_queue_limit = kv.second.as<unsigned long long>();
+			}
+			else if (key == "bandwidth_limit")
+			{
+				broker.bandwidth_limit = kv.second.as<unsigned long long>();
+			}
+			else if (key == "bandwidth_burst")
+			{
+				broker.bandwidth_burst = kv.second.as<unsigned long long>();
+			}
+			else if (key == "chunk_memory_limit")
+			{
+				broker.chunk_memory_limit = kv.second.as<unsigned long long>();
+			}
+			else if (key == "chunk_timeout")
+			{
+				broker.chunk_timeout = kv.second.as<int>();
+			}
+			else if (key == "suppress_loops")
+			{
+				broker.suppress_loops = kv.second.as<bool>();
+			}
+			else if (key == "qos_downgrade_outstanding")
+			{
+				broker.qos_downgrade_outstanding = kv.second.as<int>();
+			}
+			else if (key == "qos_downgrade_latency")
+			{
+				broker.qos_downgrade_latency = kv.second.as<int>();
+			}
+			else if (key == "qos_restore_interval")
+			{
+				broker.qos_restore_interval = kv.second.as<int>();
+			}
+			else if (key == "sparkplug_group_id")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.sparkplug_group_id = kv.second.as<std::string>();
+			}
+			else if (key == "sparkplug_edge_node_id")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.sparkplug_edge_node_id = kv.second.as<std::string>();
+			}
+			else if (key == "tcp_nodelay")
+			{
+				broker.tcp_nodelay = kv.second.as<bool>();
+			}
+			else if (key == "socket_send_buffer")
+			{
+				broker.socket_send_buffer = kv.second.as<int>();
+			}
+			else if (key == "socket_receive_buffer")
+			{
+				broker.socket_receive_buffer = kv.second.as<int>();
+			}
+			else if (key == "tcp_keepalive")
+			{
+				broker.tcp_keepalive = kv.second.as<bool>();
+			}
+			else if (key == "tcp_keepalive_idle")
+			{
+				broker.tcp_keepalive_idle = kv.second.as<int>();
+			}
+			else if (key == "tcp_keepalive_interval")
+			{
+				broker.tcp_keepalive_interval = kv.second.as<int>();
+			}
+			else if (key == "tcp_keepalive_count")
+			{
+				broker.tcp_keepalive_count = kv.second.as<int>();
+			}
+			else if (key == "ignore_error_first_connect")
+			{
+				broker.ignore_error_first_connect = kv.second.as<bool>();
+			}
+			else if (key == "use_ssl")
+			{
+				broker.use_ssl = kv.second.as<bool>();
+			}
+			else if (key == "ca_file")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.ca_file = kv.second.as<std::string>();
+			}
+			else if (key == "cert_file")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.cert_file = kv.second.as<std::string>();
+			}
+			else if (key == "key_file")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.key_file = kv.second.as<std::string>();
+			}
+			else if (key == "check_hostname_match")
+			{
+				broker.check_host_name_match = kv.second.as<bool>();
+			}
+			else if (key == "ssl_verify_server")
+			{
+				broker.ssl_verify_server = kv.second.as<bool>();
+			}
+			else if (key == "tls_version")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.tls_version = kv.second.as<std::string>();
+			}
+			else if (key == "tls_ciphers")
+			{
+				broker.tls_ciphers = kv.second.as<std::vector<std::string>>();
+			}
+			else if (key == "ssl_use_psk")
+			{
+				broker.ssl_use_psk = kv.second.as<bool>();
+			}
+			else if (key == "psk_id")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.psk_id = kv.second.as<std::string>();
+			}
+			else if (key == "psk")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					broker.psk = kv.second.as<std::string>();
+			}
+			else if (key == "psk_ciphers")
+			{
+				broker.psk_ciphers = kv.second.as<std::vector<std::string>>();
 			}
 		}
-		if (node["default_qos"])
-		{
-			broker.default_qos = node["default_qos"].as<int>();
-		}
-		if (node["keep_alive"])
-		{
-			broker.keep_alive = node["keep_alive"].as<int>();
-		}
-		if (node["default_retain_flag"])
-		{
-			broker.default_retain_flag = node["default_retain_flag"].as<bool>();
-		}
-		if (node["bind_ip"])
-		{
-			if (node["bind_ip"].as<std::string>().compare("null") != 0)
-				broker.bind_ip = node["bind_ip"].as<std::string>();
-		}
-		if (node["ignore_error_first_connect"])
-		{
-			broker.ignore_error_first_connect = node["ignore_error_first_connect"].as<bool>();
-		}
-		if (node["use_ssl"])
-		{
-			broker.use_ssl = node["use_ssl"].as<bool>();
-		}
-		if (node["ca_file"])
-		{
-			if (node["ca_file"].as<std::string>().compare("null") != 0)
-				broker.ca_file = node["ca_file"].as<std::string>();
-		}
-		if (node["cert_file"])
-		{
-			if (node["cert_file"].as<std::string>().compare("null") != 0)
-				broker.cert_file = node["cert_file"].as<std::string>();
-		}
-		if (node["key_file"])
-		{
-			if (node["key_file"].as<std::string>().compare("null") != 0)
-				broker.key_file = node["key_file"].as<std::string>();
-		}
-		if (node["check_hostname_match"])
-		{
-			broker.check_host_name_match = node["check_hostname_match"].as<bool>();
-		}
-		if (node["ssl_verify_server"])
-		{
-			broker.ssl_verify_server = node["ssl_verify_server"].as<bool>();
-		}
-		if (node["tls_version"])
-		{
-			if (node["tls_version"].as<std::string>().compare("null") != 0)
-				broker.tls_version = node["tls_version"].as<std::string>();
-		}
-		if (node["tls_ciphers"])
-		{
-			broker.tls_ciphers = node["tls_ciphers"].as<std::vector<std::string>>();
-		}
-		if (node["ssl_use_psk"])
+		if (broker.randomize_id || broker.id.empty())
 		{
-			broker.ssl_use_psk = node["ssl_use_psk"].as<bool>();
+			// if randomize_id is true, randomize in any case, otherwise only if no id is given
+			srand(static_cast<unsigned int>(time(NULL)));
+			broker.id = std::to_string(rand()) + std::to_string(rand() / 2);
 		}
-		if (node["psk_id"])
+
+		// without an explicit endpoint list, host / port / unix_socket is the only endpoint
+		if (broker.endpoints.empty())
 		{
-			if (node["psk_id"].as<std::string>().compare("null") != 0)
-				broker.psk_id = node["psk_id"].as<std::string>();
+			if (!broker.host.empty() || !broker.unix_socket.empty())
+			{
+				broker.endpoints.push_back({ broker.host, broker.port, broker.unix_socket });
+			}
 		}
-		if (node["psk"])
+		else
 		{
-			if (node["psk"].as<std::string>().compare("null") != 0)
-				broker.psk = node["psk"].as<std::string>();
+			broker.host        = broker.endpoints.front().host;
+			broker.port        = broker.endpoints.front().port;
+			broker.unix_socket = broker.endpoints.front().unix_socket;
 		}
-		if (node["psk_ciphers"])
+		if (broker.health_check_topic.empty())
 		{
-			broker.psk_ciphers = node["psk_ciphers"].as<std::vector<std::string>>();
+			broker.health_check_topic = "ecal_mqtt_bridge/" + broker.id + "/health";
 		}
 	}
 	catch (const YAML::BadConversion& e)
@@ -23,13 +23,30 @@
 #include <vector>
 #include <iostream>
 
+/**
+ * @brief One network address under which a (logical) broker can be reached
+ */
+struct BrokerEndpoint
+{
+	std::string host;
+	int port;
+	std::string unix_socket;
+
+	bool operator==(const BrokerEndpoint& other) const;
+};
+
 class Broker
 {
 public:
 
 	Broker();
 
-	bool CheckValidity();
+	/** @param mqtt_protocol_version of the general settings, some settings depend on it */
+	bool CheckValidity(const std::string& mqtt_protocol_version);
+
+	/** @return true if both brokers have the same settings; randomized ids and the bandwidth (changed without a reconnect) are not compared */
+	bool operator==(const Broker& other) const;
+	bool operator!=(const Broker& other) const;
 
 	std::string name;
 	std::string host;
@@ -38,11 +55,72 @@ public:
 	std::string password;
 	std::string id;
 	bool randomize_id;
+	bool clean_session;
+	unsigned int session_expiry_interval;
 	int default_qos;
 	int keep_alive;
+	int max_packet_size;
+	int max_inflight_messages;
+	int max_queued_messages;
+	int receive_maximum;
 	bool default_retain_flag;
 	std::string bind_ip;
 
+	std::string unix_socket;
+
+	// ordered list of endpoints, the first one is the primary endpoint
+	// if not configured, it only contains host, port and unix_socket from above
+	std::vector<BrokerEndpoint> endpoints;
+	int health_check_interval;
+	int health_check_timeout;
+	std::string health_check_topic;
+	int failback_interval;
+
+	// store and forward of eCAL -> MQTT messages while the broker is not reachable, disabled if store_directory is empty
+	std::string store_directory;
+	int store_segment_size;
+	unsigned long long store_max_bytes;
+	int store_max_age;
+	std::string store_compaction;
+	int store_replay_rate;
+
+	// conversion of eCAL messages for routes with output_format json, cbor or msgpack
+	int json_worker_threads;
+	int json_queue_size;
+
+	// bytes of the messages waiting to be sent while routes have a chunk_size or a priority, lower priorities are dropped first
+	unsigned long long send_queue_limit;
+	// bit/s of the MQTT packets sent, 0 for unlimited; the routes share it by their weight
+	unsigned long long bandwidth_limit;
+	// bytes that may be sent at once after an idle time
+	unsigned long long bandwidth_burst;
+	// memory of the incomplete received chunked messages
+	unsigned long long chunk_memory_limit;
+	// incomplete received messages are dropped after this time in ms
+	int chunk_timeout;
+
+	// messages the bridge published itself are not forwarded again, neither from eCAL nor from MQTT
+	bool suppress_loops;
+
+	// routes with adaptive_qos are downgraded (QoS 2 -> 1 -> 0) while this many QoS 1/2 messages wait for their acknowledge
+	// or the acknowledges take this many ms; 0 disables the check
+	int qos_downgrade_outstanding;
+	int qos_downgrade_latency;
+	// one level is restored after the link was below half of the thresholds for this many ms
+	int qos_restore_interval;
+
+	// Sparkplug B edge node for routes with output_format sparkplug, disabled if sparkplug_edge_node_id is empty
+	std::string sparkplug_group_id;
+	std::string sparkplug_edge_node_id;
+
+	bool tcp_nodelay;
+	int socket_send_buffer;
+	int socket_receive_buffer;
+	bool tcp_keepalive;
+	int tcp_keepalive_idle;
+	int tcp_keepalive_interval;
+	int tcp_keepalive_count;
+
 	bool use_ssl;
 	std::string ca_file;
 	std::string cert_file;
@@ -0,0 +1,913 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "CborMsgpackCodec.h"
+
+#include <google/protobuf/descriptor.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+// deeper nested data is rejected
+static const int MAX_DEPTH = 64;
+
+namespace
+{
+	/** Writes the items of both formats, all numbers are big endian */
+	class Writer
+	{
+	public:
+		Writer(CborMsgpackCodec::Format format, std::string& output) : format(format), output(output) {}
+
+		void mapHeader(size_t count)
+		{
+			if (format == CborMsgpackCodec::CBOR)
+				cborHeader(5, count);
+			else if (count < 16)
+				byte(0x80 | count);
+			else if (count <= 0xFFFF)
+				prefixed(0xDE, count, 2);
+			else
+				prefixed(0xDF, count, 4);
+		}
+
+		void arrayHeader(size_t count)
+		{
+			if (format == CborMsgpackCodec::CBOR)
+				cborHeader(4, count);
+			else if (count < 16)
+				byte(0x90 | count);
+			else if (count <= 0xFFFF)
+				prefixed(0xDC, count, 2);
+			else
+				prefixed(0xDD, count, 4);
+		}
+
+		void unsignedInteger(uint64_t value)
+		{
+			if (format == CborMsgpackCodec::CBOR)
+				cborHeader(0, value);
+			else if (value < 0x80)
+				byte(value);
+			else if (value <= 0xFF)
+				prefixed(0xCC, value, 1);
+			else if (value <= 0xFFFF)
+				prefixed(0xCD, value, 2);
+			else if (value <= 0xFFFFFFFF)
+				prefixed(0xCE, value, 4);
+			else
+				prefixed(0xCF, value, 8);
+		}
+
+		void signedInteger(int64_t value)
+		{
+			if (value >= 0)
+				unsignedInteger(static_cast<uint64_t>(value));
+			else if (format == CborMsgpackCodec::CBOR)
+				cborHeader(1, static_cast<uint64_t>(-(value + 1)));
+			else if (value >= -32)
+				byte(static_cast<uint64_t>(value) & 0xFF);
+			else if (value >= std::numeric_limits<int8_t>::min())
+				prefixed(0xD0, static_cast<uint64_t>(value), 1);
+			else if (value >= std::numeric_limits<int16_t>::min())
+				prefixed(0xD1, static_cast<uint64_t>(value), 2);
+			else if (value >= std::numeric_limits<int32_t>::min())
+				prefixed(0xD2, static_cast<uint64_t>(value), 4);
+			else
+				prefixed(0xD3, static_cast<uint64_t>(value), 8);
+		}
+
+		void floatingPoint(float value)
+		{
+			uint32_t bits = 0;
+			memcpy(&bits, &value, sizeof(bits));
+			prefixed(format == CborMsgpackCodec::CBOR ? 0xFA : 0xCA, bits, 4);
+		}
+
+		void floatingPoint(double value)
+		{
+			uint64_t bits = 0;
+			memcpy(&bits, &value, sizeof(bits));
+			prefixed(format == CborMsgpackCodec::CBOR ? 0xFB : 0xCB, bits, 8);
+		}
+
+		void boolean(bool value)
+		{
+			if (format == CborMsgpackCodec::CBOR)
+				byte(value ? 0xF5 : 0xF4);
+			else
+				byte(value ? 0xC3 : 0xC2);
+		}
+
+		void text(const std::string& value)
+		{
+			const size_t size = value.size();
+			if (format == CborMsgpackCodec::CBOR)
+				cborHeader(3, size);
+			else if (size < 32)
+				byte(0xA0 | size);
+			else if (size <= 0xFF)
+				prefixed(0xD9, size, 1);
+			else if (size <= 0xFFFF)
+				prefixed(0xDA, size, 2);
+			else
+				prefixed(0xDB, size, 4);
+			output.append(value);
+		}
+
+		void bytes(const std::string& value)
+		{
+			const size_t size = value.size();
+			if (format == CborMsgpackCodec::CBOR)
+				cborHeader(2, size);
+			else if (size <= 0xFF)
+				prefixed(0xC4, size, 1);
+			else if (size <= 0xFFFF)
+				prefixed(0xC5, size, 2);
+			else
+				prefixed(0xC6, size, 4);
+			output.append(value);
+		}
+
+	private:
+		void byte(uint64_t value)
+		{
+			output.push_back(static_cast<char>(value));
+		}
+
+		void prefixed(uint8_t prefix, uint64_t value, int size)
+		{
+			char buffer[9];
+			buffer[0] = static_cast<char>(prefix);
+			for (int i = 0; i < size; i++)
+			{
+				buffer[1 + i] = static_cast<char>(value >> (8 * (size - 1 - i)));
+			}
+			output.append(buffer, static_cast<size_t>(size) + 1);
+		}
+
+		void cborHeader(uint8_t major_type, uint64_t value)
+		{
+			const uint8_t major = static_cast<uint8_t>(major_type << 5);
+			if (value < 24)
+				byte(major | value);
+			else if (value <= 0xFF)
+				prefixed(major | 24, value, 1);
+			else if (value <= 0xFFFF)
+				prefixed(major | 25, value, 2);
+			else if (value <= 0xFFFFFFFF)
+				prefixed(major | 26, value, 4);
+			else
+				prefixed(major | 27, value, 8);
+		}
+
+		const CborMsgpackCodec::Format format;
+		std::string&                   output;
+	};
+
+	/** One decoded item. Strings are not copied, arrays and maps only carry their number of elements. */
+	struct Item
+	{
+		enum Type { UNSIGNED, NEGATIVE, FLOAT, BOOL, TEXT, BYTES, ARRAY, MAP, NIL };
+		Type        type;
+		uint64_t    unsigned_value;   // UNSIGNED, BOOL, and the number of elements of ARRAY and MAP
+		int64_t     signed_value;     // NEGATIVE
+		double      float_value;      // FLOAT
+		const char* data;             // TEXT and BYTES
+		size_t      size;
+	};
+
+	class Reader
+	{
+	public:
+		Reader(CborMsgpackCodec::Format format, const char* data, size_t size, std::string& error)
+			: format(format), begin(data), pos(data), end(data + size), error(error) {}
+
+		bool read(Item& item)
+		{
+			return format == CborMsgpackCodec::CBOR ? readCbor(item) : readMsgpack(item);
+		}
+
+		bool skip(int depth)
+		{
+			if (depth >= MAX_DEPTH)
+			{
+				return fail("too deeply nested");
+			}
+			Item item;
+			if (!read(item))
+			{
+				return false;
+			}
+			if (item.type == Item::ARRAY || item.type == Item::MAP)
+			{
+				const uint64_t count = item.type == Item::MAP ? item.unsigned_value * 2 : item.unsigned_value;
+				for (uint64_t i = 0; i < count; i++)
+				{
+					if (!skip(depth + 1))
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		bool atEnd() const
+		{
+			return pos == end;
+		}
+
+		bool fail(const std::string& reason)
+		{
+			error = "offset " + std::to_string(pos - begin) + ": " + reason;
+			return false;
+		}
+
+	private:
+		bool readBigEndian(int size, uint64_t& value)
+		{
+			if (end - pos < size)
+			{
+				return fail("unexpected end of data");
+			}
+			value = 0;
+			for (int i = 0; i < size; i++)
+			{
+				value = (value << 8) | static_cast<uint8_t>(pos[i]);
+			}
+			pos += size;
+			return true;
+		}
+
+		bool readData(uint64_t size, Item& item)
+		{
+			if (static_cast<uint64_t>(end - pos) < size)
+			{
+				return fail("unexpected end of data");
+			}
+			item.data = pos;
+			item.size = static_cast<size_t>(size);
+			pos += size;
+			return true;
+		}
+
+		/** Sanity check of the element count, every element takes at least one byte */
+		bool checkCount(uint64_t count, uint64_t bytes_per_element)
+		{
+			if (count > static_cast<uint64_t>(end - pos) / bytes_per_element)
+			{
+				return fail("element count exceeds the data");
+			}
+			return true;
+		}
+
+		static double halfToDouble(uint64_t half)
+		{
+			const int exponent = static_cast<int>((half >> 10) & 0x1F);
+			const double mantissa = static_cast<double>(half & 0x3FF);
+			double value = 0.0;
+			if (exponent == 0)
+				value = std::ldexp(mantissa, -24);
+			else if (exponent == 31)
+				value = mantissa == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+			else
+				value = std::ldexp(mantissa + 1024, exponent - 25);
+			return (half & 0x8000) ? -value : value;
+		}
+
+		bool readCbor(Item& item)
+		{
+			while (true)
+			{
+				if (pos == end)
+				{
+					return fail("unexpected end of data");
+				}
+				const uint8_t initial = static_cast<uint8_t>(*pos++);
+				const uint8_t major = initial >> 5;
+				const uint8_t info = initial & 0x1F;
+
+				uint64_t argument = info;
+				if (info == 31)
+				{
+					return fail("indefinite length items are not supported");
+				}
+				if (info >= 28)
+				{
+					return fail("invalid additional information");
+				}
+				if (info >= 24 && !readBigEndian(1 << (info - 24), argument))
+				{
+					return false;
+				}
+
+				switch (major)
+				{
+				case 0:
+					item.type = Item::UNSIGNED;
+					item.unsigned_value = argument;
+					return true;
+				case 1:
+					if (argument > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+					{
+						return fail("negative integer out of range");
+					}
+					item.type = Item::NEGATIVE;
+					item.signed_value = -1 - static_cast<int64_t>(argument);
+					return true;
+				case 2:
+					item.type = Item::BYTES;
+					return readData(argument, item);
+				case 3:
+					item.type = Item::TEXT;
+					return readData(argument, item);
+				case 4:
+					item.type = Item::ARRAY;
+					item.unsigned_value = argument;
+					return checkCount(argument, 1);
+				case 5:
+					item.type = Item::MAP;
+					item.unsigned_value = argument;
+					return checkCount(argument, 2);
+				case 6:
+					// tags only annotate the following item
+					continue;
+				default:
+					switch (info)
+					{
+					case 20:
+					case 21:
+						item.type = Item::BOOL;
+						item.unsigned_value = info == 21 ? 1 : 0;
+						return true;
+					case 22:
+					case 23:
+						item.type = Item::NIL;
+						return true;
+					case 25:
+						item.type = Item::FLOAT;
+						item.float_value = halfToDouble(argument);
+						return true;
+					case 26:
+					{
+						const uint32_t bits = static_cast<uint32_t>(argument);
+						float value = 0.0f;
+						memcpy(&value, &bits, sizeof(value));
+						item.type = Item::FLOAT;
+						item.float_value = value;
+						return true;
+					}
+					case 27:
+						item.type = Item::FLOAT;
+						memcpy(&item.float_value, &argument, sizeof(item.float_value));
+						return true;
+					default:
+						return fail("unsupported simple value");
+					}
+				}
+			}
+		}
+
+		bool readMsgpack(Item& item)
+		{
+			if (pos == end)
+			{
+				return fail("unexpected end of data");
+			}
+			const uint8_t type = static_cast<uint8_t>(*pos++);
+			uint64_t value = 0;
+
+			if (type <= 0x7F)
+			{
+				item.type = Item::UNSIGNED;
+				item.unsigned_value = type;
+				return true;
+			}
+			if (type >= 0xE0)
+			{
+				item.type = Item::NEGATIVE;
+				item.signed_value = static_cast<int8_t>(type);
+				return true;
+			}
+			if (type <= 0x8F)
+			{
+				item.type = Item::MAP;
+				item.unsigned_value = type & 0x0F;
+				return checkCount(item.unsigned_value, 2);
+			}
+			if (type <= 0x9F)
+			{
+				item.type = Item::ARRAY;
+				item.unsigned_value = type & 0x0F;
+				return checkCount(item.unsigned_value, 1);
+			}
+			if (type <= 0xBF)
+			{
+				item.type = Item::TEXT;
+				return readData(type & 0x1F, item);
+			}
+
+			switch (type)
+			{
+			case 0xC0:
+				item.type = Item::NIL;
+				return true;
+			case 0xC2:
+			case 0xC3:
+				item.type = Item::BOOL;
+				item.unsigned_value = type == 0xC3 ? 1 : 0;
+				return true;
+			case 0xC4: case 0xC5: case 0xC6:
+				item.type = Item::BYTES;
+				return readBigEndian(1 << (type - 0xC4), value) && readData(value, item);
+			case 0xCA:
+			{
+				if (!readBigEndian(4, value))
+				{
+					return false;
+				}
+				const uint32_t bits = static_cast<uint32_t>(value);
+				float float_value = 0.0f;
+				memcpy(&float_value, &bits, sizeof(float_value));
+				item.type = Item::FLOAT;
+				item.float_value = float_value;
+				return true;
+			}
+			case 0xCB:
+				if (!readBigEndian(8, value))
+				{
+					return false;
+				}
+				item.type = Item::FLOAT;
+				memcpy(&item.float_value, &value, sizeof(item.float_value));
+				return true;
+			case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+				item.type = Item::UNSIGNED;
+				return readBigEndian(1 << (type - 0xCC), item.unsigned_value);
+			case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+			{
+				const int size = 1 << (type - 0xD0);
+				if (!readBigEndian(size, value))
+				{
+					return false;
+				}
+				// sign extend
+				const int shift = 64 - 8 * size;
+				const int64_t signed_value = static_cast<int64_t>(value << shift) >> shift;
+				if (signed_value >= 0)
+				{
+					item.type = Item::UNSIGNED;
+					item.unsigned_value = static_cast<uint64_t>(signed_value);
+				}
+				else
+				{
+					item.type = Item::NEGATIVE;
+					item.signed_value = signed_value;
+				}
+				return true;
+			}
+			case 0xD9: case 0xDA: case 0xDB:
+				item.type = Item::TEXT;
+				return readBigEndian(1 << (type - 0xD9), value) && readData(value, item);
+			case 0xDC: case 0xDD:
+				item.type = Item::ARRAY;
+				return readBigEndian(type == 0xDC ? 2 : 4, item.unsigned_value) && checkCount(item.unsigned_value, 1);
+			case 0xDE: case 0xDF:
+				item.type = Item::MAP;
+				return readBigEndian(type == 0xDE ? 2 : 4, item.unsigned_value) && checkCount(item.unsigned_value, 2);
+			default:
+				return fail("unsupported type");
+			}
+		}
+
+		const CborMsgpackCodec::Format format;
+		const char*                    begin;
+		const char*                    pos;
+		const char*                    end;
+		std::string&                   error;
+	};
+
+	void encodeMessage(const Message& message, Writer& writer);
+
+	void encodeValue(const Message& message, const FieldDescriptor* field, int index, Writer& writer)
+	{
+		const Reflection* reflection = message.GetReflection();
+		const bool repeated = index >= 0;
+		switch (field->cpp_type())
+		{
+		case FieldDescriptor::CPPTYPE_INT32:
+			writer.signedInteger(repeated ? reflection->GetRepeatedInt32(message, field, index) : reflection->GetInt32(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_INT64:
+			writer.signedInteger(repeated ? reflection->GetRepeatedInt64(message, field, index) : reflection->GetInt64(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_UINT32:
+			writer.unsignedInteger(repeated ? reflection->GetRepeatedUInt32(message, field, index) : reflection->GetUInt32(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_UINT64:
+			writer.unsignedInteger(repeated ? reflection->GetRepeatedUInt64(message, field, index) : reflection->GetUInt64(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_FLOAT:
+			writer.floatingPoint(repeated ? reflection->GetRepeatedFloat(message, field, index) : reflection->GetFloat(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_DOUBLE:
+			writer.floatingPoint(repeated ? reflection->GetRepeatedDouble(message, field, index) : reflection->GetDouble(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_BOOL:
+			writer.boolean(repeated ? reflection->GetRepeatedBool(message, field, index) : reflection->GetBool(message, field));
+			break;
+		case FieldDescriptor::CPPTYPE_ENUM:
+		{
+			const int number = repeated ? reflection->GetRepeatedEnumValue(message, field, index) : reflection->GetEnumValue(message, field);
+			const google::protobuf::EnumValueDescriptor* value = field->enum_type()->FindValueByNumber(number);
+			if (value != NULL)
+				writer.text(value->name());
+			else
+				writer.signedInteger(number);
+			break;
+		}
+		case FieldDescriptor::CPPTYPE_STRING:
+		{
+			std::string scratch;
+			const std::string& value = repeated ? reflection->GetRepeatedStringReference(message, field, index, &scratch) : reflection->GetStringReference(message, field, &scratch);
+			if (field->type() == FieldDescriptor::TYPE_BYTES)
+				writer.bytes(value);
+			else
+				writer.text(value);
+			break;
+		}
+		case FieldDescriptor::CPPTYPE_MESSAGE:
+			encodeMessage(repeated ? reflection->GetRepeatedMessage(message, field, index) : reflection->GetMessage(message, field), writer);
+			break;
+		}
+	}
+
+	void encodeMessage(const Message& message, Writer& writer)
+	{
+		const Reflection* reflection = message.GetReflection();
+		std::vector<const FieldDescriptor*> fields;
+		reflection->ListFields(message, &fields);
+
+		writer.mapHeader(fields.size());
+		for (const FieldDescriptor* field : fields)
+		{
+			writer.text(field->json_name());
+			if (field->is_map())
+			{
+				const FieldDescriptor* key_field   = field->message_type()->map_key();
+				const FieldDescriptor* value_field = field->message_type()->map_value();
+				const int size = reflection->FieldSize(message, field);
+				writer.mapHeader(static_cast<size_t>(size));
+				for (int i = 0; i < size; i++)
+				{
+					const Message& entry = reflection->GetRepeatedMessage(message, field, i);
+					encodeValue(entry, key_field, -1, writer);
+					encodeValue(entry, value_field, -1, writer);
+				}
+			}
+			else if (field->is_repeated())
+			{
+				const int size = reflection->FieldSize(message, field);
+				writer.arrayHeader(static_cast<size_t>(size));
+				for (int i = 0; i < size; i++)
+				{
+					encodeValue(message, field, i, writer);
+				}
+			}
+			else
+			{
+				encodeValue(message, field, -1, writer);
+			}
+		}
+	}
+
+	bool decodeMessage(Reader& reader, uint64_t field_count, Message& message, int depth);
+
+	/** @return the integer value of the item, map keys of integer type may be given as text */
+	bool toInteger(const Item& item, bool& negative, uint64_t& magnitude)
+	{
+		if (item.type == Item::UNSIGNED)
+		{
+			negative  = false;
+			magnitude = item.unsigned_value;
+			return true;
+		}
+		if (item.type == Item::NEGATIVE)
+		{
+			negative  = true;
+			magnitude = ~static_cast<uint64_t>(item.signed_value) + 1;
+			return true;
+		}
+		if (item.type == Item::TEXT && item.size > 0 && item.size < 21)
+		{
+			negative  = item.data[0] == '-';
+			magnitude = 0;
+			for (size_t i = negative ? 1 : 0; i < item.size; i++)
+			{
+				const char c = item.data[i];
+				if (c < '0' || c > '9' || magnitude > (std::numeric_limits<uint64_t>::max() - static_cast<uint64_t>(c - '0')) / 10)
+				{
+					return false;
+				}
+				magnitude = magnitude * 10 + static_cast<uint64_t>(c - '0');
+			}
+			return item.size > (negative ? 1u : 0u);
+		}
+		return false;
+	}
+
+	bool decodeValue(Reader& reader, const Item& item, Message& message, const FieldDescriptor* field, bool add, int depth)
+	{
+		const Reflection* reflection = message.GetReflection();
+		switch (field->cpp_type())
+		{
+		case FieldDescriptor::CPPTYPE_INT32:
+		case FieldDescriptor::CPPTYPE_INT64:
+		case FieldDescriptor::CPPTYPE_UINT32:
+		case FieldDescriptor::CPPTYPE_UINT64:
+		{
+			bool negative = false;
+			uint64_t magnitude = 0;
+			if (!toInteger(item, negative, magnitude))
+			{
+				return reader.fail("expected an integer for field " + field->name());
+			}
+			const int64_t value = negative ? static_cast<int64_t>(~magnitude + 1) : static_cast<int64_t>(magnitude);
+			switch (field->cpp_type())
+			{
+			case FieldDescriptor::CPPTYPE_INT32:
+				if (negative ? magnitude > uint64_t(1) << 31 : magnitude > uint64_t(std::numeric_limits<int32_t>::max()))
+					return reader.fail("value out of range for field " + field->name());
+				add ? reflection->AddInt32(&message, field, static_cast<int32_t>(value)) : reflection->SetInt32(&message, field, static_cast<int32_t>(value));
+				break;
+			case FieldDescriptor::CPPTYPE_INT64:
+				if (negative ? magnitude > uint64_t(1) << 63 : magnitude > uint64_t(std::numeric_limits<int64_t>::max()))
+					return reader.fail("value out of range for field " + field->name());
+				add ? reflection->AddInt64(&message, field, value) : reflection->SetInt64(&message, field, value);
+				break;
+			case FieldDescriptor::CPPTYPE_UINT32:
+				if ((negative && magnitude > 0) || magnitude > std::numeric_limits<uint32_t>::max())
+					return reader.fail("value out of range for field " + field->name());
+				add ? reflection->AddUInt32(&message, field, static_cast<uint32_t>(magnitude)) : reflection->SetUInt32(&message, field, static_cast<uint32_t>(magnitude));
+				break;
+			default:
+				if (negative && magnitude > 0)
+					return reader.fail("value out of range for field " + field->name());
+				add ? reflection->AddUInt64(&message, field, magnitude) : reflection->SetUInt64(&message, field, magnitude);
+				break;
+			}
+			return true;
+		}
+
+		case FieldDescriptor::CPPTYPE_FLOAT:
+		case FieldDescriptor::CPPTYPE_DOUBLE:
+		{
+			double value = 0.0;
+			if (item.type == Item::FLOAT)
+				value = item.float_value;
+			else if (item.type == Item::UNSIGNED)
+				value = static_cast<double>(item.unsigned_value);
+			else if (item.type == Item::NEGATIVE)
+				value = static_cast<double>(item.signed_value);
+			else
+				return reader.fail("expected a number for field " + field->name());
+
+			if (field->cpp_type() == FieldDescriptor::CPPTYPE_FLOAT)
+				add ? reflection->AddFloat(&message, field, static_cast<float>(value)) : reflection->SetFloat(&message, field, static_cast<float>(value));
+			else
+				add ? reflection->AddDouble(&message, field, value) : reflection->SetDouble(&message, field, value);
+			return true;
+		}
+
+		case FieldDescriptor::CPPTYPE_BOOL:
+		{
+			bool value = false;
+			if (item.type == Item::BOOL)
+				value = item.unsigned_value != 0;
+			else if (item.type == Item::TEXT && (item.size == 4 || item.size == 5))
+				value = item.size == 4 && memcmp(item.data, "true", 4) == 0;  // map keys
+			else
+				return reader.fail("expected a boolean for field " + field->name());
+			add ? reflection->AddBool(&message, field, value) : reflection->SetBool(&message, field, value);
+			return true;
+		}
+
+		case FieldDescriptor::CPPTYPE_ENUM:
+		{
+			int number = 0;
+			bool negative = false;
+			uint64_t magnitude = 0;
+			if (item.type == Item::TEXT)
+			{
+				const google::protobuf::EnumValueDescriptor* value = field->enum_type()->FindValueByName(std::string(item.data, item.size));
+				if (value == NULL)
+				{
+					return reader.fail("unknown value \"" + std::string(item.data, item.size) + "\" for enum field " + field->name());
+				}
+				number = value->number();
+			}
+			else if (toInteger(item, negative, magnitude) && magnitude <= (negative ? uint64_t(1) << 31 : uint64_t(std::numeric_limits<int32_t>::max())))
+			{
+				number = static_cast<int>(negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude));
+			}
+			else
+			{
+				return reader.fail("expected an enum name or number for field " + field->name());
+			}
+			add ? reflection->AddEnumValue(&message, field, number) : reflection->SetEnumValue(&message, field, number);
+			return true;
+		}
+
+		case FieldDescriptor::CPPTYPE_STRING:
+		{
+			if (item.type != Item::TEXT && !(item.type == Item::BYTES && field->type() == FieldDescriptor::TYPE_BYTES))
+			{
+				return reader.fail("expected a string for field " + field->name());
+			}
+			std::string value(item.data, item.size);
+			add ? reflection->AddString(&message, field, std::move(value)) : reflection->SetString(&message, field, std::move(value));
+			return true;
+		}
+
+		case FieldDescriptor::CPPTYPE_MESSAGE:
+		{
+			if (item.type != Item::MAP)
+			{
+				return reader.fail("expected a map for field " + field->name());
+			}
+			Message* nested = add ? reflection->AddMessage(&message, field) : reflection->MutableMessage(&message, field);
+			return decodeMessage(reader, item.unsigned_value, *nested, depth + 1);
+		}
+		}
+		return reader.fail("unsupported type of field " + field->name());
+	}
+
+	const FieldDescriptor* findField(const google::protobuf::Descriptor* descriptor, const Item& key)
+	{
+		if (key.type == Item::UNSIGNED)
+		{
+			return key.unsigned_value <= static_cast<uint64_t>(std::numeric_limits<int>::max()) ? descriptor->FindFieldByNumber(static_cast<int>(key.unsigned_value)) : NULL;
+		}
+		if (key.type != Item::TEXT)
+		{
+			return NULL;
+		}
+		const std::string name(key.data, key.size);
+		for (int i = 0; i < descriptor->field_count(); i++)
+		{
+			const FieldDescriptor* field = descriptor->field(i);
+			if (field->json_name() == name)
+			{
+				return field;
+			}
+		}
+		return descriptor->FindFieldByName(name);
+	}
+
+	bool decodeMessage(Reader& reader, uint64_t field_count, Message& message, int depth)
+	{
+		if (depth >= MAX_DEPTH)
+		{
+			return reader.fail("too deeply nested");
+		}
+		const Reflection* reflection = message.GetReflection();
+		for (uint64_t i = 0; i < field_count; i++)
+		{
+			Item key;
+			if (!reader.read(key))
+			{
+				return false;
+			}
+			const FieldDescriptor* field = findField(message.GetDescriptor(), key);
+			if (field == NULL || field->type() == FieldDescriptor::TYPE_GROUP)
+			{
+				if (!reader.skip(depth))
+				{
+					return false;
+				}
+				continue;
+			}
+
+			Item value;
+			if (!reader.read(value))
+			{
+				return false;
+			}
+			if (value.type == Item::NIL)
+			{
+				continue;
+			}
+
+			if (field->is_map())
+			{
+				if (value.type != Item::MAP)
+				{
+					return reader.fail("expected a map for field " + field->name());
+				}
+				const FieldDescriptor* key_field   = field->message_type()->map_key();
+				const FieldDescriptor* value_field = field->message_type()->map_value();
+				for (uint64_t entry_index = 0; entry_index < value.unsigned_value; entry_index++)
+				{
+					Item entry_key;
+					Item entry_value;
+					Message* entry = reflection->AddMessage(&message, field);
+					if (!reader.read(entry_key) || !decodeValue(reader, entry_key, *entry, key_field, false, depth + 1)
+						|| !reader.read(entry_value) || (entry_value.type != Item::NIL && !decodeValue(reader, entry_value, *entry, value_field, false, depth + 1)))
+					{
+						return false;
+					}
+				}
+			}
+			else if (field->is_repeated())
+			{
+				if (value.type != Item::ARRAY)
+				{
+					return reader.fail("expected an array for field " + field->name());
+				}
+				for (uint64_t element_index = 0; element_index < value.unsigned_value; element_index++)
+				{
+					Item element;
+					if (!reader.read(element) || !decodeValue(reader, element, message, field, true, depth))
+					{
+						return false;
+					}
+				}
+			}
+			else if (!decodeValue(reader, value, message, field, false, depth))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool CborMsgpackCodec::parseFormat(const std::string& name, Format& format)
+{
+	if (name == "cbor")
+	{
+		format = CBOR;
+		return true;
+	}
+	if (name == "msgpack")
+	{
+		format = MESSAGEPACK;
+		return true;
+	}
+	return false;
+}
+
+void CborMsgpackCodec::encode(const Message& message, Format format, std::string& output)
+{
+	output.clear();
+	Writer writer(format, output);
+	encodeMessage(message, writer);
+}
+
+bool CborMsgpackCodec::decode(const char* data, size_t size, Format format, Message& message, std::string& error)
+{
+	error.clear();
+	Reader reader(format, data, size, error);
+	Item item;
+	if (!reader.read(item))
+	{
+		return false;
+	}
+	if (item.type != Item::MAP)
+	{
+		return reader.fail("expected a map");
+	}
+	if (!decodeMessage(reader, item.unsigned_value, message, 0))
+	{
+		return false;
+	}
+	if (!reader.atEnd())
+	{
+		return reader.fail("unexpected data after the map");
+	}
+	return true;
+}
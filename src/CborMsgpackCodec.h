@@ -0,0 +1,75 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <google/protobuf/message.h>
+
+#include <string>
+
+/**
+ * @brief Converts protobuf messages to CBOR (RFC 8949) or MessagePack and back.
+ *
+ * A message is written as a map of its set fields, keyed by their JSON names,
+ * the same structure the JSON output uses. Unlike JSON, the values keep their
+ * binary representation: integers and floats are not converted to text, 64
+ * bit integers are not quoted and bytes are not base64 encoded. Enums are
+ * written by name, repeated fields as arrays and protobuf maps as maps.
+ *
+ * When decoding, the keys may also be the field names of the .proto file or
+ * the field numbers. Unknown keys and null values are ignored.
+ */
+class CborMsgpackCodec
+{
+public:
+  enum Format
+  {
+    CBOR,
+    MESSAGEPACK
+  };
+
+  /**
+   * @param name    "cbor" or "msgpack"
+   * @param format  receives the format
+   * @return false if the name is not a supported format
+   */
+  static bool parseFormat(const std::string& name, Format& format);
+
+  /**
+   * @brief Encodes the set fields of the message
+   *
+   * @param message the message to encode
+   * @param format  the output format
+   * @param output  receives the encoded message, its capacity is reused
+   */
+  static void encode(const google::protobuf::Message& message, Format format, std::string& output);
+
+  /**
+   * @brief Merges an encoded map into the message
+   *
+   * @param data    the CBOR or MessagePack data
+   * @param size    length of the data
+   * @param format  the input format
+   * @param message the message the fields are merged into
+   * @param error   receives the reason if the data cannot be decoded
+   *
+   * @return false if the data is malformed or does not match the message type
+   */
+  static bool decode(const char* data, size_t size, Format format, google::protobuf::Message& message, std::string& error);
+};
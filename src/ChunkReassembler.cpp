@@ -0,0 +1,211 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "ChunkReassembler.h"
+
+#include <algorithm>
+
+static const uint8_t MAGIC[2] = { 0xEC, 0x43 };
+static const uint8_t VERSION  = 1;
+
+// completed messages remembered to recognize redelivered chunks (QoS 1)
+static const size_t RECENTLY_COMPLETED = 256;
+
+static void writeUint32(uint32_t value, std::string& output)
+{
+	const char bytes[4] = { static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8), static_cast<char>(value) };
+	output.append(bytes, sizeof(bytes));
+}
+
+static uint32_t readUint32(const uint8_t* data)
+{
+	return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+void ChunkHeader::write(const char* data, size_t size, std::string& output) const
+{
+	output.clear();
+	output.reserve(SIZE + size);
+	output.push_back(static_cast<char>(MAGIC[0]));
+	output.push_back(static_cast<char>(MAGIC[1]));
+	output.push_back(static_cast<char>(VERSION));
+	output.push_back(0);
+	for (uint32_t value : { sender_id, message_id, index, count, total_size, offset })
+	{
+		writeUint32(value, output);
+	}
+	output.append(data, size);
+}
+
+bool ChunkHeader::read(const char* data, size_t size)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	if (size < SIZE || bytes[0] != MAGIC[0] || bytes[1] != MAGIC[1] || bytes[2] != VERSION)
+	{
+		return false;
+	}
+	sender_id  = readUint32(bytes + 4);
+	message_id = readUint32(bytes + 8);
+	index      = readUint32(bytes + 12);
+	count      = readUint32(bytes + 16);
+	total_size = readUint32(bytes + 20);
+	offset     = readUint32(bytes + 24);
+	const uint64_t chunk_end = static_cast<uint64_t>(offset) + (size - SIZE);
+	return count > 0 && index < count && chunk_end <= total_size;
+}
+
+ChunkReassembler::ChunkReassembler(std::chrono::milliseconds timeout, size_t memory_limit)
+	: timeout(timeout)
+	, memory_limit(memory_limit)
+	, memory_used(0)
+	, completed_count(0)
+	, invalid_count(0)
+	, duplicate_count(0)
+	, expired_count(0)
+	, rejected_count(0)
+{
+}
+
+bool ChunkReassembler::add(const std::string& topic, const char* data, size_t size, const char*& message, size_t& message_size)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	ChunkHeader header;
+	if (!header.read(data, size))
+	{
+		invalid_count++;
+		return false;
+	}
+	const char*  chunk      = data + ChunkHeader::SIZE;
+	const size_t chunk_size = size - ChunkHeader::SIZE;
+	if (header.count == 1)
+	{
+		// small messages are sent in one chunk, they are passed on without a copy
+		if (chunk_size != header.total_size)
+		{
+			invalid_count++;
+			return false;
+		}
+		completed_count++;
+		message      = chunk;
+		message_size = chunk_size;
+		return true;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	expire(now);
+	const Key key(topic, header.sender_id, header.message_id);
+	auto entry = messages.find(key);
+	if (entry == messages.end())
+	{
+		if (std::find(recently_completed.begin(), recently_completed.end(), key) != recently_completed.end())
+		{
+			duplicate_count++;
+			return false;
+		}
+		// messages in progress are kept, evicting them for a new one could starve all of them
+		if (memory_used + header.total_size > memory_limit)
+		{
+			rejected_count++;
+			return false;
+		}
+		Message& added = messages[key];
+		added.data.resize(header.total_size);
+		added.received.resize(header.count, false);
+		added.ranges.resize(header.count);
+		added.received_count = 0;
+		added.first_chunk    = now;
+		memory_used += header.total_size;
+		entry = messages.find(key);
+	}
+
+	Message& current = entry->second;
+	if (current.data.size() != header.total_size || current.received.size() != header.count)
+	{
+		invalid_count++;
+		return false;
+	}
+	if (current.received[header.index])
+	{
+		duplicate_count++;
+		return false;
+	}
+	std::copy(chunk, chunk + chunk_size, &current.data[header.offset]);
+	current.received[header.index] = true;
+	current.ranges[header.index] = std::make_pair(header.offset, static_cast<uint32_t>(header.offset + chunk_size));
+	current.received_count++;
+	if (current.received_count < header.count)
+	{
+		return false;
+	}
+	// the chunks have to cover the message without gaps or overlaps
+	uint32_t covered = 0;
+	for (auto const& range : current.ranges)
+	{
+		if (range.first != covered)
+		{
+			break;
+		}
+		covered = range.second;
+	}
+	if (covered != current.data.size())
+	{
+		memory_used -= current.data.size();
+		messages.erase(entry);
+		invalid_count++;
+		return false;
+	}
+
+	completed.swap(current.data);
+	memory_used -= completed.size();
+	messages.erase(entry);
+	recently_completed.push_back(key);
+	if (recently_completed.size() > RECENTLY_COMPLETED)
+	{
+		recently_completed.pop_front();
+	}
+	completed_count++;
+	message      = completed.data();
+	message_size = completed.size();
+	return true;
+}
+
+void ChunkReassembler::expire(std::chrono::steady_clock::time_point now)
+{
+	for (auto it = messages.begin(); it != messages.end();)
+	{
+		if (now - it->second.first_chunk > timeout)
+		{
+			memory_used -= it->second.data.size();
+			expired_count++;
+			it = messages.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+std::string ChunkReassembler::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return std::to_string(completed_count) + " reassembled, " + std::to_string(messages.size()) + " incomplete (" + std::to_string(memory_used) + " bytes), "
+		+ std::to_string(expired_count) + " timed out, " + std::to_string(rejected_count) + " chunks over the memory limit, "
+		+ std::to_string(duplicate_count) + " duplicate and " + std::to_string(invalid_count) + " invalid chunks";
+}
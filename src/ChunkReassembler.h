@@ -0,0 +1,114 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The header in front of every chunk of a route with chunk_size.
+ *
+ * 28 bytes: the magic bytes 0xEC 0x43, the version 1, a reserved byte and six
+ * big endian 32 bit values. The sender id is chosen randomly per bridge, so
+ * the message ids of two bridges (or of a restarted one) do not collide.
+ */
+struct ChunkHeader
+{
+  static const size_t SIZE = 28;
+
+  uint32_t sender_id;
+  uint32_t message_id;   // per MQTT topic
+  uint32_t index;
+  uint32_t count;
+  uint32_t total_size;
+  uint32_t offset;       // of the chunk in the message
+
+  /** @brief Appends the header and the data of the chunk */
+  void write(const char* data, size_t size, std::string& output) const;
+
+  /** @return false if the data does not start with a valid header */
+  bool read(const char* data, size_t size);
+};
+
+/**
+ * @brief Collects the chunks of messages received via MQTT until they are complete.
+ *
+ * Chunks of different messages (and topics) may be interleaved and arrive in
+ * any order, duplicates are ignored. A message is allocated with its first
+ * chunk; incomplete messages are dropped after the timeout. Chunks of new
+ * messages are dropped while the messages in progress use the memory limit.
+ */
+class ChunkReassembler
+{
+public:
+  ChunkReassembler(std::chrono::milliseconds timeout, size_t memory_limit);
+
+  /**
+   * @brief Adds a chunk received on an MQTT topic
+   *
+   * @param topic         the MQTT topic
+   * @param data          the chunk including its header
+   * @param size          length of the chunk
+   * @param message       receives the complete message, valid until the next call
+   * @param message_size  receives the length of the complete message
+   *
+   * @return true if the chunk completed a message
+   */
+  bool add(const std::string& topic, const char* data, size_t size, const char*& message, size_t& message_size);
+
+  /** @return complete and incomplete messages, memory in use and the reasons of dropped chunks */
+  std::string getStatistics() const;
+
+private:
+  typedef std::tuple<std::string, uint32_t, uint32_t> Key;   // topic, sender id, message id
+
+  struct Message
+  {
+    std::string                                data;
+    std::vector<bool>                          received;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;   // offset and end of every chunk, by index
+    uint32_t                                   received_count;
+    std::chrono::steady_clock::time_point      first_chunk;
+  };
+
+  void expire(std::chrono::steady_clock::time_point now);
+
+  const std::chrono::milliseconds timeout;
+  const size_t                    memory_limit;
+
+  mutable std::mutex              mtx;
+  std::map<Key, Message>          messages;
+  std::deque<Key>                 recently_completed;   // a redelivered chunk of these must not start the message again
+  size_t                          memory_used;
+  std::string                     completed;   // the last completed message
+  uint64_t                        completed_count;
+  uint64_t                        invalid_count;
+  uint64_t                        duplicate_count;
+  uint64_t                        expired_count;
+  uint64_t                        rejected_count;   // by the memory limit
+};
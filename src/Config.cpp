@@ -0,0 +1,306 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "Config.h"
+
+#include <chrono>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+bool CheckYamlValidity(std::map<std::string,Broker>& brokers,
+                       std::map<std::string,MqttTopic>& mqtt2ecal_topics,
+                       std::map<std::string,EcalTopic>& ecal2mqtt_topics)
+{
+    // Check if we have any valid brokers
+    if (brokers.size() == 0)
+    {
+        printError("No brokers configured");
+        return false;
+    }
+
+    // every topic looks up its broker once, so the check is linear in the number of topics
+    std::set<std::string> used_brokers;
+
+    // Check if the broker name is valid for mqtt --> ecal topics
+    // If not, delete from mqtt2ecal topics list
+    // if no quality of service is defined to MQTT -> eCAL, use the default one from the corresponding broker
+    for (auto it = mqtt2ecal_topics.begin(); it != mqtt2ecal_topics.end();)
+    {
+        auto broker = brokers.find(it->second.broker_name);
+        if (broker == brokers.end())
+        {
+            printError("No broker with name " + it->second.broker_name + " configured for topic " + it->first);
+            // delete from map
+            it = mqtt2ecal_topics.erase(it);
+            continue;
+        }
+        if (it->second.qos == -1)
+        {
+            it->second.qos = broker->second.default_qos;
+        }
+        used_brokers.insert(broker->first);
+        ++it;
+    }
+
+    // Check if the broker name is valid for ecal --> mqtt topics
+    // If not, delete from ecal2mqqt topics list
+    // if no quality of service is defined to eCAL -> MQTT, use the default one from the corresponding broker
+    // if no retain_flag is set, use the default one from the corresponding broker
+    for (auto it = ecal2mqtt_topics.begin(); it != ecal2mqtt_topics.end();)
+    {
+        auto broker = brokers.find(it->second.broker_name);
+        if (broker == brokers.end())
+        {
+            printError("No broker with name " + it->second.broker_name + " configured for topic " + it->first);
+            // delete from map
+            it = ecal2mqtt_topics.erase(it);
+            continue;
+        }
+        if (it->second.output_format == "sparkplug" && broker->second.sparkplug_edge_node_id.empty())
+        {
+            printError("Topic " + it->first + " uses output_format sparkplug, but broker " + it->second.broker_name + " has no sparkplug_edge_node_id");
+            it = ecal2mqtt_topics.erase(it);
+            continue;
+        }
+        if (!it->second.is_set_retain_flag)
+        {
+            it->second.retain_flag = broker->second.default_retain_flag;
+        }
+        if (it->second.qos == -1)
+        {
+            it->second.qos = broker->second.default_qos;
+        }
+        used_brokers.insert(broker->first);
+        ++it;
+    }
+
+    // Throw out any brokers that are not used
+    for (auto it = brokers.begin(); it != brokers.end();)
+    {
+        if (used_brokers.count(it->first) == 0)
+        {
+            printError("Broker " + it->second.name + " is not used");
+            it = brokers.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return true;
+}
+
+static double getMsSince(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+static std::string formatMs(double ms)
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(1) << ms << " ms";
+    return stream.str();
+}
+
+std::string toString(const ConfigLoadTimings& timings)
+{
+    return "parse " + formatMs(timings.parse_ms) + ", convert " + formatMs(timings.convert_ms) + ", validate " + formatMs(timings.validate_ms);
+}
+
+bool loadConfig(const std::string& path_to_config,
+                GeneralSettings& general_settings,
+                std::map<std::string, Broker>& brokers,
+                std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                std::map<std::string, EcalTopic>& ecal2mqtt_topics,
+                ConfigLoadTimings& timings)
+{
+    YAML::Node loaded_file;
+    YAML::Node gateway;
+    printOutput("************************************************************************");
+    printOutput("Starting to parse yaml file...");
+    auto phase_started = std::chrono::steady_clock::now();
+    try 
+    {
+        loaded_file = YAML::LoadFile(path_to_config);
+        gateway = loaded_file["gateway"];
+    }
+    catch (std::exception& e)
+    {
+        printError(e.what());
+        return false;
+    }
+    timings.parse_ms = getMsSince(phase_started);
+    phase_started = std::chrono::steady_clock::now();
+
+    if (gateway["hide_secrets"])
+    {
+        general_settings.hide_secrets = gateway["hide_secrets"].as<bool>();
+    }
+    if (gateway["mqtt_protocol_version"])
+    {
+        if(gateway["mqtt_protocol_version"].as<std::string>().compare("null") != 0)
+            general_settings.mqtt_protocol_version = gateway["mqtt_protocol_version"].as<std::string>();
+    }
+    if (gateway["ecal_process_name"])
+    {
+        if (gateway["ecal_process_name"].as<std::string>().compare("null") != 0)
+            general_settings.ecal_process_name = gateway["ecal_process_name"].as<std::string>();
+    }
+    if (gateway["startup_timeout"])
+    {
+        if (gateway["startup_timeout"].as<std::string>().compare("null") != 0)
+            general_settings.startup_timeout = gateway["startup_timeout"].as<int>();
+    }
+
+    YAML::Node yaml_brokers   = gateway["brokers"];
+    YAML::Node yaml_mqtt2ecal = gateway["mqtt2ecal"];
+    YAML::Node yaml_ecal2mqtt = gateway["ecal2mqtt"];
+
+    // fill out brokers map
+    for (auto current_broker: yaml_brokers)
+    {
+        Broker broker;
+        current_broker >> broker;
+
+        // keep only valid brokers
+        if (broker.CheckValidity(general_settings.mqtt_protocol_version))
+        {
+            brokers.insert({broker.name, broker });
+        }
+        else
+        {
+            printError("Broker " + broker.name + " is not valid");
+        }
+    }
+
+    // fill out mqtt2ecal map
+    for (auto current_mqtt_topic : yaml_mqtt2ecal)
+    {
+        MqttTopic mqtt_topic;
+        current_mqtt_topic >> mqtt_topic;
+
+        // keep only valid topics
+        if (mqtt_topic.CheckValidity())
+        {
+            mqtt2ecal_topics.insert({mqtt_topic.name, mqtt_topic });
+        }
+        else
+        {
+            printError("Topic " + mqtt_topic.name + " is not valid");
+        }
+    }
+
+    // fill out ecal2mqtt map
+    for (auto current_ecal_topic : yaml_ecal2mqtt)
+    {
+        EcalTopic ecal_topic;
+        current_ecal_topic >> ecal_topic;
+
+        // keep only valid topics
+        if (ecal_topic.CheckValidity())
+        {
+            ecal2mqtt_topics.insert({ecal_topic.name, ecal_topic });
+        }
+        else
+        {
+            printError("Topic " + ecal_topic.name + " is not valid");
+        }
+    }
+
+    timings.convert_ms = getMsSince(phase_started);
+    phase_started = std::chrono::steady_clock::now();
+
+    bool is_valid = CheckYamlValidity(brokers, mqtt2ecal_topics, ecal2mqtt_topics);
+    timings.validate_ms = getMsSince(phase_started);
+    return is_valid;
+}
+
+void printConfig(const GeneralSettings& general_settings,
+                 const std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                 const std::map<std::string, EcalTopic>& ecal2mqtt_topics)
+{
+    printOutput("************************************************************************");
+    printOutput(add_spacing("eCAL -> MQTT"));
+    printOutput("Channels:");
+    printTopicMapEcal2Mqtt(ecal2mqtt_topics);
+    printOutput("Type:");
+    printTypesMapEcal2Mqtt(ecal2mqtt_topics);
+    printOutput("Descriptor info:");
+    printDescriptorsMapEcal2Mqtt(ecal2mqtt_topics);
+    printOutput("************************************************************************");
+    printOutput(add_spacing("MQTT -> eCAL"));
+    printOutput("Channels:");
+    printTopicMapMqtt2Ecal(mqtt2ecal_topics);
+    printOutput("Type:");
+    printTypesMapMqtt2Ecal(mqtt2ecal_topics);
+    printOutput("Descriptor info:");
+    printDescriptorsMapMqtt2Ecal(mqtt2ecal_topics);
+    printOutput("************************************************************************");
+    printOutput(add_spacing("General settings"));
+    printGeneralSettings(general_settings);
+}
+
+std::map<std::string, BrokerTopics> groupTopicsByBroker(const std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                                                        const std::map<std::string, EcalTopic>& ecal2mqtt_topics)
+{
+    std::map<std::string, BrokerTopics> topics_by_broker;
+    for (auto const& topic : mqtt2ecal_topics)
+    {
+        topics_by_broker[topic.second.broker_name].mqtt2ecal.push_back(topic.second);
+    }
+    for (auto const& topic : ecal2mqtt_topics)
+    {
+        topics_by_broker[topic.second.broker_name].ecal2mqtt.push_back(topic.second);
+    }
+    return topics_by_broker;
+}
+
+int checkConfig(const std::string& path_to_config, bool verbose)
+{
+    GeneralSettings general_settings;
+    std::map<std::string, Broker>    brokers;
+    std::map<std::string, MqttTopic> mqtt2ecal_topics;
+    std::map<std::string, EcalTopic> ecal2mqtt_topics;
+
+    auto started = std::chrono::steady_clock::now();
+    ConfigLoadTimings timings;
+    bool is_valid = loadConfig(path_to_config, general_settings, brokers, mqtt2ecal_topics, ecal2mqtt_topics, timings);
+
+    auto group_started = std::chrono::steady_clock::now();
+    auto topics_by_broker = groupTopicsByBroker(mqtt2ecal_topics, ecal2mqtt_topics);
+    double group_ms = getMsSince(group_started);
+    double total_ms = getMsSince(started);
+
+    if (verbose && is_valid)
+    {
+        printConfig(general_settings, mqtt2ecal_topics, ecal2mqtt_topics);
+    }
+    printOutput("************************************************************************");
+    printOutput(std::to_string(brokers.size()) + " brokers, "
+        + std::to_string(mqtt2ecal_topics.size()) + " MQTT -> eCAL topics, "
+        + std::to_string(ecal2mqtt_topics.size()) + " eCAL -> MQTT topics");
+    for (auto const& topics : topics_by_broker)
+    {
+        printOutput("  " + topics.first + ": " + std::to_string(topics.second.mqtt2ecal.size()) + " MQTT -> eCAL, " + std::to_string(topics.second.ecal2mqtt.size()) + " eCAL -> MQTT");
+    }
+    printOutput("Timings: " + toString(timings) + ", group by broker " + formatMs(group_ms) + ", total " + formatMs(total_ms));
+    printOutput(is_valid ? "The configuration is valid" : "The configuration is not valid");
+    return is_valid ? 0 : 1;
+}
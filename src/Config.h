@@ -0,0 +1,83 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "Broker.h"
+#include "utils.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/** Duration of the phases of loading the configuration */
+struct ConfigLoadTimings
+{
+  double parse_ms;   // reading the yaml file
+  double convert_ms;   // converting the yaml nodes to brokers and topics
+  double validate_ms;  // checking the references and applying the broker defaults
+};
+
+/** The topics of one broker */
+struct BrokerTopics
+{
+  std::vector<MqttTopic> mqtt2ecal;
+  std::vector<EcalTopic> ecal2mqtt;
+};
+
+/** @return the timings as text, e.g. "parse 1.0 ms, convert 2.0 ms, validate 0.5 ms" */
+std::string toString(const ConfigLoadTimings& timings);
+
+/**
+ * Checks the references of the topics to the brokers and applies the defaults of the brokers to the topics
+ *
+ * Topics of unknown brokers and brokers without topics are removed.
+ *
+ * @return false if no broker is configured
+ */
+bool CheckYamlValidity(std::map<std::string, Broker>& brokers,
+                       std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                       std::map<std::string, EcalTopic>& ecal2mqtt_topics);
+
+/**
+ * Loads the yaml file and keeps the valid brokers and topics
+ *
+ * @return false if the file cannot be parsed or @ref CheckYamlValidity fails
+ */
+bool loadConfig(const std::string& path_to_config,
+                GeneralSettings& general_settings,
+                std::map<std::string, Broker>& brokers,
+                std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                std::map<std::string, EcalTopic>& ecal2mqtt_topics,
+                ConfigLoadTimings& timings);
+
+void printConfig(const GeneralSettings& general_settings,
+                 const std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                 const std::map<std::string, EcalTopic>& ecal2mqtt_topics);
+
+/** Sorts the topics to the brokers they use, in one pass over all topics */
+std::map<std::string, BrokerTopics> groupTopicsByBroker(const std::map<std::string, MqttTopic>& mqtt2ecal_topics,
+                                                        const std::map<std::string, EcalTopic>& ecal2mqtt_topics);
+
+/**
+ * Loads and validates the configuration without connecting to any broker, used by --check-config
+ *
+ * @return the exit code, 0 if the configuration is valid
+ */
+int checkConfig(const std::string& path_to_config, bool verbose);
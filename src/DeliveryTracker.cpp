@@ -0,0 +1,190 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "DeliveryTracker.h"
+
+#include <algorithm>
+#include <iterator>
+
+DeliveryTracker::DeliveryTracker(uint32_t sender_id)
+	: sender_id(sender_id)
+{
+}
+
+void DeliveryTracker::wrap(const EcalTopic& route, int64_t send_time, int64_t clock, const void* payload, size_t size, std::string& output)
+{
+	MessageEnvelope envelope;
+	envelope.sender_id = sender_id;
+	envelope.send_time = send_time;
+	envelope.clock     = clock;
+	// the buffered sequence numbers are consecutive, so they are taken and buffered in one step
+	std::lock_guard<std::mutex> lock(envelope_mtx);
+	envelope.sequence = envelope_sequences[route.name]++;
+	envelope.write(static_cast<const char*>(payload), size, output);
+	if (!route.nack_topic.empty())
+	{
+		RetransmitBuffer& buffer = retransmit_buffers[route.name];
+		buffer.setLimit(static_cast<size_t>(route.retransmit_buffer));
+		buffer.add(envelope.sequence, output.data(), output.size());
+	}
+}
+
+DeliveryTracker::Verdict DeliveryTracker::unwrap(const MqttTopic& route, const void* payload, size_t size, int64_t now_us, MessageEnvelope& envelope, bool& is_nack_due, Nack& nack)
+{
+	is_nack_due = false;
+	const bool is_valid = envelope.read(static_cast<const char*>(payload), size);
+	std::lock_guard<std::mutex> lock(envelope_mtx);
+	EnvelopeStatistics& statistics = envelope_statistics[route.name];
+	if (!is_valid)
+	{
+		statistics.addInvalid();
+		return INVALID;
+	}
+	const bool is_duplicate = !statistics.add(envelope, now_us);
+	if (!route.nack_topic.empty())
+	{
+		NackTracker& tracker = nack_trackers[route.name];
+		tracker.setLimits(std::chrono::milliseconds(route.nack_interval), route.nack_retries);
+		tracker.received(envelope.sender_id, envelope.sequence);
+		is_nack_due = tracker.getDueNack(std::chrono::steady_clock::now(), nack);
+	}
+	return is_duplicate ? DUPLICATE : ACCEPTED;
+}
+
+bool DeliveryTracker::isDuplicate(const MqttTopic& route, uint64_t fingerprint)
+{
+	std::lock_guard<std::mutex> lock(duplicate_mtx);
+	DuplicateFilter& filter = duplicate_filters[route.name];
+	filter.setLimits(std::chrono::milliseconds(route.deduplicate_window), static_cast<size_t>(route.deduplicate_max_entries));
+	return filter.isDuplicate(fingerprint, std::chrono::steady_clock::now());
+}
+
+bool DeliveryTracker::collectRetransmits(const std::string& route_name, const void* payload, size_t size, std::vector<std::string>& messages)
+{
+	Nack nack;
+	if (!nack.read(static_cast<const char*>(payload), size) || nack.sender_id != sender_id)
+	{
+		// not a NACK, or for the messages of another (or an earlier run of this) bridge
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(envelope_mtx);
+	auto buffer = retransmit_buffers.find(route_name);
+	if (buffer == retransmit_buffers.end())
+	{
+		return false;
+	}
+	buffer->second.collect(nack, messages);
+	return true;
+}
+
+bool DeliveryTracker::getDueNack(const std::string& route_name, std::chrono::steady_clock::time_point now, Nack& nack)
+{
+	std::lock_guard<std::mutex> lock(envelope_mtx);
+	auto tracker = nack_trackers.find(route_name);
+	return tracker != nack_trackers.end() && tracker->second.getDueNack(now, nack);
+}
+
+void DeliveryTracker::retainRoutes(const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics)
+{
+	{
+		std::lock_guard<std::mutex> lock(envelope_mtx);
+		for (auto buffer = retransmit_buffers.begin(); buffer != retransmit_buffers.end();)
+		{
+			const bool is_used = std::any_of(ecal2mqtt_topics.begin(), ecal2mqtt_topics.end(), [&buffer](const EcalTopic& topic) { return topic.name == buffer->first && !topic.nack_topic.empty(); });
+			buffer = is_used ? std::next(buffer) : retransmit_buffers.erase(buffer);
+		}
+		for (auto tracker = nack_trackers.begin(); tracker != nack_trackers.end();)
+		{
+			const bool is_used = std::any_of(mqtt2ecal_topics.begin(), mqtt2ecal_topics.end(), [&tracker](const MqttTopic& topic) { return topic.name == tracker->first && !topic.nack_topic.empty(); });
+			tracker = is_used ? std::next(tracker) : nack_trackers.erase(tracker);
+		}
+	}
+	std::lock_guard<std::mutex> lock(duplicate_mtx);
+	for (auto filter = duplicate_filters.begin(); filter != duplicate_filters.end();)
+	{
+		const bool is_used = std::any_of(mqtt2ecal_topics.begin(), mqtt2ecal_topics.end(), [&filter](const MqttTopic& topic)
+			{
+				return topic.name == filter->first && topic.deduplicate && !topic.envelope;
+			});
+		filter = is_used ? std::next(filter) : duplicate_filters.erase(filter);
+	}
+}
+
+std::map<std::string, std::string> DeliveryTracker::getEnvelopeStatistics(const std::vector<MqttTopic>& mqtt2ecal_topics) const
+{
+	std::map<std::string, std::string> statistics;
+	std::lock_guard<std::mutex> lock(envelope_mtx);
+	for (auto const& topic : mqtt2ecal_topics)
+	{
+		if (topic.envelope)
+		{
+			auto route = envelope_statistics.find(topic.name);
+			statistics[topic.name] = route != envelope_statistics.end() ? route->second.toString() : "nothing received yet";
+		}
+	}
+	return statistics;
+}
+
+std::map<std::string, std::string> DeliveryTracker::getRetransmitStatistics(const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics) const
+{
+	std::map<std::string, std::string> statistics;
+	std::lock_guard<std::mutex> lock(envelope_mtx);
+	for (auto const& topic : ecal2mqtt_topics)
+	{
+		if (!topic.nack_topic.empty())
+		{
+			auto buffer = retransmit_buffers.find(topic.name);
+			statistics[topic.name] = buffer != retransmit_buffers.end() ? buffer->second.toString() : "nothing sent yet";
+		}
+	}
+	for (auto const& topic : mqtt2ecal_topics)
+	{
+		if (!topic.nack_topic.empty())
+		{
+			auto tracker = nack_trackers.find(topic.name);
+			statistics[topic.name] = tracker != nack_trackers.end() ? tracker->second.toString() : "nothing received yet";
+		}
+	}
+	return statistics;
+}
+
+std::map<std::string, std::string> DeliveryTracker::getDuplicateStatistics(const std::vector<MqttTopic>& mqtt2ecal_topics) const
+{
+	std::map<std::string, std::string> statistics;
+	for (auto const& topic : mqtt2ecal_topics)
+	{
+		if (!topic.deduplicate)
+		{
+			continue;
+		}
+		if (topic.envelope)
+		{
+			std::lock_guard<std::mutex> lock(envelope_mtx);
+			auto route = envelope_statistics.find(topic.name);
+			statistics[topic.name] = std::to_string(route != envelope_statistics.end() ? route->second.getDuplicateCount() : 0) + " duplicates suppressed by their sequence number";
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(duplicate_mtx);
+			auto route = duplicate_filters.find(topic.name);
+			statistics[topic.name] = route != duplicate_filters.end() ? route->second.toString() : "nothing received yet";
+		}
+	}
+	return statistics;
+}
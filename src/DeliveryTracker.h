@@ -0,0 +1,117 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "DuplicateFilter.h"
+#include "EcalTopic.h"
+#include "MessageEnvelope.h"
+#include "MqttTopic.h"
+#include "Retransmission.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Sequence numbers, retransmission and duplicate suppression of the routes of one bridge.
+ *
+ * The ecal2mqtt routes with envelope number their messages and keep them for
+ * retransmission if they have a nack_topic. The mqtt2ecal routes track the
+ * received envelopes, request the missing messages again and suppress the
+ * duplicates, by their sequence number or, without envelope, by the payload.
+ *
+ * All member functions are thread safe.
+ */
+class DeliveryTracker
+{
+public:
+  /** @brief What became of a message received with an envelope */
+  enum Verdict
+  {
+    ACCEPTED,
+    DUPLICATE,   // received before, dropped if the route has deduplicate
+    INVALID      // without a valid envelope, always dropped
+  };
+
+  /** @param sender_id written to the envelopes, NACKs for other senders are ignored */
+  explicit DeliveryTracker(uint32_t sender_id);
+
+  /**
+   * @brief Puts the envelope with the next sequence number of the route in front of the payload
+   *
+   * The message is kept for retransmission if the route has a nack_topic.
+   *
+   * @param send_time  the eCAL send time of the message
+   * @param clock      the eCAL clock of the publisher
+   */
+  void wrap(const EcalTopic& route, int64_t send_time, int64_t clock, const void* payload, size_t size, std::string& output);
+
+  /**
+   * @brief Reads and tracks the envelope of a message received by the route
+   *
+   * @param now_us       the eCAL time, for the latency
+   * @param envelope     receives the envelope
+   * @param is_nack_due  set if missing messages have to be requested, nack receives the request
+   */
+  Verdict unwrap(const MqttTopic& route, const void* payload, size_t size, int64_t now_us, MessageEnvelope& envelope, bool& is_nack_due, Nack& nack);
+
+  /** @return true if the payload (identified by its fingerprint) was received by the route within its deduplicate_window */
+  bool isDuplicate(const MqttTopic& route, uint64_t fingerprint);
+
+  /**
+   * @brief Collects the messages a NACK received for the route requests again
+   *
+   * @return false if the payload is not a NACK for the messages of this bridge
+   */
+  bool collectRetransmits(const std::string& route_name, const void* payload, size_t size, std::vector<std::string>& messages);
+
+  /** @return true if the messages missing on the route have to be requested (again), nack receives the request */
+  bool getDueNack(const std::string& route_name, std::chrono::steady_clock::time_point now, Nack& nack);
+
+  /**
+   * @brief Releases the buffers and payload hashes of routes that no longer use them
+   *
+   * The sequence numbers are kept, numbers starting again would look like redeliveries.
+   */
+  void retainRoutes(const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics);
+
+  /** @return per mqtt2ecal route with envelope: received, lost and reordered messages and their latency */
+  std::map<std::string, std::string> getEnvelopeStatistics(const std::vector<MqttTopic>& mqtt2ecal_topics) const;
+  /** @return per route with nack_topic: the retransmitted messages (ecal2mqtt) or the requested ones (mqtt2ecal) */
+  std::map<std::string, std::string> getRetransmitStatistics(const std::vector<MqttTopic>& mqtt2ecal_topics, const std::vector<EcalTopic>& ecal2mqtt_topics) const;
+  /** @return per mqtt2ecal route with deduplicate: the suppressed duplicates */
+  std::map<std::string, std::string> getDuplicateStatistics(const std::vector<MqttTopic>& mqtt2ecal_topics) const;
+
+private:
+  const uint32_t                            sender_id;
+
+  // by route name
+  mutable std::mutex                        envelope_mtx;
+  std::map<std::string, uint64_t>           envelope_sequences;   // next sequence number of the ecal2mqtt routes
+  std::map<std::string, EnvelopeStatistics> envelope_statistics;  // of the mqtt2ecal routes
+  std::map<std::string, RetransmitBuffer>   retransmit_buffers;   // of the ecal2mqtt routes with nack_topic
+  std::map<std::string, NackTracker>        nack_trackers;        // of the mqtt2ecal routes with nack_topic
+  // payload hashes of the mqtt2ecal routes with deduplicate but without envelope
+  mutable std::mutex                        duplicate_mtx;
+  std::map<std::string, DuplicateFilter>    duplicate_filters;
+};
@@ -0,0 +1,67 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "DuplicateFilter.h"
+
+DuplicateFilter::DuplicateFilter()
+	: window(0)
+	, max_entries(0)
+	, duplicate_count(0)
+	, evicted_count(0)
+{
+}
+
+void DuplicateFilter::setLimits(std::chrono::milliseconds window_, size_t max_entries_)
+{
+	window      = window_;
+	max_entries = max_entries_;
+}
+
+bool DuplicateFilter::isDuplicate(uint64_t key, std::chrono::steady_clock::time_point now)
+{
+	while (!entries.empty() && now - entries.front().first > window)
+	{
+		keys.erase(entries.front().second);
+		entries.pop_front();
+	}
+	if (keys.count(key) > 0)
+	{
+		duplicate_count++;
+		return true;
+	}
+	while (!entries.empty() && entries.size() >= max_entries)
+	{
+		keys.erase(entries.front().second);
+		entries.pop_front();
+		evicted_count++;
+	}
+	if (max_entries > 0)
+	{
+		entries.emplace_back(now, key);
+		keys.insert(key);
+	}
+	return false;
+}
+
+std::string DuplicateFilter::toString() const
+{
+	return std::to_string(duplicate_count) + " duplicates suppressed, "
+		+ std::to_string(entries.size()) + " payloads remembered, "
+		+ std::to_string(evicted_count) + " forgotten before the end of the window";
+}
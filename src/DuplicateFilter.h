@@ -0,0 +1,60 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+/**
+ * @brief Recognizes messages received again within a time window by a key, e.g. the hash of their payload.
+ *
+ * The keys are kept for the window, at most max_entries of them; the oldest
+ * key is dropped early if the limit is reached, so the memory stays bounded.
+ * The class is not thread safe, the owner has to lock.
+ */
+class DuplicateFilter
+{
+public:
+  DuplicateFilter();
+
+  /** @brief Changes the window and the number of keys, e.g. after the route was reloaded */
+  void setLimits(std::chrono::milliseconds window, size_t max_entries);
+
+  /** @return true if the key was added within the window, otherwise it is added */
+  bool isDuplicate(uint64_t key, std::chrono::steady_clock::time_point now);
+
+  /** @return suppressed duplicates, keys in use and keys dropped before the end of the window */
+  std::string toString() const;
+
+private:
+  std::chrono::milliseconds window;
+  size_t                    max_entries;
+
+  std::deque<std::pair<std::chrono::steady_clock::time_point, uint64_t>> entries;   // ascending by time
+  std::unordered_set<uint64_t> keys;
+
+  uint64_t                  duplicate_count;
+  uint64_t                  evicted_count;   // by max_entries
+};
@@ -24,16 +24,71 @@ EcalTopic::EcalTopic()
 	is_set_retain_flag = false;
 	retain_flag = false;
 	qos = -1;
+	output_format = "binary";
+	aggregate_window_ms = 1000;
+	aggregate_step_ms = 0;
+	chunk_size = 0;
+	priority = "normal";
+	weight = 1;
+	max_age_ms = 0;
+	adaptive_qos = false;
+	envelope = false;
+	retransmit_buffer = 1024 * 1024;
 }
 
 bool EcalTopic::CheckValidity()
 {
-	if (broker_name.empty() || ecal_topic_name.empty() || mqtt_out_payload_name.empty())
+	if (broker_name.empty() || ecal_topic_name.empty())
 		return false;
 
-	// check if qos is in range [0,2]
-	if (qos < 0 && qos > 2)
+	// Sparkplug routes publish to the topics of their device instead
+	if (output_format == "sparkplug")
+	{
+		if (sparkplug_device_id.empty() || sparkplug_device_id.find_first_of("/+#") != std::string::npos)
+			return false;
+	}
+	else if (mqtt_out_payload_name.empty())
+	{
+		return false;
+	}
+
+	// check if qos is in range [0,2], -1 means: use the default qos of the broker
+	if (qos < -1 || qos > 2)
+		return false;
+
+	if (output_format != "binary" && output_format != "json" && output_format != "cbor" && output_format != "msgpack" && output_format != "sparkplug")
+		return false;
+
+	// Sparkplug payloads have to be readable by any Sparkplug host application
+	if (chunk_size < 0 || (chunk_size > 0 && output_format == "sparkplug"))
+		return false;
+
+	if (priority != "high" && priority != "normal" && priority != "low")
+		return false;
+
+	if (weight < 1 || max_age_ms < 0)
+		return false;
+
+	// converted payloads and aggregates are meant to be read by any MQTT client
+	if (envelope && (output_format != "binary" || !aggregate_fields.empty()))
+		return false;
+	// the NACKs request the sequence numbers of the envelope
+	if (!nack_topic.empty() && (!envelope || retransmit_buffer == 0 || nack_topic.find_first_of("+#") != std::string::npos))
 		return false;
+
+	// the aggregates are published as JSON, in place of the (projected) messages
+	if (!aggregate_fields.empty())
+	{
+		if ((output_format != "binary" && output_format != "json") || !fields.empty())
+			return false;
+		if (aggregate_window_ms <= 0 || aggregate_step_ms < 0 || (aggregate_step_ms > 0 && aggregate_window_ms % aggregate_step_ms != 0))
+			return false;
+		for (const auto& function : aggregate_functions)
+		{
+			if (function != "min" && function != "max" && function != "mean" && function != "count" && function != "last")
+				return false;
+		}
+	}
 	return true;
 }
 
@@ -41,44 +96,141 @@ void operator>>(const YAML::Node& node, EcalTopic& ecal_topic)
 {
 	try
 	{
+		// the first key is the name of the topic, the other keys are its settings
+		// every key is visited once, a lookup by key would search the whole map each time
+		bool is_name = true;
 		for (const auto& kv : node)
 		{
-			ecal_topic.name = kv.first.as<std::string>();
-			break;
-		}
-		if (node["broker_name"])
-		{
-			if (node["broker_name"].as<std::string>().compare("null") != 0)
-				ecal_topic.broker_name = node["broker_name"].as<std::string>();
-		}
-		if (node["ecal_topic_name"])
-		{
-			if (node["ecal_topic_name"].as<std::string>().compare("null") != 0)
-				ecal_topic.ecal_topic_name = node["ecal_topic_name"].as<std::string>();
-		}
-		if (node["mqtt_out_payload_name"])
-		{
-			if (node["mqtt_out_payload_name"].as<std::string>().compare("null") != 0)
-				ecal_topic.mqtt_out_payload_name = node["mqtt_out_payload_name"].as<std::string>();
-		}
-		if (node["mqtt_out_type_name"])
-		{
-			if (node["mqtt_out_type_name"].as<std::string>().compare("null") != 0)
-				ecal_topic.mqtt_out_type_name = node["mqtt_out_type_name"].as<std::string>();
-		}
-		if (node["mqtt_out_descriptor"])
-		{
-			if (node["mqtt_out_descriptor"].as<std::string>().compare("null") != 0)
-				ecal_topic.mqtt_out_descriptor = node["mqtt_out_descriptor"].as<std::string>();
-		}
-		if (node["retain_flag"])
-		{
-			ecal_topic.is_set_retain_flag = true;
-			ecal_topic.retain_flag = node["retain_flag"].as<bool>();
+			const std::string key = kv.first.as<std::string>();
+			if (is_name)
+			{
+				ecal_topic.name = key;
+				is_name = false;
+				continue;
+			}
+			if (key == "broker_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.broker_name = kv.second.as<std::string>();
+			}
+			else if (key == "ecal_topic_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.ecal_topic_name = kv.second.as<std::string>();
+			}
+			else if (key == "mqtt_out_payload_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.mqtt_out_payload_name = kv.second.as<std::string>();
+			}
+			else if (key == "mqtt_out_type_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.mqtt_out_type_name = kv.second.as<std::string>();
+			}
+			else if (key == "mqtt_out_descriptor")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.mqtt_out_descriptor = kv.second.as<std::string>();
+			}
+			else if (key == "retain_flag")
+			{
+				ecal_topic.is_set_retain_flag = true;
+				ecal_topic.retain_flag = kv.second.as<bool>();
+			}
+			else if (key == "qos")
+			{
+				ecal_topic.qos = kv.second.as<int>();
+			}
+			else if (key == "output_format")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.output_format = kv.second.as<std::string>();
+			}
+			else if (key == "sparkplug_device_id")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.sparkplug_device_id = kv.second.as<std::string>();
+			}
+			else if (key == "sparkplug_deadbands")
+			{
+				for (const auto& deadband : kv.second)
+				{
+					ecal_topic.sparkplug_deadbands[deadband.first.as<std::string>()] = deadband.second.as<double>();
+				}
+			}
+			else if (key == "fields")
+			{
+				for (const auto& field : kv.second)
+				{
+					ecal_topic.fields.push_back(field.as<std::string>());
+				}
+			}
+			else if (key == "filter")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.filter = kv.second.as<std::string>();
+			}
+			else if (key == "aggregate_fields")
+			{
+				for (const auto& field : kv.second)
+				{
+					ecal_topic.aggregate_fields.push_back(field.as<std::string>());
+				}
+			}
+			else if (key == "aggregate_window_ms")
+			{
+				ecal_topic.aggregate_window_ms = kv.second.as<int>();
+			}
+			else if (key == "aggregate_step_ms")
+			{
+				ecal_topic.aggregate_step_ms = kv.second.as<int>();
+			}
+			else if (key == "chunk_size")
+			{
+				ecal_topic.chunk_size = kv.second.as<int>();
+			}
+			else if (key == "max_age_ms")
+			{
+				ecal_topic.max_age_ms = kv.second.as<int>();
+			}
+			else if (key == "envelope")
+			{
+				ecal_topic.envelope = kv.second.as<bool>();
+			}
+			else if (key == "nack_topic")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.nack_topic = kv.second.as<std::string>();
+			}
+			else if (key == "retransmit_buffer")
+			{
+				ecal_topic.retransmit_buffer = kv.second.as<unsigned long long>();
+			}
+			else if (key == "adaptive_qos")
+			{
+				ecal_topic.adaptive_qos = kv.second.as<bool>();
+			}
+			else if (key == "weight")
+			{
+				ecal_topic.weight = kv.second.as<int>();
+			}
+			else if (key == "priority")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					ecal_topic.priority = kv.second.as<std::string>();
+			}
+			else if (key == "aggregate_functions")
+			{
+				for (const auto& function : kv.second)
+				{
+					ecal_topic.aggregate_functions.push_back(function.as<std::string>());
+				}
+			}
 		}
-		if (node["qos"])
+		if (ecal_topic.sparkplug_device_id.empty())
 		{
-			ecal_topic.qos = node["qos"].as<int>();
+			ecal_topic.sparkplug_device_id = ecal_topic.name;
 		}
 	}
 	catch (const YAML::BadConversion& e)
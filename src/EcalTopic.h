@@ -22,6 +22,7 @@
 #include "yaml-cpp/yaml.h"
 #include <vector>
 #include <iostream>
+#include <map>
 
 
 class EcalTopic
@@ -41,6 +42,40 @@ public:
 	bool retain_flag;
 	bool is_set_retain_flag;
 	int qos;
+	// "binary" (payload unchanged), "json", "cbor", "msgpack" (protobuf converted to that format)
+	// or "sparkplug" (protobuf fields sent as metrics of a Sparkplug B device)
+	std::string output_format;
+	// Sparkplug B device of the route, the route name if not set
+	std::string sparkplug_device_id;
+	// minimum change of a numeric metric (by its name) before it is reported again
+	std::map<std::string, double> sparkplug_deadbands;
+	// dot separated field paths, only these fields of the protobuf message are forwarded, all fields if empty
+	std::vector<std::string> fields;
+	// predicate over the fields of the protobuf message, e.g. "status.error_code != 0 && speed > 5", only matching messages are forwarded
+	std::string filter;
+	// numeric fields aggregated over time windows of the eCAL send time, one JSON document per window is published instead of the messages
+	std::vector<std::string> aggregate_fields;
+	int aggregate_window_ms;
+	// distance between the starts of two windows, a divisor of aggregate_window_ms; 0 for tumbling windows (step = window)
+	int aggregate_step_ms;
+	// min, max, mean, count and last, all if empty
+	std::vector<std::string> aggregate_functions;
+	// payloads are split into chunks of at most this size (plus the chunk header), 0 to send them unchanged
+	int chunk_size;
+	// "high", "normal" or "low": while messages wait to be sent, those of a higher priority are sent first and those of a lower one are dropped first
+	std::string priority;
+	// share of the bandwidth relative to the other routes of the same priority, while they have messages waiting
+	int weight;
+	// messages are dropped this many ms after their eCAL send time instead of being sent late, 0 to keep them;
+	// with MQTT v5 the rest of the time is sent as Message Expiry Interval
+	int max_age_ms;
+	// the QoS is lowered while the link to the broker is congested (qos_downgrade_outstanding / qos_downgrade_latency of the broker)
+	bool adaptive_qos;
+	// the payload is sent in an envelope with a sequence number, the eCAL send time and the eCAL clock, for routes with output_format binary
+	bool envelope;
+	// NACKs of the receiving bridge are received on this topic, the requested messages are sent again from a buffer of retransmit_buffer bytes
+	std::string nack_topic;
+	unsigned long long retransmit_buffer;
 };
 
 void operator>> (const YAML::Node& node, EcalTopic& ecal_topic);
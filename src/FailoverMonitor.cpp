@@ -0,0 +1,229 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "FailoverMonitor.h"
+
+#include "utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>       // sockaddr_un
+#include <netdb.h>        // getaddrinfo
+#include <poll.h>
+#include <unistd.h>       // close
+
+FailoverMonitor::FailoverMonitor(const std::vector<BrokerEndpoint>& endpoints, int interval_ms, int timeout_ms, int failback_interval_ms, const Link& link)
+	: endpoints(endpoints)
+	, interval(interval_ms)
+	, timeout(timeout_ms)
+	, failback_interval(failback_interval_ms)
+	, link(link)
+	, current_endpoint(0)
+	, is_running(false)
+	, ping_mid(-1)
+	, acknowledged_count(0)
+	, is_failover_pending(false)
+	, last_failover_ms(-1)
+	, failover_counter(0)
+{
+}
+
+FailoverMonitor::~FailoverMonitor()
+{
+	stop();
+}
+
+void FailoverMonitor::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		is_running = false;
+		cv.notify_all();
+	}
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void FailoverMonitor::start()
+{
+	is_running = true;
+	thread = std::thread(&FailoverMonitor::healthCheckLoop, this);
+}
+
+const BrokerEndpoint& FailoverMonitor::getCurrentEndpoint() const
+{
+	return endpoints[current_endpoint];
+}
+
+void FailoverMonitor::onPublished(int mid)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (mid == ping_mid)
+	{
+		ping_mid = -1;
+		cv.notify_all();
+	}
+}
+
+void FailoverMonitor::onAcknowledged()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	acknowledged_count++;
+	cv.notify_all();
+}
+
+void FailoverMonitor::onConnected()
+{
+	if (is_failover_pending.exchange(false))
+	{
+		last_failover_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - failover_started).count());
+		printOutput("Switched to broker endpoint " + std::to_string(current_endpoint) + " within " + std::to_string(last_failover_ms) + " ms");
+	}
+}
+
+int FailoverMonitor::getLastFailoverMs() const
+{
+	return last_failover_ms;
+}
+
+int FailoverMonitor::getFailoverCounter() const
+{
+	return failover_counter;
+}
+
+void FailoverMonitor::healthCheckLoop()
+{
+	auto disconnected_since   = std::chrono::steady_clock::now();
+	auto last_failback_probe  = std::chrono::steady_clock::now();
+
+	while (is_running == true)
+	{
+		bool healthy = false;
+		if (link.is_connected())
+		{
+			// application level ping: a QoS 1 message is only acknowledged if the broker is actually processing our traffic
+			std::unique_lock<std::mutex> lock(mtx);
+			int mid = 0;
+			ping_mid = -1;
+			if (link.ping(mid))
+			{
+				ping_mid = mid;
+				const uint64_t acknowledged_before = acknowledged_count;
+				healthy = cv.wait_for(lock, timeout, [this, acknowledged_before]()
+					{
+						return ping_mid == -1 || acknowledged_count != acknowledged_before || is_running == false;
+					});
+			}
+			disconnected_since = std::chrono::steady_clock::now();
+		}
+		else
+		{
+			// give the regular reconnect a chance before switching to the next endpoint
+			healthy = (std::chrono::steady_clock::now() - disconnected_since) < timeout;
+		}
+		if (is_running == false)
+		{
+			break;
+		}
+
+		if (!healthy)
+		{
+			printError("Broker endpoint " + std::to_string(current_endpoint) + " is not responding, failing over");
+			switchEndpoint((current_endpoint + 1) % endpoints.size());
+			disconnected_since = std::chrono::steady_clock::now();
+		}
+		else if (current_endpoint != 0 && failback_interval.count() > 0
+			&& std::chrono::steady_clock::now() - last_failback_probe >= failback_interval)
+		{
+			last_failback_probe = std::chrono::steady_clock::now();
+			if (isEndpointReachable(endpoints.front(), static_cast<int>(timeout.count())))
+			{
+				printOutput("Primary broker endpoint is reachable again, failing back");
+				switchEndpoint(0);
+				disconnected_since = std::chrono::steady_clock::now();
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait_for(lock, interval, [this]() { return is_running == false; });
+	}
+}
+
+void FailoverMonitor::switchEndpoint(size_t endpoint_index)
+{
+	failover_started = std::chrono::steady_clock::now();
+	is_failover_pending = true;
+	failover_counter++;
+	current_endpoint = endpoint_index;
+	link.switch_endpoint();
+}
+
+bool FailoverMonitor::isEndpointReachable(const BrokerEndpoint& endpoint, int timeout_ms)
+{
+	int sock = -1;
+	bool reachable = false;
+	if (endpoint.unix_socket.size() > 0)
+	{
+		struct sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, endpoint.unix_socket.c_str(), sizeof(address.sun_path) - 1);
+		sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		reachable = (sock >= 0) && (::connect(sock, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0);
+	}
+	else
+	{
+		struct addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		struct addrinfo* result = NULL;
+		if (getaddrinfo(endpoint.host.c_str(), std::to_string(endpoint.port).c_str(), &hints, &result) != 0)
+		{
+			return false;
+		}
+		sock = ::socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		if (sock >= 0)
+		{
+			// non blocking connect, so an unreachable host cannot stall the health check for the TCP connect timeout
+			if (::connect(sock, result->ai_addr, result->ai_addrlen) == 0)
+			{
+				reachable = true;
+			}
+			else if (errno == EINPROGRESS)
+			{
+				struct pollfd poll_fd = { sock, POLLOUT, 0 };
+				int socket_error = 0;
+				socklen_t length = sizeof(socket_error);
+				reachable = (poll(&poll_fd, 1, timeout_ms) == 1)
+					&& (getsockopt(sock, SOL_SOCKET, SO_ERROR, &socket_error, &length) == 0)
+					&& (socket_error == 0);
+			}
+		}
+		freeaddrinfo(result);
+	}
+	if (sock >= 0)
+	{
+		close(sock);
+	}
+	return reachable;
+}
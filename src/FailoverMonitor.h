@@ -0,0 +1,116 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "Broker.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Pings the broker periodically and switches to the next endpoint if it does not answer in time.
+ *
+ * The ping is an application level QoS 1 message, it is only acknowledged if
+ * the broker is actually processing our traffic. Behind a backlog of QoS 1/2
+ * messages the ping waits for an in-flight slot like every other message, so
+ * any acknowledge received within the timeout counts as an answer as well.
+ * While connected to a fallback
+ * endpoint, the primary endpoint is probed every failback interval and the
+ * connection switches back once it is reachable.
+ */
+class FailoverMonitor
+{
+public:
+  /** @brief The broker connection, all functions are called by the thread of the monitor */
+  struct Link
+  {
+    std::function<bool()>                   is_connected;
+    std::function<bool(int& mid)>           ping;              // publishes the ping, false if it cannot be sent
+    std::function<void()>                   switch_endpoint;   // drops the connection and connects to the current endpoint
+  };
+
+  /**
+   * @param endpoints             the endpoints of the broker, the first one is the primary endpoint
+   * @param interval_ms           time between two pings
+   * @param timeout_ms            time the broker has to acknowledge a ping (or to reconnect)
+   * @param failback_interval_ms  time between two probes of the primary endpoint, 0 to stay on the fallback endpoint
+   */
+  FailoverMonitor(const std::vector<BrokerEndpoint>& endpoints, int interval_ms, int timeout_ms, int failback_interval_ms, const Link& link);
+  ~FailoverMonitor();
+
+  FailoverMonitor(const FailoverMonitor&) = delete;
+  FailoverMonitor& operator=(const FailoverMonitor&) = delete;
+
+  /** @brief Starts the thread that pings the broker */
+  void start();
+
+  /** @brief Stops the thread, a failover in progress is completed first */
+  void stop();
+
+  /** @return the endpoint currently used */
+  const BrokerEndpoint& getCurrentEndpoint() const;
+
+  /** @brief Confirms the ping with this message id, called once the broker acknowledged a message */
+  void onPublished(int mid);
+
+  /** @brief Shows that the broker processes our traffic, called once it acknowledged any QoS 1/2 message */
+  void onAcknowledged();
+
+  /** @brief Completes a pending failover, called on every CONNACK */
+  void onConnected();
+
+  /** @return the time between detecting a broker failure and the CONNACK of the next endpoint of the last failover, -1 if there was none */
+  int getLastFailoverMs() const;
+  int getFailoverCounter() const;
+
+  /** @brief Checks whether a TCP or unix domain socket connection to the endpoint can be established */
+  static bool isEndpointReachable(const BrokerEndpoint& endpoint, int timeout_ms);
+
+private:
+  void healthCheckLoop();
+
+  /** @brief Records the start of the failover and lets the link connect to the endpoint */
+  void switchEndpoint(size_t endpoint_index);
+
+  const std::vector<BrokerEndpoint>         endpoints;
+  const std::chrono::milliseconds           interval;
+  const std::chrono::milliseconds           timeout;
+  const std::chrono::milliseconds           failback_interval;
+  const Link                                link;
+
+  std::atomic<size_t>                       current_endpoint;
+  std::thread                               thread;
+  std::atomic<bool>                         is_running;
+  std::mutex                                mtx;
+  std::condition_variable                   cv;
+  int                                       ping_mid;
+  uint64_t                                  acknowledged_count;
+  std::chrono::steady_clock::time_point     failover_started;
+  std::atomic<bool>                         is_failover_pending;
+  std::atomic<int>                          last_failover_ms;
+  std::atomic<int>                          failover_counter;
+};
@@ -0,0 +1,260 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "FieldProjection.h"
+
+#include <algorithm>
+
+using google::protobuf::Descriptor;
+using google::protobuf::FieldDescriptor;
+
+// deeper nested messages are rejected
+static const int MAX_DEPTH = 64;
+
+enum WireType
+{
+	WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_LENGTH_DELIMITED = 2, WIRE_START_GROUP = 3, WIRE_END_GROUP = 4, WIRE_FIXED32 = 5
+};
+
+static bool readVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && data < end; shift += 7)
+	{
+		const uint8_t byte = *data++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static size_t encodeVarint(uint64_t value, char* output)
+{
+	size_t size = 0;
+	while (value >= 0x80)
+	{
+		output[size++] = static_cast<char>((value & 0x7F) | 0x80);
+		value >>= 7;
+	}
+	output[size++] = static_cast<char>(value);
+	return size;
+}
+
+/** @brief Moves data behind the value of a field, without decoding it */
+static bool skipValue(const uint8_t*& data, const uint8_t* end, uint32_t wire_type, uint32_t number, int depth)
+{
+	uint64_t value;
+	switch (wire_type)
+	{
+	case WIRE_VARINT:
+		return readVarint(data, end, value);
+	case WIRE_FIXED64:
+		if (end - data < 8)
+			return false;
+		data += 8;
+		return true;
+	case WIRE_FIXED32:
+		if (end - data < 4)
+			return false;
+		data += 4;
+		return true;
+	case WIRE_LENGTH_DELIMITED:
+		if (!readVarint(data, end, value) || value > static_cast<uint64_t>(end - data))
+			return false;
+		data += value;
+		return true;
+	case WIRE_START_GROUP:
+		// the fields of the group up to its end tag
+		if (depth >= MAX_DEPTH)
+			return false;
+		while (data < end)
+		{
+			uint64_t tag;
+			if (!readVarint(data, end, tag))
+				return false;
+			if ((tag & 0x07) == WIRE_END_GROUP)
+				return (tag >> 3) == number;
+			if (!skipValue(data, end, static_cast<uint32_t>(tag & 0x07), static_cast<uint32_t>(tag >> 3), depth + 1))
+				return false;
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+/** @return the field by its name in the .proto file or by its JSON name */
+static const FieldDescriptor* findField(const Descriptor* descriptor, const std::string& name)
+{
+	const FieldDescriptor* field = descriptor->FindFieldByName(name);
+	if (field)
+	{
+		return field;
+	}
+	for (int i = 0; i < descriptor->field_count(); i++)
+	{
+		if (descriptor->field(i)->json_name() == name)
+		{
+			return descriptor->field(i);
+		}
+	}
+	return nullptr;
+}
+
+FieldProjection::FieldProjection(const std::shared_ptr<const ProtobufSchema>& schema)
+	: schema(schema)
+{
+}
+
+std::shared_ptr<const FieldProjection> FieldProjection::compile(const std::shared_ptr<const ProtobufSchema>& schema, const std::vector<std::string>& paths, std::string& error)
+{
+	std::shared_ptr<FieldProjection> projection(new FieldProjection(schema));
+	for (const auto& path : paths)
+	{
+		MessagePlan* plan = &projection->root;
+		const Descriptor* descriptor = schema->descriptor;
+		size_t begin = 0;
+		while (true)
+		{
+			const size_t end = path.find('.', begin);
+			const bool is_last = end == std::string::npos;
+			const std::string name = path.substr(begin, is_last ? std::string::npos : end - begin);
+			const FieldDescriptor* field = descriptor ? findField(descriptor, name) : nullptr;
+			if (!field)
+			{
+				error = "field " + path + " does not exist in " + schema->descriptor->full_name();
+				return nullptr;
+			}
+			if (!is_last && (field->type() != FieldDescriptor::TYPE_MESSAGE))
+			{
+				error = "field " + path.substr(0, end) + " is not a message, it can only be selected as a whole";
+				return nullptr;
+			}
+
+			auto field_plan = std::find_if(plan->fields.begin(), plan->fields.end(), [field](const FieldPlan& existing) { return existing.number == static_cast<uint32_t>(field->number()); });
+			if (field_plan == plan->fields.end())
+			{
+				plan->fields.push_back({ static_cast<uint32_t>(field->number()), field->is_repeated(), nullptr });
+				if (is_last)
+				{
+					break;
+				}
+				plan->fields.back().nested.reset(new MessagePlan());
+				plan = plan->fields.back().nested.get();
+			}
+			else if (!field_plan->nested)
+			{
+				// the whole field is selected already
+				break;
+			}
+			else if (is_last)
+			{
+				field_plan->nested.reset();
+				break;
+			}
+			else
+			{
+				plan = field_plan->nested.get();
+			}
+			descriptor = field->message_type();
+			begin = end + 1;
+		}
+	}
+
+	std::vector<MessagePlan*> plans = { &projection->root };
+	while (!plans.empty())
+	{
+		MessagePlan* plan = plans.back();
+		plans.pop_back();
+		std::sort(plan->fields.begin(), plan->fields.end(), [](const FieldPlan& a, const FieldPlan& b) { return a.number < b.number; });
+		for (auto& field : plan->fields)
+		{
+			if (field.nested)
+			{
+				plans.push_back(field.nested.get());
+			}
+		}
+	}
+	return projection;
+}
+
+bool FieldProjection::project(const char* data, size_t size, std::string& output) const
+{
+	output.clear();
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+	return projectMessage(root, begin, begin + size, output, 0);
+}
+
+bool FieldProjection::projectMessage(const MessagePlan& plan, const uint8_t* data, const uint8_t* end, std::string& output, int depth) const
+{
+	if (depth >= MAX_DEPTH)
+	{
+		return false;
+	}
+	while (data < end)
+	{
+		const uint8_t* field_start = data;
+		uint64_t tag;
+		if (!readVarint(data, end, tag))
+		{
+			return false;
+		}
+		const uint32_t number    = static_cast<uint32_t>(tag >> 3);
+		const uint32_t wire_type = static_cast<uint32_t>(tag & 0x07);
+		const uint8_t* value_start = data;
+		if (!skipValue(data, end, wire_type, number, depth))
+		{
+			return false;
+		}
+
+		auto field = std::lower_bound(plan.fields.begin(), plan.fields.end(), number, [](const FieldPlan& field_plan, uint32_t value) { return field_plan.number < value; });
+		if (field == plan.fields.end() || field->number != number)
+		{
+			continue;
+		}
+		if (!field->nested || wire_type != WIRE_LENGTH_DELIMITED)
+		{
+			output.append(reinterpret_cast<const char*>(field_start), static_cast<size_t>(data - field_start));
+			continue;
+		}
+
+		// a submessage on a selected path, its length is only known once it is projected
+		const size_t tag_position = output.size();
+		output.append(reinterpret_cast<const char*>(field_start), static_cast<size_t>(value_start - field_start));
+		const size_t child_position = output.size();
+		uint64_t length;
+		readVarint(value_start, end, length);
+		if (!projectMessage(*field->nested, value_start, value_start + length, output, depth + 1))
+		{
+			return false;
+		}
+		const size_t child_size = output.size() - child_position;
+		if (child_size == 0 && !field->is_repeated)
+		{
+			output.resize(tag_position);
+			continue;
+		}
+		char length_bytes[10];
+		output.insert(child_position, length_bytes, encodeVarint(child_size, length_bytes));
+	}
+	return true;
+}
@@ -0,0 +1,90 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "ProtobufSchema.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reduces serialized protobuf messages to a selected set of fields.
+ *
+ * The field paths (e.g. "pose.position") are resolved against the descriptor
+ * once, into a tree of field numbers. A message is then projected on its wire
+ * format: selected fields are copied unchanged, submessages on a selected path
+ * are projected recursively and everything else is skipped by its length
+ * without being decoded. The result is a valid message of the same type that
+ * only contains the selected fields.
+ *
+ * A path selects a field of every element of a repeated message field it
+ * passes through. Singular submessages that end up empty are left out.
+ *
+ * The projection is immutable and can be used by several threads at once.
+ */
+class FieldProjection
+{
+public:
+  /**
+   * @brief Resolves the field paths against the message type of the schema
+   *
+   * @param schema  the message type
+   * @param paths   dot separated field names, as in the .proto file or as JSON names
+   * @param error   receives the reason if a path cannot be resolved
+   *
+   * @return the projection, or nullptr if a path does not exist
+   */
+  static std::shared_ptr<const FieldProjection> compile(const std::shared_ptr<const ProtobufSchema>& schema, const std::vector<std::string>& paths, std::string& error);
+
+  /**
+   * @brief Copies the selected fields of a serialized message
+   *
+   * @param data    the serialized message
+   * @param size    length of the message
+   * @param output  receives the projected message, its capacity is reused
+   *
+   * @return false if the message is malformed
+   */
+  bool project(const char* data, size_t size, std::string& output) const;
+
+private:
+  struct MessagePlan;
+
+  struct FieldPlan
+  {
+    uint32_t                     number;
+    bool                         is_repeated;
+    std::unique_ptr<MessagePlan> nested;   // not set if the whole field is selected
+  };
+
+  struct MessagePlan
+  {
+    std::vector<FieldPlan> fields;   // sorted by number
+  };
+
+  explicit FieldProjection(const std::shared_ptr<const ProtobufSchema>& schema);
+
+  bool projectMessage(const MessagePlan& plan, const uint8_t* data, const uint8_t* end, std::string& output, int depth) const;
+
+  const std::shared_ptr<const ProtobufSchema> schema;
+  MessagePlan                                 root;
+};
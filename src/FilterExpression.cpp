@@ -0,0 +1,651 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "FilterExpression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+using google::protobuf::Descriptor;
+using google::protobuf::EnumValueDescriptor;
+using google::protobuf::FieldDescriptor;
+
+// deeper nested messages are rejected
+static const int MAX_DEPTH = 64;
+
+enum WireType
+{
+	WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_LENGTH_DELIMITED = 2, WIRE_START_GROUP = 3, WIRE_END_GROUP = 4, WIRE_FIXED32 = 5
+};
+
+static bool readVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && data < end; shift += 7)
+	{
+		const uint8_t byte = *data++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool skipValue(const uint8_t*& data, const uint8_t* end, uint32_t wire_type, uint32_t number, int depth)
+{
+	uint64_t value;
+	switch (wire_type)
+	{
+	case WIRE_VARINT:
+		return readVarint(data, end, value);
+	case WIRE_FIXED64:
+		if (end - data < 8)
+			return false;
+		data += 8;
+		return true;
+	case WIRE_FIXED32:
+		if (end - data < 4)
+			return false;
+		data += 4;
+		return true;
+	case WIRE_LENGTH_DELIMITED:
+		if (!readVarint(data, end, value) || value > static_cast<uint64_t>(end - data))
+			return false;
+		data += value;
+		return true;
+	case WIRE_START_GROUP:
+		if (depth >= MAX_DEPTH)
+			return false;
+		while (data < end)
+		{
+			uint64_t tag;
+			if (!readVarint(data, end, tag))
+				return false;
+			if ((tag & 0x07) == WIRE_END_GROUP)
+				return (tag >> 3) == number;
+			if (!skipValue(data, end, static_cast<uint32_t>(tag & 0x07), static_cast<uint32_t>(tag >> 3), depth + 1))
+				return false;
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+static uint64_t readFixed(const uint8_t* data, int size)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < size; i++)
+	{
+		value |= static_cast<uint64_t>(data[i]) << (8 * i);
+	}
+	return value;
+}
+
+static const FieldDescriptor* findField(const Descriptor* descriptor, const std::string& name)
+{
+	const FieldDescriptor* field = descriptor->FindFieldByName(name);
+	if (field)
+	{
+		return field;
+	}
+	for (int i = 0; i < descriptor->field_count(); i++)
+	{
+		if (descriptor->field(i)->json_name() == name)
+		{
+			return descriptor->field(i);
+		}
+	}
+	return nullptr;
+}
+
+/** @brief Recursive descent parser that appends the nodes of the expression to the filter */
+class FilterExpression::Parser
+{
+public:
+	Parser(FilterExpression& filter, const std::string& text)
+		: filter(filter)
+		, text(text)
+		, pos(0)
+	{}
+
+	bool parse(std::string& reason)
+	{
+		if (!parseOr(filter.root))
+		{
+			reason = error;
+			return false;
+		}
+		skipWhitespace();
+		if (pos < text.size())
+		{
+			reason = "unexpected '" + text.substr(pos, 16) + "' at position " + std::to_string(pos);
+			return false;
+		}
+		return true;
+	}
+
+private:
+	bool parseOr(size_t& node)
+	{
+		if (!parseAnd(node))
+			return false;
+		while (consume("||"))
+		{
+			size_t right;
+			if (!parseAnd(right))
+				return false;
+			node = addNode(OR, NUMBER, node, right);
+		}
+		return true;
+	}
+
+	bool parseAnd(size_t& node)
+	{
+		if (!parseNot(node))
+			return false;
+		while (consume("&&"))
+		{
+			size_t right;
+			if (!parseNot(right))
+				return false;
+			node = addNode(AND, NUMBER, node, right);
+		}
+		return true;
+	}
+
+	bool parseNot(size_t& node)
+	{
+		skipWhitespace();
+		if (pos < text.size() && text[pos] == '!' && text.compare(pos, 2, "!=") != 0)
+		{
+			pos++;
+			size_t operand;
+			if (!parseNot(operand))
+				return false;
+			node = addNode(NOT, NUMBER, operand, 0);
+			return true;
+		}
+		return parseComparison(node);
+	}
+
+	bool parseComparison(size_t& node)
+	{
+		if (!parseOperand(node))
+			return false;
+
+		NodeType type;
+		if (consume("=="))      type = EQUAL;
+		else if (consume("!=")) type = NOT_EQUAL;
+		else if (consume("<=")) type = LESS_EQUAL;
+		else if (consume(">=")) type = GREATER_EQUAL;
+		else if (consume("<"))  type = LESS;
+		else if (consume(">"))  type = GREATER;
+		else return true;
+
+		size_t right;
+		if (!parseOperand(right))
+			return false;
+		for (size_t operand : { node, right })
+		{
+			if (filter.nodes[operand].type != LITERAL && filter.nodes[operand].type != FIELD)
+				return fail("only fields and values can be compared");
+		}
+		if (!resolveEnumName(node, right) || !resolveEnumName(right, node))
+			return false;
+		if (filter.nodes[node].value_type != filter.nodes[right].value_type)
+			return fail("a string cannot be compared with a number");
+		node = addNode(type, NUMBER, node, right);
+		return true;
+	}
+
+	bool parseOperand(size_t& node)
+	{
+		skipWhitespace();
+		if (pos >= text.size())
+			return fail("unexpected end of the expression");
+
+		const char c = text[pos];
+		if (c == '(')
+		{
+			pos++;
+			if (!parseOr(node))
+				return false;
+			if (!consume(")"))
+				return fail("missing ) at position " + std::to_string(pos));
+			return true;
+		}
+		if (c == '"' || c == '\'')
+		{
+			return parseString(node);
+		}
+		if (std::isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '+' || c == '.')
+		{
+			const char* begin = text.c_str() + pos;
+			char* end = nullptr;
+			const double number = std::strtod(begin, &end);
+			if (end == begin)
+				return fail("invalid number at position " + std::to_string(pos));
+			pos += static_cast<size_t>(end - begin);
+			node = addLiteral(number, std::string());
+			return true;
+		}
+		if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+		{
+			const size_t begin = pos;
+			while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_' || text[pos] == '.'))
+			{
+				pos++;
+			}
+			const std::string path = text.substr(begin, pos - begin);
+			if (path == "true" || path == "false")
+			{
+				node = addLiteral(path == "true" ? 1.0 : 0.0, std::string());
+				return true;
+			}
+			return resolveField(path, node);
+		}
+		return fail("unexpected '" + std::string(1, c) + "' at position " + std::to_string(pos));
+	}
+
+	bool parseString(size_t& node)
+	{
+		const char quote = text[pos++];
+		std::string value;
+		while (pos < text.size() && text[pos] != quote)
+		{
+			if (text[pos] == '\\' && pos + 1 < text.size())
+			{
+				pos++;
+			}
+			value.push_back(text[pos++]);
+		}
+		if (pos >= text.size())
+			return fail("unterminated string");
+		pos++;
+		node = addLiteral(0.0, value);
+		filter.nodes[node].value_type = STRING;
+		return true;
+	}
+
+	/** @brief Adds the field to the decoding plan, a path used several times is decoded once */
+	bool resolveField(const std::string& path, size_t& node)
+	{
+		auto known = slots.find(path);
+		if (known != slots.end())
+		{
+			node = known->second;
+			return true;
+		}
+
+		MessagePlan* plan = &filter.root_plan;
+		const Descriptor* descriptor = filter.schema->descriptor;
+		size_t begin = 0;
+		while (true)
+		{
+			const size_t end = path.find('.', begin);
+			const bool is_last = end == std::string::npos;
+			const FieldDescriptor* field = findField(descriptor, path.substr(begin, is_last ? std::string::npos : end - begin));
+			if (!field)
+				return fail("field " + path + " does not exist in " + filter.schema->descriptor->full_name());
+			if (field->is_repeated())
+				return fail("field " + path + " is repeated, repeated fields cannot be used in a filter");
+			const bool is_message = field->type() == FieldDescriptor::TYPE_MESSAGE || field->type() == FieldDescriptor::TYPE_GROUP;
+			if (is_last && is_message)
+				return fail("field " + path + " is a message, only its fields can be used in a filter");
+			if (!is_last && field->type() != FieldDescriptor::TYPE_MESSAGE)
+				return fail("field " + path.substr(0, end) + " is not a message");
+
+			if (is_last)
+			{
+				// the same field under another name, e.g. its JSON name
+				auto used = std::find_if(plan->fields.begin(), plan->fields.end(), [field](const FieldPlan& existing) { return existing.field == field; });
+				if (used != plan->fields.end())
+				{
+					node = slot_nodes[used->slot];
+					slots[path] = node;
+					return true;
+				}
+
+				const size_t slot = filter.defaults.size();
+				filter.defaults.push_back(getDefault(field));
+				plan->fields.push_back({ static_cast<uint32_t>(field->number()), field, slot, nullptr });
+
+				node = addNode(FIELD, field->cpp_type() == FieldDescriptor::CPPTYPE_STRING ? STRING : NUMBER, 0, 0);
+				filter.nodes[node].slot      = slot;
+				filter.nodes[node].enum_type = field->enum_type();
+				slot_nodes.push_back(node);
+				slots[path] = node;
+				return true;
+			}
+			auto field_plan = std::find_if(plan->fields.begin(), plan->fields.end(), [field](const FieldPlan& existing) { return existing.nested && existing.number == static_cast<uint32_t>(field->number()); });
+			if (field_plan == plan->fields.end())
+			{
+				plan->fields.push_back({ static_cast<uint32_t>(field->number()), nullptr, 0, std::unique_ptr<MessagePlan>(new MessagePlan()) });
+				field_plan = plan->fields.end() - 1;
+			}
+			plan = field_plan->nested.get();
+			descriptor = field->message_type();
+			begin = end + 1;
+		}
+	}
+
+	/** @brief Replaces a string compared with an enum field by the number of the enum value */
+	bool resolveEnumName(size_t field, size_t literal)
+	{
+		Node& field_node   = filter.nodes[field];
+		Node& literal_node = filter.nodes[literal];
+		if (field_node.type != FIELD || field_node.enum_type == nullptr || literal_node.type != LITERAL || literal_node.value_type != STRING)
+			return true;
+		const EnumValueDescriptor* value = field_node.enum_type->FindValueByName(literal_node.literal.text);
+		if (!value)
+			return fail(literal_node.literal.text + " is not a value of " + field_node.enum_type->full_name());
+		literal_node.value_type     = NUMBER;
+		literal_node.literal.number = value->number();
+		literal_node.literal.text.clear();
+		return true;
+	}
+
+	static Value getDefault(const FieldDescriptor* field)
+	{
+		Value value{ 0.0, std::string() };
+		switch (field->cpp_type())
+		{
+		case FieldDescriptor::CPPTYPE_INT32:  value.number = field->default_value_int32(); break;
+		case FieldDescriptor::CPPTYPE_INT64:  value.number = static_cast<double>(field->default_value_int64()); break;
+		case FieldDescriptor::CPPTYPE_UINT32: value.number = field->default_value_uint32(); break;
+		case FieldDescriptor::CPPTYPE_UINT64: value.number = static_cast<double>(field->default_value_uint64()); break;
+		case FieldDescriptor::CPPTYPE_DOUBLE: value.number = field->default_value_double(); break;
+		case FieldDescriptor::CPPTYPE_FLOAT:  value.number = field->default_value_float(); break;
+		case FieldDescriptor::CPPTYPE_BOOL:   value.number = field->default_value_bool() ? 1.0 : 0.0; break;
+		case FieldDescriptor::CPPTYPE_ENUM:   value.number = field->default_value_enum()->number(); break;
+		case FieldDescriptor::CPPTYPE_STRING: value.text   = field->default_value_string(); break;
+		default: break;
+		}
+		return value;
+	}
+
+	size_t addNode(NodeType type, ValueType value_type, size_t left, size_t right)
+	{
+		filter.nodes.push_back({ type, value_type, left, right, 0, { 0.0, std::string() }, nullptr });
+		return filter.nodes.size() - 1;
+	}
+
+	size_t addLiteral(double number, const std::string& value)
+	{
+		const size_t node = addNode(LITERAL, NUMBER, 0, 0);
+		filter.nodes[node].literal = { number, value };
+		return node;
+	}
+
+	bool consume(const char* token)
+	{
+		skipWhitespace();
+		const size_t length = std::strlen(token);
+		if (text.compare(pos, length, token) != 0)
+			return false;
+		pos += length;
+		return true;
+	}
+
+	void skipWhitespace()
+	{
+		while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+		{
+			pos++;
+		}
+	}
+
+	bool fail(const std::string& reason)
+	{
+		error = reason;
+		return false;
+	}
+
+	FilterExpression&             filter;
+	const std::string&            text;
+	size_t                        pos;
+	std::string                   error;
+	std::map<std::string, size_t> slots;        // FIELD node by path
+	std::vector<size_t>           slot_nodes;   // FIELD node by slot
+};
+
+FilterExpression::FilterExpression(const std::shared_ptr<const ProtobufSchema>& schema)
+	: schema(schema)
+	, root(0)
+{
+}
+
+std::shared_ptr<const FilterExpression> FilterExpression::compile(const std::shared_ptr<const ProtobufSchema>& schema, const std::string& expression, std::string& error)
+{
+	std::shared_ptr<FilterExpression> filter(new FilterExpression(schema));
+	Parser parser(*filter, expression);
+	if (!parser.parse(error))
+	{
+		return nullptr;
+	}
+
+	std::vector<MessagePlan*> plans = { &filter->root_plan };
+	while (!plans.empty())
+	{
+		MessagePlan* plan = plans.back();
+		plans.pop_back();
+		std::sort(plan->fields.begin(), plan->fields.end(), [](const FieldPlan& a, const FieldPlan& b) { return a.number < b.number; });
+		for (auto& field : plan->fields)
+		{
+			if (field.nested)
+			{
+				plans.push_back(field.nested.get());
+			}
+		}
+	}
+	return filter;
+}
+
+bool FilterExpression::evaluate(const char* data, size_t size, bool& result) const
+{
+	// reused by the calls of one thread, the strings keep their capacity
+	thread_local std::vector<Value> values;
+	values.resize(defaults.size());
+	for (size_t i = 0; i < defaults.size(); i++)
+	{
+		values[i].number = defaults[i].number;
+		values[i].text.assign(defaults[i].text);
+	}
+
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+	if (!decodeMessage(root_plan, begin, begin + size, values, 0))
+	{
+		return false;
+	}
+	result = isTrue(root, values);
+	return true;
+}
+
+bool FilterExpression::decodeMessage(const MessagePlan& plan, const uint8_t* data, const uint8_t* end, std::vector<Value>& values, int depth) const
+{
+	if (depth >= MAX_DEPTH)
+	{
+		return false;
+	}
+	while (data < end)
+	{
+		uint64_t tag;
+		if (!readVarint(data, end, tag))
+		{
+			return false;
+		}
+		const uint32_t number    = static_cast<uint32_t>(tag >> 3);
+		const uint32_t wire_type = static_cast<uint32_t>(tag & 0x07);
+		const uint8_t* value_start = data;
+		if (!skipValue(data, end, wire_type, number, depth))
+		{
+			return false;
+		}
+
+		auto field_plan = std::lower_bound(plan.fields.begin(), plan.fields.end(), number, [](const FieldPlan& field, uint32_t value) { return field.number < value; });
+		if (field_plan == plan.fields.end() || field_plan->number != number)
+		{
+			continue;
+		}
+
+		uint64_t raw = 0;
+		if (wire_type == WIRE_VARINT)
+		{
+			readVarint(value_start, end, raw);
+		}
+		else if (wire_type == WIRE_FIXED32)
+		{
+			raw = readFixed(value_start, 4);
+		}
+		else if (wire_type == WIRE_FIXED64)
+		{
+			raw = readFixed(value_start, 8);
+		}
+		else if (wire_type == WIRE_LENGTH_DELIMITED)
+		{
+			// the length was checked by skipValue, the content ends where the field ends
+			readVarint(value_start, end, raw);
+		}
+
+		if (field_plan->nested)
+		{
+			// a singular message may be split into several parts, they are merged
+			if (wire_type == WIRE_LENGTH_DELIMITED && !decodeMessage(*field_plan->nested, value_start, data, values, depth + 1))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		Value& value = values[field_plan->slot];
+		switch (field_plan->field->type())
+		{
+		case FieldDescriptor::TYPE_INT32:
+		case FieldDescriptor::TYPE_ENUM:
+			value.number = static_cast<int32_t>(static_cast<uint32_t>(raw));
+			break;
+		case FieldDescriptor::TYPE_INT64:
+			value.number = static_cast<double>(static_cast<int64_t>(raw));
+			break;
+		case FieldDescriptor::TYPE_UINT32:
+			value.number = static_cast<uint32_t>(raw);
+			break;
+		case FieldDescriptor::TYPE_UINT64:
+		case FieldDescriptor::TYPE_FIXED64:
+			value.number = static_cast<double>(raw);
+			break;
+		case FieldDescriptor::TYPE_BOOL:
+			value.number = raw != 0 ? 1.0 : 0.0;
+			break;
+		case FieldDescriptor::TYPE_SINT32:
+		case FieldDescriptor::TYPE_SINT64:
+			value.number = static_cast<double>(static_cast<int64_t>((raw >> 1) ^ (~(raw & 1) + 1)));
+			break;
+		case FieldDescriptor::TYPE_FIXED32:
+			value.number = static_cast<uint32_t>(raw);
+			break;
+		case FieldDescriptor::TYPE_SFIXED32:
+			value.number = static_cast<int32_t>(static_cast<uint32_t>(raw));
+			break;
+		case FieldDescriptor::TYPE_SFIXED64:
+			value.number = static_cast<double>(static_cast<int64_t>(raw));
+			break;
+		case FieldDescriptor::TYPE_FLOAT:
+		{
+			const uint32_t bits = static_cast<uint32_t>(raw);
+			float number;
+			std::memcpy(&number, &bits, sizeof(number));
+			value.number = number;
+			break;
+		}
+		case FieldDescriptor::TYPE_DOUBLE:
+			std::memcpy(&value.number, &raw, sizeof(value.number));
+			break;
+		case FieldDescriptor::TYPE_STRING:
+		case FieldDescriptor::TYPE_BYTES:
+			value.text.assign(reinterpret_cast<const char*>(value_start), static_cast<size_t>(data - value_start));
+			break;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+const FilterExpression::Value& FilterExpression::getValue(size_t node, const std::vector<Value>& values) const
+{
+	return nodes[node].type == FIELD ? values[nodes[node].slot] : nodes[node].literal;
+}
+
+bool FilterExpression::isTrue(size_t node, const std::vector<Value>& values) const
+{
+	const Node& current = nodes[node];
+	switch (current.type)
+	{
+	case NOT:
+		return !isTrue(current.left, values);
+	case AND:
+		return isTrue(current.left, values) && isTrue(current.right, values);
+	case OR:
+		return isTrue(current.left, values) || isTrue(current.right, values);
+	case LITERAL:
+	case FIELD:
+	{
+		const Value& value = getValue(node, values);
+		return current.value_type == STRING ? !value.text.empty() : value.number != 0.0;
+	}
+	default:
+		break;
+	}
+
+	// both operands have the same type, checked when the expression was compiled
+	const Value& left  = getValue(current.left, values);
+	const Value& right = getValue(current.right, values);
+	if (nodes[current.left].value_type == STRING)
+	{
+		const int order = left.text.compare(right.text);
+		switch (current.type)
+		{
+		case EQUAL:         return order == 0;
+		case NOT_EQUAL:     return order != 0;
+		case LESS:          return order < 0;
+		case LESS_EQUAL:    return order <= 0;
+		case GREATER:       return order > 0;
+		case GREATER_EQUAL: return order >= 0;
+		default:            return false;
+		}
+	}
+	// NaN is not equal to anything, so only != is true for it
+	switch (current.type)
+	{
+	case EQUAL:         return left.number == right.number;
+	case NOT_EQUAL:     return left.number != right.number;
+	case LESS:          return left.number < right.number;
+	case LESS_EQUAL:    return left.number <= right.number;
+	case GREATER:       return left.number > right.number;
+	case GREATER_EQUAL: return left.number >= right.number;
+	default:            return false;
+	}
+}
@@ -0,0 +1,118 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "ProtobufSchema.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A predicate over the fields of a protobuf message, e.g. "status.error_code != 0 && speed > 5".
+ *
+ * The expression is parsed and type checked against the descriptor once. The
+ * operators are ==, !=, <, <=, >, >=, &&, || and !, the operands are field
+ * paths (dot separated, names from the .proto file or JSON names), numbers,
+ * "strings", true and false, and parentheses group subexpressions. A field on
+ * its own is true if it is not 0, false or empty. Enum fields are compared by
+ * number or by the name of their value.
+ *
+ * A message is evaluated on its wire format: only the fields the expression
+ * uses are decoded, everything else is skipped by its length. Fields that are
+ * not set have their default value. Repeated fields and maps cannot be used.
+ *
+ * The expression is immutable and can be used by several threads at once.
+ */
+class FilterExpression
+{
+public:
+  /**
+   * @param schema      the message type the expression refers to
+   * @param expression  the expression text
+   * @param error       receives the reason if the expression is invalid
+   *
+   * @return the compiled expression, or nullptr if it is invalid
+   */
+  static std::shared_ptr<const FilterExpression> compile(const std::shared_ptr<const ProtobufSchema>& schema, const std::string& expression, std::string& error);
+
+  /**
+   * @brief Evaluates the expression for a serialized message
+   *
+   * @param data    the serialized message
+   * @param size    length of the message
+   * @param result  receives the value of the expression
+   *
+   * @return false if the message is malformed
+   */
+  bool evaluate(const char* data, size_t size, bool& result) const;
+
+private:
+  enum ValueType { NUMBER, STRING };
+
+  struct Value
+  {
+    double      number;   // also booleans and enums
+    std::string text;
+  };
+
+  enum NodeType { LITERAL, FIELD, NOT, AND, OR, EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+
+  struct Node
+  {
+    NodeType  type;
+    ValueType value_type;
+    size_t    left;       // operands of the operators
+    size_t    right;
+    size_t    slot;       // FIELD: index into the decoded field values
+    Value     literal;    // LITERAL
+    const google::protobuf::EnumDescriptor* enum_type;   // FIELD of an enum type, to resolve names compared with it
+  };
+
+  struct MessagePlan;
+
+  struct FieldPlan
+  {
+    uint32_t                                 number;
+    const google::protobuf::FieldDescriptor* field;   // set for the fields the expression uses
+    size_t                                   slot;
+    std::unique_ptr<MessagePlan>             nested;  // set for submessages on the path to a used field
+  };
+
+  struct MessagePlan
+  {
+    std::vector<FieldPlan> fields;   // sorted by number
+  };
+
+  class Parser;
+
+  explicit FilterExpression(const std::shared_ptr<const ProtobufSchema>& schema);
+
+  bool decodeMessage(const MessagePlan& plan, const uint8_t* data, const uint8_t* end, std::vector<Value>& values, int depth) const;
+  bool isTrue(size_t node, const std::vector<Value>& values) const;
+  const Value& getValue(size_t node, const std::vector<Value>& values) const;
+
+  const std::shared_ptr<const ProtobufSchema> schema;
+  std::vector<Node>                           nodes;
+  size_t                                      root;
+  MessagePlan                                 root_plan;
+  std::vector<Value>                          defaults;   // per slot, the value of a field that is not set
+};
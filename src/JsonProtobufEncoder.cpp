@@ -0,0 +1,951 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "JsonProtobufEncoder.h"
+
+#include <google/protobuf/descriptor.pb.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using google::protobuf::FieldDescriptor;
+
+// deeper nested JSON documents are rejected
+static const int MAX_DEPTH = 64;
+
+enum WireType
+{
+	WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_LENGTH_DELIMITED = 2, WIRE_FIXED32 = 5
+};
+
+static WireType getWireType(FieldDescriptor::Type type)
+{
+	switch (type)
+	{
+	case FieldDescriptor::TYPE_DOUBLE:
+	case FieldDescriptor::TYPE_FIXED64:
+	case FieldDescriptor::TYPE_SFIXED64:
+		return WIRE_FIXED64;
+	case FieldDescriptor::TYPE_FLOAT:
+	case FieldDescriptor::TYPE_FIXED32:
+	case FieldDescriptor::TYPE_SFIXED32:
+		return WIRE_FIXED32;
+	case FieldDescriptor::TYPE_STRING:
+	case FieldDescriptor::TYPE_BYTES:
+	case FieldDescriptor::TYPE_MESSAGE:
+	case FieldDescriptor::TYPE_GROUP:
+		return WIRE_LENGTH_DELIMITED;
+	default:
+		return WIRE_VARINT;
+	}
+}
+
+static void writeVarint(std::string& output, uint64_t value)
+{
+	char buffer[10];
+	size_t size = 0;
+	while (value >= 0x80)
+	{
+		buffer[size++] = static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+	buffer[size++] = static_cast<char>(value);
+	output.append(buffer, size);
+}
+
+static void writeFixed32(std::string& output, uint32_t value)
+{
+	char buffer[4];
+	for (size_t i = 0; i < sizeof(buffer); i++)
+	{
+		buffer[i] = static_cast<char>(value >> (8 * i));
+	}
+	output.append(buffer, sizeof(buffer));
+}
+
+static void writeFixed64(std::string& output, uint64_t value)
+{
+	char buffer[8];
+	for (size_t i = 0; i < sizeof(buffer); i++)
+	{
+		buffer[i] = static_cast<char>(value >> (8 * i));
+	}
+	output.append(buffer, sizeof(buffer));
+}
+
+static void writeLengthDelimited(std::string& output, uint32_t tag, const std::string& data)
+{
+	writeVarint(output, tag);
+	writeVarint(output, data.size());
+	output.append(data);
+}
+
+static bool isWhitespace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static bool isNumberChar(char c)
+{
+	return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+/**
+ * Parses an integer given as JSON number or string. Numbers with a fraction or
+ * an exponent are accepted as long as their value is integral, e.g. 1e3.
+ */
+static bool parseInteger(const char* data, size_t size, bool& negative, uint64_t& magnitude)
+{
+	negative = size > 0 && data[0] == '-';
+	size_t i = negative ? 1 : 0;
+	if (i == size)
+	{
+		return false;
+	}
+	magnitude = 0;
+	for (; i < size; i++)
+	{
+		const char c = data[i];
+		if (c < '0' || c > '9')
+		{
+			break;
+		}
+		const uint64_t digit = static_cast<uint64_t>(c - '0');
+		if (magnitude > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+		{
+			return false;
+		}
+		magnitude = magnitude * 10 + digit;
+	}
+	if (i == size)
+	{
+		return true;
+	}
+
+	char buffer[64];
+	if (size >= sizeof(buffer))
+	{
+		return false;
+	}
+	memcpy(buffer, data, size);
+	buffer[size] = '\0';
+	char* parsed_end = NULL;
+	const double value = std::strtod(buffer, &parsed_end);
+	if (parsed_end != buffer + size || std::floor(value) != value || std::fabs(value) >= 18446744073709551616.0)
+	{
+		return false;
+	}
+	negative  = value < 0;
+	magnitude = static_cast<uint64_t>(std::fabs(value));
+	return true;
+}
+
+static bool parseDouble(const char* data, size_t size, double& value)
+{
+	if ((size == 3 && memcmp(data, "NaN", 3) == 0))
+	{
+		value = std::numeric_limits<double>::quiet_NaN();
+		return true;
+	}
+	if ((size == 8 && memcmp(data, "Infinity", 8) == 0) || (size == 9 && memcmp(data, "-Infinity", 9) == 0))
+	{
+		value = data[0] == '-' ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+		return true;
+	}
+	char buffer[64];
+	if (size == 0 || size >= sizeof(buffer))
+	{
+		return false;
+	}
+	memcpy(buffer, data, size);
+	buffer[size] = '\0';
+	char* parsed_end = NULL;
+	value = std::strtod(buffer, &parsed_end);
+	return parsed_end == buffer + size;
+}
+
+static int decodeBase64Char(char c)
+{
+	if (c >= 'A' && c <= 'Z') return c - 'A';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+	if (c >= '0' && c <= '9') return c - '0' + 52;
+	if (c == '+' || c == '-') return 62;
+	if (c == '/' || c == '_') return 63;
+	return -1;
+}
+
+/** Decodes standard and URL safe base64, the padding is optional */
+static bool decodeBase64(const char* data, size_t size, std::string& output)
+{
+	output.clear();
+	while (size > 0 && data[size - 1] == '=')
+	{
+		size--;
+	}
+	uint32_t bits = 0;
+	int bit_count = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		const int value = decodeBase64Char(data[i]);
+		if (value < 0)
+		{
+			return false;
+		}
+		bits = (bits << 6) | static_cast<uint32_t>(value);
+		bit_count += 6;
+		if (bit_count >= 8)
+		{
+			bit_count -= 8;
+			output.push_back(static_cast<char>(bits >> bit_count));
+		}
+	}
+	return true;
+}
+
+static void appendUtf8(std::string& output, uint32_t code_point)
+{
+	if (code_point < 0x80)
+	{
+		output.push_back(static_cast<char>(code_point));
+	}
+	else if (code_point < 0x800)
+	{
+		output.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+		output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+	}
+	else if (code_point < 0x10000)
+	{
+		output.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+		output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+		output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+	}
+	else
+	{
+		output.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+		output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+		output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+		output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+	}
+}
+
+static bool parseHex4(const char* data, uint32_t& value)
+{
+	value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		const char c = data[i];
+		value <<= 4;
+		if (c >= '0' && c <= '9')      value |= static_cast<uint32_t>(c - '0');
+		else if (c >= 'a' && c <= 'f') value |= static_cast<uint32_t>(c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F') value |= static_cast<uint32_t>(c - 'A' + 10);
+		else return false;
+	}
+	return true;
+}
+
+JsonProtobufEncoder::JsonProtobufEncoder(const std::shared_ptr<const ProtobufSchema>& schema)
+	: schema(schema)
+	, root(NULL)
+	, begin(NULL)
+	, pos(NULL)
+	, end(NULL)
+	, nested_buffers(MAX_DEPTH + 2)
+	, keys(MAX_DEPTH + 1)
+{
+	root = compile(schema->descriptor);
+}
+
+const JsonProtobufEncoder::MessagePlan* JsonProtobufEncoder::compile(const google::protobuf::Descriptor* descriptor)
+{
+	auto existing_plan = plans.find(descriptor);
+	if (existing_plan != plans.end())
+	{
+		return existing_plan->second.get();
+	}
+	// registered before the fields are compiled, so recursive types end here
+	MessagePlan* plan = new MessagePlan();
+	plan->map_key   = NULL;
+	plan->map_value = NULL;
+	plans[descriptor].reset(plan);
+
+	for (int i = 0; i < descriptor->field_count(); i++)
+	{
+		const FieldDescriptor* field = descriptor->field(i);
+		if (field->type() == FieldDescriptor::TYPE_GROUP)
+		{
+			continue;
+		}
+		FieldPlan field_plan;
+		field_plan.field     = field;
+		field_plan.message   = field->type() == FieldDescriptor::TYPE_MESSAGE ? compile(field->message_type()) : NULL;
+		field_plan.tag       = (static_cast<uint32_t>(field->number()) << 3) | getWireType(field->type());
+		field_plan.is_packed = field->is_packed();
+		plan->fields[field->json_name()] = field_plan;
+		plan->fields[field->name()]      = field_plan;
+	}
+	if (descriptor->options().map_entry())
+	{
+		auto key   = plan->fields.find(descriptor->map_key()->name());
+		auto value = plan->fields.find(descriptor->map_value()->name());
+		plan->map_key   = key != plan->fields.end() ? &key->second : NULL;
+		plan->map_value = value != plan->fields.end() ? &value->second : NULL;
+	}
+	return plan;
+}
+
+bool JsonProtobufEncoder::encode(const char* json, size_t size, std::string& output)
+{
+	output.clear();
+	error.clear();
+	begin = json;
+	pos   = json;
+	end   = json + size;
+
+	skipWhitespace();
+	if (pos == end || *pos != '{')
+	{
+		return fail("expected an object");
+	}
+	if (!parseMessage(*root, output, 0))
+	{
+		return false;
+	}
+	skipWhitespace();
+	if (pos != end)
+	{
+		return fail("unexpected characters after the object");
+	}
+	return true;
+}
+
+const std::string& JsonProtobufEncoder::getError() const
+{
+	return error;
+}
+
+bool JsonProtobufEncoder::fail(const std::string& reason)
+{
+	error = "offset " + std::to_string(pos - begin) + ": " + reason;
+	return false;
+}
+
+void JsonProtobufEncoder::skipWhitespace()
+{
+	while (pos != end && isWhitespace(*pos))
+	{
+		pos++;
+	}
+}
+
+bool JsonProtobufEncoder::parseMessage(const MessagePlan& plan, std::string& output, int depth)
+{
+	if (depth >= MAX_DEPTH)
+	{
+		return fail("too deeply nested");
+	}
+	pos++;  // '{'
+	skipWhitespace();
+	if (pos != end && *pos == '}')
+	{
+		pos++;
+		return true;
+	}
+	std::string& key = keys[depth];
+	while (true)
+	{
+		Token token;
+		if (pos == end || *pos != '"' || !readString(token))
+		{
+			return error.empty() ? fail("expected a field name") : false;
+		}
+		key.assign(token.data, token.size);
+		skipWhitespace();
+		if (pos == end || *pos != ':')
+		{
+			return fail("expected ':'");
+		}
+		pos++;
+		skipWhitespace();
+
+		auto field = plan.fields.find(key);
+		if (field == plan.fields.end())
+		{
+			if (!skipValue(depth))
+			{
+				return false;
+			}
+		}
+		else if (!parseField(field->second, output, depth))
+		{
+			return false;
+		}
+
+		skipWhitespace();
+		if (pos == end)
+		{
+			return fail("unterminated object");
+		}
+		if (*pos == '}')
+		{
+			pos++;
+			return true;
+		}
+		if (*pos != ',')
+		{
+			return fail("expected ',' or '}'");
+		}
+		pos++;
+		skipWhitespace();
+	}
+}
+
+bool JsonProtobufEncoder::parseField(const FieldPlan& field, std::string& output, int depth)
+{
+	if (pos == end)
+	{
+		return fail("expected a value");
+	}
+	if (*pos == 'n')
+	{
+		// null leaves the field unset
+		Token token;
+		return readToken(token);
+	}
+
+	if (field.field->is_map())
+	{
+		if (*pos != '{')
+		{
+			return fail("expected an object for map field " + field.field->name());
+		}
+		const MessagePlan& entry_plan = *field.message;
+		if (entry_plan.map_key == NULL || entry_plan.map_value == NULL)
+		{
+			return fail("invalid map entry type of field " + field.field->name());
+		}
+		pos++;
+		skipWhitespace();
+		if (pos != end && *pos == '}')
+		{
+			pos++;
+			return true;
+		}
+		std::string& entry = nested_buffers[depth + 1];
+		while (true)
+		{
+			// the key is encoded right away, as the token may point to a buffer the value reuses
+			Token key;
+			entry.clear();
+			if (pos == end || *pos != '"' || !readString(key) || !encodeScalar(*entry_plan.map_key, key, true, entry))
+			{
+				return error.empty() ? fail("expected a map key") : false;
+			}
+			skipWhitespace();
+			if (pos == end || *pos != ':')
+			{
+				return fail("expected ':'");
+			}
+			pos++;
+			skipWhitespace();
+			if (!parseValue(*entry_plan.map_value, true, entry, depth + 1))
+			{
+				return false;
+			}
+			writeLengthDelimited(output, (static_cast<uint32_t>(field.field->number()) << 3) | WIRE_LENGTH_DELIMITED, entry);
+
+			skipWhitespace();
+			if (pos == end)
+			{
+				return fail("unterminated object");
+			}
+			if (*pos == '}')
+			{
+				pos++;
+				return true;
+			}
+			if (*pos != ',')
+			{
+				return fail("expected ',' or '}'");
+			}
+			pos++;
+			skipWhitespace();
+		}
+	}
+
+	if (field.field->is_repeated())
+	{
+		if (*pos != '[')
+		{
+			return fail("expected an array for repeated field " + field.field->name());
+		}
+		pos++;
+		skipWhitespace();
+		if (pos != end && *pos == ']')
+		{
+			pos++;
+			return true;
+		}
+		// packed values are collected first, they are written as one length delimited field
+		std::string& values = field.is_packed ? nested_buffers[depth + 1] : output;
+		if (field.is_packed)
+		{
+			values.clear();
+		}
+		while (true)
+		{
+			if (!parseValue(field, !field.is_packed, values, depth))
+			{
+				return false;
+			}
+			skipWhitespace();
+			if (pos == end)
+			{
+				return fail("unterminated array");
+			}
+			if (*pos == ']')
+			{
+				pos++;
+				break;
+			}
+			if (*pos != ',')
+			{
+				return fail("expected ',' or ']'");
+			}
+			pos++;
+			skipWhitespace();
+		}
+		if (field.is_packed && !values.empty())
+		{
+			writeLengthDelimited(output, (static_cast<uint32_t>(field.field->number()) << 3) | WIRE_LENGTH_DELIMITED, values);
+		}
+		return true;
+	}
+
+	return parseValue(field, true, output, depth);
+}
+
+bool JsonProtobufEncoder::parseValue(const FieldPlan& field, bool with_tag, std::string& output, int depth)
+{
+	if (pos == end)
+	{
+		return fail("expected a value");
+	}
+	if (field.message != NULL)
+	{
+		if (*pos == 'n')
+		{
+			Token token;
+			return readToken(token);
+		}
+		if (*pos != '{')
+		{
+			return fail("expected an object for field " + field.field->name());
+		}
+		std::string& nested = nested_buffers[depth + 1];
+		nested.clear();
+		if (!parseMessage(*field.message, nested, depth + 1))
+		{
+			return false;
+		}
+		writeLengthDelimited(output, field.tag, nested);
+		return true;
+	}
+
+	Token token;
+	if (!readToken(token))
+	{
+		return false;
+	}
+	if (token.type == Token::VALUE_NULL)
+	{
+		return true;
+	}
+	return encodeScalar(field, token, with_tag, output);
+}
+
+bool JsonProtobufEncoder::encodeScalar(const FieldPlan& field, const Token& token, bool with_tag, std::string& output)
+{
+	const FieldDescriptor* descriptor = field.field;
+	const bool is_text = token.type == Token::VALUE_STRING || token.type == Token::VALUE_NUMBER;
+
+	switch (descriptor->cpp_type())
+	{
+	case FieldDescriptor::CPPTYPE_INT32:
+	case FieldDescriptor::CPPTYPE_INT64:
+	case FieldDescriptor::CPPTYPE_UINT32:
+	case FieldDescriptor::CPPTYPE_UINT64:
+	{
+		bool negative = false;
+		uint64_t magnitude = 0;
+		if (!is_text || !parseInteger(token.data, token.size, negative, magnitude))
+		{
+			return fail("expected an integer for field " + descriptor->name());
+		}
+		const int64_t value = negative ? static_cast<int64_t>(~magnitude + 1) : static_cast<int64_t>(magnitude);
+		bool in_range = true;
+		switch (descriptor->cpp_type())
+		{
+		case FieldDescriptor::CPPTYPE_INT32:
+			in_range = negative ? magnitude <= uint64_t(1) << 31 : magnitude <= uint64_t(std::numeric_limits<int32_t>::max());
+			break;
+		case FieldDescriptor::CPPTYPE_INT64:
+			in_range = negative ? magnitude <= uint64_t(1) << 63 : magnitude <= uint64_t(std::numeric_limits<int64_t>::max());
+			break;
+		case FieldDescriptor::CPPTYPE_UINT32:
+			in_range = (!negative || magnitude == 0) && magnitude <= std::numeric_limits<uint32_t>::max();
+			break;
+		default:
+			in_range = !negative || magnitude == 0;
+			break;
+		}
+		if (!in_range)
+		{
+			return fail("value out of range for field " + descriptor->name());
+		}
+
+		if (with_tag)
+		{
+			writeVarint(output, field.tag);
+		}
+		switch (descriptor->type())
+		{
+		case FieldDescriptor::TYPE_SINT32:
+		{
+			const int32_t value32 = static_cast<int32_t>(value);
+			writeVarint(output, (static_cast<uint32_t>(value32) << 1) ^ static_cast<uint32_t>(value32 >> 31));
+			break;
+		}
+		case FieldDescriptor::TYPE_SINT64:
+			writeVarint(output, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+			break;
+		case FieldDescriptor::TYPE_FIXED32:
+		case FieldDescriptor::TYPE_SFIXED32:
+			writeFixed32(output, static_cast<uint32_t>(value));
+			break;
+		case FieldDescriptor::TYPE_FIXED64:
+		case FieldDescriptor::TYPE_SFIXED64:
+			writeFixed64(output, static_cast<uint64_t>(value));
+			break;
+		default:
+			// negative int32 values are sign extended to 64 bit, like protobuf does
+			writeVarint(output, static_cast<uint64_t>(value));
+			break;
+		}
+		return true;
+	}
+
+	case FieldDescriptor::CPPTYPE_DOUBLE:
+	case FieldDescriptor::CPPTYPE_FLOAT:
+	{
+		double value = 0.0;
+		if (!is_text || !parseDouble(token.data, token.size, value))
+		{
+			return fail("expected a number for field " + descriptor->name());
+		}
+		if (with_tag)
+		{
+			writeVarint(output, field.tag);
+		}
+		if (descriptor->cpp_type() == FieldDescriptor::CPPTYPE_FLOAT)
+		{
+			const float value32 = static_cast<float>(value);
+			uint32_t bits = 0;
+			memcpy(&bits, &value32, sizeof(bits));
+			writeFixed32(output, bits);
+		}
+		else
+		{
+			uint64_t bits = 0;
+			memcpy(&bits, &value, sizeof(bits));
+			writeFixed64(output, bits);
+		}
+		return true;
+	}
+
+	case FieldDescriptor::CPPTYPE_BOOL:
+	{
+		// map keys are always strings
+		bool value = false;
+		if (token.type == Token::VALUE_TRUE || (token.type == Token::VALUE_STRING && token.size == 4 && memcmp(token.data, "true", 4) == 0))
+		{
+			value = true;
+		}
+		else if (!(token.type == Token::VALUE_FALSE || (token.type == Token::VALUE_STRING && token.size == 5 && memcmp(token.data, "false", 5) == 0)))
+		{
+			return fail("expected true or false for field " + descriptor->name());
+		}
+		if (with_tag)
+		{
+			writeVarint(output, field.tag);
+		}
+		writeVarint(output, value ? 1 : 0);
+		return true;
+	}
+
+	case FieldDescriptor::CPPTYPE_ENUM:
+	{
+		int number = 0;
+		if (token.type == Token::VALUE_STRING)
+		{
+			const google::protobuf::EnumValueDescriptor* enum_value = descriptor->enum_type()->FindValueByName(std::string(token.data, token.size));
+			if (enum_value == NULL)
+			{
+				return fail("unknown value \"" + std::string(token.data, token.size) + "\" for enum field " + descriptor->name());
+			}
+			number = enum_value->number();
+		}
+		else
+		{
+			bool negative = false;
+			uint64_t magnitude = 0;
+			if (token.type != Token::VALUE_NUMBER || !parseInteger(token.data, token.size, negative, magnitude)
+				|| magnitude > (negative ? uint64_t(1) << 31 : uint64_t(std::numeric_limits<int32_t>::max())))
+			{
+				return fail("expected an enum name or number for field " + descriptor->name());
+			}
+			number = static_cast<int>(negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude));
+		}
+		if (with_tag)
+		{
+			writeVarint(output, field.tag);
+		}
+		writeVarint(output, static_cast<uint64_t>(static_cast<int64_t>(number)));
+		return true;
+	}
+
+	case FieldDescriptor::CPPTYPE_STRING:
+	{
+		if (token.type != Token::VALUE_STRING)
+		{
+			return fail("expected a string for field " + descriptor->name());
+		}
+		const char* data = token.data;
+		size_t size      = token.size;
+		if (descriptor->type() == FieldDescriptor::TYPE_BYTES)
+		{
+			if (!decodeBase64(token.data, token.size, bytes_buffer))
+			{
+				return fail("expected base64 for field " + descriptor->name());
+			}
+			data = bytes_buffer.data();
+			size = bytes_buffer.size();
+		}
+		if (with_tag)
+		{
+			writeVarint(output, field.tag);
+		}
+		writeVarint(output, size);
+		output.append(data, size);
+		return true;
+	}
+
+	default:
+		return fail("unsupported type of field " + descriptor->name());
+	}
+}
+
+bool JsonProtobufEncoder::readToken(Token& token)
+{
+	if (pos == end)
+	{
+		return fail("expected a value");
+	}
+	const char c = *pos;
+	if (c == '"')
+	{
+		return readString(token);
+	}
+	if (c == '-' || (c >= '0' && c <= '9'))
+	{
+		token.type = Token::VALUE_NUMBER;
+		token.data = pos;
+		while (pos != end && isNumberChar(*pos))
+		{
+			pos++;
+		}
+		token.size = static_cast<size_t>(pos - token.data);
+		return true;
+	}
+
+	static const struct { const char* text; size_t size; Token::Type type; } literals[] =
+	{
+		{ "true", 4, Token::VALUE_TRUE }, { "false", 5, Token::VALUE_FALSE }, { "null", 4, Token::VALUE_NULL }
+	};
+	for (auto const& literal : literals)
+	{
+		if (static_cast<size_t>(end - pos) >= literal.size && memcmp(pos, literal.text, literal.size) == 0)
+		{
+			token.type = literal.type;
+			token.data = pos;
+			token.size = literal.size;
+			pos += literal.size;
+			return true;
+		}
+	}
+	return fail("unexpected character");
+}
+
+bool JsonProtobufEncoder::readString(Token& token)
+{
+	pos++;  // '"'
+	token.type = Token::VALUE_STRING;
+
+	// fast path: no escape sequence before the closing quote, the token points into the JSON text
+	const char* quote = static_cast<const char*>(memchr(pos, '"', static_cast<size_t>(end - pos)));
+	if (quote == NULL)
+	{
+		return fail("unterminated string");
+	}
+	if (memchr(pos, '\\', static_cast<size_t>(quote - pos)) == NULL)
+	{
+		token.data = pos;
+		token.size = static_cast<size_t>(quote - pos);
+		pos = quote + 1;
+		return true;
+	}
+
+	string_buffer.clear();
+	while (true)
+	{
+		const char* backslash = static_cast<const char*>(memchr(pos, '\\', static_cast<size_t>(end - pos)));
+		quote = static_cast<const char*>(memchr(pos, '"', static_cast<size_t>(end - pos)));
+		if (quote == NULL)
+		{
+			return fail("unterminated string");
+		}
+		if (backslash == NULL || quote < backslash)
+		{
+			string_buffer.append(pos, quote);
+			pos = quote + 1;
+			break;
+		}
+		string_buffer.append(pos, backslash);
+		pos = backslash + 1;
+		if (pos == end)
+		{
+			return fail("unterminated string");
+		}
+		const char escaped = *pos++;
+		switch (escaped)
+		{
+		case '"':  string_buffer.push_back('"');  break;
+		case '\\': string_buffer.push_back('\\'); break;
+		case '/':  string_buffer.push_back('/');  break;
+		case 'b':  string_buffer.push_back('\b'); break;
+		case 'f':  string_buffer.push_back('\f'); break;
+		case 'n':  string_buffer.push_back('\n'); break;
+		case 'r':  string_buffer.push_back('\r'); break;
+		case 't':  string_buffer.push_back('\t'); break;
+		case 'u':
+		{
+			uint32_t code_point = 0;
+			if (end - pos < 4 || !parseHex4(pos, code_point))
+			{
+				return fail("invalid unicode escape");
+			}
+			pos += 4;
+			if (code_point >= 0xD800 && code_point <= 0xDBFF)
+			{
+				// a surrogate pair encodes a code point outside of the basic multilingual plane
+				uint32_t low_surrogate = 0;
+				if (end - pos < 6 || pos[0] != '\\' || pos[1] != 'u' || !parseHex4(pos + 2, low_surrogate) || low_surrogate < 0xDC00 || low_surrogate > 0xDFFF)
+				{
+					return fail("invalid unicode surrogate pair");
+				}
+				pos += 6;
+				code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+			}
+			appendUtf8(string_buffer, code_point);
+			break;
+		}
+		default:
+			return fail("invalid escape sequence");
+		}
+	}
+	token.data = string_buffer.data();
+	token.size = string_buffer.size();
+	return true;
+}
+
+bool JsonProtobufEncoder::skipValue(int depth)
+{
+	if (depth >= MAX_DEPTH)
+	{
+		return fail("too deeply nested");
+	}
+	if (pos == end)
+	{
+		return fail("expected a value");
+	}
+	if (*pos != '{' && *pos != '[')
+	{
+		Token token;
+		return readToken(token);
+	}
+
+	const bool is_object = *pos == '{';
+	const char closing   = is_object ? '}' : ']';
+	pos++;
+	skipWhitespace();
+	if (pos != end && *pos == closing)
+	{
+		pos++;
+		return true;
+	}
+	while (true)
+	{
+		if (is_object)
+		{
+			Token key;
+			if (pos == end || *pos != '"' || !readString(key))
+			{
+				return error.empty() ? fail("expected a field name") : false;
+			}
+			skipWhitespace();
+			if (pos == end || *pos != ':')
+			{
+				return fail("expected ':'");
+			}
+			pos++;
+			skipWhitespace();
+		}
+		if (!skipValue(depth + 1))
+		{
+			return false;
+		}
+		skipWhitespace();
+		if (pos == end)
+		{
+			return fail(is_object ? "unterminated object" : "unterminated array");
+		}
+		if (*pos == closing)
+		{
+			pos++;
+			return true;
+		}
+		if (*pos != ',')
+		{
+			return fail(is_object ? "expected ',' or '}'" : "expected ',' or ']'");
+		}
+		pos++;
+		skipWhitespace();
+	}
+}
@@ -0,0 +1,121 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "ProtobufSchema.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Converts JSON documents to the protobuf wire format of a message type.
+ *
+ * The JSON text is parsed in a single pass and written to the output as
+ * protobuf fields directly, no message object is built. The fields of every
+ * message type are looked up in a table that is compiled from the descriptor
+ * once, by their JSON name as well as by their name in the .proto file.
+ *
+ * The mapping follows the protobuf JSON format: 64 bit integers may be quoted,
+ * enums are given by name or number, bytes are base64 encoded and maps are
+ * JSON objects. Unknown fields and null values are ignored. Well-known types
+ * with a special JSON representation (Timestamp, Duration, Struct, Any, ...)
+ * are not supported.
+ *
+ * The encoder keeps its buffers between the calls and is not thread safe.
+ */
+class JsonProtobufEncoder
+{
+public:
+  /** @param schema the message type the JSON documents are converted to */
+  explicit JsonProtobufEncoder(const std::shared_ptr<const ProtobufSchema>& schema);
+
+  JsonProtobufEncoder(const JsonProtobufEncoder&) = delete;
+  JsonProtobufEncoder& operator=(const JsonProtobufEncoder&) = delete;
+
+  /**
+   * @brief Converts one JSON object to a serialized protobuf message
+   *
+   * @param json    the JSON text
+   * @param size    length of the JSON text
+   * @param output  receives the serialized message, its capacity is reused
+   *
+   * @return false if the JSON is malformed or does not match the message type, see @ref getError
+   */
+  bool encode(const char* json, size_t size, std::string& output);
+
+  /** @return the reason why the last call of @ref encode failed */
+  const std::string& getError() const;
+
+private:
+  struct MessagePlan;
+
+  struct FieldPlan
+  {
+    const google::protobuf::FieldDescriptor* field;
+    const MessagePlan*                       message;  // message fields and map entries
+    uint32_t                                 tag;      // field number and wire type of a single value
+    bool                                     is_packed;
+  };
+
+  struct MessagePlan
+  {
+    std::unordered_map<std::string, FieldPlan> fields;     // by JSON name and by name
+    const FieldPlan*                           map_key;    // only set for map entries
+    const FieldPlan*                           map_value;
+  };
+
+  struct Token
+  {
+    enum Type { VALUE_STRING, VALUE_NUMBER, VALUE_TRUE, VALUE_FALSE, VALUE_NULL };
+    Type        type;
+    const char* data;
+    size_t      size;
+  };
+
+  const MessagePlan* compile(const google::protobuf::Descriptor* descriptor);
+
+  bool parseMessage(const MessagePlan& plan, std::string& output, int depth);
+  bool parseField(const FieldPlan& field, std::string& output, int depth);
+  bool parseValue(const FieldPlan& field, bool with_tag, std::string& output, int depth);
+  bool encodeScalar(const FieldPlan& field, const Token& token, bool with_tag, std::string& output);
+  bool readToken(Token& token);
+  bool readString(Token& token);
+  bool skipValue(int depth);
+  void skipWhitespace();
+  bool fail(const std::string& reason);
+
+  const std::shared_ptr<const ProtobufSchema>                                             schema;
+  std::unordered_map<const google::protobuf::Descriptor*, std::unique_ptr<MessagePlan>>   plans;
+  const MessagePlan*                                                                      root;
+
+  const char*                                                                             begin;
+  const char*                                                                             pos;
+  const char*                                                                             end;
+  std::string                                                                             error;
+
+  // reused per nesting level, nested messages are written there first to know their length
+  std::vector<std::string>                                                                nested_buffers;
+  std::vector<std::string>                                                                keys;
+  std::string                                                                             string_buffer;
+  std::string                                                                             bytes_buffer;
+};
@@ -0,0 +1,156 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "MessageEnvelope.h"
+
+static const uint8_t MAGIC[2] = { 0xEC, 0x45 };
+static const uint8_t VERSION  = 1;
+
+// sequence numbers remembered below the highest one received
+static const uint64_t WINDOW = 1024;
+
+static void writeUint32(uint32_t value, std::string& output)
+{
+	const char bytes[4] = { static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8), static_cast<char>(value) };
+	output.append(bytes, sizeof(bytes));
+}
+
+static void writeUint64(uint64_t value, std::string& output)
+{
+	writeUint32(static_cast<uint32_t>(value >> 32), output);
+	writeUint32(static_cast<uint32_t>(value), output);
+}
+
+static uint32_t readUint32(const uint8_t* data)
+{
+	return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+static uint64_t readUint64(const uint8_t* data)
+{
+	return (static_cast<uint64_t>(readUint32(data)) << 32) | readUint32(data + 4);
+}
+
+void MessageEnvelope::write(const char* data, size_t size, std::string& output) const
+{
+	output.clear();
+	output.reserve(SIZE + size);
+	output.push_back(static_cast<char>(MAGIC[0]));
+	output.push_back(static_cast<char>(MAGIC[1]));
+	output.push_back(static_cast<char>(VERSION));
+	output.push_back(0);
+	writeUint32(sender_id, output);
+	writeUint64(sequence, output);
+	writeUint64(static_cast<uint64_t>(send_time), output);
+	writeUint64(static_cast<uint64_t>(clock), output);
+	output.append(data, size);
+}
+
+bool MessageEnvelope::read(const char* data, size_t size)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	if (size < SIZE || bytes[0] != MAGIC[0] || bytes[1] != MAGIC[1] || bytes[2] != VERSION)
+	{
+		return false;
+	}
+	sender_id = readUint32(bytes + 4);
+	sequence  = readUint64(bytes + 8);
+	send_time = static_cast<int64_t>(readUint64(bytes + 16));
+	clock     = static_cast<int64_t>(readUint64(bytes + 24));
+	return true;
+}
+
+EnvelopeStatistics::EnvelopeStatistics()
+	: has_sender(false)
+	, sender_id(0)
+	, highest_sequence(0)
+	, last_clock(0)
+	, received_count(0)
+	, lost_count(0)
+	, reordered_count(0)
+	, duplicate_count(0)
+	, invalid_count(0)
+	, restart_count(0)
+	, clock_gap_count(0)
+{
+}
+
+bool EnvelopeStatistics::add(const MessageEnvelope& envelope, int64_t now)
+{
+	if (!has_sender || envelope.sender_id != sender_id)
+	{
+		// the first message, or the sending bridge was restarted
+		restart_count += has_sender ? 1 : 0;
+		has_sender       = true;
+		sender_id        = envelope.sender_id;
+		highest_sequence = envelope.sequence;
+		received_window.reset();
+		received_window.set(0);
+		last_clock       = envelope.clock;
+	}
+	else if (envelope.sequence > highest_sequence)
+	{
+		const uint64_t distance = envelope.sequence - highest_sequence;
+		lost_count      += distance - 1;
+		received_window  = distance < WINDOW ? received_window << distance : std::bitset<WINDOW>();
+		received_window.set(0);
+		highest_sequence = envelope.sequence;
+		// a smaller clock is a restarted eCAL publisher
+		if (envelope.clock > last_clock + 1)
+		{
+			clock_gap_count += static_cast<uint64_t>(envelope.clock - last_clock - 1);
+		}
+		last_clock = envelope.clock;
+	}
+	else
+	{
+		const uint64_t distance = highest_sequence - envelope.sequence;
+		if (distance < WINDOW)
+		{
+			if (received_window.test(distance))
+			{
+				duplicate_count++;
+				return false;
+			}
+			received_window.set(distance);
+		}
+		// counted as lost when the later message arrived; older than the window it may be a duplicate as well
+		reordered_count++;
+		lost_count -= lost_count > 0 ? 1 : 0;
+	}
+	received_count++;
+	latency.add(now - envelope.send_time);
+	return true;
+}
+
+void EnvelopeStatistics::addInvalid()
+{
+	invalid_count++;
+}
+
+std::string EnvelopeStatistics::toString() const
+{
+	return std::to_string(received_count) + " received, "
+		+ std::to_string(lost_count) + " lost, "
+		+ std::to_string(reordered_count) + " reordered, "
+		+ std::to_string(duplicate_count) + " duplicates, "
+		+ std::to_string(invalid_count) + " without envelope, "
+		+ std::to_string(restart_count) + " sender restarts, "
+		+ std::to_string(clock_gap_count) + " missed by the sender (eCAL clock), latency: " + latency.toString();
+}
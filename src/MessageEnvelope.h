@@ -0,0 +1,99 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Statistics.h"
+
+/**
+ * @brief The envelope in front of the payload of a route with envelope enabled.
+ *
+ * 32 bytes: the magic bytes 0xEC 0x45, the version 1, a reserved byte, the
+ * big endian 32 bit sender id and three big endian 64 bit values. The sender
+ * id is chosen randomly per bridge, so a restarted bridge (starting its
+ * sequence numbers again) is recognized.
+ */
+struct MessageEnvelope
+{
+  static const size_t SIZE = 32;
+
+  uint32_t sender_id;
+  uint64_t sequence;    // per route, starting at 0
+  int64_t  send_time;   // of the eCAL message in us
+  int64_t  clock;       // of the eCAL publisher
+
+  /** @brief Writes the envelope and the payload */
+  void write(const char* data, size_t size, std::string& output) const;
+
+  /** @return false if the data does not start with a valid envelope */
+  bool read(const char* data, size_t size);
+};
+
+/**
+ * @brief Loss, reordering and latency of the envelopes received on one route.
+ *
+ * The sequence numbers of the last 1024 messages are remembered, a message
+ * arriving after a later one was counted as lost is counted as reordered
+ * instead. The latency compares the eCAL send time with the eCAL time of the
+ * receiver, so the clocks of both hosts have to be synchronized. The class is
+ * not thread safe, the owner has to lock.
+ */
+class EnvelopeStatistics
+{
+public:
+  EnvelopeStatistics();
+
+  /**
+   * @brief Counts a received envelope
+   *
+   * @param now  eCAL time of the receiver in us
+   *
+   * @return false if the message was received already (e.g. redelivered with QoS 1)
+   */
+  bool add(const MessageEnvelope& envelope, int64_t now);
+
+  /** @brief Counts a payload without a valid envelope */
+  void addInvalid();
+
+  uint64_t getDuplicateCount() const { return duplicate_count; }
+
+  /** @return received, lost, reordered and duplicate messages and the latency */
+  std::string toString() const;
+
+private:
+  bool              has_sender;
+  uint32_t          sender_id;
+  uint64_t          highest_sequence;
+  std::bitset<1024> received_window;   // bit i: highest_sequence - i was received
+  int64_t           last_clock;
+
+  uint64_t          received_count;
+  uint64_t          lost_count;
+  uint64_t          reordered_count;
+  uint64_t          duplicate_count;
+  uint64_t          invalid_count;
+  uint64_t          restart_count;      // of the sending bridge
+  uint64_t          clock_gap_count;    // messages of the eCAL publisher the sending bridge did not receive
+  LatencyStatistics latency;
+};
@@ -0,0 +1,625 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "MessageStore.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Segment layout:  [magic (8 bytes)] [read offset (8 bytes)] [record]* [0 (4 bytes)]
+// Record layout:   [body size (4 bytes)] [crc (4)] [timestamp (8)] [deadline (8)] [qos (1)] [retain (1)] [topic size (2)] [payload size (4)] [topic] [payload]
+// The CRC-32C covers the rest of the body. The records of version 2 segments have no CRC, the ones of version 1 no deadline either,
+// they are still read after an update.
+static const int      SEGMENT_VERSION       = 3;
+static const char     SEGMENT_MAGIC[8]      = { 'E', 'C', 'M', 'Q', 'S', 'E', 'G', '3' };
+static const char     SEGMENT_MAGIC_V2[8]   = { 'E', 'C', 'M', 'Q', 'S', 'E', 'G', '2' };
+static const char     SEGMENT_MAGIC_V1[8]   = { 'E', 'C', 'M', 'Q', 'S', 'E', 'G', '1' };
+static const size_t   SEGMENT_HEADER_SIZE   = 16;
+static const size_t   RECORD_HEADER_SIZE    = 4 + 4 + 8 + 8 + 1 + 1 + 2 + 4;
+static const size_t   RECORD_HEADER_SIZE_V2 = 4 + 8 + 8 + 1 + 1 + 2 + 4;
+static const size_t   RECORD_HEADER_SIZE_V1 = 4 + 8 + 1 + 1 + 2 + 4;
+
+static size_t recordHeaderSize(int version)
+{
+	return version == 1 ? RECORD_HEADER_SIZE_V1 : (version == 2 ? RECORD_HEADER_SIZE_V2 : RECORD_HEADER_SIZE);
+}
+
+// CRC-32C (Castagnoli), reflected, as used by iSCSI and ext4
+static uint32_t crc32c(const char* data, size_t size)
+{
+	static const std::vector<uint32_t> table = []()
+	{
+		std::vector<uint32_t> entries(256);
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+			}
+			entries[i] = crc;
+		}
+		return entries;
+	}();
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+	}
+	return crc ^ 0xFFFFFFFF;
+}
+
+static int64_t nowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string segmentFileName(uint64_t sequence)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "segment-%016llu.log", static_cast<unsigned long long>(sequence));
+	return name;
+}
+
+static bool createDirectories(const std::string& path)
+{
+	for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+	{
+		std::string sub_path = path.substr(0, pos);
+		if (!sub_path.empty() && mkdir(sub_path.c_str(), 0755) != 0 && errno != EEXIST)
+		{
+			return false;
+		}
+		if (pos == std::string::npos)
+		{
+			return true;
+		}
+	}
+}
+
+MessageStore::MessageStore(const std::string& directory, size_t segment_size, uint64_t max_bytes, int max_age_s, bool keep_latest_per_topic)
+	: directory(directory)
+	, segment_size(std::max(segment_size, SEGMENT_HEADER_SIZE + RECORD_HEADER_SIZE + 4))
+	, max_bytes(max_bytes)
+	, max_age_s(max_age_s)
+	, keep_latest_per_topic(keep_latest_per_topic)
+	, next_sequence(0)
+	, backlog_bytes(0)
+	, backlog_count(0)
+	, dropped_count(0)
+	, expired_count(0)
+	, bytes_since_compaction(0)
+	, front_record_size(0)
+	, front_sequence(0)
+	, front_offset(0)
+{
+}
+
+MessageStore::~MessageStore()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	for (auto& segment : segments)
+	{
+		closeSegment(segment, false);
+	}
+	segments.clear();
+}
+
+bool MessageStore::open()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (!createDirectories(directory))
+	{
+		return false;
+	}
+
+	// recover existing segments in the order they were written
+	std::vector<uint64_t> sequences;
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL)
+	{
+		return false;
+	}
+	while (struct dirent* entry = readdir(dir))
+	{
+		unsigned long long sequence = 0;
+		if (sscanf(entry->d_name, "segment-%16llu.log", &sequence) == 1 && segmentFileName(sequence) == entry->d_name)
+		{
+			sequences.push_back(sequence);
+		}
+	}
+	closedir(dir);
+	std::sort(sequences.begin(), sequences.end());
+
+	for (uint64_t sequence : sequences)
+	{
+		Segment segment;
+		if (!openSegment(sequence, 0, false, segment))
+		{
+			continue;
+		}
+		// find the end of the written records and count the ones not consumed yet
+		size_t offset = SEGMENT_HEADER_SIZE;
+		uint64_t read_offset = readOffset(segment);
+		Record record;
+		size_t record_size = 0;
+		segment.write_offset = segment.size;
+		while (readRecord(segment, offset, record, record_size))
+		{
+			if (offset >= read_offset)
+			{
+				segment.record_count++;
+				backlog_bytes += record_size;
+			}
+			segment.newest_timestamp_us = record.timestamp_us;
+			offset += record_size;
+		}
+		segment.write_offset = offset;
+		backlog_count += segment.record_count;
+		next_sequence = sequence + 1;
+
+		if (segment.record_count == 0)
+		{
+			closeSegment(segment, true);
+		}
+		else
+		{
+			segments.push_back(segment);
+		}
+	}
+	return true;
+}
+
+bool MessageStore::openSegment(uint64_t sequence, size_t size, bool create, Segment& segment)
+{
+	segment.sequence            = sequence;
+	segment.path                = directory + "/" + segmentFileName(sequence);
+	segment.write_offset        = SEGMENT_HEADER_SIZE;
+	segment.newest_timestamp_us = 0;
+	segment.record_count        = 0;
+	segment.data                = NULL;
+	segment.version             = SEGMENT_VERSION;
+
+	segment.fd = ::open(segment.path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+	if (segment.fd < 0)
+	{
+		return false;
+	}
+	if (create)
+	{
+		// the file is zero filled, so the first record size of 0 marks the end of the segment
+		if (ftruncate(segment.fd, static_cast<off_t>(size)) != 0)
+		{
+			closeSegment(segment, true);
+			return false;
+		}
+		segment.size = size;
+	}
+	else
+	{
+		struct stat file_stat;
+		if (fstat(segment.fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < SEGMENT_HEADER_SIZE + 4)
+		{
+			closeSegment(segment, false);
+			return false;
+		}
+		segment.size = static_cast<size_t>(file_stat.st_size);
+	}
+
+	void* data = mmap(NULL, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+	if (data == MAP_FAILED)
+	{
+		closeSegment(segment, create);
+		return false;
+	}
+	segment.data = static_cast<char*>(data);
+
+	if (create)
+	{
+		memcpy(segment.data, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+		setReadOffset(segment, SEGMENT_HEADER_SIZE);
+	}
+	else if (memcmp(segment.data, SEGMENT_MAGIC_V1, sizeof(SEGMENT_MAGIC_V1)) == 0)
+	{
+		segment.version = 1;
+	}
+	else if (memcmp(segment.data, SEGMENT_MAGIC_V2, sizeof(SEGMENT_MAGIC_V2)) == 0)
+	{
+		segment.version = 2;
+	}
+	else if (memcmp(segment.data, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0)
+	{
+		closeSegment(segment, false);
+		return false;
+	}
+	return true;
+}
+
+void MessageStore::closeSegment(Segment& segment, bool remove)
+{
+	if (segment.data != NULL)
+	{
+		munmap(segment.data, segment.size);
+		segment.data = NULL;
+	}
+	if (segment.fd >= 0)
+	{
+		close(segment.fd);
+		segment.fd = -1;
+	}
+	if (remove)
+	{
+		unlink(segment.path.c_str());
+	}
+}
+
+uint64_t MessageStore::readOffset(const Segment& segment) const
+{
+	uint64_t offset = 0;
+	memcpy(&offset, segment.data + sizeof(SEGMENT_MAGIC), sizeof(offset));
+	return offset;
+}
+
+void MessageStore::setReadOffset(Segment& segment, uint64_t offset)
+{
+	memcpy(segment.data + sizeof(SEGMENT_MAGIC), &offset, sizeof(offset));
+}
+
+bool MessageStore::readRecord(const Segment& segment, size_t offset, Record& record, size_t& record_size) const
+{
+	const size_t header_size = recordHeaderSize(segment.version);
+	if (offset + header_size > segment.write_offset)
+	{
+		return false;
+	}
+	const char* pos = segment.data + offset;
+	uint32_t body_size    = 0;
+	uint32_t crc          = 0;
+	uint16_t topic_size   = 0;
+	uint32_t payload_size = 0;
+	memcpy(&body_size, pos, 4);
+	if (body_size < header_size - 4 || offset + 4 + body_size > segment.write_offset)
+	{
+		return false;
+	}
+	const char* fields = pos + 4;
+	if (segment.version >= 3)
+	{
+		memcpy(&crc, fields, 4);
+		fields += 4;
+	}
+	memcpy(&record.timestamp_us, fields, 8);
+	fields += 8;
+	record.deadline_us = 0;
+	if (segment.version >= 2)
+	{
+		memcpy(&record.deadline_us, fields, 8);
+		fields += 8;
+	}
+	record.qos    = static_cast<unsigned char>(fields[0]);
+	record.retain = fields[1] != 0;
+	memcpy(&topic_size, fields + 2, 2);
+	memcpy(&payload_size, fields + 4, 4);
+	if (header_size - 4 + topic_size + static_cast<size_t>(payload_size) != body_size)
+	{
+		return false;
+	}
+	// the pages of a mapped file reach the disk in any order, so a crash can leave a record with its size but without its data
+	if (segment.version >= 3 && crc32c(pos + 8, body_size - 4) != crc)
+	{
+		return false;
+	}
+	record.topic.assign(pos + header_size, topic_size);
+	record.payload.assign(pos + header_size + topic_size, payload_size);
+	record_size = 4 + body_size;
+	return true;
+}
+
+bool MessageStore::append(const std::string& topic, const void* payload, size_t payload_size, int qos, bool retain, int64_t deadline_us)
+{
+	if (topic.size() > UINT16_MAX || payload_size > UINT32_MAX - RECORD_HEADER_SIZE - UINT16_MAX)
+	{
+		return false;
+	}
+	Record record;
+	record.timestamp_us = nowUs();
+	record.deadline_us  = deadline_us;
+	record.qos          = qos;
+	record.retain       = retain;
+	record.topic        = topic;
+	record.payload.assign(static_cast<const char*>(payload), payload_size);
+
+	std::lock_guard<std::mutex> lock(mtx);
+	return appendLocked(record);
+}
+
+bool MessageStore::appendLocked(const Record& record)
+{
+	const size_t record_size = RECORD_HEADER_SIZE + record.topic.size() + record.payload.size();
+
+	// segments of an older version recovered from an older bridge are not continued
+	if (segments.empty() || segments.back().version != SEGMENT_VERSION || segments.back().write_offset + record_size + 4 > segments.back().size)
+	{
+		// a message larger than a segment gets a segment of its own
+		const size_t new_segment_size = std::max(segment_size, SEGMENT_HEADER_SIZE + record_size + 4);
+		uint64_t total_size = new_segment_size;
+		for (const auto& segment : segments)
+		{
+			total_size += segment.size;
+		}
+		if (max_bytes > 0 && total_size > max_bytes)
+		{
+			enforceLimitsLocked();
+		}
+
+		Segment segment;
+		if (!openSegment(next_sequence, new_segment_size, true, segment))
+		{
+			dropped_count++;
+			return false;
+		}
+		next_sequence++;
+		segments.push_back(segment);
+	}
+
+	Segment& segment = segments.back();
+	char* pos = segment.data + segment.write_offset;
+	const uint32_t body_size    = static_cast<uint32_t>(record_size - 4);
+	const uint16_t topic_size   = static_cast<uint16_t>(record.topic.size());
+	const uint32_t payload_size = static_cast<uint32_t>(record.payload.size());
+
+	// the body size is written last, so a partially written record is not read back while the bridge runs,
+	// after a crash the CRC detects a record whose pages did not all reach the disk
+	memcpy(pos + 8, &record.timestamp_us, 8);
+	memcpy(pos + 16, &record.deadline_us, 8);
+	pos[24] = static_cast<char>(record.qos);
+	pos[25] = record.retain ? 1 : 0;
+	memcpy(pos + 26, &topic_size, 2);
+	memcpy(pos + 28, &payload_size, 4);
+	memcpy(pos + RECORD_HEADER_SIZE, record.topic.data(), record.topic.size());
+	memcpy(pos + RECORD_HEADER_SIZE + record.topic.size(), record.payload.data(), record.payload.size());
+	const uint32_t crc = crc32c(pos + 8, body_size - 4);
+	memcpy(pos + 4, &crc, 4);
+	memcpy(pos, &body_size, 4);
+
+	segment.write_offset       += record_size;
+	segment.newest_timestamp_us = record.timestamp_us;
+	segment.record_count++;
+	backlog_bytes              += record_size;
+	backlog_count++;
+	bytes_since_compaction     += record_size;
+	return true;
+}
+
+void MessageStore::enforceLimitsLocked()
+{
+	// segments that only contain expired messages can go first
+	if (max_age_s > 0)
+	{
+		const int64_t oldest_allowed = nowUs() - static_cast<int64_t>(max_age_s) * 1000000;
+		while (!segments.empty() && segments.front().newest_timestamp_us < oldest_allowed)
+		{
+			dropOldestSegmentLocked();
+		}
+	}
+
+	// leave room for one more segment
+	auto total_size = [this]() -> uint64_t
+	{
+		uint64_t size = segment_size;
+		for (const auto& segment : segments)
+		{
+			size += segment.size;
+		}
+		return size;
+	};
+	while (!segments.empty() && total_size() > max_bytes)
+	{
+		// compacting only pays off if a considerable amount of messages was added since the last time
+		if (keep_latest_per_topic && bytes_since_compaction >= segment_size)
+		{
+			compactLocked();
+			continue;
+		}
+		dropOldestSegmentLocked();
+	}
+}
+
+void MessageStore::dropOldestSegmentLocked()
+{
+	Segment& segment = segments.front();
+	dropped_count += segment.record_count;
+	backlog_count -= segment.record_count;
+	backlog_bytes -= segment.write_offset - readOffset(segment);
+	closeSegment(segment, true);
+	segments.pop_front();
+}
+
+void MessageStore::compact()
+{
+	if (!keep_latest_per_topic)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mtx);
+	compactLocked();
+}
+
+void MessageStore::compactLocked()
+{
+	bytes_since_compaction = 0;
+
+	// keep the latest record per topic, in the order of their last occurrence
+	std::unordered_map<std::string, std::pair<uint64_t, Record>> latest;
+	uint64_t position = 0;
+	uint64_t record_count = 0;
+	for (const auto& segment : segments)
+	{
+		size_t offset = static_cast<size_t>(readOffset(segment));
+		Record record;
+		size_t record_size = 0;
+		while (readRecord(segment, offset, record, record_size))
+		{
+			latest[record.topic] = std::make_pair(position++, record);
+			offset += record_size;
+			record_count++;
+		}
+	}
+	if (latest.size() == record_count)
+	{
+		return;
+	}
+
+	std::vector<std::pair<uint64_t, Record>*> ordered;
+	ordered.reserve(latest.size());
+	for (auto& entry : latest)
+	{
+		ordered.push_back(&entry.second);
+	}
+	std::sort(ordered.begin(), ordered.end(), [](const std::pair<uint64_t, Record>* a, const std::pair<uint64_t, Record>* b) { return a->first < b->first; });
+
+	// write the compacted records to new segments first, so a crash cannot lose the backlog
+	std::deque<Segment> old_segments;
+	old_segments.swap(segments);
+	backlog_bytes = 0;
+	backlog_count = 0;
+	for (const auto* entry : ordered)
+	{
+		appendLocked(entry->second);
+	}
+	dropped_count += record_count - backlog_count;
+	for (auto& segment : old_segments)
+	{
+		closeSegment(segment, true);
+	}
+	bytes_since_compaction = 0;
+}
+
+bool MessageStore::front(Record& record)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (!frontLocked(record, front_record_size))
+	{
+		front_record_size = 0;
+		return false;
+	}
+	front_sequence = segments.front().sequence;
+	front_offset   = readOffset(segments.front());
+	return true;
+}
+
+bool MessageStore::frontLocked(Record& record, size_t& record_size)
+{
+	const int64_t now            = nowUs();
+	const int64_t oldest_allowed = max_age_s > 0 ? now - static_cast<int64_t>(max_age_s) * 1000000 : INT64_MIN;
+	while (!segments.empty())
+	{
+		Segment& segment = segments.front();
+		if (!readRecord(segment, static_cast<size_t>(readOffset(segment)), record, record_size))
+		{
+			// the front segment is consumed (or its remaining records are damaged)
+			dropOldestSegmentLocked();
+			continue;
+		}
+		if (record.timestamp_us < oldest_allowed)
+		{
+			popLocked(record_size);
+			dropped_count++;
+			continue;
+		}
+		if (record.deadline_us != 0 && record.deadline_us <= now)
+		{
+			popLocked(record_size);
+			expired_count++;
+			continue;
+		}
+		return true;
+	}
+	return false;
+}
+
+void MessageStore::pop()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	// the record may have been dropped by the size limit in the meantime
+	if (front_record_size > 0 && !segments.empty()
+		&& segments.front().sequence == front_sequence && readOffset(segments.front()) == front_offset)
+	{
+		popLocked(front_record_size);
+	}
+	front_record_size = 0;
+}
+
+void MessageStore::popLocked(size_t record_size)
+{
+	if (segments.empty())
+	{
+		return;
+	}
+	Segment& segment = segments.front();
+	setReadOffset(segment, readOffset(segment) + record_size);
+	segment.record_count--;
+	backlog_bytes -= record_size;
+	backlog_count--;
+	if (segment.record_count == 0)
+	{
+		closeSegment(segment, true);
+		segments.pop_front();
+	}
+}
+
+bool MessageStore::empty() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return backlog_count == 0;
+}
+
+uint64_t MessageStore::getBacklogBytes() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return backlog_bytes;
+}
+
+uint64_t MessageStore::getBacklogCount() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return backlog_count;
+}
+
+uint64_t MessageStore::getDroppedCount() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return dropped_count;
+}
+
+uint64_t MessageStore::getExpiredCount() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return expired_count;
+}
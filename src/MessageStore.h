@@ -0,0 +1,144 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Disk backed FIFO of MQTT messages, used to bridge broker outages.
+ *
+ * The messages are appended to memory mapped segment files of a fixed size.
+ * The read position is stored in the header of each segment, so a backlog
+ * survives a restart of the bridge. Fully consumed segments are deleted.
+ *
+ * The store is bounded by its size on disk and by the age of the messages.
+ * If the size limit is exceeded, the oldest segment is dropped, unless the
+ * "latest per topic" compaction can free enough space by keeping only the
+ * newest message of every topic.
+ *
+ * All member functions are thread safe.
+ */
+class MessageStore
+{
+public:
+  struct Record
+  {
+    int64_t     timestamp_us;  // wall clock time when the message was stored
+    int64_t     deadline_us;   // wall clock time when the message expires, 0 if it does not
+    int         qos;
+    bool        retain;
+    std::string topic;
+    std::string payload;
+  };
+
+  /**
+   * @param directory             directory of the segment files, created if it does not exist
+   * @param segment_size          size of one segment file in bytes
+   * @param max_bytes             maximum size of all segments, 0 means unlimited
+   * @param max_age_s             messages older than this are discarded, 0 means unlimited
+   * @param keep_latest_per_topic compact the store by keeping only the latest message per topic
+   */
+  MessageStore(const std::string& directory, size_t segment_size, uint64_t max_bytes, int max_age_s, bool keep_latest_per_topic);
+  ~MessageStore();
+
+  MessageStore(const MessageStore&) = delete;
+  MessageStore& operator=(const MessageStore&) = delete;
+
+  /**
+   * @brief Opens the store and recovers the messages of existing segment files
+   *
+   * @return false if the directory or the segment files cannot be used
+   */
+  bool open();
+
+  /**
+   * @param deadline_us  wall clock time in microseconds when the message expires, 0 if it does not
+   * @return false if the message could not be stored
+   */
+  bool append(const std::string& topic, const void* payload, size_t payload_size, int qos, bool retain, int64_t deadline_us = 0);
+
+  /**
+   * @brief Reads the oldest message without removing it. Messages older than max_age_s or past their deadline are skipped.
+   *
+   * @return false if the store is empty
+   */
+  bool front(Record& record);
+
+  /** @brief Removes the message returned by the last call of @ref front */
+  void pop();
+
+  /** @brief Applies the "latest per topic" compaction, if configured */
+  void compact();
+
+  bool     empty() const;
+  uint64_t getBacklogBytes() const;
+  uint64_t getBacklogCount() const;
+  uint64_t getDroppedCount() const;
+  /** @return messages skipped because of their deadline */
+  uint64_t getExpiredCount() const;
+
+private:
+  struct Segment
+  {
+    uint64_t    sequence;
+    std::string path;
+    int         fd;
+    char*       data;
+    size_t      size;
+    size_t      write_offset;
+    int64_t     newest_timestamp_us;
+    uint64_t    record_count;     // number of unconsumed records
+    int         version;          // of the record layout
+  };
+
+  bool      openSegment(uint64_t sequence, size_t size, bool create, Segment& segment);
+  void      closeSegment(Segment& segment, bool remove);
+  bool      appendLocked(const Record& record);
+  bool      frontLocked(Record& record, size_t& record_size);
+  void      popLocked(size_t record_size);
+  void      dropOldestSegmentLocked();
+  void      enforceLimitsLocked();
+  void      compactLocked();
+  uint64_t  readOffset(const Segment& segment) const;
+  void      setReadOffset(Segment& segment, uint64_t offset);
+  bool      readRecord(const Segment& segment, size_t offset, Record& record, size_t& record_size) const;
+
+  const std::string   directory;
+  const size_t        segment_size;
+  const uint64_t      max_bytes;
+  const int           max_age_s;
+  const bool          keep_latest_per_topic;
+
+  mutable std::mutex  mtx;
+  std::deque<Segment> segments;
+  uint64_t            next_sequence;
+  uint64_t            backlog_bytes;
+  uint64_t            backlog_count;
+  uint64_t            dropped_count;
+  uint64_t            expired_count;
+  uint64_t            bytes_since_compaction;
+  size_t              front_record_size;
+  uint64_t            front_sequence;
+  uint64_t            front_offset;
+};
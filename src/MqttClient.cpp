@@ -0,0 +1,167 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "MqttClient.h"
+
+MqttClient::MqttClient(const char* id, bool clean_session)
+{
+	mosq = mosquitto_new(id, clean_session, this);
+
+	// libmosquitto calls every registered connect callback, so only the v5 variants are registered
+	// (they are called for MQTT v3.x connections as well, just without properties)
+	mosquitto_connect_v5_callback_set(mosq, [](struct mosquitto*, void* userdata, int rc, int flags, const mosquitto_property* props)
+		{
+			static_cast<MqttClient*>(userdata)->on_connect(rc, flags, props);
+		});
+	mosquitto_disconnect_callback_set(mosq, [](struct mosquitto*, void* userdata, int rc)
+		{
+			static_cast<MqttClient*>(userdata)->on_disconnect(rc);
+		});
+	mosquitto_publish_v5_callback_set(mosq, [](struct mosquitto*, void* userdata, int mid, int reason_code, const mosquitto_property*)
+		{
+			static_cast<MqttClient*>(userdata)->on_publish(mid, reason_code);
+		});
+	mosquitto_message_v5_callback_set(mosq, [](struct mosquitto*, void* userdata, const struct mosquitto_message* message, const mosquitto_property* props)
+		{
+			static_cast<MqttClient*>(userdata)->on_message(message, props);
+		});
+	mosquitto_subscribe_callback_set(mosq, [](struct mosquitto*, void* userdata, int mid, int qos_count, const int* granted_qos)
+		{
+			static_cast<MqttClient*>(userdata)->on_subscribe(mid, qos_count, granted_qos);
+		});
+	mosquitto_log_callback_set(mosq, [](struct mosquitto*, void* userdata, int level, const char* str)
+		{
+			static_cast<MqttClient*>(userdata)->on_log(level, str);
+		});
+}
+
+MqttClient::~MqttClient()
+{
+	mosquitto_destroy(mosq);
+}
+
+struct mosquitto* MqttClient::handle() const
+{
+	return mosq;
+}
+
+int MqttClient::will_set(const char* topic, int payloadlen, const void* payload, int qos, bool retain)
+{
+	return mosquitto_will_set(mosq, topic, payloadlen, payload, qos, retain);
+}
+
+int MqttClient::username_pw_set(const char* username, const char* password)
+{
+	return mosquitto_username_pw_set(mosq, username, password);
+}
+
+int MqttClient::connect(const char* host, int port, int keepalive, const char* bind_address)
+{
+	return mosquitto_connect_bind(mosq, host, port, keepalive, bind_address);
+}
+
+int MqttClient::connect_async(const char* host, int port, int keepalive)
+{
+	return mosquitto_connect_async(mosq, host, port, keepalive);
+}
+
+int MqttClient::connect_v5(const char* host, int port, int keepalive, const char* bind_address, const mosquitto_property* properties)
+{
+	return mosquitto_connect_bind_v5(mosq, host, port, keepalive, bind_address, properties);
+}
+
+int MqttClient::disconnect()
+{
+	return mosquitto_disconnect(mosq);
+}
+
+int MqttClient::publish(int* mid, const char* topic, int payloadlen, const void* payload, int qos, bool retain)
+{
+	return mosquitto_publish(mosq, mid, topic, payloadlen, payload, qos, retain);
+}
+
+int MqttClient::publish_v5(int* mid, const char* topic, int payloadlen, const void* payload, int qos, bool retain, const mosquitto_property* properties)
+{
+	return mosquitto_publish_v5(mosq, mid, topic, payloadlen, payload, qos, retain, properties);
+}
+
+int MqttClient::subscribe(int* mid, const char* sub, int qos)
+{
+	return mosquitto_subscribe(mosq, mid, sub, qos);
+}
+
+int MqttClient::subscribe_multiple(int* mid, int sub_count, char* const* const sub, int qos, int options)
+{
+	return mosquitto_subscribe_multiple(mosq, mid, sub_count, sub, qos, options, NULL);
+}
+
+int MqttClient::unsubscribe_multiple(int* mid, int sub_count, char* const* const sub)
+{
+	return mosquitto_unsubscribe_multiple(mosq, mid, sub_count, sub, NULL);
+}
+
+int MqttClient::tls_set(const char* cafile, const char* capath, const char* certfile, const char* keyfile, int (*pw_callback)(char* buf, int size, int rwflag, void* userdata))
+{
+	return mosquitto_tls_set(mosq, cafile, capath, certfile, keyfile, pw_callback);
+}
+
+int MqttClient::tls_opts_set(int cert_reqs, const char* tls_version, const char* ciphers)
+{
+	return mosquitto_tls_opts_set(mosq, cert_reqs, tls_version, ciphers);
+}
+
+int MqttClient::tls_insecure_set(bool value)
+{
+	return mosquitto_tls_insecure_set(mosq, value);
+}
+
+int MqttClient::tls_psk_set(const char* psk, const char* identity, const char* ciphers)
+{
+	return mosquitto_tls_psk_set(mosq, psk, identity, ciphers);
+}
+
+int MqttClient::opts_set(enum mosq_opt_t option, void* value)
+{
+	return mosquitto_opts_set(mosq, option, value);
+}
+
+int MqttClient::int_option(enum mosq_opt_t option, int value)
+{
+	return mosquitto_int_option(mosq, option, value);
+}
+
+int MqttClient::max_inflight_messages_set(unsigned int max_inflight_messages)
+{
+	return mosquitto_max_inflight_messages_set(mosq, max_inflight_messages);
+}
+
+int MqttClient::loop_start()
+{
+	return mosquitto_loop_start(mosq);
+}
+
+int MqttClient::loop_stop(bool force)
+{
+	return mosquitto_loop_stop(mosq, force);
+}
+
+int MqttClient::socket()
+{
+	return mosquitto_socket(mosq);
+}
@@ -0,0 +1,86 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <mosquitto.h>
+#include <mqtt_protocol.h>
+
+/**
+ * @brief Thin C++ wrapper around a libmosquitto client instance.
+ *
+ * The member functions mirror the ones of the (deprecated) mosqpp::mosquittopp
+ * class, but the callbacks also carry the MQTT v5 information (connect flags,
+ * properties and reason codes) and the raw handle is available to derived
+ * classes for the functions that have no wrapper here.
+ */
+class MqttClient
+{
+public:
+  /**
+   * @param id             the client id, may be NULL if clean_session is true
+   * @param clean_session  if false, the broker keeps the session (subscriptions
+   *                       and queued QoS 1/2 messages) while the client is away
+   */
+  MqttClient(const char* id, bool clean_session);
+  virtual ~MqttClient();
+
+  MqttClient(const MqttClient&) = delete;
+  MqttClient& operator=(const MqttClient&) = delete;
+
+  int will_set(const char* topic, int payloadlen, const void* payload, int qos, bool retain);
+  int username_pw_set(const char* username, const char* password = NULL);
+  int connect(const char* host, int port, int keepalive, const char* bind_address);
+  int connect_async(const char* host, int port, int keepalive);
+  int connect_v5(const char* host, int port, int keepalive, const char* bind_address, const mosquitto_property* properties);
+  int disconnect();
+  int publish(int* mid, const char* topic, int payloadlen, const void* payload, int qos, bool retain);
+  int publish_v5(int* mid, const char* topic, int payloadlen, const void* payload, int qos, bool retain, const mosquitto_property* properties);
+  int subscribe(int* mid, const char* sub, int qos);
+  int subscribe_multiple(int* mid, int sub_count, char* const* const sub, int qos, int options = 0);
+  int unsubscribe_multiple(int* mid, int sub_count, char* const* const sub);
+  int tls_set(const char* cafile, const char* capath, const char* certfile, const char* keyfile, int (*pw_callback)(char* buf, int size, int rwflag, void* userdata) = NULL);
+  int tls_opts_set(int cert_reqs, const char* tls_version, const char* ciphers);
+  int tls_insecure_set(bool value);
+  int tls_psk_set(const char* psk, const char* identity, const char* ciphers);
+  int opts_set(enum mosq_opt_t option, void* value);
+  int int_option(enum mosq_opt_t option, int value);
+  int max_inflight_messages_set(unsigned int max_inflight_messages);
+  int loop_start();
+  int loop_stop(bool force = false);
+  int socket();
+
+protected:
+  struct mosquitto* handle() const;
+
+  /**
+   * @param rc     the CONNACK return / reason code
+   * @param flags  the CONNACK flags, bit 0 is the "session present" flag
+   * @param props  the CONNACK properties (MQTT v5 only, NULL otherwise)
+   */
+  virtual void on_connect(int /*rc*/, int /*flags*/, const mosquitto_property* /*props*/) {}
+  virtual void on_disconnect(int /*rc*/) {}
+  virtual void on_publish(int /*mid*/, int /*reason_code*/) {}
+  virtual void on_message(const struct mosquitto_message* /*message*/, const mosquitto_property* /*props*/) {}
+  virtual void on_subscribe(int /*mid*/, int /*qos_count*/, const int* /*granted_qos*/) {}
+  virtual void on_log(int /*level*/, const char* /*str*/) {}
+
+private:
+  struct mosquitto* mosq;
+};
@@ -18,6 +18,7 @@
 */
 
 #include "Bridge.h"
+#include "Config.h"
 #include "stringutils.h"
 
 #include <vector>
@@ -26,13 +27,22 @@
 #include <iomanip>
 #include <thread>
 #include <algorithm>
+#include <set>
+#include <sstream>
 #include <memory>
 #include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <csignal>
 #include <time.h>
 
 #include <libgen.h>         // dirname
 #include <unistd.h>         // readlink
 #include <linux/limits.h>   // PATH_MAX
+#include <sys/stat.h>       // stat
+#include <sys/socket.h>     // sendto
+#include <sys/un.h>         // sockaddr_un
 
 
 void usage()
@@ -41,6 +51,8 @@ void usage()
   std::cout << "-h            --help           Display this help" << std::endl;
   std::cout << "-c=PATH       --config=PATH    Use the path to a yaml file to load the config" << std::endl;
   std::cout << "-v            --verbose        Print all logging information from MQTT" << std::endl;
+  std::cout << "              --check-config   Only load and validate the config, print parse and validation timings" << std::endl;
+  std::cout << "-w            --watch          Reload the config when the yaml file changes (it is always reloaded on SIGHUP)" << std::endl;
 }
 
 void setAlgoState(char state_, const char *infoText_) 
@@ -63,314 +75,374 @@ void setAlgoState(char state_, const char *infoText_)
     eCAL::Process::SetState(severity, proc_sev_level1, infoText_);
 };
 
-bool CheckYamlValidity(std::map<std::string,Broker>& brokers,
-                       std::map<std::string,MqttTopic>& mqtt2ecal_topics,
-                       std::map<std::string,EcalTopic>& ecal2mqtt_topics)
+/**
+ * Sends a state to the service manager, if it started the process with NOTIFY_SOCKET set.
+ * This is the protocol of sd_notify(3), without depending on libsystemd.
+ */
+void notifyService(const std::string& service_state)
 {
-    // Check if we have any valid brokers
-    if (brokers.size() == 0)
+    const char* socket_path = getenv("NOTIFY_SOCKET");
+    if (socket_path == NULL || (socket_path[0] != '/' && socket_path[0] != '@'))
     {
-        printError("No brokers configured");
-        return false;
+        return;
     }
-
-    // Check if the broker name is valid for mqtt --> ecal topics
-    // If not, delete from mqtt2ecal topics list
-    for (auto it = mqtt2ecal_topics.cbegin(); it != mqtt2ecal_topics.cend();)
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    size_t path_length = strlen(socket_path);
+    if (path_length >= sizeof(address.sun_path))
     {
-        if (brokers.count(it->second.broker_name) != 1)
-        {
-            printError("No broker with name " + it->second.broker_name + " configured for topic " + it->first);
-            // delete from map
-            mqtt2ecal_topics.erase(it++);
-        }
-        else
-        {
-            ++it;
-        }
+        return;
     }
-
-    // Check if the broker name is valid for ecal --> mqtt topics
-    // If not, delete from ecal2mqqt topics list
-    for (auto it = ecal2mqtt_topics.cbegin(); it != ecal2mqtt_topics.cend();)
+    memcpy(address.sun_path, socket_path, path_length);
+    if (address.sun_path[0] == '@')
     {
-        if (brokers.count(it->second.broker_name) != 1)
-        {
-            printError("No broker with name " + it->second.broker_name + " configured for topic " + it->first);
-            // delete from map
-            ecal2mqtt_topics.erase(it++);
-        }
-        else
-        {
-            ++it;
-        }
+        // abstract socket namespace
+        address.sun_path[0] = '\0';
     }
 
-    // Throw out any brokers that are not used
-    bool found = false;
-    for (auto it = brokers.cbegin(); it != brokers.cend();)
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
     {
-        for (auto topic : mqtt2ecal_topics)
-        {
-            if (topic.second.broker_name == it->second.name)
-            {
-                found = true;
-            }
-        }
-        for (auto topic : ecal2mqtt_topics)
-        {
-            if (topic.second.broker_name == it->second.name)
-            {
-                found = true;
-            }
-
-        }
-        if (!found)
-        {
-            printError("Broker " + it->second.name + " is not used");
-            brokers.erase(it++);
-        }
-        else
-        {
-            ++it;
-        }
+        return;
     }
+    sendto(fd, service_state.c_str(), service_state.size(), MSG_NOSIGNAL, reinterpret_cast<struct sockaddr*>(&address), static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path_length));
+    close(fd);
+}
+
+std::unique_ptr<Bridge> createBridge(int argc, char** argv,
+                                     const Broker& broker,
+                                     const BrokerTopics& topics,
+                                     const GeneralSettings& general_settings,
+                                     bool verbose)
+{
+    return std::make_unique<Bridge>(argc, argv, broker, topics.mqtt2ecal, topics.ecal2mqtt, general_settings, verbose);
+}
 
-    // if no quality of service is defined to eCAL -> MQTT, use the default one from the corresponding broker
-    // if no retain_flag is set, use the default one from the corresponding broker
-    for (auto topic : ecal2mqtt_topics)
+/**
+ * Creates the bridges of the given brokers in parallel, so a slow broker does not delay the others
+ */
+void createBridges(int argc, char** argv,
+                   const std::vector<Broker>& brokers,
+                   const std::map<std::string, BrokerTopics>& topics_by_broker,
+                   const GeneralSettings& general_settings,
+                   bool verbose,
+                   std::map<std::string, std::unique_ptr<Bridge>>& bridges)
+{
+    std::vector<std::unique_ptr<Bridge>> created_bridges(brokers.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < brokers.size(); i++)
     {
-        if (!topic.second.is_set_retain_flag || topic.second.qos == -1)
+        threads.emplace_back([&, i]()
         {
-            for (auto broker : brokers)
-            {
-                if (broker.second.name == topic.second.broker_name)
-                {
-                    if (!topic.second.is_set_retain_flag)
-                    {
-                        topic.second.retain_flag = broker.second.default_retain_flag;
-                    }
-                    if (topic.second.qos == -1)
-                    {
-                        topic.second.qos = broker.second.default_qos;
-                    }
-                }
-            }
-
-        }
+            auto topics = topics_by_broker.find(brokers[i].name);
+            created_bridges[i] = createBridge(argc, argv, brokers[i], topics != topics_by_broker.end() ? topics->second : BrokerTopics(), general_settings, verbose);
+        });
     }
-
-    // if no quality of service is defined to MQTT -> eCAL, use the default one from the corresponding broker
-    for (auto topic : mqtt2ecal_topics)
+    for (auto& thread : threads)
     {
-        // if the qos is not defined, iterate through all brokers, find the corresponding one and set the qos to the default one from the broker
-        if (topic.second.qos == -1)
-        {
-            for (auto broker : brokers)
-            {
-                if (broker.second.name == topic.second.broker_name)
-                {
-                    topic.second.qos = broker.second.default_qos;
-                }
-            }
+        thread.join();
+    }
+    for (size_t i = 0; i < brokers.size(); i++)
+    {
+        bridges[brokers[i].name] = std::move(created_bridges[i]);
+    }
+}
 
-        }
+// set from the SIGHUP handler, the reload itself is done by the supervisor loop
+std::atomic<bool> reload_requested(false);
+
+void requestReload(int /*signal*/)
+{
+    reload_requested = true;
+}
+
+time_t getModificationTime(const std::string& path)
+{
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) != 0)
+    {
+        return 0;
     }
-    return true;
+    return file_stat.st_mtime;
 }
 
-void run(int argc, char** argv, const std::string& path_to_config, bool verbose)
+/**
+ * Loads the configuration again and applies the differences to the running bridges:
+ * bridges of removed brokers are destroyed, bridges of new or changed brokers are
+ * (re)created and all other bridges only get their routes updated.
+ * If the new configuration is not valid, the running one is kept.
+ */
+void reloadConfig(int argc, char** argv, const std::string& path_to_config, bool verbose,
+                  GeneralSettings& general_settings,
+                  std::map<std::string, std::unique_ptr<Bridge>>& bridges)
 {
-    GeneralSettings general_settings;
+    GeneralSettings                  new_general_settings;
     std::map<std::string, Broker>    brokers;
     std::map<std::string, MqttTopic> mqtt2ecal_topics;
     std::map<std::string, EcalTopic> ecal2mqtt_topics;
 
-    YAML::Node loaded_file;
-    YAML::Node gateway;
-    printOutput("************************************************************************");
-    printOutput("Starting to parse yaml file...");
-    try 
+    auto reload_started = std::chrono::steady_clock::now();
+    ConfigLoadTimings timings;
+    if (!loadConfig(path_to_config, new_general_settings, brokers, mqtt2ecal_topics, ecal2mqtt_topics, timings))
     {
-        loaded_file = YAML::LoadFile(path_to_config);
-        gateway = loaded_file["gateway"];
-    }
-    catch (std::exception& e)
-    {
-        printError(e.what());
+        printError("Failed to reload the configuration, keeping the current one");
         return;
     }
-
-    if (gateway["hide_secrets"])
+    if (new_general_settings.ecal_process_name != general_settings.ecal_process_name)
     {
-        general_settings.hide_secrets = gateway["hide_secrets"].as<bool>();
+        printError("The eCAL process name can only be changed by a restart, keeping " + general_settings.ecal_process_name);
+        new_general_settings.ecal_process_name = general_settings.ecal_process_name;
     }
-    if (gateway["mqtt_protocol_version"])
-    {
-        if(gateway["mqtt_protocol_version"].as<std::string>().compare("null") != 0)
-            general_settings.mqtt_protocol_version = gateway["mqtt_protocol_version"].as<std::string>();
-    }
-    if (gateway["ecal_process_name"])
+    if (verbose)
     {
-        if (gateway["ecal_process_name"].as<std::string>().compare("null") != 0)
-            general_settings.ecal_process_name = gateway["ecal_process_name"].as<std::string>();
+        printConfig(new_general_settings, mqtt2ecal_topics, ecal2mqtt_topics);
     }
 
-    YAML::Node yaml_brokers   = gateway["brokers"];
-    YAML::Node yaml_mqtt2ecal = gateway["mqtt2ecal"];
-    YAML::Node yaml_ecal2mqtt = gateway["ecal2mqtt"];
-
-    // fill out brokers map
-    for (auto current_broker: yaml_brokers)
+    auto topics_by_broker = groupTopicsByBroker(mqtt2ecal_topics, ecal2mqtt_topics);
+    int removed = 0, recreated = 0, updated = 0, added = 0;
+    std::vector<Broker> new_brokers;
+    for (auto it = bridges.begin(); it != bridges.end();)
     {
-        Broker broker;
-        current_broker >> broker;
-
-        // keep only valid brokers
-        if (broker.CheckValidity())
+        auto broker = brokers.find(it->first);
+        if (broker == brokers.end())
         {
-            brokers.insert({broker.name, broker });
+            printOutput("Removing broker " + it->first);
+            it = bridges.erase(it);
+            removed++;
+            continue;
+        }
+        if (!it->second->hasSettings(broker->second, new_general_settings))
+        {
+            // the connection settings changed, so the bridge has to connect again anyway
+            printOutput("Reconnecting to broker " + it->first + " with the changed settings");
+            it = bridges.erase(it);
+            new_brokers.push_back(broker->second);
+            recreated++;
+            continue;
         }
         else
         {
-            printError("Broker " + broker.name + " is not valid");
+            const BrokerTopics& topics = topics_by_broker[it->first];
+            it->second->setBandwidthLimit(broker->second.bandwidth_limit, broker->second.bandwidth_burst);
+            it->second->updateRoutes(topics.mqtt2ecal, topics.ecal2mqtt);
+            updated++;
         }
+        ++it;
     }
-
-    // fill out mqtt2ecal map
-    for (auto current_mqtt_topic : yaml_mqtt2ecal)
+    for (auto const& broker : brokers)
     {
-        MqttTopic mqtt_topic;
-        current_mqtt_topic >> mqtt_topic;
-
-        // keep only valid topics
-        if (mqtt_topic.CheckValidity())
+        if (bridges.count(broker.first) == 0 && std::none_of(new_brokers.begin(), new_brokers.end(), [&broker](const Broker& new_broker) { return new_broker.name == broker.first; }))
         {
-            mqtt2ecal_topics.insert({mqtt_topic.name, mqtt_topic });
+            printOutput("Adding broker " + broker.first);
+            new_brokers.push_back(broker.second);
+            added++;
+        }
+    }
+    createBridges(argc, argv, new_brokers, topics_by_broker, new_general_settings, verbose, bridges);
+    for (auto it = bridges.begin(); it != bridges.end();)
+    {
+        if (!it->second->isInitialized())
+        {
+            printError("Error when initializing the bridge for broker " + it->first);
+            it = bridges.erase(it);
         }
         else
         {
-            printError("Topic " + mqtt_topic.name + " is not valid");
+            ++it;
         }
     }
+    general_settings = new_general_settings;
 
-    // fill out ecal2mqtt map
-    for (auto current_ecal_topic : yaml_ecal2mqtt)
-    {
-        EcalTopic ecal_topic;
-        current_ecal_topic >> ecal_topic;
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - reload_started);
+    printOutput("Configuration reloaded in " + std::to_string(duration.count()) + " ms: "
+        + std::to_string(updated) + " brokers updated, " + std::to_string(added) + " added, "
+        + std::to_string(recreated) + " reconnected, " + std::to_string(removed) + " removed");
+}
 
-        // keep only valid topics
-        if (ecal_topic.CheckValidity())
-        {
-            ecal2mqtt_topics.insert({ecal_topic.name, ecal_topic });
-        }
-        else
+/**
+ * Determines the state of one bridge for the eCAL process state
+ *
+ * @return 2 if ok, 1 on warnings, 0 on errors
+ */
+char getBridgeState(Bridge& bridge, std::string& info)
+{
+    char state;
+    if (!bridge.isConnectedToMqttBroker())
+    {
+        state = 0;
+        info = "not connected";
+        if ((!bridge.getEcalRxCounter()) && (!bridge.getMqttRxCounter()))
         {
-            printError("Topic " + ecal_topic.name + " is not valid");
+            info = "not connected, trying to reconnect";
+            bridge.tryReconnectMqtt();
+
         }
     }
+    else if (!bridge.getEcalRxCounter() && !bridge.getMqttRxCounter())
+    {
+        state = 1;
+        info = "no data exchange";
+    }
+    else
+    {
+        state = 2;
+        info = "ok, " + std::to_string(bridge.getEcalRxCounter()) + " tx-pkts, " + std::to_string(bridge.getMqttRxCounter()) + " rx-pkts";
+    }
+    if (bridge.getFailoverCounter() > 0)
+    {
+        info += ", " + std::to_string(bridge.getFailoverCounter()) + " failovers (last took " + std::to_string(bridge.getLastFailoverMs()) + " ms)";
+    }
+    return state;
+}
 
-    if (!CheckYamlValidity(brokers, mqtt2ecal_topics, ecal2mqtt_topics))
+void run(int argc, char** argv, const std::string& path_to_config, bool verbose, bool watch_config)
+{
+    GeneralSettings general_settings;
+    std::map<std::string, Broker>    brokers;
+    std::map<std::string, MqttTopic> mqtt2ecal_topics;
+    std::map<std::string, EcalTopic> ecal2mqtt_topics;
+
+    auto startup_started = std::chrono::steady_clock::now();
+    auto phase_started   = startup_started;
+    auto elapsedMs = [](std::chrono::steady_clock::time_point since)
+    {
+        return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - since).count()) + " ms";
+    };
+
+    time_t config_modification_time = getModificationTime(path_to_config);
+    ConfigLoadTimings config_timings;
+    if (!loadConfig(path_to_config, general_settings, brokers, mqtt2ecal_topics, ecal2mqtt_topics, config_timings))
     {
         return;
     }
   
     if (verbose)
     {
-        printOutput("************************************************************************");
-        printOutput(add_spacing("eCAL -> MQTT"));
-        printOutput("Channels:");
-        printTopicMapEcal2Mqtt(ecal2mqtt_topics);
-        printOutput("Type:");
-        printTypesMapEcal2Mqtt(ecal2mqtt_topics);
-        printOutput("Descriptor info:");
-        printDescriptorsMapEcal2Mqtt(ecal2mqtt_topics);
-        printOutput("************************************************************************");
-        printOutput(add_spacing("MQTT -> eCAL"));
-        printOutput("Channels:");
-        printTopicMapMqtt2Ecal(mqtt2ecal_topics);
-        printOutput("Type:");
-        printTypesMapMqtt2Ecal(mqtt2ecal_topics);
-        printOutput("Descriptor info:");
-        printDescriptorsMapMqtt2Ecal(mqtt2ecal_topics);
-        printOutput("************************************************************************");
-        printOutput(add_spacing("General settings"));
-        printGeneralSettings(general_settings);
-
+        printConfig(general_settings, mqtt2ecal_topics, ecal2mqtt_topics);
     }
+    std::string startup_timings = "config " + elapsedMs(phase_started) + " (" + toString(config_timings) + ")";
+
+  // eCAL stays initialized while the bridges are recreated on a reload
+  phase_started = std::chrono::steady_clock::now();
+  eCAL::Initialize(argc, argv, general_settings.ecal_process_name.c_str());
+  startup_timings += ", eCAL " + elapsedMs(phase_started);
 
   char state = 1;
   std::string info = "connecting";
   setAlgoState(state, info.c_str());
+  notifyService("STATUS=" + info);
 
-  std::list<std::unique_ptr<Bridge>> list_of_bridges;
-  for (std::pair<std::string, Broker> broker : brokers)
+  phase_started = std::chrono::steady_clock::now();
+  std::map<std::string, std::unique_ptr<Bridge>> bridges;
+  std::vector<Broker> broker_list;
+  for (auto const& broker : brokers)
   {
-      // filter topics that only use the current broker to send to the bridge
-      std::vector<MqttTopic> temp_mqtt2ecal;
-      std::vector<EcalTopic> temp_ecal2mqtt;
+      broker_list.push_back(broker.second);
+  }
+  createBridges(argc, argv, broker_list, groupTopicsByBroker(mqtt2ecal_topics, ecal2mqtt_topics), general_settings, verbose, bridges);
+  startup_timings += ", bridges " + elapsedMs(phase_started);
 
-      for (auto topic : mqtt2ecal_topics)
+  for (auto it = bridges.begin(); it != bridges.end();)
+  {
+      if (it->second->isInitialized() == false)
       {
-          if (topic.second.broker_name == broker.first)
-          {
-              temp_mqtt2ecal.push_back(topic.second);
-          }
+          std::cerr << getLogTime() << ": Error when initializing the bridge for broker " << it->first << "." << std::endl;
+          it = bridges.erase(it);
       }
-      for (auto topic : ecal2mqtt_topics)
+      else
       {
-          if (topic.second.broker_name == broker.first)
-          {
-              temp_ecal2mqtt.push_back(topic.second);
-          }
+          ++it;
       }
+  }
+  if (bridges.empty())
+  {
+      std::cerr << getLogTime() << ": Error when initializing. The program will now exit." << std::endl;
+      eCAL::Finalize();
+      return;
+  }
 
-      list_of_bridges.push_back(std::make_unique<Bridge>(argc, argv, broker.second, temp_mqtt2ecal, temp_ecal2mqtt, general_settings, verbose));
+  // the bridges connect in the background, wait for the CONNACKs and SUBACKs instead of a fixed time
+  phase_started = std::chrono::steady_clock::now();
+  auto ready_deadline = phase_started + std::chrono::milliseconds(general_settings.startup_timeout);
+  bool is_ready = true;
+  for (auto const& bridge : bridges)
+  {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(ready_deadline - std::chrono::steady_clock::now());
+      if (!bridge.second->waitUntilReady(std::max(0, static_cast<int>(remaining.count()))))
+      {
+          printError("Broker " + bridge.first + " is not ready after " + std::to_string(general_settings.startup_timeout) + " ms");
+          is_ready = false;
+      }
+  }
+  startup_timings += ", connect and subscribe " + elapsedMs(phase_started);
+  printOutput("Startup took " + elapsedMs(startup_started) + " (" + startup_timings + ")");
+  for (auto const& bridge : bridges)
+  {
+      printOutput("Broker " + bridge.first + ": " + bridge.second->getStartupTimings());
+  }
+  if (is_ready)
+  {
+      setAlgoState(2, "ready");
+      notifyService("READY=1\nSTATUS=ready");
   }
 
-  std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-  for (auto const& bridge : list_of_bridges) 
+  signal(SIGHUP, requestReload);
+  while (eCAL::Ok() == true)
   {
-      if (bridge->isInitialized() == true)
+      if (watch_config)
       {
-          while (eCAL::Ok() == true)
+          time_t modification_time = getModificationTime(path_to_config);
+          if (modification_time != 0 && modification_time != config_modification_time)
           {
-              if (!bridge->isConnectedToMqttBroker())
-              {
-                  state = 0;
-                  info = "not connected";
-                  if ((!bridge->getEcalRxCounter()) && (!bridge->getMqttRxCounter()))
-                  {
-                      info = "not connected, trying to reconnect";
-                      bridge->tryReconnectMqtt();
-
-                  }
-              }
-              else if (!bridge->getEcalRxCounter() && !bridge->getMqttRxCounter())
-              {
-                  state = 1;
-                  info = "no data exchange";
-              }
-              else
-              {
-                  state = 2;
-                  info = "ok, " + std::to_string(bridge->getEcalRxCounter()) + " tx-pkts, " + std::to_string(bridge->getMqttRxCounter()) + " rx-pkts";
-              }
-              if (verbose == true)
+              config_modification_time = modification_time;
+              reload_requested = true;
+          }
+      }
+      if (reload_requested.exchange(false))
+      {
+          notifyService("RELOADING=1");
+          reloadConfig(argc, argv, path_to_config, verbose, general_settings, bridges);
+          notifyService("READY=1");
+      }
+
+      state = 2;
+      info  = "";
+      for (auto const& bridge : bridges)
+      {
+          std::string bridge_info;
+          state = std::min(state, getBridgeState(*bridge.second, bridge_info));
+          info += (info.empty() ? "" : "; ") + (bridges.size() > 1 ? bridge.first + ": " : std::string()) + bridge_info;
+          if (verbose == true)
+          {
+              std::cout << getLogTime() << ": current status of " << bridge.first << ": " << bridge_info << std::endl;
+              for (auto const& statistic : bridge.second->getStatistics())
               {
-                  std::cout << getLogTime() << ": current status: " << info << std::endl;
+                  std::cout << getLogTime() << ": " << statistic.first << ": " << statistic.second << std::endl;
               }
-
-              setAlgoState(state, info.c_str());
-              std::this_thread::sleep_for(std::chrono::milliseconds(2000));
           }
       }
-      else
+      if (bridges.empty())
       {
-          std::cerr << getLogTime() << ": Error when initializing. The program will now exit." << std::endl;
+          state = 0;
+          info  = "no brokers configured";
       }
+
+      if (!is_ready && !bridges.empty() && std::all_of(bridges.begin(), bridges.end(), [](const std::pair<const std::string, std::unique_ptr<Bridge>>& bridge) { return bridge.second->isReady(); }))
+      {
+          // some brokers were not reachable at startup, but are now
+          is_ready = true;
+          printOutput("All brokers are ready after " + elapsedMs(startup_started));
+          notifyService("READY=1");
+      }
+
+      setAlgoState(state, info.c_str());
+      notifyService("STATUS=" + info);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2000));
   }
+  notifyService("STOPPING=1");
+  bridges.clear();
+  eCAL::Finalize();
 }
 
 std::string ExePath() 
@@ -394,11 +466,13 @@ int main(int argc, char** argv)
 {
   std::string path_to_config = ExePath() + "settings.yaml";
   bool verbose = false;
+  bool watch_config = false;
+  bool check_config = false;
 
   if (argc == 1)
   {
     // No parameters
-    run(argc, argv, path_to_config, verbose);
+    run(argc, argv, path_to_config, verbose, watch_config);
   }
   else
   {
@@ -427,6 +501,18 @@ int main(int argc, char** argv)
           verbose = true;
           valid_param = true;
         }
+        else
+        if ((param == "-w") || (param == "--watch"))
+        {
+          watch_config = true;
+          valid_param = true;
+        }
+        else
+        if (param == "--check-config")
+        {
+          check_config = true;
+          valid_param = true;
+        }
 
         if (!valid_param)
         {
@@ -435,7 +521,11 @@ int main(int argc, char** argv)
           return 0;
         }
       }
-      run(0/*argc*/, argv, path_to_config, verbose); // ecal_init fails on ecal-unknown parameter, so we have to provide no parameter
+      if (check_config)
+      {
+        return checkConfig(path_to_config, verbose);
+      }
+      run(0/*argc*/, argv, path_to_config, verbose, watch_config); // ecal_init fails on ecal-unknown parameter, so we have to provide no parameter
     }
   }
 }
@@ -22,6 +22,14 @@
 MqttTopic::MqttTopic()
 {
 	qos = -1;
+	input_format = "binary";
+	reassemble_chunks = false;
+	envelope = false;
+	deduplicate = false;
+	deduplicate_window = 30000;
+	deduplicate_max_entries = 10000;
+	nack_interval = 200;
+	nack_retries = 3;
 }
 
 bool MqttTopic::CheckValidity()
@@ -29,8 +37,18 @@ bool MqttTopic::CheckValidity()
 	if (broker_name.empty() || mqtt_payload_name.empty() || ecal_out_topic_name.empty())
 		return false;
 
-	// check if qos is in range [0,2]
-	if (qos < 0 && qos > 2)
+	// check if qos is in range [0,2], -1 means: use the default qos of the broker
+	if (qos < -1 || qos > 2)
+		return false;
+
+	if (input_format != "binary" && input_format != "json" && input_format != "cbor" && input_format != "msgpack")
+		return false;
+	// the payload is converted to (or filtered as) the static type, its descriptor comes from a file or via MQTT
+	if ((input_format != "binary" || !filter.empty()) && (static_ecal_type_name.empty() || (descriptor_file.empty() && mqtt_ecal_type_descriptor.empty())))
+		return false;
+	if (deduplicate_window <= 0 || deduplicate_max_entries <= 0)
+		return false;
+	if (!nack_topic.empty() && (!envelope || nack_interval <= 0 || nack_retries < 0 || nack_topic.find_first_of("+#") != std::string::npos))
 		return false;
 	return true;
 }
@@ -39,44 +57,100 @@ void operator>>(const YAML::Node& node, MqttTopic& mqtt_topic)
 {
 	try
 	{
+		// the first key is the name of the topic, the other keys are its settings
+		// every key is visited once, a lookup by key would search the whole map each time
+		bool is_name = true;
 		for (const auto& kv : node)
 		{
-			mqtt_topic.name = kv.first.as<std::string>();
-			break;
-		}
-		if (node["broker_name"])
-		{
-			if (node["broker_name"].as<std::string>().compare("null") != 0)
-				mqtt_topic.broker_name = node["broker_name"].as<std::string>();
-		}
-		if (node["mqtt_payload_name"])
-		{
-			if (node["mqtt_payload_name"].as<std::string>().compare("null") != 0)
-				mqtt_topic.mqtt_payload_name = node["mqtt_payload_name"].as<std::string>();
-		}
-		if (node["mqtt_ecal_type_name"])
-		{
-			if (node["mqtt_ecal_type_name"].as<std::string>().compare("null") != 0)
-				mqtt_topic.mqtt_ecal_type_name = node["mqtt_ecal_type_name"].as<std::string>();
-		}
-		if (node["static_ecal_type_name"])
-		{
-			if (node["static_ecal_type_name"].as<std::string>().compare("null") != 0)
-				mqtt_topic.static_ecal_type_name = node["static_ecal_type_name"].as<std::string>();
-		}
-		if (node["mqtt_ecal_type_descriptor"])
-		{
-			if (node["mqtt_ecal_type_descriptor"].as<std::string>().compare("null") != 0)
-				mqtt_topic.mqtt_ecal_type_descriptor = node["mqtt_ecal_type_descriptor"].as<std::string>();
-		}
-		if (node["ecal_out_topic_name"])
-		{
-			if (node["ecal_out_topic_name"].as<std::string>().compare("null") != 0)
-				mqtt_topic.ecal_out_topic_name = node["ecal_out_topic_name"].as<std::string>();
-		}
-		if (node["qos"])
-		{
-			mqtt_topic.qos = node["qos"].as<int>();
+			const std::string key = kv.first.as<std::string>();
+			if (is_name)
+			{
+				mqtt_topic.name = key;
+				is_name = false;
+				continue;
+			}
+			if (key == "broker_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.broker_name = kv.second.as<std::string>();
+			}
+			else if (key == "mqtt_payload_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.mqtt_payload_name = kv.second.as<std::string>();
+			}
+			else if (key == "mqtt_ecal_type_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.mqtt_ecal_type_name = kv.second.as<std::string>();
+			}
+			else if (key == "static_ecal_type_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.static_ecal_type_name = kv.second.as<std::string>();
+			}
+			else if (key == "mqtt_ecal_type_descriptor")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.mqtt_ecal_type_descriptor = kv.second.as<std::string>();
+			}
+			else if (key == "ecal_out_topic_name")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.ecal_out_topic_name = kv.second.as<std::string>();
+			}
+			else if (key == "qos")
+			{
+				mqtt_topic.qos = kv.second.as<int>();
+			}
+			else if (key == "input_format")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.input_format = kv.second.as<std::string>();
+			}
+			else if (key == "descriptor_file")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.descriptor_file = kv.second.as<std::string>();
+			}
+			else if (key == "filter")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.filter = kv.second.as<std::string>();
+			}
+			else if (key == "reassemble_chunks")
+			{
+				mqtt_topic.reassemble_chunks = kv.second.as<bool>();
+			}
+			else if (key == "envelope")
+			{
+				mqtt_topic.envelope = kv.second.as<bool>();
+			}
+			else if (key == "deduplicate")
+			{
+				mqtt_topic.deduplicate = kv.second.as<bool>();
+			}
+			else if (key == "deduplicate_window")
+			{
+				mqtt_topic.deduplicate_window = kv.second.as<int>();
+			}
+			else if (key == "deduplicate_max_entries")
+			{
+				mqtt_topic.deduplicate_max_entries = kv.second.as<int>();
+			}
+			else if (key == "nack_topic")
+			{
+				if (kv.second.as<std::string>().compare("null") != 0)
+					mqtt_topic.nack_topic = kv.second.as<std::string>();
+			}
+			else if (key == "nack_interval")
+			{
+				mqtt_topic.nack_interval = kv.second.as<int>();
+			}
+			else if (key == "nack_retries")
+			{
+				mqtt_topic.nack_retries = kv.second.as<int>();
+			}
 		}
 	}
 	catch (const YAML::BadConversion& e)
@@ -40,6 +40,25 @@ public:
 	std::string mqtt_ecal_type_descriptor;
 	std::string ecal_out_topic_name;
 	int qos;
+	// binary: the MQTT payload is published unchanged, json, cbor or msgpack: the payload is converted to protobuf
+	std::string input_format;
+	// serialized FileDescriptorSet of static_ecal_type_name, used to convert JSON payloads
+	std::string descriptor_file;
+	// predicate over the fields of the protobuf message, only matching messages are published to eCAL
+	std::string filter;
+	// the payloads are chunks sent by a route with chunk_size, they are reassembled before they are published to eCAL
+	bool reassemble_chunks;
+	// the payloads are in the envelope of a route with envelope, it is removed and its send time used for the eCAL message
+	bool envelope;
+	// messages received again (QoS 1 redeliveries) are not published to eCAL: by the sequence number of the envelope,
+	// otherwise by the hash of the payload within deduplicate_window ms, for at most deduplicate_max_entries payloads
+	bool deduplicate;
+	int deduplicate_window;
+	int deduplicate_max_entries;
+	// missing messages of the envelope are requested on this topic, again every nack_interval ms, at most nack_retries times
+	std::string nack_topic;
+	int nack_interval;
+	int nack_retries;
 };
 
 void operator>> (const YAML::Node& node, MqttTopic& mqtt_topic);
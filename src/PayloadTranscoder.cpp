@@ -0,0 +1,234 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "PayloadTranscoder.h"
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <chrono>
+
+// size of the buffer every worker reuses as the first block of its arena
+static const size_t ARENA_INITIAL_BLOCK_SIZE = 64 * 1024;
+
+PayloadTranscoder::PayloadTranscoder(size_t worker_count, size_t max_queue_size, const PublishCallback& publish, const MessageCallback& deliver)
+	: max_queue_size(max_queue_size)
+	, publish(publish)
+	, deliver(deliver)
+	, is_running(true)
+	, transcoded_count(0)
+	, busy_us(0)
+	, dropped_no_descriptor(0)
+	, dropped_queue_full(0)
+	, decode_errors(0)
+	, expired_count(0)
+{
+	for (size_t i = 0; i < std::max<size_t>(worker_count, 1); i++)
+	{
+		workers.emplace_back(new Worker());
+	}
+	for (auto& worker : workers)
+	{
+		worker->thread = std::thread(&PayloadTranscoder::workerLoop, this, std::ref(*worker));
+	}
+}
+
+PayloadTranscoder::~PayloadTranscoder()
+{
+	is_running = false;
+	for (auto& worker : workers)
+	{
+		{
+			std::lock_guard<std::mutex> lock(worker->mtx);
+			worker->cv.notify_all();
+		}
+		worker->thread.join();
+	}
+}
+
+void PayloadTranscoder::setDescriptor(const std::string& ecal_topic, const std::string& type_name, const std::string& descriptor)
+{
+	// the publishers register periodically, usually with the same descriptor
+	const size_t hash = std::hash<std::string>()(type_name) ^ std::hash<std::string>()(descriptor);
+	{
+		std::lock_guard<std::mutex> lock(schema_mtx);
+		auto topic_schema = schemas_by_topic.find(ecal_topic);
+		if (topic_schema != schemas_by_topic.end() && topic_schema->second.first == hash)
+		{
+			return;
+		}
+		auto cached_schema = schemas_by_hash.find(hash);
+		if (cached_schema != schemas_by_hash.end())
+		{
+			schemas_by_topic[ecal_topic] = { hash, cached_schema->second };
+			return;
+		}
+	}
+
+	// building the pool takes a while, so it is done without holding the lock
+	auto schema = ProtobufSchema::build(type_name, descriptor);
+	if (!schema)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(schema_mtx);
+	schemas_by_hash[hash] = schema;
+	schemas_by_topic[ecal_topic] = { hash, schema };
+}
+
+bool PayloadTranscoder::hasDescriptor(const std::string& ecal_topic) const
+{
+	std::lock_guard<std::mutex> lock(schema_mtx);
+	return schemas_by_topic.count(ecal_topic) > 0;
+}
+
+bool PayloadTranscoder::parseFormat(const std::string& name, OutputFormat& format)
+{
+	CborMsgpackCodec::Format binary_format;
+	if (name == "json")
+	{
+		format = JSON;
+		return true;
+	}
+	if (name == "sparkplug")
+	{
+		format = SPARKPLUG;
+		return true;
+	}
+	if (CborMsgpackCodec::parseFormat(name, binary_format))
+	{
+		format = binary_format == CborMsgpackCodec::CBOR ? CBOR : MESSAGEPACK;
+		return true;
+	}
+	return false;
+}
+
+bool PayloadTranscoder::transcode(const std::string& ecal_topic, const std::string& mqtt_topic, OutputFormat format, const void* payload, size_t size, int qos, bool retain,
+	const std::chrono::steady_clock::time_point& deadline)
+{
+	std::shared_ptr<const ProtobufSchema> schema;
+	{
+		std::lock_guard<std::mutex> lock(schema_mtx);
+		auto topic_schema = schemas_by_topic.find(ecal_topic);
+		if (topic_schema != schemas_by_topic.end())
+		{
+			schema = topic_schema->second.second;
+		}
+	}
+	if (!schema)
+	{
+		dropped_no_descriptor++;
+		return false;
+	}
+
+	// all messages of a topic go to the same worker to keep their order
+	Worker& worker = *workers[std::hash<std::string>()(ecal_topic) % workers.size()];
+	std::lock_guard<std::mutex> lock(worker.mtx);
+	if (max_queue_size > 0 && worker.jobs.size() >= max_queue_size)
+	{
+		dropped_queue_full++;
+		return false;
+	}
+	worker.jobs.push_back({ schema, mqtt_topic, format, std::string(static_cast<const char*>(payload), size), qos, retain, deadline });
+	worker.cv.notify_one();
+	return true;
+}
+
+void PayloadTranscoder::workerLoop(Worker& worker)
+{
+	std::vector<char> arena_block(ARENA_INITIAL_BLOCK_SIZE);
+	google::protobuf::ArenaOptions arena_options;
+	arena_options.initial_block      = arena_block.data();
+	arena_options.initial_block_size = arena_block.size();
+
+	google::protobuf::util::JsonPrintOptions print_options;
+	std::string output;
+
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(worker.mtx);
+			worker.cv.wait(lock, [this, &worker]() { return !is_running || !worker.jobs.empty(); });
+			if (!is_running)
+			{
+				return;
+			}
+			job = std::move(worker.jobs.front());
+			worker.jobs.pop_front();
+		}
+
+		auto started = std::chrono::steady_clock::now();
+		if (job.deadline <= started)
+		{
+			expired_count++;
+			continue;
+		}
+		bool converted = false;
+		bool delivered = false;
+		{
+			// the arena releases the whole message at once when it goes out of scope
+			google::protobuf::Arena arena(arena_options);
+			google::protobuf::Message* message = job.schema->prototype->New(&arena);
+			output.clear();
+			if (message->ParseFromString(job.payload))
+			{
+				if (job.format == SPARKPLUG)
+				{
+					// the message is only valid as long as the arena exists
+					deliver(job.mqtt_topic, *message);
+					converted = delivered = true;
+				}
+				else if (job.format == JSON)
+				{
+					converted = google::protobuf::util::MessageToJsonString(*message, &output, print_options).ok();
+				}
+				else
+				{
+					CborMsgpackCodec::encode(*message, job.format == CBOR ? CborMsgpackCodec::CBOR : CborMsgpackCodec::MESSAGEPACK, output);
+					converted = true;
+				}
+			}
+		}
+		busy_us += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+
+		if (!converted)
+		{
+			decode_errors++;
+			continue;
+		}
+		transcoded_count++;
+		if (!delivered)
+		{
+			publish(job.mqtt_topic, output, job.qos, job.retain, job.deadline);
+		}
+	}
+}
+
+std::string PayloadTranscoder::getStatistics() const
+{
+	const uint64_t count = transcoded_count;
+	const uint64_t busy = busy_us;
+	const uint64_t rate = busy > 0 ? count * 1000000 / busy : 0;
+	return std::to_string(count) + " converted (" + std::to_string(rate) + " msgs/s per worker)"
+		+ ", dropped: " + std::to_string(dropped_no_descriptor) + " without descriptor, "
+		+ std::to_string(dropped_queue_full) + " queue full, "
+		+ std::to_string(decode_errors) + " decode errors, "
+		+ std::to_string(expired_count) + " expired in the queue";
+}
@@ -0,0 +1,152 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "CborMsgpackCodec.h"
+#include "ProtobufSchema.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Converts protobuf encoded eCAL messages to JSON, CBOR or MessagePack on a pool of worker threads.
+ *
+ * The message types are not known at compile time. They are built from the
+ * descriptor (a serialized FileDescriptorSet) that every eCAL publisher
+ * registers for its topic. Descriptor pools are cached by the hash of the
+ * descriptor, so topics of the same type share one pool and message factory.
+ *
+ * The messages of a topic are always handled by the same worker, so they are
+ * published in the order they were received. Every worker decodes into an
+ * arena that starts on a reused buffer, so small messages do not allocate.
+ * Messages of the SPARKPLUG format are not converted here, the decoded message
+ * is handed to a callback that turns it into Sparkplug B metrics.
+ */
+class PayloadTranscoder
+{
+public:
+  enum OutputFormat
+  {
+    JSON,
+    CBOR,
+    MESSAGEPACK,
+    SPARKPLUG
+  };
+
+  /** Called by the workers with the converted message and the deadline it was queued with */
+  typedef std::function<void(const std::string& mqtt_topic, const std::string& payload, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)> PublishCallback;
+
+  /** Called by the workers with the decoded message of the SPARKPLUG format, the target is the Sparkplug device id */
+  typedef std::function<void(const std::string& target, const google::protobuf::Message& message)> MessageCallback;
+
+  /**
+   * @param name    "json", "cbor", "msgpack" or "sparkplug"
+   * @param format  receives the format
+   * @return false if the name is not a supported output format
+   */
+  static bool parseFormat(const std::string& name, OutputFormat& format);
+
+  /**
+   * @param worker_count    number of worker threads (at least 1)
+   * @param max_queue_size  messages waiting per worker, further messages are dropped
+   * @param publish         called for every converted message
+   * @param deliver         called for every decoded message of the SPARKPLUG format
+   */
+  PayloadTranscoder(size_t worker_count, size_t max_queue_size, const PublishCallback& publish, const MessageCallback& deliver);
+  ~PayloadTranscoder();
+
+  PayloadTranscoder(const PayloadTranscoder&) = delete;
+  PayloadTranscoder& operator=(const PayloadTranscoder&) = delete;
+
+  /**
+   * @brief Sets the message type of an eCAL topic
+   *
+   * @param ecal_topic  the eCAL topic name
+   * @param type_name   the eCAL type name, e.g. "proto:pb.People.Person"
+   * @param descriptor  the serialized FileDescriptorSet of the type
+   */
+  void setDescriptor(const std::string& ecal_topic, const std::string& type_name, const std::string& descriptor);
+
+  /** @return true if the message type of the topic is known */
+  bool hasDescriptor(const std::string& ecal_topic) const;
+
+  /**
+   * @brief Queues a message for the conversion
+   *
+   * @param mqtt_topic  the topic to publish the converted message to, the device id for the SPARKPLUG format
+   * @param deadline    the message is dropped instead of converted after this time
+   * @return false if the message was dropped, because the type of the topic is not known yet or the queue is full
+   */
+  bool transcode(const std::string& ecal_topic, const std::string& mqtt_topic, OutputFormat format, const void* payload, size_t size, int qos, bool retain,
+    const std::chrono::steady_clock::time_point& deadline = std::chrono::steady_clock::time_point::max());
+
+  /** @return number of converted, dropped and expired messages and the throughput per worker */
+  std::string getStatistics() const;
+
+private:
+  struct Job
+  {
+    std::shared_ptr<const ProtobufSchema> schema;
+    std::string                           mqtt_topic;
+    OutputFormat                          format;
+    std::string                           payload;
+    int                                   qos;
+    bool                                  retain;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  struct Worker
+  {
+    std::thread             thread;
+    std::mutex              mtx;
+    std::condition_variable cv;
+    std::deque<Job>         jobs;
+  };
+
+  void workerLoop(Worker& worker);
+
+  const size_t                                             max_queue_size;
+  const PublishCallback                                    publish;
+  const MessageCallback                                    deliver;
+
+  mutable std::mutex                                       schema_mtx;
+  std::unordered_map<size_t, std::shared_ptr<const ProtobufSchema>> schemas_by_hash;
+  std::unordered_map<std::string, std::pair<size_t, std::shared_ptr<const ProtobufSchema>>> schemas_by_topic;
+
+  std::vector<std::unique_ptr<Worker>>                     workers;
+  std::atomic<bool>                                        is_running;
+
+  std::atomic<uint64_t>                                    transcoded_count;
+  std::atomic<uint64_t>                                    busy_us;
+  std::atomic<uint64_t>                                    dropped_no_descriptor;
+  std::atomic<uint64_t>                                    dropped_queue_full;
+  std::atomic<uint64_t>                                    decode_errors;
+  std::atomic<uint64_t>                                    expired_count;
+};
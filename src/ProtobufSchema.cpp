@@ -0,0 +1,82 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "ProtobufSchema.h"
+
+#include <google/protobuf/descriptor.pb.h>
+
+#include <functional>
+#include <map>
+#include <set>
+
+std::shared_ptr<const ProtobufSchema> ProtobufSchema::build(const std::string& type_name, const std::string& descriptor)
+{
+	google::protobuf::FileDescriptorSet file_set;
+	if (!file_set.ParseFromString(descriptor))
+	{
+		return nullptr;
+	}
+
+	// the files have to be added after the files they import
+	std::map<std::string, const google::protobuf::FileDescriptorProto*> files;
+	for (auto const& file : file_set.file())
+	{
+		files[file.name()] = &file;
+	}
+	auto schema = std::make_shared<ProtobufSchema>();
+	std::set<std::string> added_files;
+	std::function<bool(const google::protobuf::FileDescriptorProto&)> addFile = [&](const google::protobuf::FileDescriptorProto& file) -> bool
+	{
+		if (!added_files.insert(file.name()).second)
+		{
+			return true;
+		}
+		for (auto const& dependency : file.dependency())
+		{
+			auto dependency_file = files.find(dependency);
+			if (dependency_file == files.end() || !addFile(*dependency_file->second))
+			{
+				return false;
+			}
+		}
+		return schema->pool.BuildFile(file) != NULL;
+	};
+	for (auto const& file : file_set.file())
+	{
+		if (!addFile(file))
+		{
+			return nullptr;
+		}
+	}
+
+	// eCAL prefixes the type name with the serialization format, e.g. "proto:pb.People.Person"
+	std::string message_name = type_name;
+	auto separator = message_name.find(':');
+	if (separator != std::string::npos)
+	{
+		message_name = message_name.substr(separator + 1);
+	}
+	schema->descriptor = schema->pool.FindMessageTypeByName(message_name);
+	if (schema->descriptor == NULL)
+	{
+		return nullptr;
+	}
+	schema->prototype = schema->factory.GetPrototype(schema->descriptor);
+	return schema;
+}
@@ -0,0 +1,54 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/dynamic_message.h>
+
+#include <memory>
+#include <string>
+
+/**
+ * @brief A protobuf message type that is only known at runtime.
+ *
+ * The type is built from a descriptor as eCAL registers it for a topic: a
+ * serialized FileDescriptorSet that contains the file of the type and all
+ * files it imports.
+ */
+struct ProtobufSchema
+{
+  google::protobuf::DescriptorPool        pool;
+  google::protobuf::DynamicMessageFactory factory;
+  const google::protobuf::Descriptor*     descriptor;
+  const google::protobuf::Message*        prototype;
+
+  ProtobufSchema() : factory(&pool), descriptor(NULL), prototype(NULL) {}
+
+  ProtobufSchema(const ProtobufSchema&) = delete;
+  ProtobufSchema& operator=(const ProtobufSchema&) = delete;
+
+  /**
+   * @param type_name   the eCAL type name, e.g. "proto:pb.People.Person" (the prefix is optional)
+   * @param descriptor  the serialized FileDescriptorSet
+   *
+   * @return the schema, or nullptr if the descriptor cannot be parsed or does not contain the type
+   */
+  static std::shared_ptr<const ProtobufSchema> build(const std::string& type_name, const std::string& descriptor);
+};
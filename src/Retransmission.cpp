@@ -0,0 +1,266 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "Retransmission.h"
+
+#include <algorithm>
+
+static const uint8_t MAGIC[2] = { 0xEC, 0x4E };
+static const uint8_t VERSION  = 1;
+
+// missing messages tracked at most by a receiving route, and requested at most by one NACK
+static const size_t MAX_MISSING = 4096;
+static const size_t MAX_RANGES  = 256;
+
+static void writeUint32(uint32_t value, std::string& output)
+{
+	const char bytes[4] = { static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8), static_cast<char>(value) };
+	output.append(bytes, sizeof(bytes));
+}
+
+static void writeUint64(uint64_t value, std::string& output)
+{
+	writeUint32(static_cast<uint32_t>(value >> 32), output);
+	writeUint32(static_cast<uint32_t>(value), output);
+}
+
+static uint32_t readUint32(const uint8_t* data)
+{
+	return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+static uint64_t readUint64(const uint8_t* data)
+{
+	return (static_cast<uint64_t>(readUint32(data)) << 32) | readUint32(data + 4);
+}
+
+void Nack::write(std::string& output) const
+{
+	output.clear();
+	output.reserve(HEADER_SIZE + ranges.size() * 16);
+	output.push_back(static_cast<char>(MAGIC[0]));
+	output.push_back(static_cast<char>(MAGIC[1]));
+	output.push_back(static_cast<char>(VERSION));
+	output.push_back(0);
+	writeUint32(sender_id, output);
+	for (auto const& range : ranges)
+	{
+		writeUint64(range.first, output);
+		writeUint64(range.second, output);
+	}
+}
+
+bool Nack::read(const char* data, size_t size)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	if (size < HEADER_SIZE || (size - HEADER_SIZE) % 16 != 0 || bytes[0] != MAGIC[0] || bytes[1] != MAGIC[1] || bytes[2] != VERSION)
+	{
+		return false;
+	}
+	sender_id = readUint32(bytes + 4);
+	ranges.clear();
+	for (size_t offset = HEADER_SIZE; offset < size; offset += 16)
+	{
+		const uint64_t first = readUint64(bytes + offset);
+		const uint64_t last  = readUint64(bytes + offset + 8);
+		if (last < first)
+		{
+			return false;
+		}
+		ranges.emplace_back(first, last);
+	}
+	return true;
+}
+
+RetransmitBuffer::RetransmitBuffer()
+	: first_sequence(0)
+	, bytes(0)
+	, max_bytes(0)
+	, retransmitted_count(0)
+	, unavailable_count(0)
+{
+}
+
+void RetransmitBuffer::setLimit(size_t max_bytes_)
+{
+	max_bytes = max_bytes_;
+}
+
+void RetransmitBuffer::add(uint64_t sequence, const char* data, size_t size)
+{
+	if (messages.empty() || sequence != first_sequence + messages.size())
+	{
+		// the first message, or the sequence of the route started again
+		messages.clear();
+		bytes          = 0;
+		first_sequence = sequence;
+	}
+	messages.emplace_back(data, size);
+	bytes += size;
+	while (!messages.empty() && bytes > max_bytes)
+	{
+		bytes -= messages.front().size();
+		messages.pop_front();
+		first_sequence++;
+	}
+}
+
+void RetransmitBuffer::collect(const Nack& nack, std::vector<std::string>& output)
+{
+	// the ranges are clamped to the buffer, so a corrupt NACK cannot make us loop over 2^64 sequence numbers
+	std::vector<bool> is_collected(messages.size(), false);
+	for (auto const& range : nack.ranges)
+	{
+		// sequence numbers after the buffer were never sent, only those before it count as no longer buffered
+		if (range.first < first_sequence)
+		{
+			unavailable_count += std::min(range.second, first_sequence - 1) - range.first + 1;
+		}
+		if (messages.empty() || range.second < first_sequence || range.first >= first_sequence + messages.size())
+		{
+			continue;
+		}
+		const uint64_t first = std::max(range.first, first_sequence);
+		const uint64_t last  = std::min<uint64_t>(range.second, first_sequence + messages.size() - 1);
+		for (uint64_t sequence = first; sequence <= last; sequence++)
+		{
+			const size_t index = static_cast<size_t>(sequence - first_sequence);
+			if (!is_collected[index])
+			{
+				is_collected[index] = true;
+				output.push_back(messages[index]);
+				retransmitted_count++;
+			}
+		}
+	}
+}
+
+std::string RetransmitBuffer::toString() const
+{
+	return std::to_string(messages.size()) + " messages buffered (" + std::to_string(bytes) + " bytes), "
+		+ std::to_string(retransmitted_count) + " retransmitted, "
+		+ std::to_string(unavailable_count) + " requested but no longer buffered";
+}
+
+NackTracker::NackTracker()
+	: interval(0)
+	, retries(0)
+	, has_sender(false)
+	, sender_id(0)
+	, highest_sequence(0)
+	, nack_count(0)
+	, requested_count(0)
+	, recovered_count(0)
+	, given_up_count(0)
+{
+}
+
+void NackTracker::setLimits(std::chrono::milliseconds interval_, int retries_)
+{
+	interval = interval_;
+	retries  = retries_;
+}
+
+void NackTracker::received(uint32_t sender_id_, uint64_t sequence)
+{
+	if (!has_sender || sender_id_ != sender_id)
+	{
+		// the first message, or the sending bridge was restarted: its earlier messages cannot be requested any more
+		given_up_count  += missing.size();
+		missing.clear();
+		has_sender       = true;
+		sender_id        = sender_id_;
+		highest_sequence = sequence;
+		return;
+	}
+	if (sequence <= highest_sequence)
+	{
+		auto entry = missing.find(sequence);
+		if (entry != missing.end())
+		{
+			recovered_count++;
+			missing.erase(entry);
+		}
+		return;
+	}
+	// a gap larger than the limit is only tracked for its most recent messages
+	uint64_t first_missing = highest_sequence + 1;
+	if (sequence - first_missing > MAX_MISSING)
+	{
+		given_up_count += sequence - first_missing - MAX_MISSING;
+		first_missing   = sequence - MAX_MISSING;
+	}
+	for (uint64_t missing_sequence = first_missing; missing_sequence < sequence; missing_sequence++)
+	{
+		missing[missing_sequence] = { std::chrono::steady_clock::time_point(), 0 };
+	}
+	while (missing.size() > MAX_MISSING)
+	{
+		given_up_count++;
+		missing.erase(missing.begin());
+	}
+	highest_sequence = sequence;
+}
+
+bool NackTracker::getDueNack(std::chrono::steady_clock::time_point now, Nack& nack)
+{
+	nack.sender_id = sender_id;
+	nack.ranges.clear();
+	for (auto entry = missing.begin(); entry != missing.end();)
+	{
+		if (entry->second.due > now)
+		{
+			++entry;
+			continue;
+		}
+		if (entry->second.requests > retries)
+		{
+			given_up_count++;
+			entry = missing.erase(entry);
+			continue;
+		}
+		if (!nack.ranges.empty() && nack.ranges.back().second + 1 == entry->first)
+		{
+			nack.ranges.back().second = entry->first;
+		}
+		else if (nack.ranges.size() < MAX_RANGES)
+		{
+			nack.ranges.emplace_back(entry->first, entry->first);
+		}
+		else
+		{
+			// requested with the next NACK
+			break;
+		}
+		entry->second.due = now + interval;
+		entry->second.requests++;
+		requested_count++;
+		++entry;
+	}
+	nack_count += nack.ranges.empty() ? 0 : 1;
+	return !nack.ranges.empty();
+}
+
+std::string NackTracker::toString() const
+{
+	return std::to_string(missing.size()) + " missing, "
+		+ std::to_string(nack_count) + " NACKs sent for " + std::to_string(requested_count) + " messages, "
+		+ std::to_string(recovered_count) + " recovered, "
+		+ std::to_string(given_up_count) + " given up";
+}
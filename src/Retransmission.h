@@ -0,0 +1,133 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A request to send missing messages of a route with envelope again.
+ *
+ * 8 bytes: the magic bytes 0xEC 0x4E, the version 1, a reserved byte and the
+ * big endian 32 bit sender id of the envelopes, followed by the ranges of
+ * missing sequence numbers (two big endian 64 bit values each, first and last).
+ */
+struct Nack
+{
+  static const size_t HEADER_SIZE = 8;
+
+  uint32_t                                   sender_id;
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+
+  void write(std::string& output) const;
+
+  /** @return false if the data is not a valid NACK */
+  bool read(const char* data, size_t size);
+};
+
+/**
+ * @brief The last messages sent by a route with nack_topic, including their envelope.
+ *
+ * The sequence numbers of the messages are consecutive, the oldest messages
+ * are dropped once the buffer exceeds its size in bytes. The class is not
+ * thread safe, the owner has to lock.
+ */
+class RetransmitBuffer
+{
+public:
+  RetransmitBuffer();
+
+  void setLimit(size_t max_bytes);
+
+  void add(uint64_t sequence, const char* data, size_t size);
+
+  /**
+   * @brief Collects the buffered messages requested by a NACK, each at most once per NACK
+   *
+   * The requested messages no longer (or not yet) buffered are counted.
+   */
+  void collect(const Nack& nack, std::vector<std::string>& output);
+
+  /** @return buffered messages and bytes, retransmitted and requested but no longer buffered messages */
+  std::string toString() const;
+
+private:
+  std::deque<std::string> messages;
+  uint64_t                first_sequence;
+  size_t                  bytes;
+  size_t                  max_bytes;
+  uint64_t                retransmitted_count;
+  uint64_t                unavailable_count;
+};
+
+/**
+ * @brief The missing messages of a route with nack_topic on the receiving side.
+ *
+ * A gap in the sequence numbers is requested at once and again every
+ * interval until the messages arrive or the retries are used up. At most
+ * 4096 missing messages are tracked, the oldest are given up first. The
+ * class is not thread safe, the owner has to lock.
+ */
+class NackTracker
+{
+public:
+  NackTracker();
+
+  void setLimits(std::chrono::milliseconds interval, int retries);
+
+  /** @brief Updates the missing messages with the sequence number of a received message */
+  void received(uint32_t sender_id, uint64_t sequence);
+
+  /**
+   * @brief Collects the missing messages to request now
+   *
+   * @return false if nothing is to be requested
+   */
+  bool getDueNack(std::chrono::steady_clock::time_point now, Nack& nack);
+
+  /** @return missing messages, NACKs sent, recovered and given up messages */
+  std::string toString() const;
+
+private:
+  struct Missing
+  {
+    std::chrono::steady_clock::time_point due;
+    int                                   requests;
+  };
+
+  std::chrono::milliseconds               interval;
+  int                                     retries;
+
+  bool                                    has_sender;
+  uint32_t                                sender_id;
+  uint64_t                                highest_sequence;
+  std::map<uint64_t, Missing>             missing;   // by sequence number
+
+  uint64_t                                nack_count;
+  uint64_t                                requested_count;
+  uint64_t                                recovered_count;
+  uint64_t                                given_up_count;
+};
@@ -0,0 +1,494 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "SendScheduler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// QoS 0 messages (or chunks) handed to mosquitto but not written yet, a message of a higher priority or another route waits for at most these
+static const size_t SEND_WINDOW = 4;
+
+static const char* const PRIORITY_NAMES[] = { "high", "normal", "low" };
+
+SendScheduler::Priority SendScheduler::parsePriority(const std::string& name)
+{
+	auto priority = std::find(std::begin(PRIORITY_NAMES), std::end(PRIORITY_NAMES), name);
+	return priority != std::end(PRIORITY_NAMES) ? static_cast<Priority>(priority - std::begin(PRIORITY_NAMES)) : NORMAL;
+}
+
+SendScheduler::SendScheduler(size_t queue_limit, uint32_t sender_id, const Output& output)
+	: queue_limit(queue_limit)
+	, sender_id(sender_id)
+	, output(output)
+	, is_used(false)
+	, has_queued_routes(false)
+	, has_priority_routes(false)
+	, queue_bytes(0)
+	, chunked_message_count(0)
+	, chunk_count(0)
+	, dropped_chunked_count(0)
+	, expired_count(0)
+	, is_running(false)
+{
+}
+
+SendScheduler::~SendScheduler()
+{
+	stop();
+}
+
+void SendScheduler::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		is_running = false;
+		cv.notify_all();
+	}
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void SendScheduler::setRoutes(const std::map<std::string, Route>& routes_)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	routes = routes_;
+	has_queued_routes   = std::any_of(routes.begin(), routes.end(), [](const std::pair<const std::string, Route>& route)
+		{
+			return route.second.chunk_size > 0 || route.second.priority != NORMAL || route.second.weight != 1;
+		});
+	has_priority_routes = std::any_of(routes.begin(), routes.end(), [](const std::pair<const std::string, Route>& route) { return route.second.priority != NORMAL; });
+	updateLocked();
+}
+
+void SendScheduler::setBandwidthLimit(uint64_t bits_per_second, uint64_t burst)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	bandwidth.setRate(bits_per_second / 8, burst);
+	updateLocked();
+	cv.notify_all();
+}
+
+TokenBucket& SendScheduler::getBandwidth()
+{
+	return bandwidth;
+}
+
+bool SendScheduler::isUsed() const
+{
+	return is_used;
+}
+
+void SendScheduler::updateLocked()
+{
+	is_used = has_queued_routes || bandwidth.isLimited();
+	if (is_used && !is_running)
+	{
+		is_running = true;
+		thread = std::thread(&SendScheduler::sendLoop, this);
+	}
+}
+
+void SendScheduler::queue(const std::string& topic, const void* payload, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	Route route = { std::string(), NORMAL, 0, 1 };
+	auto topic_route = routes.find(topic);
+	if (topic_route != routes.end())
+	{
+		route = topic_route->second;
+	}
+	// under overload the lowest priority is dropped first
+	for (size_t lower = priority_classes.size() - 1; lower > static_cast<size_t>(route.priority) && queue_bytes + size > queue_limit; lower--)
+	{
+		shedMessagesLocked(priority_classes[lower], queue_bytes + size - queue_limit);
+	}
+	if (queue_bytes + size > queue_limit)
+	{
+		priority_classes[route.priority].shed_count++;
+		topic_states[topic].dropped_bytes += size;
+		dropped_chunked_count += route.chunk_size > 0 ? 1 : 0;
+		return;
+	}
+
+	QueuedMessage message;
+	message.payload.assign(static_cast<const char*>(payload), size);
+	message.qos        = qos;
+	message.retain     = retain;
+	message.chunk_size = route.chunk_size;
+	message.weight     = route.weight;
+	message.finish     = 0;
+	message.queued     = std::chrono::steady_clock::now();
+	message.deadline   = deadline;
+	if (route.chunk_size > 0)
+	{
+		message.header.sender_id  = sender_id;
+		message.header.message_id = chunk_sequences[topic]++;
+		message.header.index      = 0;
+		message.header.count      = static_cast<uint32_t>(std::max<size_t>(1, (size + route.chunk_size - 1) / route.chunk_size));
+		message.header.total_size = static_cast<uint32_t>(size);
+		message.header.offset     = 0;
+	}
+	priority_classes[route.priority].queues[topic].push_back(std::move(message));
+	queue_bytes += size;
+	cv.notify_all();
+}
+
+void SendScheduler::onPublished(int mid)
+{
+	if (!is_running)
+	{
+		return;
+	}
+	// an acknowledge may let mosquitto send a queued QoS 1/2 message as well
+	std::lock_guard<std::mutex> lock(mtx);
+	sent_in_flight.erase(mid);
+	cv.notify_all();
+}
+
+void SendScheduler::onDisconnected()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	sent_in_flight.clear();
+}
+
+void SendScheduler::wake()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	cv.notify_all();
+}
+
+void SendScheduler::dropExpiredLocked()
+{
+	const auto now = std::chrono::steady_clock::now();
+	for (auto& priority_class : priority_classes)
+	{
+		for (auto queue = priority_class.queues.begin(); queue != priority_class.queues.end();)
+		{
+			for (auto message = queue->second.begin(); message != queue->second.end();)
+			{
+				if (message->deadline > now)
+				{
+					++message;
+					continue;
+				}
+				// a chunked message partly sent is not completed, the receiver drops it after its chunk_timeout
+				expired_count++;
+				topic_states[queue->first].dropped_bytes += message->payload.size();
+				dropped_chunked_count += message->chunk_size > 0 ? 1 : 0;
+				queue_bytes -= message->payload.size();
+				message = queue->second.erase(message);
+			}
+			if (queue->second.empty())
+			{
+				queue = priority_class.queues.erase(queue);
+			}
+			else
+			{
+				++queue;
+			}
+		}
+	}
+}
+
+void SendScheduler::shedMessagesLocked(PriorityClass& priority_class, size_t bytes)
+{
+	size_t freed = 0;
+	while (freed < bytes)
+	{
+		// the oldest message of all topics, the rest of a message already partly sent would be useless without its first chunks
+		std::map<std::string, std::deque<QueuedMessage>>::iterator oldest_queue = priority_class.queues.end();
+		std::deque<QueuedMessage>::iterator oldest;
+		for (auto queue = priority_class.queues.begin(); queue != priority_class.queues.end(); ++queue)
+		{
+			auto candidate = queue->second.begin();
+			if (candidate != queue->second.end() && candidate->header.index > 0 && candidate->chunk_size > 0)
+			{
+				++candidate;
+			}
+			if (candidate != queue->second.end() && (oldest_queue == priority_class.queues.end() || candidate->queued < oldest->queued))
+			{
+				oldest_queue = queue;
+				oldest       = candidate;
+			}
+		}
+		if (oldest_queue == priority_class.queues.end())
+		{
+			return;
+		}
+		freed       += oldest->payload.size();
+		queue_bytes -= oldest->payload.size();
+		dropped_chunked_count += oldest->chunk_size > 0 ? 1 : 0;
+		topic_states[oldest_queue->first].dropped_bytes += oldest->payload.size();
+		priority_class.shed_count++;
+		oldest_queue->second.erase(oldest);
+		if (oldest_queue->second.empty())
+		{
+			priority_class.queues.erase(oldest_queue);
+		}
+	}
+}
+
+void SendScheduler::dropAllLocked()
+{
+	for (auto& priority_class : priority_classes)
+	{
+		for (auto const& queue : priority_class.queues)
+		{
+			priority_class.shed_count += queue.second.size();
+			for (auto const& message : queue.second)
+			{
+				topic_states[queue.first].dropped_bytes += message.payload.size();
+			}
+			dropped_chunked_count += std::count_if(queue.second.begin(), queue.second.end(), [](const QueuedMessage& message) { return message.chunk_size > 0; });
+		}
+		priority_class.queues.clear();
+	}
+	queue_bytes = 0;
+}
+
+void SendScheduler::popLocked(PriorityClass& priority_class, std::map<std::string, std::deque<QueuedMessage>>::iterator queue)
+{
+	queue_bytes -= queue->second.front().payload.size();
+	queue->second.pop_front();
+	if (queue->second.empty())
+	{
+		priority_class.queues.erase(queue);
+	}
+}
+
+bool SendScheduler::hasQueuedMessagesLocked() const
+{
+	return std::any_of(priority_classes.begin(), priority_classes.end(), [](const PriorityClass& priority_class) { return !priority_class.queues.empty(); });
+}
+
+bool SendScheduler::isSendWindowOpenLocked() const
+{
+	// QoS 1/2 messages beyond max_inflight_messages wait inside mosquitto
+	return sent_in_flight.size() < SEND_WINDOW && output.is_idle();
+}
+
+void SendScheduler::sendLoop()
+{
+	std::string chunk;
+	while (is_running == true)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait_for(lock, std::chrono::milliseconds(500), [&]()
+			{
+				return is_running == false
+					|| (hasQueuedMessagesLocked() && (!output.is_connected() || output.is_storing() || isSendWindowOpenLocked()));
+			});
+		if (is_running == false || !hasQueuedMessagesLocked())
+		{
+			continue;
+		}
+		const bool use_store = output.store && output.is_storing();
+		if (!output.is_connected() && !output.store)
+		{
+			// like the messages sent directly, they are not kept without a message store
+			dropAllLocked();
+			continue;
+		}
+		if (!use_store && !isSendWindowOpenLocked())
+		{
+			continue;
+		}
+
+		dropExpiredLocked();
+		if (!hasQueuedMessagesLocked())
+		{
+			continue;
+		}
+
+		// strict priority, within a priority the message (or chunk) with the smallest finish tag
+		PriorityClass& current = *std::find_if(priority_classes.begin(), priority_classes.end(), [](const PriorityClass& priority_class) { return !priority_class.queues.empty(); });
+		auto   queue = current.queues.end();
+		double finish = 0;
+		for (auto candidate = current.queues.begin(); candidate != current.queues.end(); ++candidate)
+		{
+			QueuedMessage& front = candidate->second.front();
+			if (front.finish == 0)
+			{
+				// tagging it again later with the virtual time advanced by other topics would starve the lighter topics
+				const size_t length = front.chunk_size > 0 ? std::min(front.chunk_size, front.payload.size() - front.header.offset) + ChunkHeader::SIZE : front.payload.size();
+				front.finish = std::max(current.virtual_time, topic_states[candidate->first].finish)
+					+ static_cast<double>(publishPacketSize(candidate->first, length)) / front.weight;
+			}
+			if (queue == current.queues.end() || front.finish < finish)
+			{
+				queue  = candidate;
+				finish = front.finish;
+			}
+		}
+		QueuedMessage& message = queue->second.front();
+		const char* data   = message.payload.data();
+		size_t      size   = message.payload.size();
+		size_t      length = size;
+		if (message.chunk_size > 0)
+		{
+			length = std::min(message.chunk_size, message.payload.size() - message.header.offset);
+			message.header.write(message.payload.data() + message.header.offset, length, chunk);
+			data = chunk.data();
+			size = chunk.size();
+		}
+		const size_t packet_size = publishPacketSize(queue->first, size);
+		if (!use_store)
+		{
+			auto wait = bandwidth.take(packet_size);
+			if (wait.count() > 0)
+			{
+				// woken early by new messages, which may have a higher priority
+				cv.wait_for(lock, wait);
+				continue;
+			}
+		}
+
+		if (use_store)
+		{
+			output.store(queue->first, data, size, message.qos, message.retain, message.deadline);
+		}
+		else
+		{
+			int mid      = 0;
+			int sent_qos = message.qos;
+			const PublishResult result = output.publish(queue->first, data, size, message.qos, message.retain, message.deadline, mid, sent_qos);
+			if (result != PUBLISH_SENT)
+			{
+				// only sent bytes are paid for, also when the message is sent again
+				bandwidth.refund(packet_size);
+			}
+			if (result == PUBLISH_RETRY)
+			{
+				// e.g. the queue limit is reached, the message is sent again
+				lock.unlock();
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			if (result != PUBLISH_SENT)
+			{
+				// expired or rejected, the remaining chunks are dropped as well
+				if (message.chunk_size > 0)
+				{
+					dropped_chunked_count++;
+				}
+				topic_states[queue->first].dropped_bytes += message.payload.size();
+				popLocked(current, queue);
+				continue;
+			}
+			// a message downgraded to QoS 0 is not tracked by the flow control, so it counts against the send window
+			if (sent_qos == 0)
+			{
+				sent_in_flight.insert(mid);
+			}
+		}
+		TopicState& state = topic_states[queue->first];
+		state.finish        = finish;
+		state.sent_bytes   += packet_size;
+		current.virtual_time = finish;
+
+		if (message.chunk_size > 0)
+		{
+			chunk_count++;
+			message.finish = 0;
+			message.header.index++;
+			message.header.offset += static_cast<uint32_t>(length);
+			if (message.header.index < message.header.count)
+			{
+				continue;
+			}
+			chunked_message_count++;
+		}
+		const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - message.queued).count();
+		current.sent_count++;
+		current.latency.add(latency);
+		state.latency.add(latency);
+		popLocked(current, queue);
+	}
+}
+
+uint64_t SendScheduler::getExpiredCount() const
+{
+	return expired_count;
+}
+
+std::string SendScheduler::getChunkStatistics() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (chunk_count == 0 && dropped_chunked_count == 0 && std::none_of(routes.begin(), routes.end(), [](const std::pair<const std::string, Route>& route) { return route.second.chunk_size > 0; }))
+	{
+		return std::string();
+	}
+	return std::to_string(chunked_message_count) + " messages sent in " + std::to_string(chunk_count) + " chunks, "
+		+ std::to_string(dropped_chunked_count) + " dropped";
+}
+
+std::map<std::string, std::string> SendScheduler::getPriorityStatistics() const
+{
+	std::map<std::string, std::string> statistics;
+	std::lock_guard<std::mutex> lock(mtx);
+	if (!has_priority_routes)
+	{
+		return statistics;
+	}
+	for (size_t priority = 0; priority < priority_classes.size(); priority++)
+	{
+		const PriorityClass& priority_class = priority_classes[priority];
+		size_t queued_count = 0;
+		for (auto const& queue : priority_class.queues)
+		{
+			queued_count += queue.second.size();
+		}
+		statistics[PRIORITY_NAMES[priority]] = std::to_string(priority_class.sent_count) + " sent, " + std::to_string(queued_count) + " queued, "
+			+ std::to_string(priority_class.shed_count) + " dropped, time in queue: " + priority_class.latency.toString();
+	}
+	return statistics;
+}
+
+std::map<std::string, std::string> SendScheduler::getShapingStatistics() const
+{
+	std::map<std::string, std::string> statistics;
+	if (!is_used)
+	{
+		return statistics;
+	}
+	std::lock_guard<std::mutex> lock(mtx);
+	uint64_t total_bytes = 0;
+	for (auto const& state : topic_states)
+	{
+		total_bytes += state.second.sent_bytes;
+	}
+	for (auto const& route : routes)
+	{
+		auto state = topic_states.find(route.first);
+		if (state == topic_states.end())
+		{
+			statistics[route.second.name] = "nothing sent yet";
+			continue;
+		}
+		std::ostringstream share;
+		share << std::fixed << std::setprecision(1) << (total_bytes > 0 ? 100.0 * static_cast<double>(state->second.sent_bytes) / static_cast<double>(total_bytes) : 0.0) << "%";
+		statistics[route.second.name] = share.str() + " of the bytes sent (" + std::to_string(state->second.sent_bytes) + "), "
+			+ std::to_string(state->second.dropped_bytes) + " bytes dropped, time in queue: " + state->second.latency.toString();
+	}
+	return statistics;
+}
@@ -0,0 +1,248 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "ChunkReassembler.h"
+#include "Statistics.h"
+#include "TokenBucket.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+/** @brief Result of a publish to MQTT */
+enum PublishResult
+{
+  PUBLISH_SENT,     // handed to mosquitto
+  PUBLISH_EXPIRED,  // the deadline of the message has passed
+  PUBLISH_RETRY,    // not connected, out of memory or the max_queued_messages limit is reached, the message can be sent again
+  PUBLISH_FAILED    // rejected by mosquitto, e.g. too large or an invalid topic, sending it again fails as well
+};
+
+/** @return bytes of a PUBLISH packet: fixed header (5 bytes at most), topic length, topic, packet identifier and payload */
+inline size_t publishPacketSize(const std::string& topic, size_t payload_size)
+{
+  return 5 + 2 + topic.size() + 2 + payload_size;
+}
+
+/**
+ * @brief Sends the messages to MQTT by priority, shares the bandwidth between the topics and splits large messages into chunks.
+ *
+ * The messages are queued by the callers and sent by the thread of the
+ * scheduler, the highest priority first. Within a priority the topics share
+ * the bandwidth by their weight (self-clocked fair queuing): the next message
+ * (or chunk) is the one with the smallest finish tag. A message is tagged
+ * once, when it becomes the head of its topic queue, with
+ * max(virtual time, finish tag of the topic) + size / weight, so a backlogged
+ * topic continues from its own last finish tag.
+ *
+ * Only a few messages are handed to mosquitto at a time, so a message of a
+ * higher priority or of another route does not wait behind all messages (or
+ * chunks of a large message) already queued. The thread is started once a
+ * route or the bandwidth limit needs the queue.
+ */
+class SendScheduler
+{
+public:
+  enum Priority
+  {
+    HIGH,
+    NORMAL,
+    LOW
+  };
+
+  /** @brief How the messages of an MQTT topic are queued */
+  struct Route
+  {
+    std::string                             name;
+    Priority                                priority;
+    size_t                                  chunk_size;   // 0 if the messages are sent in one piece
+    int                                     weight;
+  };
+
+  /**
+   * @brief Where the queued messages go, all functions are called by the send thread
+   *
+   * publish receives the message id and the QoS the message was sent with.
+   * store is empty without a message store; then the queued messages are
+   * dropped while the broker is not connected.
+   */
+  struct Output
+  {
+    std::function<PublishResult(const std::string& topic, const char* data, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline, int& mid, int& sent_qos)> publish;
+    std::function<void(const std::string& topic, const char* data, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)> store;
+    std::function<bool()>                   is_connected;
+    std::function<bool()>                   is_storing;   // the messages have to be appended to the store, e.g. while older messages wait there
+    std::function<bool()>                   is_idle;      // mosquitto has no QoS 1/2 message waiting for an in-flight slot
+  };
+
+  /** @return the priority of its name ("high", "normal" or "low"), NORMAL for unknown names */
+  static Priority parsePriority(const std::string& name);
+
+  /**
+   * @param queue_limit  bytes the queue holds at most, messages of lower priorities are dropped first
+   * @param sender_id    written to the chunk headers
+   * @param output       where the messages go
+   */
+  SendScheduler(size_t queue_limit, uint32_t sender_id, const Output& output);
+  ~SendScheduler();
+
+  SendScheduler(const SendScheduler&) = delete;
+  SendScheduler& operator=(const SendScheduler&) = delete;
+
+  /**
+   * @brief Replaces the routes, other topics are sent in one piece with normal priority
+   *
+   * Messages already queued keep their priority and are still sent in chunks of their old size.
+   */
+  void setRoutes(const std::map<std::string, Route>& routes);
+
+  /**
+   * @param bits_per_second  0 means unlimited
+   * @param burst            bytes that may be sent at once after an idle time
+   */
+  void setBandwidthLimit(uint64_t bits_per_second, uint64_t burst);
+
+  /** @return the bandwidth limit, shared with the replay of the message store */
+  TokenBucket& getBandwidth();
+
+  /** @return true if the messages have to be queued, because a route has a chunk_size, a priority or a weight, or the bandwidth is limited */
+  bool isUsed() const;
+
+  /**
+   * @brief Queues the message with the priority and chunk_size of its route
+   *
+   * If the queue is full, messages of lower priorities are dropped to make room,
+   * otherwise the message itself is dropped.
+   */
+  void queue(const std::string& topic, const void* payload, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline);
+
+  /** @brief Called once mosquitto has written a QoS 0 message or a QoS 1/2 message was acknowledged */
+  void onPublished(int mid);
+
+  /** @brief Forgets the QoS 0 messages mosquitto has not written, it does not report them after a disconnect */
+  void onDisconnected();
+
+  /** @brief Wakes the send thread, e.g. after the broker was connected */
+  void wake();
+
+  /** @brief Stops the send thread, the messages still queued are not sent anymore */
+  void stop();
+
+  /** @return messages dropped in the queue because of their deadline */
+  uint64_t getExpiredCount() const;
+
+  /** @return sent and dropped chunked messages, empty if no route uses chunks */
+  std::string getChunkStatistics() const;
+  /** @return per priority: sent, queued and dropped messages and their time in the queue, empty if no route has a priority */
+  std::map<std::string, std::string> getPriorityStatistics() const;
+  /** @return per route name: share of the bytes sent, time in the queue and dropped bytes, empty if the queue is not used */
+  std::map<std::string, std::string> getShapingStatistics() const;
+
+private:
+  /** @brief A message waiting in the queue, sent in one piece or chunk by chunk */
+  struct QueuedMessage
+  {
+    std::string                             payload;
+    int                                     qos;
+    bool                                    retain;
+    size_t                                  chunk_size;   // 0 if the message is sent in one piece
+    ChunkHeader                             header;       // of the next chunk
+    int                                     weight;
+    double                                  finish;       // finish tag as head of the queue (of the next chunk), 0 until then
+    std::chrono::steady_clock::time_point   queued;
+    std::chrono::steady_clock::time_point   deadline;
+  };
+  /** @brief The queued messages of one priority */
+  struct PriorityClass
+  {
+    std::map<std::string, std::deque<QueuedMessage>> queues;   // by MQTT topic
+    double                                  virtual_time;   // finish tag of the last message sent
+    uint64_t                                sent_count;
+    uint64_t                                shed_count;
+    LatencyStatistics                       latency;      // from queueing a message to handing its (last chunk) to mosquitto
+
+    PriorityClass() : virtual_time(0), sent_count(0), shed_count(0) {}
+  };
+  /** @brief Fair queuing state and statistics of an MQTT topic */
+  struct TopicState
+  {
+    double                                  finish;       // finish tag of the last message sent
+    uint64_t                                sent_bytes;   // of the MQTT packets
+    uint64_t                                dropped_bytes;
+    LatencyStatistics                       latency;
+
+    TopicState() : finish(0), sent_bytes(0), dropped_bytes(0) {}
+  };
+
+  /** @brief Drops the oldest messages of a priority (except those partly sent) until the given number of bytes is freed */
+  void shedMessagesLocked(PriorityClass& priority_class, size_t bytes);
+
+  /** @brief Drops the queued messages whose deadline has passed */
+  void dropExpiredLocked();
+
+  /** @brief Drops all queued messages, while they can neither be sent nor stored */
+  void dropAllLocked();
+
+  /** @brief Removes the first message of a queue, and the queue once it is empty */
+  void popLocked(PriorityClass& priority_class, std::map<std::string, std::deque<QueuedMessage>>::iterator queue);
+
+  bool hasQueuedMessagesLocked() const;
+
+  /** @return true if mosquitto has written the previous messages, so the next one does not wait behind them */
+  bool isSendWindowOpenLocked() const;
+
+  /** @brief Enables the queue (and starts the send thread) if the routes or the bandwidth need it */
+  void updateLocked();
+
+  void sendLoop();
+
+  const size_t                              queue_limit;
+  const uint32_t                            sender_id;
+  const Output                              output;
+
+  mutable std::mutex                        mtx;
+  std::condition_variable                   cv;
+  std::atomic<bool>                         is_used;
+  bool                                      has_queued_routes;
+  bool                                      has_priority_routes;
+  std::map<std::string, Route>              routes;             // by MQTT topic
+  std::map<std::string, TopicState>         topic_states;       // by MQTT topic
+  TokenBucket                               bandwidth;
+  std::array<PriorityClass, 3>              priority_classes;   // by Priority
+  size_t                                    queue_bytes;
+  std::set<int>                             sent_in_flight;     // message ids of QoS 0 messages mosquitto has not written yet
+  std::map<std::string, uint32_t>           chunk_sequences;    // next message id by MQTT topic
+  uint64_t                                  chunked_message_count;
+  uint64_t                                  chunk_count;
+  uint64_t                                  dropped_chunked_count;
+  std::atomic<uint64_t>                     expired_count;
+  std::thread                               thread;
+  std::atomic<bool>                         is_running;
+};
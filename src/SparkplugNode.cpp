@@ -0,0 +1,665 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "SparkplugNode.h"
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/coded_stream.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using google::protobuf::Descriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+static const int MAX_DEPTH = 64;
+
+static const char* const NAMESPACE      = "spBv1.0";
+static const char* const BD_SEQ_METRIC  = "bdSeq";
+static const char* const REBIRTH_METRIC = "Node Control/Rebirth";
+
+// Sparkplug B data types
+static const uint32_t DATATYPE_INT32   = 3;
+static const uint32_t DATATYPE_INT64   = 4;
+static const uint32_t DATATYPE_UINT32  = 7;
+static const uint32_t DATATYPE_UINT64  = 8;
+static const uint32_t DATATYPE_FLOAT   = 9;
+static const uint32_t DATATYPE_DOUBLE  = 10;
+static const uint32_t DATATYPE_BOOLEAN = 11;
+static const uint32_t DATATYPE_STRING  = 12;
+static const uint32_t DATATYPE_BYTES   = 17;
+
+// field numbers of the Payload and Metric messages of sparkplug_b.proto
+static const uint32_t PAYLOAD_TIMESTAMP    = 1;
+static const uint32_t PAYLOAD_METRICS      = 2;
+static const uint32_t PAYLOAD_SEQ          = 3;
+static const uint32_t METRIC_NAME          = 1;
+static const uint32_t METRIC_ALIAS         = 2;
+static const uint32_t METRIC_TIMESTAMP     = 3;
+static const uint32_t METRIC_DATATYPE      = 4;
+static const uint32_t METRIC_INT_VALUE     = 10;
+static const uint32_t METRIC_LONG_VALUE    = 11;
+static const uint32_t METRIC_FLOAT_VALUE   = 12;
+static const uint32_t METRIC_DOUBLE_VALUE  = 13;
+static const uint32_t METRIC_BOOLEAN_VALUE = 14;
+static const uint32_t METRIC_STRING_VALUE  = 15;
+static const uint32_t METRIC_BYTES_VALUE   = 16;
+
+enum WireType
+{
+	WIRETYPE_VARINT           = 0,
+	WIRETYPE_FIXED64          = 1,
+	WIRETYPE_LENGTH_DELIMITED = 2,
+	WIRETYPE_FIXED32          = 5
+};
+
+static void writeVarint(std::string& output, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	output.push_back(static_cast<char>(value));
+}
+
+static void writeTag(std::string& output, uint32_t field_number, WireType wire_type)
+{
+	writeVarint(output, (field_number << 3) | wire_type);
+}
+
+static void writeFixed(std::string& output, uint64_t value, int size)
+{
+	for (int i = 0; i < size; i++)
+	{
+		output.push_back(static_cast<char>(value >> (8 * i)));
+	}
+}
+
+static void writeLengthDelimited(std::string& output, uint32_t field_number, const std::string& data)
+{
+	writeTag(output, field_number, WIRETYPE_LENGTH_DELIMITED);
+	writeVarint(output, data.size());
+	output.append(data);
+}
+
+/**
+ * Appends a Metric to the metrics of a Payload. Births carry the name and the
+ * datatype, data messages only the alias.
+ */
+static void appendMetric(std::string& output, std::string& buffer, const std::string* name, const uint64_t* alias, uint32_t datatype, bool with_datatype, uint64_t bits, const std::string& text, uint64_t timestamp)
+{
+	buffer.clear();
+	if (name)
+	{
+		writeLengthDelimited(buffer, METRIC_NAME, *name);
+	}
+	if (alias)
+	{
+		writeTag(buffer, METRIC_ALIAS, WIRETYPE_VARINT);
+		writeVarint(buffer, *alias);
+	}
+	writeTag(buffer, METRIC_TIMESTAMP, WIRETYPE_VARINT);
+	writeVarint(buffer, timestamp);
+	if (with_datatype)
+	{
+		writeTag(buffer, METRIC_DATATYPE, WIRETYPE_VARINT);
+		writeVarint(buffer, datatype);
+	}
+	switch (datatype)
+	{
+	case DATATYPE_INT32:
+	case DATATYPE_UINT32:
+		writeTag(buffer, METRIC_INT_VALUE, WIRETYPE_VARINT);
+		writeVarint(buffer, static_cast<uint32_t>(bits));
+		break;
+	case DATATYPE_INT64:
+	case DATATYPE_UINT64:
+		writeTag(buffer, METRIC_LONG_VALUE, WIRETYPE_VARINT);
+		writeVarint(buffer, bits);
+		break;
+	case DATATYPE_FLOAT:
+		writeTag(buffer, METRIC_FLOAT_VALUE, WIRETYPE_FIXED32);
+		writeFixed(buffer, bits, 4);
+		break;
+	case DATATYPE_DOUBLE:
+		writeTag(buffer, METRIC_DOUBLE_VALUE, WIRETYPE_FIXED64);
+		writeFixed(buffer, bits, 8);
+		break;
+	case DATATYPE_BOOLEAN:
+		writeTag(buffer, METRIC_BOOLEAN_VALUE, WIRETYPE_VARINT);
+		writeVarint(buffer, bits);
+		break;
+	case DATATYPE_STRING:
+		writeLengthDelimited(buffer, METRIC_STRING_VALUE, text);
+		break;
+	case DATATYPE_BYTES:
+		writeLengthDelimited(buffer, METRIC_BYTES_VALUE, text);
+		break;
+	default:
+		break;
+	}
+	writeLengthDelimited(output, PAYLOAD_METRICS, buffer);
+}
+
+static void beginPayload(std::string& output, uint64_t timestamp)
+{
+	output.clear();
+	writeTag(output, PAYLOAD_TIMESTAMP, WIRETYPE_VARINT);
+	writeVarint(output, timestamp);
+}
+
+/** @return milliseconds since the epoch, the timestamp format of Sparkplug */
+static uint64_t currentTimestamp()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+/** @return false if the datatype is not numeric */
+static bool toNumber(uint32_t datatype, uint64_t bits, double& number)
+{
+	switch (datatype)
+	{
+	case DATATYPE_INT32:
+		number = static_cast<double>(static_cast<int32_t>(static_cast<uint32_t>(bits)));
+		return true;
+	case DATATYPE_INT64:
+		number = static_cast<double>(static_cast<int64_t>(bits));
+		return true;
+	case DATATYPE_UINT32:
+	case DATATYPE_UINT64:
+		number = static_cast<double>(bits);
+		return true;
+	case DATATYPE_FLOAT:
+	{
+		const uint32_t float_bits = static_cast<uint32_t>(bits);
+		float value;
+		std::memcpy(&value, &float_bits, sizeof(value));
+		number = value;
+		return true;
+	}
+	case DATATYPE_DOUBLE:
+		std::memcpy(&number, &bits, sizeof(number));
+		return true;
+	default:
+		return false;
+	}
+}
+
+/** @return false if the field cannot be skipped */
+static bool skipField(google::protobuf::io::CodedInputStream& input, uint32_t tag)
+{
+	uint64_t value;
+	uint32_t length;
+	switch (tag & 0x07)
+	{
+	case WIRETYPE_VARINT:
+		return input.ReadVarint64(&value);
+	case WIRETYPE_FIXED64:
+		return input.Skip(8);
+	case WIRETYPE_LENGTH_DELIMITED:
+		return input.ReadVarint32(&length) && input.Skip(static_cast<int>(length));
+	case WIRETYPE_FIXED32:
+		return input.Skip(4);
+	default:
+		return false;
+	}
+}
+
+SparkplugNode::SparkplugNode(const std::string& group_id, const std::string& edge_node_id, const PublishCallback& publish)
+	: group_id(group_id)
+	, edge_node_id(edge_node_id)
+	, publish(publish)
+	, is_online(false)
+	, bd_seq(0)
+	, seq(0)
+	, next_alias(1)
+	, sample_count(0)
+	, birth_count(0)
+	, data_count(0)
+	, metrics_sent(0)
+	, metrics_suppressed(0)
+{
+}
+
+std::string SparkplugNode::getDeathTopic() const
+{
+	return std::string(NAMESPACE) + "/" + group_id + "/NDEATH/" + edge_node_id;
+}
+
+std::string SparkplugNode::getDeathPayload() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	const uint64_t timestamp = currentTimestamp();
+	const std::string name = BD_SEQ_METRIC;
+	std::string output;
+	std::string buffer;
+	beginPayload(output, timestamp);
+	appendMetric(output, buffer, &name, nullptr, DATATYPE_INT64, true, bd_seq, std::string(), timestamp);
+	return output;
+}
+
+std::string SparkplugNode::getCommandTopic() const
+{
+	return std::string(NAMESPACE) + "/" + group_id + "/NCMD/" + edge_node_id;
+}
+
+void SparkplugNode::setDevices(const std::map<std::string, std::map<std::string, double>>& new_devices)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	for (auto device = devices.begin(); device != devices.end();)
+	{
+		if (new_devices.count(device->first) > 0)
+		{
+			++device;
+			continue;
+		}
+		if (is_online && device->second.is_born)
+		{
+			beginPayload(payload, currentTimestamp());
+			publishLocked("DDEATH", device->first);
+		}
+		device = devices.erase(device);
+	}
+
+	for (auto const& new_device : new_devices)
+	{
+		Device& device = devices[new_device.first];
+		device.deadbands = new_device.second;
+		for (auto& metric : device.metrics)
+		{
+			auto deadband = device.deadbands.find(metric.first);
+			metric.second.deadband = deadband != device.deadbands.end() ? deadband->second : 0.0;
+		}
+	}
+}
+
+void SparkplugNode::publishBirth()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	is_online = true;
+	// the NBIRTH starts the seq numbers of the connection
+	seq = 0;
+
+	const uint64_t timestamp = currentTimestamp();
+	const std::string bd_seq_name  = BD_SEQ_METRIC;
+	const std::string rebirth_name = REBIRTH_METRIC;
+	beginPayload(payload, timestamp);
+	appendMetric(payload, metric_buffer, &bd_seq_name, nullptr, DATATYPE_INT64, true, bd_seq, std::string(), timestamp);
+	appendMetric(payload, metric_buffer, &rebirth_name, nullptr, DATATYPE_BOOLEAN, true, 0, std::string(), timestamp);
+	birth_count++;
+	publishLocked("NBIRTH", std::string());
+
+	for (auto& device : devices)
+	{
+		if (device.second.metrics.empty())
+		{
+			// born with its first message
+			device.second.is_born = false;
+			continue;
+		}
+		publishDeviceBirthLocked(device.first, device.second, timestamp);
+	}
+}
+
+void SparkplugNode::setOffline()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (!is_online)
+	{
+		// already counted, e.g. by a deliberate disconnect before the on_disconnect
+		return;
+	}
+	is_online = false;
+	// the will of the next connection has to carry the next bdSeq
+	bd_seq = (bd_seq + 1) % 256;
+	for (auto& device : devices)
+	{
+		device.second.is_born = false;
+	}
+}
+
+void SparkplugNode::update(const std::string& device_id, const Message& message)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	auto device_entry = devices.find(device_id);
+	if (device_entry == devices.end())
+	{
+		return;
+	}
+	Device& device = device_entry->second;
+
+	sample_count = 0;
+	path.clear();
+	flatten(message, path, 0);
+
+	bool needs_birth = !device.is_born;
+	changed_metrics.clear();
+	for (size_t i = 0; i < sample_count; i++)
+	{
+		Sample& sample = samples[i];
+		auto metric_entry = device.metrics.find(sample.name);
+		if (metric_entry == device.metrics.end())
+		{
+			auto deadband = device.deadbands.find(sample.name);
+			Metric metric{ next_alias++, sample.datatype, deadband != device.deadbands.end() ? deadband->second : 0.0, sample.value, sample.value };
+			device.metrics.emplace(sample.name, std::move(metric));
+			needs_birth = true;
+			continue;
+		}
+		Metric& metric = metric_entry->second;
+		if (metric.datatype != sample.datatype)
+		{
+			metric.datatype = sample.datatype;
+			needs_birth = true;
+		}
+		metric.value.bits = sample.value.bits;
+		metric.value.text.swap(sample.value.text);
+		if (isReportable(metric))
+		{
+			changed_metrics.push_back(&metric);
+		}
+	}
+	if (!is_online)
+	{
+		return;
+	}
+
+	const uint64_t timestamp = currentTimestamp();
+	if (needs_birth)
+	{
+		publishDeviceBirthLocked(device_id, device, timestamp);
+		return;
+	}
+	metrics_suppressed += sample_count - changed_metrics.size();
+	if (changed_metrics.empty())
+	{
+		return;
+	}
+	beginPayload(payload, timestamp);
+	for (Metric* metric : changed_metrics)
+	{
+		appendMetric(payload, metric_buffer, nullptr, &metric->alias, metric->datatype, false, metric->value.bits, metric->value.text, timestamp);
+		metric->reported = metric->value;
+	}
+	metrics_sent += changed_metrics.size();
+	data_count++;
+	publishLocked("DDATA", device_id);
+}
+
+void SparkplugNode::flatten(const Message& message, std::string& field_path, int depth)
+{
+	if (depth >= MAX_DEPTH)
+	{
+		return;
+	}
+	const Descriptor* descriptor = message.GetDescriptor();
+	const Reflection* reflection = message.GetReflection();
+	for (int i = 0; i < descriptor->field_count(); i++)
+	{
+		const FieldDescriptor* field = descriptor->field(i);
+		const size_t parent_length = field_path.size();
+		if (parent_length > 0)
+		{
+			field_path.push_back('/');
+		}
+		field_path.append(field->name());
+
+		if (field->is_map())
+		{
+			const FieldDescriptor* key_field   = field->message_type()->map_key();
+			const FieldDescriptor* value_field = field->message_type()->map_value();
+			for (int j = 0; j < reflection->FieldSize(message, field); j++)
+			{
+				const Message& entry = reflection->GetRepeatedMessage(message, field, j);
+				const Reflection* entry_reflection = entry.GetReflection();
+				const size_t map_length = field_path.size();
+				field_path.push_back('/');
+				switch (key_field->cpp_type())
+				{
+				case FieldDescriptor::CPPTYPE_STRING: field_path.append(entry_reflection->GetString(entry, key_field)); break;
+				case FieldDescriptor::CPPTYPE_INT32:  field_path.append(std::to_string(entry_reflection->GetInt32(entry, key_field))); break;
+				case FieldDescriptor::CPPTYPE_INT64:  field_path.append(std::to_string(entry_reflection->GetInt64(entry, key_field))); break;
+				case FieldDescriptor::CPPTYPE_UINT32: field_path.append(std::to_string(entry_reflection->GetUInt32(entry, key_field))); break;
+				case FieldDescriptor::CPPTYPE_UINT64: field_path.append(std::to_string(entry_reflection->GetUInt64(entry, key_field))); break;
+				case FieldDescriptor::CPPTYPE_BOOL:   field_path.append(entry_reflection->GetBool(entry, key_field) ? "true" : "false"); break;
+				default: break;
+				}
+				if (value_field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)
+				{
+					flatten(entry_reflection->GetMessage(entry, value_field), field_path, depth + 1);
+				}
+				else
+				{
+					addSample(entry, value_field, -1, field_path);
+				}
+				field_path.resize(map_length);
+			}
+		}
+		else if (field->is_repeated())
+		{
+			for (int j = 0; j < reflection->FieldSize(message, field); j++)
+			{
+				const size_t list_length = field_path.size();
+				field_path.push_back('/');
+				field_path.append(std::to_string(j));
+				if (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)
+				{
+					flatten(reflection->GetRepeatedMessage(message, field, j), field_path, depth + 1);
+				}
+				else
+				{
+					addSample(message, field, j, field_path);
+				}
+				field_path.resize(list_length);
+			}
+		}
+		else if (field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)
+		{
+			// unset messages are skipped, recursive types would not end otherwise
+			if (reflection->HasField(message, field))
+			{
+				flatten(reflection->GetMessage(message, field), field_path, depth + 1);
+			}
+		}
+		else if (field->containing_oneof() == nullptr || reflection->HasField(message, field))
+		{
+			// scalars are reported with their default value, in proto3 they are not set if they have it
+			addSample(message, field, -1, field_path);
+		}
+		field_path.resize(parent_length);
+	}
+}
+
+void SparkplugNode::addSample(const Message& message, const FieldDescriptor* field, int index, const std::string& name)
+{
+	if (sample_count == samples.size())
+	{
+		samples.emplace_back();
+	}
+	Sample& sample = samples[sample_count++];
+	sample.name = name;
+	sample.value.bits = 0;
+	sample.value.text.clear();
+
+	const Reflection* reflection = message.GetReflection();
+	const bool is_repeated = index >= 0;
+	switch (field->cpp_type())
+	{
+	case FieldDescriptor::CPPTYPE_INT32:
+		sample.datatype   = DATATYPE_INT32;
+		sample.value.bits = static_cast<uint32_t>(is_repeated ? reflection->GetRepeatedInt32(message, field, index) : reflection->GetInt32(message, field));
+		break;
+	case FieldDescriptor::CPPTYPE_INT64:
+		sample.datatype   = DATATYPE_INT64;
+		sample.value.bits = static_cast<uint64_t>(is_repeated ? reflection->GetRepeatedInt64(message, field, index) : reflection->GetInt64(message, field));
+		break;
+	case FieldDescriptor::CPPTYPE_UINT32:
+		sample.datatype   = DATATYPE_UINT32;
+		sample.value.bits = is_repeated ? reflection->GetRepeatedUInt32(message, field, index) : reflection->GetUInt32(message, field);
+		break;
+	case FieldDescriptor::CPPTYPE_UINT64:
+		sample.datatype   = DATATYPE_UINT64;
+		sample.value.bits = is_repeated ? reflection->GetRepeatedUInt64(message, field, index) : reflection->GetUInt64(message, field);
+		break;
+	case FieldDescriptor::CPPTYPE_FLOAT:
+	{
+		const float value = is_repeated ? reflection->GetRepeatedFloat(message, field, index) : reflection->GetFloat(message, field);
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		sample.datatype   = DATATYPE_FLOAT;
+		sample.value.bits = bits;
+		break;
+	}
+	case FieldDescriptor::CPPTYPE_DOUBLE:
+	{
+		const double value = is_repeated ? reflection->GetRepeatedDouble(message, field, index) : reflection->GetDouble(message, field);
+		std::memcpy(&sample.value.bits, &value, sizeof(value));
+		sample.datatype = DATATYPE_DOUBLE;
+		break;
+	}
+	case FieldDescriptor::CPPTYPE_BOOL:
+		sample.datatype   = DATATYPE_BOOLEAN;
+		sample.value.bits = (is_repeated ? reflection->GetRepeatedBool(message, field, index) : reflection->GetBool(message, field)) ? 1 : 0;
+		break;
+	case FieldDescriptor::CPPTYPE_ENUM:
+		// enums are sent by name, Sparkplug has no enum type
+		sample.datatype   = DATATYPE_STRING;
+		sample.value.text = (is_repeated ? reflection->GetRepeatedEnum(message, field, index) : reflection->GetEnum(message, field))->name();
+		break;
+	case FieldDescriptor::CPPTYPE_STRING:
+		sample.datatype   = field->type() == FieldDescriptor::TYPE_BYTES ? DATATYPE_BYTES : DATATYPE_STRING;
+		sample.value.text = is_repeated ? reflection->GetRepeatedString(message, field, index) : reflection->GetString(message, field);
+		break;
+	default:
+		sample_count--;
+		break;
+	}
+}
+
+bool SparkplugNode::isReportable(const Metric& metric) const
+{
+	if (metric.value == metric.reported)
+	{
+		return false;
+	}
+	double current;
+	double reported;
+	if (metric.deadband <= 0.0 || !toNumber(metric.datatype, metric.value.bits, current) || !toNumber(metric.datatype, metric.reported.bits, reported))
+	{
+		return true;
+	}
+	// NaN is always reported
+	return !(std::fabs(current - reported) <= metric.deadband);
+}
+
+void SparkplugNode::publishDeviceBirthLocked(const std::string& device_id, Device& device, uint64_t timestamp)
+{
+	beginPayload(payload, timestamp);
+	for (auto& metric : device.metrics)
+	{
+		appendMetric(payload, metric_buffer, &metric.first, &metric.second.alias, metric.second.datatype, true, metric.second.value.bits, metric.second.value.text, timestamp);
+		metric.second.reported = metric.second.value;
+	}
+	metrics_sent += device.metrics.size();
+	birth_count++;
+	device.is_born = true;
+	publishLocked("DBIRTH", device_id);
+}
+
+void SparkplugNode::publishLocked(const std::string& message_type, const std::string& device_id)
+{
+	writeTag(payload, PAYLOAD_SEQ, WIRETYPE_VARINT);
+	writeVarint(payload, seq);
+	seq = (seq + 1) % 256;
+
+	std::string topic = std::string(NAMESPACE) + "/" + group_id + "/" + message_type + "/" + edge_node_id;
+	if (!device_id.empty())
+	{
+		topic += "/" + device_id;
+	}
+	publish(topic, payload);
+}
+
+bool SparkplugNode::isRebirthRequest(const void* data, size_t size)
+{
+	google::protobuf::io::CodedInputStream input(static_cast<const uint8_t*>(data), static_cast<int>(size));
+	uint32_t tag;
+	while ((tag = input.ReadTag()) != 0)
+	{
+		if (tag != ((PAYLOAD_METRICS << 3) | WIRETYPE_LENGTH_DELIMITED))
+		{
+			if (!skipField(input, tag))
+			{
+				return false;
+			}
+			continue;
+		}
+		uint32_t length;
+		if (!input.ReadVarint32(&length))
+		{
+			return false;
+		}
+		auto limit = input.PushLimit(static_cast<int>(length));
+		std::string name;
+		uint64_t value = 0;
+		while ((tag = input.ReadTag()) != 0)
+		{
+			if (tag == ((METRIC_NAME << 3) | WIRETYPE_LENGTH_DELIMITED))
+			{
+				if (!input.ReadVarint32(&length) || !input.ReadString(&name, static_cast<int>(length)))
+				{
+					return false;
+				}
+			}
+			else if (tag == ((METRIC_BOOLEAN_VALUE << 3) | WIRETYPE_VARINT))
+			{
+				if (!input.ReadVarint64(&value))
+				{
+					return false;
+				}
+			}
+			else if (!skipField(input, tag))
+			{
+				return false;
+			}
+		}
+		if (!input.ConsumedEntireMessage())
+		{
+			return false;
+		}
+		input.PopLimit(limit);
+		if (name == REBIRTH_METRIC && value != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string SparkplugNode::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return std::to_string(birth_count) + " births, " + std::to_string(data_count) + " data messages, metrics: "
+		+ std::to_string(metrics_sent) + " sent, " + std::to_string(metrics_suppressed) + " unchanged or within deadband"
+		+ ", bdSeq: " + std::to_string(bd_seq) + (is_online ? "" : " (offline)");
+}
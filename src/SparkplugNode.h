@@ -0,0 +1,171 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <google/protobuf/message.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A Sparkplug B edge node that publishes protobuf messages as device metrics.
+ *
+ * Every eCAL -> MQTT route with output_format sparkplug is a device of the
+ * edge node. The fields of its messages are flattened to metrics, named by
+ * their field path ("pose/position/x", repeated fields and maps add the index
+ * or key as another level). Each metric gets an alias that is unique within
+ * the edge node and is announced together with the name in the DBIRTH.
+ *
+ * After the births only the metrics that changed are sent in a DDATA, by their
+ * alias. A numeric metric with a deadband is reported once it differs from the
+ * last reported value by more than the deadband. A metric that appears after
+ * the DBIRTH (e.g. a new element of a repeated field) makes the device send a
+ * new DBIRTH. While the node is offline the values are only recorded, the
+ * births after the next connect carry the current state.
+ *
+ * The seq number of the edge node is counted across all of its messages, so
+ * the messages are built and handed to the publish callback under one lock.
+ */
+class SparkplugNode
+{
+public:
+  /** Called with every message of the edge node, in seq order */
+  typedef std::function<void(const std::string& topic, const std::string& payload)> PublishCallback;
+
+  /**
+   * @param group_id      the Sparkplug group of the edge node
+   * @param edge_node_id  the id of the edge node within the group
+   * @param publish       called for every message to send
+   */
+  SparkplugNode(const std::string& group_id, const std::string& edge_node_id, const PublishCallback& publish);
+
+  SparkplugNode(const SparkplugNode&) = delete;
+  SparkplugNode& operator=(const SparkplugNode&) = delete;
+
+  /** @return the NDEATH topic, to be set as will of the MQTT connection */
+  std::string getDeathTopic() const;
+
+  /** @return the NDEATH payload with the bdSeq of the next connection */
+  std::string getDeathPayload() const;
+
+  /** @return the NCMD topic host applications send rebirth requests to */
+  std::string getCommandTopic() const;
+
+  /**
+   * @brief Sets the devices of the edge node
+   *
+   * Removed devices are announced with a DDEATH. The metrics of kept devices
+   * are not touched, only their deadbands are updated.
+   *
+   * @param devices the deadbands by metric name, per device id
+   */
+  void setDevices(const std::map<std::string, std::map<std::string, double>>& devices);
+
+  /** @brief Publishes the NBIRTH and the DBIRTH of every device that has received a message, e.g. after a connect or a rebirth request */
+  void publishBirth();
+
+  /** @brief Stops publishing after the connection was lost, the next connection uses the next bdSeq; nothing if the node is offline */
+  void setOffline();
+
+  /**
+   * @brief Updates the metrics of a device and publishes the changed ones
+   *
+   * @param device_id the device the message belongs to
+   * @param message   the decoded message
+   */
+  void update(const std::string& device_id, const google::protobuf::Message& message);
+
+  /** @return true if the NCMD payload sets the "Node Control/Rebirth" metric */
+  static bool isRebirthRequest(const void* payload, size_t size);
+
+  /** @return number of births, data messages and sent / suppressed metrics */
+  std::string getStatistics() const;
+
+private:
+  struct Value
+  {
+    uint64_t    bits;   // integers, booleans and the bit pattern of floats
+    std::string text;   // strings, enums and bytes
+
+    bool operator==(const Value& other) const { return bits == other.bits && text == other.text; }
+  };
+
+  struct Metric
+  {
+    uint64_t alias;
+    uint32_t datatype;
+    double   deadband;
+    Value    value;     // last received
+    Value    reported;  // last published
+  };
+
+  struct Device
+  {
+    std::map<std::string, double> deadbands;
+    std::map<std::string, Metric> metrics;   // by name
+    bool                          is_born;
+
+    Device() : is_born(false) {}
+  };
+
+  struct Sample
+  {
+    std::string name;
+    uint32_t    datatype;
+    Value       value;
+  };
+
+  void flatten(const google::protobuf::Message& message, std::string& field_path, int depth);
+  void addSample(const google::protobuf::Message& message, const google::protobuf::FieldDescriptor* field, int index, const std::string& name);
+  bool isReportable(const Metric& metric) const;
+
+  void publishDeviceBirthLocked(const std::string& device_id, Device& device, uint64_t timestamp);
+
+  /** @brief Adds the seq number to the payload and publishes it */
+  void publishLocked(const std::string& message_type, const std::string& device_id);
+
+  const std::string               group_id;
+  const std::string               edge_node_id;
+  const PublishCallback           publish;
+
+  mutable std::mutex              mtx;
+  std::map<std::string, Device>   devices;   // by device id
+  bool                            is_online;
+  uint64_t                        bd_seq;
+  uint64_t                        seq;
+  uint64_t                        next_alias;
+
+  // reused for every message
+  std::vector<Sample>             samples;
+  size_t                          sample_count;
+  std::vector<Metric*>            changed_metrics;
+  std::string                     path;
+  std::string                     payload;
+  std::string                     metric_buffer;
+
+  uint64_t                        birth_count;
+  uint64_t                        data_count;
+  uint64_t                        metrics_sent;
+  uint64_t                        metrics_suppressed;
+};
@@ -0,0 +1,117 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+/**
+ * @brief Collects latency samples in a histogram with power of two buckets.
+ *
+ * Adding a sample is O(1) and the memory footprint is constant, so it can be
+ * used on the message path. Percentiles are reported as the upper bound of the
+ * bucket they fall into. The class is not thread safe, the owner has to lock.
+ */
+class LatencyStatistics
+{
+public:
+  LatencyStatistics()
+  {
+    reset();
+  }
+
+  void add(int64_t latency_us)
+  {
+    latency_us = std::max<int64_t>(latency_us, 0);
+    size_t bucket = 0;
+    while (bucket + 1 < buckets.size() && (int64_t(1) << bucket) <= latency_us)
+    {
+      bucket++;
+    }
+    buckets[bucket]++;
+    count++;
+    sum_us += latency_us;
+    max_us = std::max(max_us, latency_us);
+  }
+
+  void reset()
+  {
+    buckets.fill(0);
+    count  = 0;
+    sum_us = 0;
+    max_us = 0;
+  }
+
+  uint64_t getCount() const
+  {
+    return count;
+  }
+
+  int64_t getMeanUs() const
+  {
+    return count > 0 ? static_cast<int64_t>(sum_us / static_cast<int64_t>(count)) : 0;
+  }
+
+  int64_t getMaxUs() const
+  {
+    return max_us;
+  }
+
+  /**
+   * @param percentile value between 0 and 100
+   * @return upper bound of the latency in microseconds, below which the given percentage of samples lie
+   */
+  int64_t getPercentileUs(double percentile) const
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+    uint64_t threshold = static_cast<uint64_t>(static_cast<double>(count) * percentile / 100.0);
+    uint64_t accumulated = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); bucket++)
+    {
+      accumulated += buckets[bucket];
+      if (accumulated >= threshold && accumulated > 0)
+      {
+        return std::min(int64_t(1) << bucket, max_us);
+      }
+    }
+    return max_us;
+  }
+
+  /** @return a one line summary, e.g. "n=12 mean=130us p50<=128us p99<=512us max=401us" */
+  std::string toString() const
+  {
+    return "n=" + std::to_string(count)
+      + " mean=" + std::to_string(getMeanUs()) + "us"
+      + " p50<=" + std::to_string(getPercentileUs(50)) + "us"
+      + " p99<=" + std::to_string(getPercentileUs(99)) + "us"
+      + " max=" + std::to_string(max_us) + "us";
+  }
+
+private:
+  std::array<uint64_t, 40> buckets;
+  uint64_t count;
+  int64_t  sum_us;
+  int64_t  max_us;
+};
@@ -0,0 +1,183 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "StoreReplay.h"
+
+#include "utils.h"
+
+#include <algorithm>
+
+StoreReplay::StoreReplay(std::unique_ptr<MessageStore> store_, int replay_rate, TokenBucket& bandwidth, const PublishCallback& publish, const std::function<bool()>& is_connected)
+	: store(std::move(store_))
+	, send_interval(replay_rate > 0 ? std::chrono::microseconds(1000000 / replay_rate) : std::chrono::microseconds(0))
+	, bandwidth(bandwidth)
+	, publish(publish)
+	, is_connected(is_connected)
+	, is_running(false)
+	, last_drain_ms(-1)
+{
+}
+
+StoreReplay::~StoreReplay()
+{
+	stop();
+}
+
+void StoreReplay::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		is_running = false;
+		cv.notify_all();
+	}
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void StoreReplay::start()
+{
+	is_running = true;
+	thread = std::thread(&StoreReplay::replayLoop, this);
+}
+
+void StoreReplay::append(const std::string& topic, const void* payload, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)
+{
+	store->append(topic, payload, size, qos, retain, toStoreDeadline(deadline));
+	cv.notify_all();
+}
+
+bool StoreReplay::hasBacklog() const
+{
+	return !store->empty();
+}
+
+void StoreReplay::wake()
+{
+	cv.notify_all();
+}
+
+int64_t StoreReplay::toStoreDeadline(const std::chrono::steady_clock::time_point& deadline)
+{
+	if (deadline == std::chrono::steady_clock::time_point::max())
+	{
+		return 0;
+	}
+	// the store keeps the messages across restarts, so it uses the wall clock
+	const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+	const auto wall_clock = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+	return std::max<int64_t>((wall_clock + remaining).count(), 1);
+}
+
+std::chrono::steady_clock::time_point StoreReplay::fromStoreDeadline(int64_t deadline_us)
+{
+	if (deadline_us == 0)
+	{
+		return std::chrono::steady_clock::time_point::max();
+	}
+	const auto wall_clock = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+	return std::chrono::steady_clock::now() + (std::chrono::microseconds(deadline_us) - wall_clock);
+}
+
+void StoreReplay::replayLoop()
+{
+	bool draining = false;
+	uint64_t drained_count = 0;
+	auto drain_started = std::chrono::steady_clock::now();
+	auto next_send     = std::chrono::steady_clock::now();
+
+	while (is_running == true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait_for(lock, std::chrono::milliseconds(500), [this]()
+				{
+					return is_running == false || (is_connected() && !store->empty());
+				});
+		}
+		if (is_running == false || !is_connected() || store->empty())
+		{
+			continue;
+		}
+
+		if (!draining)
+		{
+			draining = true;
+			drained_count = 0;
+			drain_started = std::chrono::steady_clock::now();
+			next_send = drain_started;
+			store->compact();
+			printOutput("Sending " + std::to_string(store->getBacklogCount()) + " stored messages ("
+				+ std::to_string(store->getBacklogBytes()) + " bytes) to MQTT");
+		}
+
+		MessageStore::Record record;
+		while (is_running == true && is_connected() && store->front(record))
+		{
+			std::this_thread::sleep_until(next_send);
+			const size_t packet_size = publishPacketSize(record.topic, record.payload.size());
+			auto wait = bandwidth.take(packet_size);
+			if (wait.count() > 0)
+			{
+				std::this_thread::sleep_for(wait);
+				continue;
+			}
+			const PublishResult result = publish(record.topic, record.payload.data(), record.payload.size(), record.qos, record.retain, fromStoreDeadline(record.deadline_us));
+			if (result != PUBLISH_SENT)
+			{
+				bandwidth.refund(packet_size);
+			}
+			if (result == PUBLISH_RETRY)
+			{
+				// e.g. the queue limit is reached, try again later
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			// a message that mosquitto rejects (counted as failed) would block the store forever
+			store->pop();
+			if (result != PUBLISH_SENT)
+			{
+				continue;
+			}
+			drained_count++;
+			next_send = std::max(next_send + send_interval, std::chrono::steady_clock::now() - send_interval);
+		}
+
+		if (store->empty())
+		{
+			draining = false;
+			last_drain_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - drain_started).count());
+			printOutput("Sent " + std::to_string(drained_count) + " stored messages to MQTT in " + std::to_string(last_drain_ms) + " ms");
+		}
+	}
+}
+
+uint64_t StoreReplay::getExpiredCount() const
+{
+	return store->getExpiredCount();
+}
+
+std::string StoreReplay::getStatistics() const
+{
+	return "backlog: " + std::to_string(store->getBacklogCount()) + " messages / "
+		+ std::to_string(store->getBacklogBytes()) + " bytes"
+		+ ", dropped: " + std::to_string(store->getDroppedCount())
+		+ ", last drain: " + std::to_string(last_drain_ms) + " ms";
+}
@@ -0,0 +1,105 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "MessageStore.h"
+#include "SendScheduler.h"
+#include "TokenBucket.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Keeps the messages in the store and forward buffer while the broker is not connected and sends them after the reconnect.
+ *
+ * As long as stored messages are waiting, new messages are appended behind
+ * them to keep the order. The thread of the replay sends them at most at the
+ * store_replay_rate and within the bandwidth limit shared with the send queue.
+ */
+class StoreReplay
+{
+public:
+  typedef std::function<PublishResult(const std::string& topic, const char* data, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline)> PublishCallback;
+
+  /**
+   * @param store         the opened message store
+   * @param replay_rate   messages sent per second at most, 0 means unlimited
+   * @param bandwidth     the bandwidth limit of the broker connection
+   * @param publish       sends a stored message
+   * @param is_connected  true while the broker is connected
+   */
+  StoreReplay(std::unique_ptr<MessageStore> store, int replay_rate, TokenBucket& bandwidth, const PublishCallback& publish, const std::function<bool()>& is_connected);
+  ~StoreReplay();
+
+  StoreReplay(const StoreReplay&) = delete;
+  StoreReplay& operator=(const StoreReplay&) = delete;
+
+  /** @brief Starts the thread that sends the stored messages */
+  void start();
+
+  /** @brief Stops the thread, the messages not sent yet stay in the store */
+  void stop();
+
+  /**
+   * @brief Appends a message to the store
+   *
+   * @param deadline  the message is dropped instead of sent after this time
+   */
+  void append(const std::string& topic, const void* payload, size_t size, int qos, bool retain, const std::chrono::steady_clock::time_point& deadline);
+
+  /** @return true while stored messages are waiting, new messages have to be appended behind them */
+  bool hasBacklog() const;
+
+  /** @brief Wakes the thread, e.g. after the broker was connected */
+  void wake();
+
+  /** @return messages dropped in the store because of their deadline */
+  uint64_t getExpiredCount() const;
+
+  /** @return backlog and drain time */
+  std::string getStatistics() const;
+
+  /** @brief Converts a deadline to the wall clock time (in us) kept by the message store, 0 for none */
+  static int64_t toStoreDeadline(const std::chrono::steady_clock::time_point& deadline);
+
+  /** @brief Converts a deadline of the message store back, time_point::max() for 0 */
+  static std::chrono::steady_clock::time_point fromStoreDeadline(int64_t deadline_us);
+
+private:
+  void replayLoop();
+
+  const std::unique_ptr<MessageStore>       store;
+  const std::chrono::microseconds           send_interval;
+  TokenBucket&                              bandwidth;
+  const PublishCallback                     publish;
+  const std::function<bool()>               is_connected;
+
+  std::mutex                                mtx;
+  std::condition_variable                   cv;
+  std::thread                               thread;
+  std::atomic<bool>                         is_running;
+  std::atomic<int>                          last_drain_ms;
+};
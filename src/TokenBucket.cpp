@@ -0,0 +1,83 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "TokenBucket.h"
+
+#include <algorithm>
+#include <cmath>
+
+TokenBucket::TokenBucket()
+	: rate(0)
+	, burst(0)
+	, tokens(0)
+	, last_refill(std::chrono::steady_clock::now())
+{
+}
+
+void TokenBucket::setRate(uint64_t bytes_per_second, uint64_t burst_)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	refill(std::chrono::steady_clock::now());
+	const bool was_unlimited = rate == 0;
+	rate   = bytes_per_second;
+	burst  = std::max<uint64_t>(burst_, 1);
+	// starts full, like a bucket that was idle
+	tokens = was_unlimited ? static_cast<double>(burst) : std::min(tokens, static_cast<double>(burst));
+}
+
+bool TokenBucket::isLimited() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return rate > 0;
+}
+
+std::chrono::microseconds TokenBucket::take(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (rate == 0)
+	{
+		return std::chrono::microseconds(0);
+	}
+	refill(std::chrono::steady_clock::now());
+	// larger messages need a full bucket
+	const double needed = std::min(static_cast<double>(bytes), static_cast<double>(burst));
+	if (tokens < needed)
+	{
+		return std::chrono::microseconds(static_cast<int64_t>(std::ceil((needed - tokens) * 1e6 / static_cast<double>(rate))));
+	}
+	tokens -= static_cast<double>(bytes);
+	return std::chrono::microseconds(0);
+}
+
+void TokenBucket::refund(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (rate == 0)
+	{
+		return;
+	}
+	tokens = std::min(tokens + static_cast<double>(bytes), static_cast<double>(burst));
+}
+
+void TokenBucket::refill(std::chrono::steady_clock::time_point now)
+{
+	const double elapsed_s = std::chrono::duration<double>(now - last_refill).count();
+	last_refill = now;
+	tokens = std::min(tokens + elapsed_s * static_cast<double>(rate), static_cast<double>(burst));
+}
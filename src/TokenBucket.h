@@ -0,0 +1,68 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @brief Limits the rate of the bytes sent, with bursts up to a bucket size.
+ *
+ * The bucket is filled at the rate and holds at most the burst size. A message
+ * larger than the burst size is sent once the bucket is full, the debt is paid
+ * by the following refills. The rate can be changed while messages are sent.
+ *
+ * All member functions are thread safe.
+ */
+class TokenBucket
+{
+public:
+  TokenBucket();
+
+  /**
+   * @param bytes_per_second  0 means unlimited
+   * @param burst             bytes that may be sent at once after an idle time
+   */
+  void setRate(uint64_t bytes_per_second, uint64_t burst);
+
+  /** @return false if the rate is unlimited */
+  bool isLimited() const;
+
+  /**
+   * @brief Takes the tokens for the bytes, if the bucket holds enough
+   *
+   * @return zero if the bytes may be sent, otherwise the time until the bucket holds enough
+   */
+  std::chrono::microseconds take(size_t bytes);
+
+  /** @brief Gives back the tokens taken for bytes that were not sent after all */
+  void refund(size_t bytes);
+
+private:
+  void refill(std::chrono::steady_clock::time_point now);
+
+  mutable std::mutex                    mtx;
+  uint64_t                              rate;
+  uint64_t                              burst;
+  double                                tokens;
+  std::chrono::steady_clock::time_point last_refill;
+};
@@ -0,0 +1,558 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "WindowAggregator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+using google::protobuf::Descriptor;
+using google::protobuf::FieldDescriptor;
+
+// deeper nested messages are rejected
+static const int MAX_DEPTH = 64;
+
+enum WireType
+{
+	WIRE_VARINT = 0, WIRE_FIXED64 = 1, WIRE_LENGTH_DELIMITED = 2, WIRE_START_GROUP = 3, WIRE_END_GROUP = 4, WIRE_FIXED32 = 5
+};
+
+static bool readVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && data < end; shift += 7)
+	{
+		const uint8_t byte = *data++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool skipValue(const uint8_t*& data, const uint8_t* end, uint32_t wire_type, uint32_t number, int depth)
+{
+	uint64_t value;
+	switch (wire_type)
+	{
+	case WIRE_VARINT:
+		return readVarint(data, end, value);
+	case WIRE_FIXED64:
+		if (end - data < 8)
+			return false;
+		data += 8;
+		return true;
+	case WIRE_FIXED32:
+		if (end - data < 4)
+			return false;
+		data += 4;
+		return true;
+	case WIRE_LENGTH_DELIMITED:
+		if (!readVarint(data, end, value) || value > static_cast<uint64_t>(end - data))
+			return false;
+		data += value;
+		return true;
+	case WIRE_START_GROUP:
+		if (depth >= MAX_DEPTH)
+			return false;
+		while (data < end)
+		{
+			uint64_t tag;
+			if (!readVarint(data, end, tag))
+				return false;
+			if ((tag & 0x07) == WIRE_END_GROUP)
+				return (tag >> 3) == number;
+			if (!skipValue(data, end, static_cast<uint32_t>(tag & 0x07), static_cast<uint32_t>(tag >> 3), depth + 1))
+				return false;
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+static uint64_t readFixed(const uint8_t* data, int size)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < size; i++)
+	{
+		value |= static_cast<uint64_t>(data[i]) << (8 * i);
+	}
+	return value;
+}
+
+static const FieldDescriptor* findField(const Descriptor* descriptor, const std::string& name)
+{
+	const FieldDescriptor* field = descriptor->FindFieldByName(name);
+	if (field)
+	{
+		return field;
+	}
+	for (int i = 0; i < descriptor->field_count(); i++)
+	{
+		if (descriptor->field(i)->json_name() == name)
+		{
+			return descriptor->field(i);
+		}
+	}
+	return nullptr;
+}
+
+static double getDefault(const FieldDescriptor* field)
+{
+	switch (field->cpp_type())
+	{
+	case FieldDescriptor::CPPTYPE_INT32:  return field->default_value_int32();
+	case FieldDescriptor::CPPTYPE_INT64:  return static_cast<double>(field->default_value_int64());
+	case FieldDescriptor::CPPTYPE_UINT32: return field->default_value_uint32();
+	case FieldDescriptor::CPPTYPE_UINT64: return static_cast<double>(field->default_value_uint64());
+	case FieldDescriptor::CPPTYPE_DOUBLE: return field->default_value_double();
+	case FieldDescriptor::CPPTYPE_FLOAT:  return field->default_value_float();
+	case FieldDescriptor::CPPTYPE_BOOL:   return field->default_value_bool() ? 1.0 : 0.0;
+	case FieldDescriptor::CPPTYPE_ENUM:   return field->default_value_enum()->number();
+	default:                              return 0.0;
+	}
+}
+
+/** @brief Rounds towards negative infinity, so windows before 1970 are aligned as well */
+static int64_t floorDivide(int64_t value, int64_t divisor)
+{
+	const int64_t quotient = value / divisor;
+	return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+/** @brief The shortest representation that parses back to the same double, null for NaN and infinity */
+static void appendNumber(std::string& output, double value)
+{
+	if (!std::isfinite(value))
+	{
+		output += "null";
+		return;
+	}
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.15g", value);
+	if (std::strtod(buffer, nullptr) != value)
+	{
+		snprintf(buffer, sizeof(buffer), "%.17g", value);
+	}
+	output += buffer;
+}
+
+static void appendString(std::string& output, const std::string& text)
+{
+	output += '"';
+	for (const char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			output += '\\';
+		}
+		output += c;
+	}
+	output += '"';
+}
+
+bool WindowAggregator::parseFunctions(const std::vector<std::string>& names, int& functions)
+{
+	if (names.empty())
+	{
+		functions = ALL;
+		return true;
+	}
+	functions = 0;
+	for (const auto& name : names)
+	{
+		if (name == "min")        functions |= MIN;
+		else if (name == "max")   functions |= MAX;
+		else if (name == "mean")  functions |= MEAN;
+		else if (name == "count") functions |= COUNT;
+		else if (name == "last")  functions |= LAST;
+		else return false;
+	}
+	return true;
+}
+
+WindowAggregator::WindowAggregator(const std::shared_ptr<const ProtobufSchema>& schema, int64_t window_us, int64_t step_us, int functions)
+	: schema(schema)
+	, window_us(window_us)
+	, step_us(step_us)
+	, steps_per_window(window_us / step_us)
+	, functions(functions)
+	, min_index(std::numeric_limits<int64_t>::min())
+	, sample_count(0)
+	, window_count(0)
+	, late_count(0)
+	, malformed_count(0)
+{
+}
+
+std::shared_ptr<WindowAggregator> WindowAggregator::compile(const std::shared_ptr<const ProtobufSchema>& schema, const std::vector<std::string>& paths, int64_t window_us, int64_t step_us, int functions, std::string& error)
+{
+	if (window_us <= 0 || step_us <= 0 || window_us % step_us != 0)
+	{
+		error = "the window length has to be a multiple of the step";
+		return nullptr;
+	}
+	if (paths.empty())
+	{
+		error = "no fields to aggregate";
+		return nullptr;
+	}
+
+	std::shared_ptr<WindowAggregator> aggregator(new WindowAggregator(schema, window_us, step_us, functions));
+	for (const auto& path : paths)
+	{
+		MessagePlan* plan = &aggregator->root;
+		const Descriptor* descriptor = schema->descriptor;
+		size_t begin = 0;
+		while (true)
+		{
+			const size_t end = path.find('.', begin);
+			const bool is_last = end == std::string::npos;
+			const FieldDescriptor* field = findField(descriptor, path.substr(begin, is_last ? std::string::npos : end - begin));
+			if (!field)
+			{
+				error = "field " + path + " does not exist in " + schema->descriptor->full_name();
+				return nullptr;
+			}
+			if (field->is_repeated())
+			{
+				error = "field " + path + " is repeated, only singular fields can be aggregated";
+				return nullptr;
+			}
+			if (!is_last)
+			{
+				if (field->type() != FieldDescriptor::TYPE_MESSAGE)
+				{
+					error = "field " + path.substr(0, end) + " is not a message";
+					return nullptr;
+				}
+				auto field_plan = std::find_if(plan->fields.begin(), plan->fields.end(), [field](const FieldPlan& existing) { return existing.nested && existing.number == static_cast<uint32_t>(field->number()); });
+				if (field_plan == plan->fields.end())
+				{
+					plan->fields.push_back({ static_cast<uint32_t>(field->number()), nullptr, 0, std::unique_ptr<MessagePlan>(new MessagePlan()) });
+					field_plan = plan->fields.end() - 1;
+				}
+				plan = field_plan->nested.get();
+				descriptor = field->message_type();
+				begin = end + 1;
+				continue;
+			}
+
+			if (field->cpp_type() == FieldDescriptor::CPPTYPE_STRING || field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE)
+			{
+				error = "field " + path + " is not numeric";
+				return nullptr;
+			}
+			if (std::any_of(plan->fields.begin(), plan->fields.end(), [field](const FieldPlan& existing) { return existing.field == field; }))
+			{
+				error = "field " + path + " is aggregated twice";
+				return nullptr;
+			}
+			plan->fields.push_back({ static_cast<uint32_t>(field->number()), field, aggregator->paths.size(), nullptr });
+			aggregator->paths.push_back(path);
+			aggregator->defaults.push_back(getDefault(field));
+			break;
+		}
+	}
+
+	std::vector<MessagePlan*> plans = { &aggregator->root };
+	while (!plans.empty())
+	{
+		MessagePlan* plan = plans.back();
+		plans.pop_back();
+		std::sort(plan->fields.begin(), plan->fields.end(), [](const FieldPlan& a, const FieldPlan& b) { return a.number < b.number; });
+		for (auto& field : plan->fields)
+		{
+			if (field.nested)
+			{
+				plans.push_back(field.nested.get());
+			}
+		}
+	}
+	return aggregator;
+}
+
+bool WindowAggregator::add(const char* data, size_t size, int64_t time_us, std::vector<std::string>& windows)
+{
+	const int64_t index = floorDivide(time_us, step_us);
+	std::lock_guard<std::mutex> lock(mtx);
+	if (index < min_index)
+	{
+		late_count++;
+		return true;
+	}
+
+	values = defaults;
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+	if (!decodeMessage(root, begin, begin + size, values, 0))
+	{
+		malformed_count++;
+		return false;
+	}
+
+	if (!buckets.empty() && index > buckets.back().index)
+	{
+		closeWindows(index, windows);
+	}
+	if (buckets.empty() || buckets.back().index != index)
+	{
+		Bucket bucket;
+		bucket.index        = index;
+		bucket.count        = 0;
+		bucket.last_time_us = time_us;
+		bucket.fields.resize(paths.size());
+		buckets.push_back(std::move(bucket));
+	}
+	min_index = index;
+
+	Bucket& bucket = buckets.back();
+	for (size_t slot = 0; slot < values.size(); slot++)
+	{
+		Aggregate& aggregate = bucket.fields[slot];
+		const double value = values[slot];
+		if (bucket.count == 0)
+		{
+			aggregate = { value, value, value, value };
+			continue;
+		}
+		aggregate.min  = std::min(aggregate.min, value);
+		aggregate.max  = std::max(aggregate.max, value);
+		aggregate.sum += value;
+		if (time_us >= bucket.last_time_us)
+		{
+			aggregate.last = value;
+		}
+	}
+	bucket.last_time_us = std::max(bucket.last_time_us, time_us);
+	bucket.count++;
+	sample_count++;
+	last_sample = std::chrono::steady_clock::now();
+	return true;
+}
+
+void WindowAggregator::flushIdle(std::chrono::steady_clock::time_point now, std::vector<std::string>& windows)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (buckets.empty() || now - last_sample < std::chrono::microseconds(window_us))
+	{
+		return;
+	}
+	// every window containing the newest step is published, later samples of these windows are late
+	const int64_t last_end_index = buckets.back().index + steps_per_window;
+	closeWindows(last_end_index, windows);
+	min_index = last_end_index;
+}
+
+std::chrono::steady_clock::time_point WindowAggregator::getIdleDeadline(std::chrono::steady_clock::time_point now) const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return (buckets.empty() ? now : last_sample) + std::chrono::microseconds(window_us);
+}
+
+void WindowAggregator::closeWindows(int64_t last_end_index, std::vector<std::string>& windows)
+{
+	// a window ending at step e covers the buckets e - steps_per_window .. e - 1, only windows with samples are published
+	const int64_t newest_index = buckets.back().index;
+	for (int64_t end_index = newest_index + 1; end_index <= std::min(last_end_index, newest_index + steps_per_window); end_index++)
+	{
+		windows.push_back(formatWindow(end_index));
+		window_count++;
+	}
+	while (!buckets.empty() && buckets.front().index <= last_end_index - steps_per_window)
+	{
+		buckets.pop_front();
+	}
+}
+
+std::string WindowAggregator::formatWindow(int64_t end_index) const
+{
+	const int64_t start_index = end_index - steps_per_window;
+	uint64_t count = 0;
+	std::vector<Aggregate> fields(paths.size());
+	for (const Bucket& bucket : buckets)
+	{
+		if (bucket.index < start_index || bucket.index >= end_index || bucket.count == 0)
+		{
+			continue;
+		}
+		for (size_t slot = 0; slot < fields.size(); slot++)
+		{
+			const Aggregate& aggregate = bucket.fields[slot];
+			if (count == 0)
+			{
+				fields[slot] = aggregate;
+				continue;
+			}
+			fields[slot].min  = std::min(fields[slot].min, aggregate.min);
+			fields[slot].max  = std::max(fields[slot].max, aggregate.max);
+			fields[slot].sum += aggregate.sum;
+			fields[slot].last = aggregate.last;   // the buckets are in ascending order
+		}
+		count += bucket.count;
+	}
+
+	std::string output = "{\"start\":" + std::to_string(start_index * step_us) + ",\"end\":" + std::to_string(end_index * step_us);
+	if (functions & COUNT)
+	{
+		output += ",\"count\":" + std::to_string(count);
+	}
+	output += ",\"fields\":{";
+	for (size_t slot = 0; slot < fields.size(); slot++)
+	{
+		if (slot > 0)
+		{
+			output += ',';
+		}
+		appendString(output, paths[slot]);
+		output += ":{";
+		const char* separator = "";
+		const std::pair<int, const char*> names[] = { { MIN, "min" }, { MAX, "max" }, { MEAN, "mean" }, { LAST, "last" } };
+		for (const auto& name : names)
+		{
+			if ((functions & name.first) == 0)
+			{
+				continue;
+			}
+			output += separator;
+			output += '"';
+			output += name.second;
+			output += "\":";
+			const Aggregate& aggregate = fields[slot];
+			appendNumber(output, name.first == MIN ? aggregate.min : name.first == MAX ? aggregate.max : name.first == MEAN ? aggregate.sum / static_cast<double>(count) : aggregate.last);
+			separator = ",";
+		}
+		output += '}';
+	}
+	output += "}}";
+	return output;
+}
+
+bool WindowAggregator::decodeMessage(const MessagePlan& plan, const uint8_t* data, const uint8_t* end, std::vector<double>& decoded, int depth) const
+{
+	if (depth >= MAX_DEPTH)
+	{
+		return false;
+	}
+	while (data < end)
+	{
+		uint64_t tag;
+		if (!readVarint(data, end, tag))
+		{
+			return false;
+		}
+		const uint32_t number    = static_cast<uint32_t>(tag >> 3);
+		const uint32_t wire_type = static_cast<uint32_t>(tag & 0x07);
+		const uint8_t* value_start = data;
+		if (!skipValue(data, end, wire_type, number, depth))
+		{
+			return false;
+		}
+
+		auto field_plan = std::lower_bound(plan.fields.begin(), plan.fields.end(), number, [](const FieldPlan& field, uint32_t value) { return field.number < value; });
+		if (field_plan == plan.fields.end() || field_plan->number != number)
+		{
+			continue;
+		}
+		if (field_plan->nested)
+		{
+			// a singular message may be split into several parts, they are merged
+			uint64_t length;
+			if (wire_type == WIRE_LENGTH_DELIMITED && readVarint(value_start, end, length) && !decodeMessage(*field_plan->nested, value_start, data, decoded, depth + 1))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		uint64_t raw = 0;
+		if (wire_type == WIRE_VARINT)
+		{
+			readVarint(value_start, end, raw);
+		}
+		else if (wire_type == WIRE_FIXED32)
+		{
+			raw = readFixed(value_start, 4);
+		}
+		else if (wire_type == WIRE_FIXED64)
+		{
+			raw = readFixed(value_start, 8);
+		}
+		else
+		{
+			continue;
+		}
+
+		double& value = decoded[field_plan->slot];
+		switch (field_plan->field->type())
+		{
+		case FieldDescriptor::TYPE_INT32:
+		case FieldDescriptor::TYPE_ENUM:
+		case FieldDescriptor::TYPE_SFIXED32:
+			value = static_cast<int32_t>(static_cast<uint32_t>(raw));
+			break;
+		case FieldDescriptor::TYPE_INT64:
+		case FieldDescriptor::TYPE_SFIXED64:
+			value = static_cast<double>(static_cast<int64_t>(raw));
+			break;
+		case FieldDescriptor::TYPE_UINT32:
+		case FieldDescriptor::TYPE_FIXED32:
+			value = static_cast<uint32_t>(raw);
+			break;
+		case FieldDescriptor::TYPE_UINT64:
+		case FieldDescriptor::TYPE_FIXED64:
+			value = static_cast<double>(raw);
+			break;
+		case FieldDescriptor::TYPE_BOOL:
+			value = raw != 0 ? 1.0 : 0.0;
+			break;
+		case FieldDescriptor::TYPE_SINT32:
+		case FieldDescriptor::TYPE_SINT64:
+			value = static_cast<double>(static_cast<int64_t>((raw >> 1) ^ (~(raw & 1) + 1)));
+			break;
+		case FieldDescriptor::TYPE_FLOAT:
+		{
+			const uint32_t bits = static_cast<uint32_t>(raw);
+			float number;
+			std::memcpy(&number, &bits, sizeof(number));
+			value = number;
+			break;
+		}
+		case FieldDescriptor::TYPE_DOUBLE:
+			std::memcpy(&value, &raw, sizeof(value));
+			break;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+std::string WindowAggregator::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	return std::to_string(sample_count) + " samples, " + std::to_string(window_count) + " windows published, "
+		+ std::to_string(late_count) + " late, " + std::to_string(malformed_count) + " malformed";
+}
@@ -0,0 +1,163 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "ProtobufSchema.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Aggregates numeric fields of a protobuf message over time windows.
+ *
+ * The windows are aligned to the timestamps of the messages (the send time of
+ * the eCAL publisher), not to the time they are received. Tumbling windows
+ * have a step equal to their length, sliding windows advance by a step that
+ * is a fraction of their length. Every step is collected in a bucket (min,
+ * max, sum, count and last value per field), so a window is the combination
+ * of the buckets it covers and a sample is only added once.
+ *
+ * A window is closed by the first sample of a later step, or by flushIdle()
+ * once no sample arrived for the length of a window. Samples older than the
+ * newest step are late and dropped. The result is a JSON document:
+ *
+ *   {"start":<us>,"end":<us>,"count":3,"fields":{"speed":{"min":1,"max":4,"mean":2.5,"last":4}}}
+ *
+ * The fields are decoded from the wire format, other fields are skipped by
+ * their length. Fields that are not set count as their default value.
+ */
+class WindowAggregator
+{
+public:
+  enum Function
+  {
+    MIN   = 1 << 0,
+    MAX   = 1 << 1,
+    MEAN  = 1 << 2,
+    COUNT = 1 << 3,
+    LAST  = 1 << 4,
+    ALL   = MIN | MAX | MEAN | COUNT | LAST,
+  };
+
+  /**
+   * @param names   min, max, mean, count and last
+   * @param functions receives the combined Function flags, ALL if names is empty
+   *
+   * @return false if a name is unknown
+   */
+  static bool parseFunctions(const std::vector<std::string>& names, int& functions);
+
+  /**
+   * @brief Resolves the field paths against the message type of the schema
+   *
+   * @param schema     the message type
+   * @param paths      dot separated paths of numeric, bool or enum fields, as in the .proto file or as JSON names
+   * @param window_us  length of a window
+   * @param step_us    distance between the starts of two windows, a divisor of window_us
+   * @param functions  Function flags of the aggregates to publish
+   * @param error      receives the reason if a path cannot be aggregated
+   *
+   * @return the aggregator, or nullptr if a path does not exist or is not numeric
+   */
+  static std::shared_ptr<WindowAggregator> compile(const std::shared_ptr<const ProtobufSchema>& schema, const std::vector<std::string>& paths, int64_t window_us, int64_t step_us, int functions, std::string& error);
+
+  /**
+   * @brief Adds a serialized message to the window of its timestamp
+   *
+   * @param data     the serialized message
+   * @param size     length of the message
+   * @param time_us  timestamp of the message
+   * @param windows  receives the JSON documents of the windows closed by this sample
+   *
+   * @return false if the message is malformed
+   */
+  bool add(const char* data, size_t size, int64_t time_us, std::vector<std::string>& windows);
+
+  /** @brief Closes the open windows if no sample was added for the length of a window */
+  void flushIdle(std::chrono::steady_clock::time_point now, std::vector<std::string>& windows);
+
+  /** @return when flushIdle closes the open windows, without open windows the earliest a window opened from now on can be closed */
+  std::chrono::steady_clock::time_point getIdleDeadline(std::chrono::steady_clock::time_point now) const;
+
+  /** @return aggregated samples, published windows, late and malformed samples */
+  std::string getStatistics() const;
+
+private:
+  struct MessagePlan;
+
+  struct FieldPlan
+  {
+    uint32_t                                 number;
+    const google::protobuf::FieldDescriptor* field;   // set for the aggregated fields
+    size_t                                   slot;
+    std::unique_ptr<MessagePlan>             nested;  // set for submessages on the path to an aggregated field
+  };
+
+  struct MessagePlan
+  {
+    std::vector<FieldPlan> fields;   // sorted by number
+  };
+
+  struct Aggregate
+  {
+    double min;
+    double max;
+    double sum;
+    double last;
+  };
+
+  struct Bucket
+  {
+    int64_t                index;   // time / step
+    uint64_t               count;
+    int64_t                last_time_us;
+    std::vector<Aggregate> fields;  // by slot
+  };
+
+  WindowAggregator(const std::shared_ptr<const ProtobufSchema>& schema, int64_t window_us, int64_t step_us, int functions);
+
+  bool decodeMessage(const MessagePlan& plan, const uint8_t* data, const uint8_t* end, std::vector<double>& decoded, int depth) const;
+  void closeWindows(int64_t last_end_index, std::vector<std::string>& windows);
+  std::string formatWindow(int64_t end_index) const;
+
+  const std::shared_ptr<const ProtobufSchema> schema;
+  const int64_t                               window_us;
+  const int64_t                               step_us;
+  const int64_t                               steps_per_window;
+  const int                                   functions;
+  std::vector<std::string>                    paths;      // by slot
+  std::vector<double>                         defaults;   // by slot, the value of a field that is not set
+  MessagePlan                                 root;
+
+  mutable std::mutex                          mtx;
+  std::deque<Bucket>                          buckets;          // ascending, at most steps_per_window
+  int64_t                                     min_index;        // samples of earlier steps are late
+  std::chrono::steady_clock::time_point       last_sample;
+  std::vector<double>                         values;
+  uint64_t                                    sample_count;
+  uint64_t                                    window_count;
+  uint64_t                                    late_count;
+  uint64_t                                    malformed_count;
+};
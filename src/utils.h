@@ -17,8 +17,12 @@
  * ========================= MQTT2eCAL LICENSE =================================
 */
 
+#pragma once
+
 #include <string>
 #include <chrono>
+#include <iostream>
+#include <map>
 
 #include "MqttTopic.h"
 #include "EcalTopic.h"
@@ -29,11 +33,14 @@ struct GeneralSettings
   bool hide_secrets;
   std::string mqtt_protocol_version;
   std::string ecal_process_name;
+  /** Time in ms to wait for all brokers to connect and acknowledge the subscriptions before reporting a problem */
+  int startup_timeout;
 
   GeneralSettings() :
       hide_secrets(true),
       mqtt_protocol_version("v3.1.1"),
-      ecal_process_name("mqtt_ecal_bridge")
+      ecal_process_name("mqtt_ecal_bridge"),
+      startup_timeout(10000)
   {}
 };
 
@@ -157,4 +164,5 @@ static void printGeneralSettings(const GeneralSettings& general_settings)
     printOutput("hide_secrets: " + std::to_string(general_settings.hide_secrets));
     printOutput("mqtt_protocol_version: " + general_settings.mqtt_protocol_version);
     printOutput("ecal_process_name: " + general_settings.ecal_process_name);
+    printOutput("startup_timeout: " + std::to_string(general_settings.startup_timeout));
 }
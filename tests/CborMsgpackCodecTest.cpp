@@ -0,0 +1,200 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "CborMsgpackCodec.h"
+#include "TestSchema.h"
+
+#include <google/protobuf/util/message_differencer.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+namespace
+{
+  class CborMsgpackCodecTest : public ::testing::TestWithParam<CborMsgpackCodec::Format>
+  {
+  protected:
+    void SetUp() override
+    {
+      schema = test_schema::build();
+      ASSERT_NE(schema, nullptr);
+    }
+
+    std::unique_ptr<google::protobuf::Message> newMessage() const
+    {
+      return std::unique_ptr<google::protobuf::Message>(schema->prototype->New());
+    }
+
+    // a message with every kind of field set
+    std::unique_ptr<google::protobuf::Message> sample() const
+    {
+      auto message = newMessage();
+      auto reflection = message->GetReflection();
+      auto field = [this](const char* name) { return schema->descriptor->FindFieldByName(name); };
+      reflection->SetInt32(message.get(), field("id"), -123456);
+      reflection->SetInt64(message.get(), field("stamp"), -9007199254740993LL);
+      reflection->SetUInt32(message.get(), field("count"), 4000000000u);
+      reflection->SetDouble(message.get(), field("value"), 3.141592653589793);
+      reflection->SetFloat(message.get(), field("ratio"), 0.5f);
+      reflection->SetBool(message.get(), field("valid"), true);
+      reflection->SetString(message.get(), field("name"), "sensor");
+      reflection->SetString(message.get(), field("data"), std::string("\x00\xff\x10", 3));
+      reflection->SetEnumValue(message.get(), field("mode"), 1);
+      reflection->SetInt32(message.get(), field("delta_value"), -2);
+
+      auto position = reflection->MutableMessage(message.get(), field("position"));
+      position->GetReflection()->SetDouble(position, position->GetDescriptor()->FindFieldByName("x"), -1.25);
+      for (int value : { 1, -1, 70000 })
+      {
+        reflection->AddInt32(message.get(), field("values"), value);
+      }
+      for (double x : { 1.0, 2.0 })
+      {
+        auto point = reflection->AddMessage(message.get(), field("track"));
+        point->GetReflection()->SetDouble(point, point->GetDescriptor()->FindFieldByName("x"), x);
+      }
+      for (auto const& counter : { std::make_pair("a", 1), std::make_pair("b", -2) })
+      {
+        auto entry = reflection->AddMessage(message.get(), field("counters"));
+        entry->GetReflection()->SetString(entry, entry->GetDescriptor()->FindFieldByName("key"), counter.first);
+        entry->GetReflection()->SetInt32(entry, entry->GetDescriptor()->FindFieldByName("value"), counter.second);
+      }
+      return message;
+    }
+
+    bool decode(const std::string& data, google::protobuf::Message& message, std::string& error) const
+    {
+      return CborMsgpackCodec::decode(data.data(), data.size(), GetParam(), message, error);
+    }
+
+    std::shared_ptr<const ProtobufSchema> schema;
+  };
+}
+
+TEST(CborMsgpackCodecFormatTest, ParsesFormatNames)
+{
+  CborMsgpackCodec::Format format;
+  ASSERT_TRUE(CborMsgpackCodec::parseFormat("cbor", format));
+  EXPECT_EQ(format, CborMsgpackCodec::CBOR);
+  ASSERT_TRUE(CborMsgpackCodec::parseFormat("msgpack", format));
+  EXPECT_EQ(format, CborMsgpackCodec::MESSAGEPACK);
+  EXPECT_FALSE(CborMsgpackCodec::parseFormat("json", format));
+}
+
+TEST(CborMsgpackCodecFormatTest, EncodesKnownBytes)
+{
+  auto schema = test_schema::build();
+  ASSERT_NE(schema, nullptr);
+  std::unique_ptr<google::protobuf::Message> message(schema->prototype->New());
+  message->GetReflection()->SetInt32(message.get(), schema->descriptor->FindFieldByName("id"), 1);
+
+  std::string output;
+  CborMsgpackCodec::encode(*message, CborMsgpackCodec::CBOR, output);
+  EXPECT_EQ(output, std::string("\xa1\x62id\x01", 5));
+  CborMsgpackCodec::encode(*message, CborMsgpackCodec::MESSAGEPACK, output);
+  EXPECT_EQ(output, std::string("\x81\xa2id\x01", 5));
+}
+
+TEST_P(CborMsgpackCodecTest, RoundTripKeepsEveryField)
+{
+  auto original = sample();
+  std::string encoded;
+  CborMsgpackCodec::encode(*original, GetParam(), encoded);
+
+  auto decoded = newMessage();
+  std::string error;
+  ASSERT_TRUE(decode(encoded, *decoded, error)) << error;
+  EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(*original, *decoded))
+    << original->DebugString() << "\n" << decoded->DebugString();
+}
+
+TEST_P(CborMsgpackCodecTest, EmptyMessageRoundTrips)
+{
+  std::string encoded;
+  CborMsgpackCodec::encode(*newMessage(), GetParam(), encoded);
+  EXPECT_EQ(encoded.size(), 1u);
+
+  auto decoded = newMessage();
+  std::string error;
+  EXPECT_TRUE(decode(encoded, *decoded, error)) << error;
+}
+
+TEST_P(CborMsgpackCodecTest, EveryTruncationIsRejected)
+{
+  std::string encoded;
+  CborMsgpackCodec::encode(*sample(), GetParam(), encoded);
+  for (size_t size = 0; size < encoded.size(); size++)
+  {
+    auto decoded = newMessage();
+    std::string error;
+    EXPECT_FALSE(decode(encoded.substr(0, size), *decoded, error)) << "truncated to " << size << " bytes";
+    EXPECT_FALSE(error.empty());
+  }
+}
+
+TEST_P(CborMsgpackCodecTest, TrailingDataIsRejected)
+{
+  std::string encoded;
+  CborMsgpackCodec::encode(*sample(), GetParam(), encoded);
+  auto decoded = newMessage();
+  std::string error;
+  EXPECT_FALSE(decode(encoded + '\x01', *decoded, error));
+}
+
+TEST_P(CborMsgpackCodecTest, WrongTypesAreRejected)
+{
+  // {"id": "x"} and {"position": 1}
+  const bool cbor = GetParam() == CborMsgpackCodec::CBOR;
+  const std::string string_for_int   = cbor ? std::string("\xa1\x62id\x61x", 5)        : std::string("\x81\xa2id\xa1x", 5);
+  const std::string int_for_message  = cbor ? std::string("\xa1\x68position\x01", 11) : std::string("\x81\xa8position\x01", 11);
+  for (auto const& data : { string_for_int, int_for_message })
+  {
+    auto decoded = newMessage();
+    std::string error;
+    EXPECT_FALSE(decode(data, *decoded, error));
+    EXPECT_FALSE(error.empty());
+  }
+}
+
+TEST_P(CborMsgpackCodecTest, AcceptsFieldNumbersAndIgnoresUnknownKeys)
+{
+  // {1: 5, "other": 7}
+  const bool cbor = GetParam() == CborMsgpackCodec::CBOR;
+  const std::string data = cbor ? std::string("\xa2\x01\x05\x65other\x07", 10) : std::string("\x82\x01\x05\xa5other\x07", 10);
+  auto decoded = newMessage();
+  std::string error;
+  ASSERT_TRUE(decode(data, *decoded, error)) << error;
+  EXPECT_EQ(decoded->GetReflection()->GetInt32(*decoded, schema->descriptor->FindFieldByName("id")), 5);
+}
+
+TEST_P(CborMsgpackCodecTest, HugeElementCountIsRejected)
+{
+  // a map that claims 2^32 - 1 entries
+  const bool cbor = GetParam() == CborMsgpackCodec::CBOR;
+  const std::string data = cbor ? std::string("\xba\xff\xff\xff\xff", 5) : std::string("\xdf\xff\xff\xff\xff", 5);
+  auto decoded = newMessage();
+  std::string error;
+  EXPECT_FALSE(decode(data, *decoded, error));
+}
+
+INSTANTIATE_TEST_SUITE_P(Formats, CborMsgpackCodecTest,
+  ::testing::Values(CborMsgpackCodec::CBOR, CborMsgpackCodec::MESSAGEPACK),
+  [](const ::testing::TestParamInfo<CborMsgpackCodec::Format>& info) { return info.param == CborMsgpackCodec::CBOR ? "Cbor" : "MessagePack"; });
@@ -0,0 +1,224 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "ChunkReassembler.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  // splits a message into chunks with their headers, like the sender of a route with chunk_size
+  std::vector<std::string> split(const std::string& message, size_t chunk_size, uint32_t message_id, uint32_t sender_id = 1)
+  {
+    const uint32_t count = static_cast<uint32_t>((message.size() + chunk_size - 1) / chunk_size);
+    std::vector<std::string> chunks(count);
+    for (uint32_t index = 0; index < count; index++)
+    {
+      const size_t offset = index * chunk_size;
+      const ChunkHeader header = { sender_id, message_id, index, count, static_cast<uint32_t>(message.size()), static_cast<uint32_t>(offset) };
+      header.write(message.data() + offset, std::min(chunk_size, message.size() - offset), chunks[index]);
+    }
+    return chunks;
+  }
+
+  std::string testMessage(size_t size)
+  {
+    std::string message(size, '\0');
+    for (size_t i = 0; i < size; i++)
+    {
+      message[i] = static_cast<char>(i * 31 + 7);
+    }
+    return message;
+  }
+
+  // adds the chunk and returns the completed message, or an empty string
+  std::string add(ChunkReassembler& reassembler, const std::string& chunk, const std::string& topic = "topic")
+  {
+    const char* message = nullptr;
+    size_t size = 0;
+    return reassembler.add(topic, chunk.data(), chunk.size(), message, size) ? std::string(message, size) : std::string();
+  }
+
+  bool contains(const std::string& statistics, const std::string& text)
+  {
+    return statistics.find(text) != std::string::npos;
+  }
+}
+
+TEST(ChunkHeaderTest, WriteAndReadRoundTrip)
+{
+  const ChunkHeader header = { 0xdeadbeef, 7, 2, 3, 25, 20 };
+  std::string chunk;
+  header.write("12345", 5, chunk);
+  ASSERT_EQ(chunk.size(), ChunkHeader::SIZE + 5);
+
+  ChunkHeader read;
+  ASSERT_TRUE(read.read(chunk.data(), chunk.size()));
+  EXPECT_EQ(read.sender_id, 0xdeadbeefu);
+  EXPECT_EQ(read.message_id, 7u);
+  EXPECT_EQ(read.index, 2u);
+  EXPECT_EQ(read.count, 3u);
+  EXPECT_EQ(read.total_size, 25u);
+  EXPECT_EQ(read.offset, 20u);
+}
+
+TEST(ChunkHeaderTest, RejectsHeadersOutOfBounds)
+{
+  std::string chunk;
+  ChunkHeader read;
+  // chunk beyond the total size, index beyond the count, no chunks
+  for (const ChunkHeader& header : { ChunkHeader{ 1, 1, 0, 2, 10, 8 }, ChunkHeader{ 1, 1, 2, 2, 10, 0 }, ChunkHeader{ 1, 1, 0, 0, 10, 0 } })
+  {
+    header.write("12345", 5, chunk);
+    EXPECT_FALSE(read.read(chunk.data(), chunk.size()));
+  }
+  // offset and size that overflow 32 bits
+  ChunkHeader{ 1, 1, 0, 2, 0xffffffff, 0xfffffffe }.write("12345", 5, chunk);
+  EXPECT_FALSE(read.read(chunk.data(), chunk.size()));
+
+  ChunkHeader{ 1, 1, 0, 1, 5, 0 }.write("12345", 5, chunk);
+  EXPECT_FALSE(read.read(chunk.data(), ChunkHeader::SIZE - 1));
+  chunk[0] = 'x';
+  EXPECT_FALSE(read.read(chunk.data(), chunk.size()));
+}
+
+TEST(ChunkReassemblerTest, ReassemblesChunksInAnyOrder)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 1 << 20);
+  const std::string message = testMessage(1000);
+  auto chunks = split(message, 128, 1);
+  ASSERT_EQ(chunks.size(), 8u);
+
+  const size_t order[] = { 7, 0, 3, 5, 1, 6, 4 };
+  for (size_t index : order)
+  {
+    EXPECT_TRUE(add(reassembler, chunks[index]).empty());
+  }
+  EXPECT_EQ(add(reassembler, chunks[2]), message);
+}
+
+TEST(ChunkReassemblerTest, SingleChunkIsPassedOn)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 0);
+  auto chunks = split("small", 100, 1);
+  ASSERT_EQ(chunks.size(), 1u);
+  EXPECT_EQ(add(reassembler, chunks[0]), "small");
+}
+
+TEST(ChunkReassemblerTest, InterleavedMessagesAreKeptApart)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 1 << 20);
+  const std::string first  = testMessage(300);
+  const std::string second = std::string(300, 'x');
+  auto first_chunks  = split(first, 100, 1);
+  auto second_chunks = split(second, 100, 1, 2);   // same message id, another sender
+  auto other_topic   = split(second, 100, 1);      // same ids, another topic
+
+  for (size_t i = 0; i < 2; i++)
+  {
+    EXPECT_TRUE(add(reassembler, first_chunks[i]).empty());
+    EXPECT_TRUE(add(reassembler, second_chunks[i]).empty());
+    EXPECT_TRUE(add(reassembler, other_topic[i], "other").empty());
+  }
+  EXPECT_EQ(add(reassembler, second_chunks[2]), second);
+  EXPECT_EQ(add(reassembler, other_topic[2], "other"), second);
+  EXPECT_EQ(add(reassembler, first_chunks[2]), first);
+}
+
+TEST(ChunkReassemblerTest, DuplicatesAreIgnored)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 1 << 20);
+  const std::string message = testMessage(300);
+  auto chunks = split(message, 100, 1);
+  add(reassembler, chunks[0]);
+  EXPECT_TRUE(add(reassembler, chunks[0]).empty());
+  add(reassembler, chunks[1]);
+  EXPECT_EQ(add(reassembler, chunks[2]), message);
+
+  // a redelivered chunk of a completed message does not start it again
+  EXPECT_TRUE(add(reassembler, chunks[1]).empty());
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "0 incomplete")) << reassembler.getStatistics();
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "2 duplicate")) << reassembler.getStatistics();
+}
+
+TEST(ChunkReassemblerTest, ChunksThatDoNotMatchTheirMessageAreInvalid)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 1 << 20);
+  std::string chunk;
+  ChunkHeader{ 1, 1, 0, 3, 300, 0 }.write("abc", 3, chunk);
+  add(reassembler, chunk);
+
+  // another total size and another chunk count for the same message
+  ChunkHeader{ 1, 1, 1, 3, 400, 100 }.write("abc", 3, chunk);
+  EXPECT_TRUE(add(reassembler, chunk).empty());
+  ChunkHeader{ 1, 1, 1, 4, 300, 100 }.write("abc", 3, chunk);
+  EXPECT_TRUE(add(reassembler, chunk).empty());
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "2 invalid")) << reassembler.getStatistics();
+}
+
+TEST(ChunkReassemblerTest, OverlappingChunksDoNotCompleteTheMessage)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 1 << 20);
+  std::string chunk;
+  ChunkHeader{ 1, 1, 0, 2, 10, 0 }.write("12345", 5, chunk);
+  add(reassembler, chunk);
+  ChunkHeader{ 1, 1, 1, 2, 10, 2 }.write("34567", 5, chunk);
+  EXPECT_TRUE(add(reassembler, chunk).empty());
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "0 incomplete (0 bytes)")) << reassembler.getStatistics();
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "1 invalid")) << reassembler.getStatistics();
+}
+
+TEST(ChunkReassemblerTest, MemoryLimitRejectsNewMessages)
+{
+  ChunkReassembler reassembler(std::chrono::seconds(10), 500);
+  const std::string first  = testMessage(300);
+  const std::string second = testMessage(300);
+  auto first_chunks  = split(first, 100, 1);
+  auto second_chunks = split(second, 100, 2);
+
+  add(reassembler, first_chunks[0]);
+  EXPECT_TRUE(add(reassembler, second_chunks[0]).empty());
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "1 chunks over the memory limit")) << reassembler.getStatistics();
+
+  // the message in progress is completed, then there is room again
+  add(reassembler, first_chunks[1]);
+  EXPECT_EQ(add(reassembler, first_chunks[2]), first);
+  add(reassembler, second_chunks[0]);
+  add(reassembler, second_chunks[1]);
+  EXPECT_EQ(add(reassembler, second_chunks[2]), second);
+}
+
+TEST(ChunkReassemblerTest, IncompleteMessagesTimeOut)
+{
+  ChunkReassembler reassembler(std::chrono::milliseconds(20), 500);
+  const std::string message = testMessage(300);
+  auto chunks = split(message, 100, 1);
+  add(reassembler, chunks[0]);
+  add(reassembler, chunks[1]);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  // the expired message is dropped with its memory, the last chunk starts it again
+  EXPECT_TRUE(add(reassembler, chunks[2]).empty());
+  EXPECT_TRUE(contains(reassembler.getStatistics(), "1 incomplete (300 bytes), 1 timed out")) << reassembler.getStatistics();
+}
@@ -0,0 +1,159 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "Config.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace
+{
+  Broker validBroker()
+  {
+    Broker broker;
+    broker.name = "broker";
+    BrokerEndpoint endpoint;
+    endpoint.host = "127.0.0.1";
+    endpoint.port = 1883;
+    broker.endpoints.push_back(endpoint);
+    return broker;
+  }
+
+  class ConfigFile
+  {
+  public:
+    explicit ConfigFile(const std::string& content)
+    {
+      char name[] = "/tmp/config_test_XXXXXX";
+      int fd = mkstemp(name);
+      close(fd);
+      path = name;
+      std::ofstream(path) << content;
+    }
+    ~ConfigFile() { unlink(path.c_str()); }
+
+    std::string path;
+  };
+}
+
+TEST(ConfigTest, DefaultQosMustBeInRange)
+{
+  Broker broker = validBroker();
+  ASSERT_TRUE(broker.CheckValidity("v3.1.1"));
+  broker.default_qos = 2;
+  EXPECT_TRUE(broker.CheckValidity("v3.1.1"));
+  broker.default_qos = 3;
+  EXPECT_FALSE(broker.CheckValidity("v3.1.1"));
+  broker.default_qos = -1;
+  EXPECT_FALSE(broker.CheckValidity("v3.1.1"));
+}
+
+TEST(ConfigTest, PersistentV5SessionNeedsAnExpiryInterval)
+{
+  Broker broker = validBroker();
+  broker.clean_session = false;
+  EXPECT_TRUE(broker.CheckValidity("v3.1.1"));
+  EXPECT_FALSE(broker.CheckValidity("v5"));
+  broker.session_expiry_interval = 3600;
+  EXPECT_TRUE(broker.CheckValidity("v5"));
+}
+
+TEST(ConfigTest, TopicsGetTheDefaultsOfTheirBroker)
+{
+  ConfigFile file(
+    "gateway:\n"
+    "  brokers:\n"
+    "    - used:\n"
+    "      host: 127.0.0.1\n"
+    "      default_qos: 2\n"
+    "      default_retain_flag: true\n"
+    "    - unused:\n"
+    "      host: 127.0.0.1\n"
+    "  mqtt2ecal:\n"
+    "    - in:\n"
+    "      broker_name: used\n"
+    "      mqtt_payload_name: a/b\n"
+    "      ecal_out_topic_name: ab\n"
+    "    - unknown_broker:\n"
+    "      broker_name: missing\n"
+    "      mqtt_payload_name: c/d\n"
+    "      ecal_out_topic_name: cd\n"
+    "  ecal2mqtt:\n"
+    "    - out:\n"
+    "      broker_name: used\n"
+    "      ecal_topic_name: ef\n"
+    "      mqtt_out_payload_name: e/f\n"
+    "    - explicit:\n"
+    "      broker_name: used\n"
+    "      ecal_topic_name: gh\n"
+    "      mqtt_out_payload_name: g/h\n"
+    "      qos: 0\n"
+    "      retain_flag: false\n");
+
+  GeneralSettings general_settings;
+  std::map<std::string, Broker>    brokers;
+  std::map<std::string, MqttTopic> mqtt2ecal_topics;
+  std::map<std::string, EcalTopic> ecal2mqtt_topics;
+  ConfigLoadTimings timings;
+  ASSERT_TRUE(loadConfig(file.path, general_settings, brokers, mqtt2ecal_topics, ecal2mqtt_topics, timings));
+
+  EXPECT_EQ(brokers.size(), 1u);
+  EXPECT_EQ(brokers.count("used"), 1u);
+  ASSERT_EQ(mqtt2ecal_topics.size(), 1u);
+  EXPECT_EQ(mqtt2ecal_topics["in"].qos, 2);
+  ASSERT_EQ(ecal2mqtt_topics.size(), 2u);
+  EXPECT_EQ(ecal2mqtt_topics["out"].qos, 2);
+  EXPECT_TRUE(ecal2mqtt_topics["out"].retain_flag);
+  EXPECT_EQ(ecal2mqtt_topics["explicit"].qos, 0);
+  EXPECT_FALSE(ecal2mqtt_topics["explicit"].retain_flag);
+
+  auto topics_by_broker = groupTopicsByBroker(mqtt2ecal_topics, ecal2mqtt_topics);
+  ASSERT_EQ(topics_by_broker.size(), 1u);
+  EXPECT_EQ(topics_by_broker["used"].mqtt2ecal.size(), 1u);
+  EXPECT_EQ(topics_by_broker["used"].ecal2mqtt.size(), 2u);
+}
+
+TEST(ConfigTest, BrokerWithInvalidDefaultQosIsNotUsed)
+{
+  ConfigFile file(
+    "gateway:\n"
+    "  brokers:\n"
+    "    - broker:\n"
+    "      host: 127.0.0.1\n"
+    "      default_qos: 5\n"
+    "  ecal2mqtt:\n"
+    "    - out:\n"
+    "      broker_name: broker\n"
+    "      ecal_topic_name: ef\n"
+    "      mqtt_out_payload_name: e/f\n");
+
+  GeneralSettings general_settings;
+  std::map<std::string, Broker>    brokers;
+  std::map<std::string, MqttTopic> mqtt2ecal_topics;
+  std::map<std::string, EcalTopic> ecal2mqtt_topics;
+  ConfigLoadTimings timings;
+  EXPECT_FALSE(loadConfig(file.path, general_settings, brokers, mqtt2ecal_topics, ecal2mqtt_topics, timings));
+  EXPECT_TRUE(brokers.empty());
+}
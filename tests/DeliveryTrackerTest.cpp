@@ -0,0 +1,156 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "DeliveryTracker.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  EcalTopic outgoingRoute(bool retransmits)
+  {
+    EcalTopic route;
+    route.name     = "out";
+    route.envelope = true;
+    if (retransmits)
+    {
+      route.nack_topic = "out/nack";
+    }
+    return route;
+  }
+
+  MqttTopic incomingRoute(bool deduplicate, bool requests)
+  {
+    MqttTopic route;
+    route.name        = "in";
+    route.envelope    = true;
+    route.deduplicate = deduplicate;
+    if (requests)
+    {
+      route.nack_topic = "out/nack";
+    }
+    return route;
+  }
+}
+
+TEST(DeliveryTrackerTest, NumbersTheMessagesOfARoute)
+{
+  DeliveryTracker sender(42);
+  std::string first;
+  std::string second;
+  sender.wrap(outgoingRoute(false), 1000, 7, "abc", 3, first);
+  sender.wrap(outgoingRoute(false), 2000, 8, "de", 2, second);
+
+  MessageEnvelope envelope;
+  ASSERT_TRUE(envelope.read(second.data(), second.size()));
+  EXPECT_EQ(envelope.sender_id, 42u);
+  EXPECT_EQ(envelope.sequence, 1u);
+  EXPECT_EQ(envelope.send_time, 2000);
+  EXPECT_EQ(envelope.clock, 8);
+  EXPECT_EQ(second.substr(MessageEnvelope::SIZE), "de");
+}
+
+TEST(DeliveryTrackerTest, RecognizesDuplicatesAndInvalidEnvelopes)
+{
+  DeliveryTracker sender(42);
+  DeliveryTracker receiver(43);
+  std::string message;
+  sender.wrap(outgoingRoute(false), 1000, 1, "abc", 3, message);
+
+  MessageEnvelope envelope;
+  bool is_nack_due = false;
+  Nack nack;
+  const MqttTopic route = incomingRoute(true, false);
+  EXPECT_EQ(receiver.unwrap(route, message.data(), message.size(), 1500, envelope, is_nack_due, nack), DeliveryTracker::ACCEPTED);
+  EXPECT_EQ(receiver.unwrap(route, message.data(), message.size(), 1500, envelope, is_nack_due, nack), DeliveryTracker::DUPLICATE);
+  EXPECT_EQ(receiver.unwrap(route, "abc", 3, 1500, envelope, is_nack_due, nack), DeliveryTracker::INVALID);
+  EXPECT_FALSE(is_nack_due);
+  EXPECT_EQ(receiver.getDuplicateStatistics({ route })["in"], "1 duplicates suppressed by their sequence number");
+}
+
+TEST(DeliveryTrackerTest, RetransmitsTheRequestedMessages)
+{
+  DeliveryTracker sender(42);
+  DeliveryTracker receiver(43);
+  std::vector<std::string> messages(3);
+  for (auto& message : messages)
+  {
+    sender.wrap(outgoingRoute(true), 1000, 1, "abc", 3, message);
+  }
+
+  // the second message is lost
+  MessageEnvelope envelope;
+  bool is_nack_due = false;
+  Nack nack;
+  const MqttTopic route = incomingRoute(false, true);
+  receiver.unwrap(route, messages[0].data(), messages[0].size(), 1500, envelope, is_nack_due, nack);
+  EXPECT_FALSE(is_nack_due);
+  // a gap is requested at once, and again after the nack_interval
+  receiver.unwrap(route, messages[2].data(), messages[2].size(), 1500, envelope, is_nack_due, nack);
+  ASSERT_TRUE(is_nack_due);
+  EXPECT_EQ(nack.sender_id, 42u);
+  ASSERT_EQ(nack.ranges.size(), 1u);
+  EXPECT_EQ(nack.ranges.front(), (std::pair<uint64_t, uint64_t>(1, 1)));
+  EXPECT_FALSE(receiver.getDueNack("in", std::chrono::steady_clock::now(), nack));
+  EXPECT_TRUE(receiver.getDueNack("in", std::chrono::steady_clock::now() + std::chrono::seconds(1), nack));
+
+  std::string request;
+  nack.write(request);
+  std::vector<std::string> retransmitted;
+  ASSERT_TRUE(sender.collectRetransmits("out", request.data(), request.size(), retransmitted));
+  EXPECT_EQ(retransmitted, std::vector<std::string>{ messages[1] });
+
+  // NACKs for another sender are ignored
+  DeliveryTracker other(44);
+  retransmitted.clear();
+  EXPECT_FALSE(other.collectRetransmits("out", request.data(), request.size(), retransmitted));
+  EXPECT_TRUE(retransmitted.empty());
+}
+
+TEST(DeliveryTrackerTest, SuppressesRedeliveredPayloads)
+{
+  DeliveryTracker receiver(43);
+  MqttTopic route = incomingRoute(true, false);
+  route.envelope = false;
+  EXPECT_FALSE(receiver.isDuplicate(route, 1));
+  EXPECT_TRUE(receiver.isDuplicate(route, 1));
+  EXPECT_FALSE(receiver.isDuplicate(route, 2));
+}
+
+TEST(DeliveryTrackerTest, ReleasesTheStateOfRemovedRoutes)
+{
+  DeliveryTracker sender(42);
+  std::string message;
+  sender.wrap(outgoingRoute(true), 1000, 1, "abc", 3, message);
+  EXPECT_EQ(sender.getRetransmitStatistics({}, { outgoingRoute(true) })["out"].find("1 messages buffered"), 0u);
+
+  sender.retainRoutes({}, { outgoingRoute(false) });
+  EXPECT_EQ(sender.getRetransmitStatistics({}, { outgoingRoute(true) })["out"], "nothing sent yet");
+
+  // the sequence numbers go on, numbers starting again would look like redeliveries
+  sender.wrap(outgoingRoute(true), 1000, 1, "abc", 3, message);
+  MessageEnvelope envelope;
+  ASSERT_TRUE(envelope.read(message.data(), message.size()));
+  EXPECT_EQ(envelope.sequence, 1u);
+}
@@ -0,0 +1,93 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "DuplicateFilter.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+
+namespace
+{
+  const std::chrono::steady_clock::time_point START;
+
+  std::chrono::steady_clock::time_point at(int ms)
+  {
+    return START + std::chrono::milliseconds(ms);
+  }
+}
+
+TEST(DuplicateFilterTest, RecognizesKeysWithinTheWindow)
+{
+  DuplicateFilter filter;
+  filter.setLimits(std::chrono::milliseconds(100), 10);
+  EXPECT_FALSE(filter.isDuplicate(1, at(0)));
+  EXPECT_FALSE(filter.isDuplicate(2, at(10)));
+  EXPECT_TRUE(filter.isDuplicate(1, at(50)));
+  // the key added at 0 ms is forgotten by now
+  EXPECT_TRUE(filter.isDuplicate(2, at(110)));
+  EXPECT_EQ(filter.toString(), "2 duplicates suppressed, 1 payloads remembered, 0 forgotten before the end of the window");
+}
+
+TEST(DuplicateFilterTest, ForgetsKeysAfterTheWindow)
+{
+  DuplicateFilter filter;
+  filter.setLimits(std::chrono::milliseconds(100), 10);
+  EXPECT_FALSE(filter.isDuplicate(1, at(0)));
+  // a duplicate does not extend the window of its key
+  EXPECT_TRUE(filter.isDuplicate(1, at(90)));
+  EXPECT_FALSE(filter.isDuplicate(1, at(101)));
+  EXPECT_TRUE(filter.isDuplicate(1, at(150)));
+}
+
+TEST(DuplicateFilterTest, MaxEntriesDropsTheOldestKey)
+{
+  DuplicateFilter filter;
+  filter.setLimits(std::chrono::seconds(10), 2);
+  filter.isDuplicate(1, at(0));
+  filter.isDuplicate(2, at(1));
+  filter.isDuplicate(3, at(2));
+  EXPECT_FALSE(filter.isDuplicate(1, at(3)));
+  EXPECT_TRUE(filter.isDuplicate(1, at(4)));
+  EXPECT_EQ(filter.toString(), "1 duplicates suppressed, 2 payloads remembered, 2 forgotten before the end of the window");
+}
+
+TEST(DuplicateFilterTest, SmallerLimitsApplyToTheNextKey)
+{
+  DuplicateFilter filter;
+  filter.setLimits(std::chrono::seconds(10), 10);
+  for (uint64_t key = 0; key < 5; key++)
+  {
+    filter.isDuplicate(key, at(0));
+  }
+  filter.setLimits(std::chrono::seconds(10), 2);
+  EXPECT_FALSE(filter.isDuplicate(5, at(1)));
+  EXPECT_FALSE(filter.isDuplicate(0, at(2)));
+  EXPECT_TRUE(filter.isDuplicate(0, at(3)));
+}
+
+TEST(DuplicateFilterTest, NoEntriesRemembersNothing)
+{
+  DuplicateFilter filter;
+  filter.setLimits(std::chrono::seconds(10), 0);
+  EXPECT_FALSE(filter.isDuplicate(1, at(0)));
+  EXPECT_FALSE(filter.isDuplicate(1, at(1)));
+  EXPECT_EQ(filter.toString(), "0 duplicates suppressed, 0 payloads remembered, 0 forgotten before the end of the window");
+}
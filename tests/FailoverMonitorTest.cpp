@@ -0,0 +1,281 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "FailoverMonitor.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  /** @brief A listening socket that stands in for a broker, connections are accepted by the kernel */
+  class StandInBroker
+  {
+  public:
+    StandInBroker()
+      : sock(-1)
+    {
+    }
+
+    ~StandInBroker()
+    {
+      stop();
+    }
+
+    /** @return the TCP endpoint on the loopback interface */
+    BrokerEndpoint listenTcp()
+    {
+      struct sockaddr_in address = {};
+      address.sin_family      = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      socklen_t length = sizeof(address);
+      sock = socket(AF_INET, SOCK_STREAM, 0);
+      EXPECT_EQ(bind(sock, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)), 0);
+      EXPECT_EQ(getsockname(sock, reinterpret_cast<struct sockaddr*>(&address), &length), 0);
+      EXPECT_EQ(listen(sock, 4), 0);
+      return { "127.0.0.1", ntohs(address.sin_port), "" };
+    }
+
+    void listenUnix(const std::string& path)
+    {
+      struct sockaddr_un address = {};
+      address.sun_family = AF_UNIX;
+      snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+      sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      EXPECT_EQ(bind(sock, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)), 0);
+      EXPECT_EQ(listen(sock, 4), 0);
+      unix_path = path;
+    }
+
+    void stop()
+    {
+      if (sock >= 0)
+      {
+        close(sock);
+        sock = -1;
+      }
+      if (!unix_path.empty())
+      {
+        unlink(unix_path.c_str());
+        unix_path.clear();
+      }
+    }
+
+  private:
+    int         sock;
+    std::string unix_path;
+  };
+
+  /**
+   * @brief Stands in for the broker connection of the bridge
+   *
+   * The pings are acknowledged by a thread of the test, like the network
+   * thread of mosquitto, if the endpoint in use answers.
+   */
+  class FailoverMonitorTest : public ::testing::Test
+  {
+  protected:
+    FailoverMonitorTest()
+      : ping_mid(-1)
+      , next_mid(1)
+      , switch_count(0)
+      , is_acking(true)
+    {
+      for (auto& answers : is_answering)
+      {
+        answers = true;
+      }
+      char path[] = "/tmp/failover_monitor_test_XXXXXX";
+      close(mkstemp(path));
+      unlink(path);
+      primary_path = path;
+    }
+
+    ~FailoverMonitorTest()
+    {
+      if (monitor)
+      {
+        monitor->stop();
+      }
+      is_acking = false;
+      if (acker.joinable())
+      {
+        acker.join();
+      }
+      primary.stop();
+    }
+
+    void start(int failback_interval_ms)
+    {
+      FailoverMonitor::Link link;
+      link.is_connected    = []() { return true; };
+      link.ping            = [this](int& mid)
+      {
+        mid = next_mid++;
+        if (is_answering[currentEndpoint()])
+        {
+          ping_mid = mid;
+        }
+        return true;
+      };
+      link.switch_endpoint = [this]()
+      {
+        switch_count++;
+        monitor->onConnected();
+      };
+      endpoints = { { "", 0, primary_path }, { "localhost", 1883, "" } };
+      monitor.reset(new FailoverMonitor(endpoints, 10, 100, failback_interval_ms, link));
+      acker = std::thread([this]()
+      {
+        while (is_acking)
+        {
+          const int mid = ping_mid.exchange(-1);
+          if (mid >= 0)
+          {
+            monitor->onPublished(mid);
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+      monitor->start();
+    }
+
+    /** @return true once the monitor switched the given number of times, false after two seconds */
+    bool waitForSwitches(int count)
+    {
+      for (int i = 0; i < 2000 && switch_count < count; i++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return switch_count >= count;
+    }
+
+    size_t currentEndpoint() const
+    {
+      return monitor->getCurrentEndpoint() == endpoints.front() ? 0 : 1;
+    }
+
+    std::string                       primary_path;
+    StandInBroker                     primary;
+    std::vector<BrokerEndpoint>       endpoints;
+    std::unique_ptr<FailoverMonitor>  monitor;
+    std::atomic<bool>                 is_answering[2];   // by endpoint
+    std::atomic<int>                  ping_mid;          // to be acknowledged
+    std::atomic<int>                  next_mid;
+    std::atomic<int>                  switch_count;
+    std::atomic<bool>                 is_acking;
+    std::thread                       acker;
+  };
+}
+
+TEST(FailoverMonitorReachableTest, ChecksTcpEndpoints)
+{
+  StandInBroker broker;
+  const BrokerEndpoint endpoint = broker.listenTcp();
+  EXPECT_TRUE(FailoverMonitor::isEndpointReachable(endpoint, 100));
+  broker.stop();
+  EXPECT_FALSE(FailoverMonitor::isEndpointReachable(endpoint, 100));
+}
+
+TEST(FailoverMonitorReachableTest, ChecksUnixSocketEndpoints)
+{
+  char path[] = "/tmp/failover_monitor_test_XXXXXX";
+  close(mkstemp(path));
+  unlink(path);
+  const BrokerEndpoint endpoint = { "", 0, path };
+  EXPECT_FALSE(FailoverMonitor::isEndpointReachable(endpoint, 100));
+  StandInBroker broker;
+  broker.listenUnix(path);
+  EXPECT_TRUE(FailoverMonitor::isEndpointReachable(endpoint, 100));
+}
+
+TEST_F(FailoverMonitorTest, StaysWhileThePingsAreAnswered)
+{
+  start(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  EXPECT_EQ(switch_count, 0);
+  EXPECT_EQ(monitor->getFailoverCounter(), 0);
+}
+
+TEST_F(FailoverMonitorTest, FailsOverIfThePingIsNotAnswered)
+{
+  is_answering[0] = false;
+  start(0);
+  ASSERT_TRUE(waitForSwitches(1));
+  EXPECT_EQ(currentEndpoint(), 1u);
+  EXPECT_EQ(monitor->getFailoverCounter(), 1);
+  EXPECT_GE(monitor->getLastFailoverMs(), 0);
+
+  // the fallback answers, without failback it stays there
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  EXPECT_EQ(switch_count, 1);
+}
+
+TEST_F(FailoverMonitorTest, OtherAcknowledgesShowTheBrokerIsAlive)
+{
+  // the ping waits behind a backlog of QoS 1 messages, which are acknowledged
+  is_answering[0] = false;
+  std::atomic<bool> is_backlog_sent(false);
+  start(0);
+  std::thread backlog([this, &is_backlog_sent]()
+  {
+    while (!is_backlog_sent)
+    {
+      monitor->onAcknowledged();
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  is_backlog_sent = true;
+  backlog.join();
+  EXPECT_EQ(switch_count, 0);
+
+  // without acknowledges the broker is considered failed
+  ASSERT_TRUE(waitForSwitches(1));
+  EXPECT_EQ(currentEndpoint(), 1u);
+}
+
+TEST_F(FailoverMonitorTest, FailsBackOnceThePrimaryIsReachable)
+{
+  is_answering[0] = false;
+  start(50);
+  ASSERT_TRUE(waitForSwitches(1));
+  EXPECT_EQ(currentEndpoint(), 1u);
+
+  // the primary is probed, but not reachable yet
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  EXPECT_EQ(switch_count, 1);
+
+  is_answering[0] = true;
+  primary.listenUnix(primary_path);
+  ASSERT_TRUE(waitForSwitches(2));
+  EXPECT_EQ(currentEndpoint(), 0u);
+  EXPECT_EQ(monitor->getFailoverCounter(), 2);
+}
@@ -0,0 +1,128 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "FieldProjection.h"
+#include "TestSchema.h"
+
+#include <google/protobuf/util/message_differencer.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const char* SAMPLE = R"(
+    id: 42 stamp: 1700000000 name: "engine" data: "\x01\x02" mode: MODE_ON delta_value: -5
+    position { x: 1.5 y: -3.25 } values: [1, 2, 3]
+    track { x: 1 y: 2 } track { x: 3 y: 4 } counters { key: "ok" value: 10 }
+  )";
+
+  class FieldProjectionTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      schema = test_schema::build();
+      ASSERT_NE(schema, nullptr);
+    }
+
+    // projects SAMPLE and compares the result with the expected message in text format
+    void expectProjection(const std::vector<std::string>& paths, const std::string& expected)
+    {
+      std::string error;
+      auto projection = FieldProjection::compile(schema, paths, error);
+      ASSERT_NE(projection, nullptr) << error;
+
+      const std::string data = test_schema::parse(*schema, SAMPLE)->SerializeAsString();
+      std::string output;
+      ASSERT_TRUE(projection->project(data.data(), data.size(), output));
+
+      std::unique_ptr<google::protobuf::Message> projected(schema->prototype->New());
+      ASSERT_TRUE(projected->ParseFromString(output));
+      auto expected_message = test_schema::parse(*schema, expected);
+      EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(*expected_message, *projected)) << projected->DebugString();
+    }
+
+    std::shared_ptr<const ProtobufSchema> schema;
+  };
+}
+
+TEST_F(FieldProjectionTest, KeepsSelectedScalars)
+{
+  expectProjection({ "id", "name", "data", "mode" }, R"(id: 42 name: "engine" data: "\x01\x02" mode: MODE_ON)");
+}
+
+TEST_F(FieldProjectionTest, AcceptsJsonNames)
+{
+  expectProjection({ "deltaValue" }, "delta_value: -5");
+}
+
+TEST_F(FieldProjectionTest, KeepsWholeSubmessagesAndRepeatedFields)
+{
+  expectProjection({ "position", "values", "counters" }, R"(position { x: 1.5 y: -3.25 } values: [1, 2, 3] counters { key: "ok" value: 10 })");
+}
+
+TEST_F(FieldProjectionTest, ProjectsNestedPaths)
+{
+  expectProjection({ "position.y" }, "position { y: -3.25 }");
+}
+
+TEST_F(FieldProjectionTest, ProjectsEveryElementOfRepeatedMessages)
+{
+  expectProjection({ "track.y", "id" }, "id: 42 track { y: 2 } track { y: 4 }");
+}
+
+TEST_F(FieldProjectionTest, LeavesOutEmptySubmessages)
+{
+  std::string error;
+  auto projection = FieldProjection::compile(schema, { "position.y" }, error);
+  ASSERT_NE(projection, nullptr) << error;
+
+  const std::string data = test_schema::parse(*schema, "id: 1 position { x: 2 }")->SerializeAsString();
+  std::string output;
+  ASSERT_TRUE(projection->project(data.data(), data.size(), output));
+  EXPECT_TRUE(output.empty());
+}
+
+TEST_F(FieldProjectionTest, RejectsUnknownPaths)
+{
+  for (auto const& path : { "unknown", "position.z", "id.x", "" })
+  {
+    std::string error;
+    EXPECT_EQ(FieldProjection::compile(schema, { path }, error), nullptr) << path;
+    EXPECT_FALSE(error.empty());
+  }
+}
+
+TEST_F(FieldProjectionTest, RejectsMalformedMessages)
+{
+  std::string error;
+  auto projection = FieldProjection::compile(schema, { "position.y" }, error);
+  ASSERT_NE(projection, nullptr) << error;
+
+  const std::string data = test_schema::parse(*schema, SAMPLE)->SerializeAsString();
+  std::string output;
+  // truncated in the middle of a field, a length beyond the end and an invalid wire type
+  EXPECT_FALSE(projection->project(data.data(), data.size() - 1, output));
+  EXPECT_FALSE(projection->project("\x52\x10\x09", 3, output));
+  EXPECT_FALSE(projection->project("\x0f\x01", 2, output));
+}
@@ -0,0 +1,131 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "FilterExpression.h"
+#include "TestSchema.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+namespace
+{
+  const char* SAMPLE = R"(
+    id: 42 stamp: -7 count: 3 value: 2.5 valid: true name: "engine" mode: MODE_ON delta_value: -5
+    position { x: 1.5 y: -3.25 } values: [1, 2, 3]
+  )";
+
+  class FilterExpressionTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      schema = test_schema::build();
+      ASSERT_NE(schema, nullptr);
+    }
+
+    // evaluates the expression for a message in text format, SAMPLE by default
+    bool matches(const std::string& expression, const std::string& message = SAMPLE)
+    {
+      std::string error;
+      auto filter = FilterExpression::compile(schema, expression, error);
+      if (!filter)
+      {
+        ADD_FAILURE() << expression << ": " << error;
+        return false;
+      }
+      const std::string data = test_schema::parse(*schema, message)->SerializeAsString();
+      bool result = false;
+      EXPECT_TRUE(filter->evaluate(data.data(), data.size(), result));
+      return result;
+    }
+
+    bool rejects(const std::string& expression)
+    {
+      std::string error;
+      return FilterExpression::compile(schema, expression, error) == nullptr && !error.empty();
+    }
+
+    std::shared_ptr<const ProtobufSchema> schema;
+  };
+}
+
+TEST_F(FilterExpressionTest, ComparesNumbers)
+{
+  EXPECT_TRUE(matches("id == 42"));
+  EXPECT_FALSE(matches("id != 42"));
+  EXPECT_TRUE(matches("value > 2 && value < 3"));
+  EXPECT_TRUE(matches("stamp <= -7 && stamp >= -7"));
+  EXPECT_TRUE(matches("deltaValue < 0"));
+  EXPECT_TRUE(matches("position.y < position.x"));
+}
+
+TEST_F(FilterExpressionTest, ComparesStringsBooleansAndEnums)
+{
+  EXPECT_TRUE(matches(R"(name == "engine")"));
+  EXPECT_FALSE(matches(R"(name == "gearbox")"));
+  EXPECT_TRUE(matches("valid == true"));
+  EXPECT_TRUE(matches(R"(mode == "MODE_ON")"));
+  EXPECT_TRUE(matches("mode == 1"));
+  EXPECT_FALSE(matches(R"(mode == "MODE_OFF")"));
+}
+
+TEST_F(FilterExpressionTest, CombinesWithPrecedenceAndParentheses)
+{
+  EXPECT_TRUE(matches("id == 1 || id == 42 && valid"));
+  EXPECT_FALSE(matches("(id == 1 || id == 42) && !valid"));
+  EXPECT_TRUE(matches("!(count > 5)"));
+}
+
+TEST_F(FilterExpressionTest, FieldsOnTheirOwnAreTruthy)
+{
+  EXPECT_TRUE(matches("valid && name && id"));
+  EXPECT_FALSE(matches("ratio"));
+}
+
+TEST_F(FilterExpressionTest, MissingFieldsHaveTheirDefaultValue)
+{
+  EXPECT_TRUE(matches(R"(id == 0 && name == "" && !valid && mode == "MODE_OFF" && position.x == 0)", ""));
+}
+
+TEST_F(FilterExpressionTest, RejectsInvalidExpressions)
+{
+  EXPECT_TRUE(rejects(""));
+  EXPECT_TRUE(rejects("unknown == 1"));
+  EXPECT_TRUE(rejects("id =="));
+  EXPECT_TRUE(rejects("(id == 1"));
+  EXPECT_TRUE(rejects("id == 1)"));
+  EXPECT_TRUE(rejects(R"(id == "text")"));
+  EXPECT_TRUE(rejects(R"(name == "unterminated)"));
+  EXPECT_TRUE(rejects(R"(mode == "MODE_UNKNOWN")"));
+  EXPECT_TRUE(rejects("values == 1"));
+  EXPECT_TRUE(rejects("position == 1"));
+}
+
+TEST_F(FilterExpressionTest, RejectsMalformedMessages)
+{
+  std::string error;
+  auto filter = FilterExpression::compile(schema, "position.y > 0", error);
+  ASSERT_NE(filter, nullptr) << error;
+  bool result = false;
+  // a length beyond the end and an invalid wire type
+  EXPECT_FALSE(filter->evaluate("\x52\x10\x09", 3, result));
+  EXPECT_FALSE(filter->evaluate("\x0f\x01", 2, result));
+}
@@ -0,0 +1,181 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "JsonProtobufEncoder.h"
+#include "TestSchema.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <memory>
+#include <string>
+
+namespace
+{
+  class JsonProtobufEncoderTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      schema = test_schema::build();
+      ASSERT_NE(schema, nullptr);
+      encoder.reset(new JsonProtobufEncoder(schema));
+    }
+
+    // encodes the JSON and parses the result with the protobuf library
+    std::unique_ptr<google::protobuf::Message> encode(const std::string& json)
+    {
+      std::string output;
+      if (!encoder->encode(json.data(), json.size(), output))
+      {
+        ADD_FAILURE() << "encoding failed: " << encoder->getError();
+        return nullptr;
+      }
+      std::unique_ptr<google::protobuf::Message> message(schema->prototype->New());
+      EXPECT_TRUE(message->ParseFromString(output));
+      return message;
+    }
+
+    bool rejects(const std::string& json)
+    {
+      std::string output;
+      return !encoder->encode(json.data(), json.size(), output) && !encoder->getError().empty();
+    }
+
+    const google::protobuf::FieldDescriptor* field(const std::string& name) const
+    {
+      return schema->descriptor->FindFieldByName(name);
+    }
+
+    std::shared_ptr<const ProtobufSchema> schema;
+    std::unique_ptr<JsonProtobufEncoder>  encoder;
+  };
+}
+
+TEST(ProtobufSchemaTest, BuildsTypeWithOrWithoutPrefix)
+{
+  EXPECT_NE(test_schema::build("proto:test.Sample"), nullptr);
+  EXPECT_NE(test_schema::build("test.Position"), nullptr);
+  EXPECT_EQ(test_schema::build("proto:test.Unknown"), nullptr);
+  EXPECT_EQ(ProtobufSchema::build("proto:test.Sample", "not a descriptor"), nullptr);
+}
+
+TEST_F(JsonProtobufEncoderTest, EncodesScalars)
+{
+  auto message = encode(R"({"id": -7, "stamp": "9007199254740993", "count": 4000000000, "value": 2.5, "ratio": 0.25,
+                           "valid": true, "name": "café \"x\"", "data": "AAEC/w==", "mode": "MODE_ON", "deltaValue": -3})");
+  ASSERT_NE(message, nullptr);
+  auto reflection = message->GetReflection();
+  EXPECT_EQ(reflection->GetInt32(*message, field("id")), -7);
+  EXPECT_EQ(reflection->GetInt64(*message, field("stamp")), 9007199254740993LL);
+  EXPECT_EQ(reflection->GetUInt32(*message, field("count")), 4000000000u);
+  EXPECT_DOUBLE_EQ(reflection->GetDouble(*message, field("value")), 2.5);
+  EXPECT_FLOAT_EQ(reflection->GetFloat(*message, field("ratio")), 0.25f);
+  EXPECT_TRUE(reflection->GetBool(*message, field("valid")));
+  EXPECT_EQ(reflection->GetString(*message, field("name")), "caf\xc3\xa9 \"x\"");
+  EXPECT_EQ(reflection->GetString(*message, field("data")), std::string("\x00\x01\x02\xff", 4));
+  EXPECT_EQ(reflection->GetEnumValue(*message, field("mode")), 1);
+  EXPECT_EQ(reflection->GetInt32(*message, field("delta_value")), -3);
+}
+
+TEST_F(JsonProtobufEncoderTest, AcceptsProtoNamesAndEnumNumbers)
+{
+  auto message = encode(R"({"delta_value": 12, "mode": 1, "id": 3.0})");
+  ASSERT_NE(message, nullptr);
+  auto reflection = message->GetReflection();
+  EXPECT_EQ(reflection->GetInt32(*message, field("delta_value")), 12);
+  EXPECT_EQ(reflection->GetEnumValue(*message, field("mode")), 1);
+  EXPECT_EQ(reflection->GetInt32(*message, field("id")), 3);
+}
+
+TEST_F(JsonProtobufEncoderTest, EncodesNestedRepeatedAndMapFields)
+{
+  auto message = encode(R"({"position": {"x": 1, "y": -2},
+                           "values": [1, 2, 300],
+                           "track": [{"x": 1}, {"y": 2}],
+                           "counters": {"a": 1, "b": 2}})");
+  ASSERT_NE(message, nullptr);
+  auto reflection = message->GetReflection();
+
+  const auto& position = reflection->GetMessage(*message, field("position"));
+  EXPECT_DOUBLE_EQ(position.GetReflection()->GetDouble(position, position.GetDescriptor()->FindFieldByName("y")), -2.0);
+
+  ASSERT_EQ(reflection->FieldSize(*message, field("values")), 3);
+  EXPECT_EQ(reflection->GetRepeatedInt32(*message, field("values"), 2), 300);
+
+  ASSERT_EQ(reflection->FieldSize(*message, field("track")), 2);
+  const auto& second = reflection->GetRepeatedMessage(*message, field("track"), 1);
+  EXPECT_DOUBLE_EQ(second.GetReflection()->GetDouble(second, second.GetDescriptor()->FindFieldByName("y")), 2.0);
+
+  EXPECT_EQ(reflection->FieldSize(*message, field("counters")), 2);
+}
+
+TEST_F(JsonProtobufEncoderTest, IgnoresUnknownFieldsAndNulls)
+{
+  auto message = encode(R"({"unknown": {"deep": [1, {"x": null}]}, "name": null, "id": 5})");
+  ASSERT_NE(message, nullptr);
+  EXPECT_EQ(message->GetReflection()->GetInt32(*message, field("id")), 5);
+  EXPECT_FALSE(message->GetReflection()->HasField(*message, field("name")));
+}
+
+TEST_F(JsonProtobufEncoderTest, ReusesTheOutputBuffer)
+{
+  std::string output;
+  const std::string first  = R"({"name": "a long name that needs some space"})";
+  const std::string second = R"({"id": 1})";
+  ASSERT_TRUE(encoder->encode(first.data(), first.size(), output));
+  ASSERT_TRUE(encoder->encode(second.data(), second.size(), output));
+  EXPECT_EQ(output, std::string("\x08\x01", 2));
+}
+
+TEST_F(JsonProtobufEncoderTest, RejectsMalformedJson)
+{
+  EXPECT_TRUE(rejects(""));
+  EXPECT_TRUE(rejects("[]"));
+  EXPECT_TRUE(rejects(R"({"id": 1)"));
+  EXPECT_TRUE(rejects(R"({"id" 1})"));
+  EXPECT_TRUE(rejects(R"({"id": 1,})"));
+  EXPECT_TRUE(rejects(R"({"name": "unterminated})"));
+  EXPECT_TRUE(rejects(R"({"name": "\q"})"));
+  EXPECT_TRUE(rejects(R"({"name": "\ud800"})"));
+  EXPECT_TRUE(rejects(R"({"id": 1} trailing)"));
+  EXPECT_TRUE(rejects(std::string(200, '[')));
+}
+
+TEST_F(JsonProtobufEncoderTest, RejectsValuesThatDoNotMatchTheType)
+{
+  EXPECT_TRUE(rejects(R"({"id": "abc"})"));
+  EXPECT_TRUE(rejects(R"({"id": 1.5})"));
+  EXPECT_TRUE(rejects(R"({"id": 3000000000})"));
+  EXPECT_TRUE(rejects(R"({"count": -1})"));
+  EXPECT_TRUE(rejects(R"({"valid": 1})"));
+  EXPECT_TRUE(rejects(R"({"mode": "MODE_UNKNOWN"})"));
+  EXPECT_TRUE(rejects(R"({"data": "not base64!"})"));
+  EXPECT_TRUE(rejects(R"({"values": 1})"));
+  EXPECT_TRUE(rejects(R"({"position": [1, 2]})"));
+  EXPECT_TRUE(rejects(R"({"counters": {"a": "b"}})"));
+}
+
+TEST_F(JsonProtobufEncoderTest, RecoversAfterAnError)
+{
+  EXPECT_TRUE(rejects(R"({"id": "abc"})"));
+  auto message = encode(R"({"id": 2})");
+  ASSERT_NE(message, nullptr);
+  EXPECT_EQ(message->GetReflection()->GetInt32(*message, field("id")), 2);
+}
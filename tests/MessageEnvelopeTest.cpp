@@ -0,0 +1,126 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "MessageEnvelope.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+  MessageEnvelope envelope(uint64_t sequence, int64_t clock, uint32_t sender_id = 1)
+  {
+    return { sender_id, sequence, 1000, clock };
+  }
+
+  bool contains(const EnvelopeStatistics& statistics, const std::string& text)
+  {
+    return statistics.toString().find(text) != std::string::npos;
+  }
+}
+
+TEST(MessageEnvelopeTest, WriteAndReadRoundTrip)
+{
+  const MessageEnvelope written = { 0xcafebabe, 0x0102030405060708ULL, -5, 1234567890123LL };
+  std::string output;
+  written.write("payload", 7, output);
+  ASSERT_EQ(output.size(), MessageEnvelope::SIZE + 7);
+  EXPECT_EQ(output.substr(MessageEnvelope::SIZE), "payload");
+
+  MessageEnvelope read;
+  ASSERT_TRUE(read.read(output.data(), output.size()));
+  EXPECT_EQ(read.sender_id, written.sender_id);
+  EXPECT_EQ(read.sequence, written.sequence);
+  EXPECT_EQ(read.send_time, written.send_time);
+  EXPECT_EQ(read.clock, written.clock);
+}
+
+TEST(MessageEnvelopeTest, RejectsInvalidEnvelopes)
+{
+  std::string output;
+  envelope(1, 1).write("", 0, output);
+  MessageEnvelope read;
+  EXPECT_FALSE(read.read(output.data(), MessageEnvelope::SIZE - 1));
+  EXPECT_FALSE(read.read("plain payload without an envelope", 33));
+
+  std::string other_version = output;
+  other_version[2] = 2;
+  EXPECT_FALSE(read.read(other_version.data(), other_version.size()));
+}
+
+TEST(EnvelopeStatisticsTest, CountsGapsAsLost)
+{
+  EnvelopeStatistics statistics;
+  EXPECT_TRUE(statistics.add(envelope(0, 0), 1000));
+  EXPECT_TRUE(statistics.add(envelope(1, 1), 1000));
+  EXPECT_TRUE(statistics.add(envelope(5, 5), 1000));
+  EXPECT_TRUE(contains(statistics, "3 received, 3 lost, 0 reordered")) << statistics.toString();
+}
+
+TEST(EnvelopeStatisticsTest, LateMessagesAreReorderedNotLost)
+{
+  EnvelopeStatistics statistics;
+  statistics.add(envelope(0, 0), 1000);
+  statistics.add(envelope(3, 3), 1000);
+  EXPECT_TRUE(statistics.add(envelope(1, 1), 1000));
+  EXPECT_TRUE(contains(statistics, "3 received, 1 lost, 1 reordered")) << statistics.toString();
+}
+
+TEST(EnvelopeStatisticsTest, DuplicatesAreRecognized)
+{
+  EnvelopeStatistics statistics;
+  statistics.add(envelope(0, 0), 1000);
+  statistics.add(envelope(1, 1), 1000);
+  EXPECT_FALSE(statistics.add(envelope(1, 1), 1000));
+  EXPECT_FALSE(statistics.add(envelope(0, 0), 1000));
+  EXPECT_EQ(statistics.getDuplicateCount(), 2u);
+  EXPECT_TRUE(contains(statistics, "2 received, 0 lost, 0 reordered, 2 duplicates")) << statistics.toString();
+}
+
+TEST(EnvelopeStatisticsTest, LargeJumpClearsTheWindow)
+{
+  EnvelopeStatistics statistics;
+  statistics.add(envelope(0, 0), 1000);
+  statistics.add(envelope(5000, 5000), 1000);
+  EXPECT_TRUE(statistics.add(envelope(4999, 4999), 1000));
+  EXPECT_FALSE(statistics.add(envelope(4999, 4999), 1000));
+  EXPECT_TRUE(contains(statistics, "3 received, 4998 lost, 1 reordered, 1 duplicates")) << statistics.toString();
+}
+
+TEST(EnvelopeStatisticsTest, SenderRestartStartsAgain)
+{
+  EnvelopeStatistics statistics;
+  statistics.add(envelope(10, 10), 1000);
+  statistics.add(envelope(11, 11), 1000);
+  EXPECT_TRUE(statistics.add(envelope(0, 12, 2), 1000));
+  EXPECT_TRUE(statistics.add(envelope(1, 13, 2), 1000));
+  EXPECT_TRUE(contains(statistics, "4 received, 0 lost, 0 reordered, 0 duplicates, 0 without envelope, 1 sender restarts")) << statistics.toString();
+}
+
+TEST(EnvelopeStatisticsTest, CountsMessagesTheSenderMissed)
+{
+  EnvelopeStatistics statistics;
+  statistics.add(envelope(0, 100), 1000);
+  statistics.add(envelope(1, 104), 1000);
+  // a restarted eCAL publisher starts its clock again
+  statistics.add(envelope(2, 1), 1000);
+  statistics.addInvalid();
+  EXPECT_TRUE(contains(statistics, "1 without envelope, 0 sender restarts, 3 missed by the sender")) << statistics.toString();
+}
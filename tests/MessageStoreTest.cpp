@@ -0,0 +1,262 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "MessageStore.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  // layout of version 3 segments, see MessageStore.cpp
+  const size_t SEGMENT_HEADER_SIZE = 16;
+  const size_t RECORD_HEADER_SIZE  = 32;
+
+  int64_t nowUs()
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  class MessageStoreTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      char path[] = "/tmp/message_store_test_XXXXXX";
+      ASSERT_NE(mkdtemp(path), nullptr);
+      directory = path;
+    }
+
+    void TearDown() override
+    {
+      if (DIR* dir = opendir(directory.c_str()))
+      {
+        while (struct dirent* entry = readdir(dir))
+        {
+          unlink((directory + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+      }
+      rmdir(directory.c_str());
+    }
+
+    std::string segmentPath(unsigned long long sequence) const
+    {
+      char name[64];
+      snprintf(name, sizeof(name), "/segment-%016llu.log", sequence);
+      return directory + name;
+    }
+
+    void overwrite(const std::string& path, size_t offset, const std::string& data) const
+    {
+      int fd = open(path.c_str(), O_RDWR);
+      ASSERT_GE(fd, 0);
+      ASSERT_EQ(pwrite(fd, data.data(), data.size(), static_cast<off_t>(offset)), static_cast<ssize_t>(data.size()));
+      close(fd);
+    }
+
+    static void append(MessageStore& store, const std::string& topic, const std::string& payload, int qos = 1, bool retain = false, int64_t deadline_us = 0)
+    {
+      ASSERT_TRUE(store.append(topic, payload.data(), payload.size(), qos, retain, deadline_us));
+    }
+
+    static std::vector<std::string> drain(MessageStore& store)
+    {
+      std::vector<std::string> messages;
+      MessageStore::Record record;
+      while (store.front(record))
+      {
+        messages.push_back(record.topic + "=" + record.payload);
+        store.pop();
+      }
+      return messages;
+    }
+
+    std::string directory;
+  };
+}
+
+TEST_F(MessageStoreTest, ReturnsMessagesInOrder)
+{
+  MessageStore store(directory, 4096, 0, 0, false);
+  ASSERT_TRUE(store.open());
+  EXPECT_TRUE(store.empty());
+  append(store, "a", "1", 2, true, 0);
+  append(store, "b", std::string("\0\1\2", 3), 0, false, nowUs() + 60000000);
+
+  MessageStore::Record record;
+  ASSERT_TRUE(store.front(record));
+  EXPECT_EQ(record.topic, "a");
+  EXPECT_EQ(record.payload, "1");
+  EXPECT_EQ(record.qos, 2);
+  EXPECT_TRUE(record.retain);
+  EXPECT_EQ(record.deadline_us, 0);
+  store.pop();
+
+  ASSERT_TRUE(store.front(record));
+  EXPECT_EQ(record.topic, "b");
+  EXPECT_EQ(record.payload, std::string("\0\1\2", 3));
+  EXPECT_EQ(record.qos, 0);
+  EXPECT_FALSE(record.retain);
+  EXPECT_GT(record.deadline_us, 0);
+  store.pop();
+
+  EXPECT_FALSE(store.front(record));
+  EXPECT_TRUE(store.empty());
+}
+
+TEST_F(MessageStoreTest, BacklogSurvivesRestart)
+{
+  {
+    MessageStore store(directory, 4096, 0, 0, false);
+    ASSERT_TRUE(store.open());
+    append(store, "a", "1");
+    append(store, "a", "2");
+    append(store, "a", "3");
+    MessageStore::Record record;
+    ASSERT_TRUE(store.front(record));
+    store.pop();
+  }
+  MessageStore store(directory, 4096, 0, 0, false);
+  ASSERT_TRUE(store.open());
+  EXPECT_EQ(store.getBacklogCount(), 2u);
+  EXPECT_EQ(drain(store), (std::vector<std::string>{ "a=2", "a=3" }));
+}
+
+TEST_F(MessageStoreTest, RecoveryStopsAtTornRecord)
+{
+  {
+    MessageStore store(directory, 4096, 0, 0, false);
+    ASSERT_TRUE(store.open());
+    append(store, "t", "first");
+    append(store, "t", "second");
+    append(store, "t", "third");
+  }
+  // the size of the third record reached the disk, the page with its payload did not
+  const size_t third = SEGMENT_HEADER_SIZE + 2 * RECORD_HEADER_SIZE + 1 + 5 + 1 + 6;
+  overwrite(segmentPath(0), third + RECORD_HEADER_SIZE + 1, std::string(5, '\0'));
+
+  MessageStore store(directory, 4096, 0, 0, false);
+  ASSERT_TRUE(store.open());
+  EXPECT_EQ(store.getBacklogCount(), 2u);
+  // new messages continue after the last intact record
+  append(store, "t", "fourth");
+  EXPECT_EQ(drain(store), (std::vector<std::string>{ "t=first", "t=second", "t=fourth" }));
+}
+
+TEST_F(MessageStoreTest, RecordWithOnlyItsSizeIsRejected)
+{
+  {
+    MessageStore store(directory, 4096, 0, 0, false);
+    ASSERT_TRUE(store.open());
+    append(store, "t", "payload");
+  }
+  // everything but the body size is lost
+  overwrite(segmentPath(0), SEGMENT_HEADER_SIZE + 4, std::string(RECORD_HEADER_SIZE - 4 + 1 + 7, '\0'));
+
+  MessageStore store(directory, 4096, 0, 0, false);
+  ASSERT_TRUE(store.open());
+  EXPECT_TRUE(store.empty());
+}
+
+TEST_F(MessageStoreTest, ReadsVersion2Segments)
+{
+  // [magic] [read offset] [body size] [timestamp] [deadline] [qos] [retain] [topic size] [payload size] [topic] [payload] [0]
+  std::string segment("ECMQSEG2", 8);
+  const uint64_t read_offset = SEGMENT_HEADER_SIZE;
+  segment.append(reinterpret_cast<const char*>(&read_offset), 8);
+  const int64_t  timestamp    = nowUs();
+  const int64_t  deadline     = 0;
+  const uint16_t topic_size   = 3;
+  const uint32_t payload_size = 5;
+  const uint32_t body_size    = 8 + 8 + 1 + 1 + 2 + 4 + topic_size + payload_size;
+  segment.append(reinterpret_cast<const char*>(&body_size), 4);
+  segment.append(reinterpret_cast<const char*>(&timestamp), 8);
+  segment.append(reinterpret_cast<const char*>(&deadline), 8);
+  segment.push_back(1);
+  segment.push_back(0);
+  segment.append(reinterpret_cast<const char*>(&topic_size), 2);
+  segment.append(reinterpret_cast<const char*>(&payload_size), 4);
+  segment.append("old");
+  segment.append("value");
+  segment.append(4, '\0');
+  FILE* file = fopen(segmentPath(7).c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  fwrite(segment.data(), 1, segment.size(), file);
+  fclose(file);
+
+  MessageStore store(directory, 4096, 0, 0, false);
+  ASSERT_TRUE(store.open());
+  EXPECT_EQ(store.getBacklogCount(), 1u);
+  // new messages go to a new segment of the current version
+  append(store, "new", "value");
+  EXPECT_EQ(drain(store), (std::vector<std::string>{ "old=value", "new=value" }));
+}
+
+TEST_F(MessageStoreTest, SkipsExpiredMessages)
+{
+  MessageStore store(directory, 4096, 0, 0, false);
+  ASSERT_TRUE(store.open());
+  append(store, "t", "expired", 1, false, nowUs() - 1);
+  append(store, "t", "valid", 1, false, nowUs() + 60000000);
+  EXPECT_EQ(drain(store), (std::vector<std::string>{ "t=valid" }));
+  EXPECT_EQ(store.getExpiredCount(), 1u);
+}
+
+TEST_F(MessageStoreTest, SizeLimitDropsOldestSegment)
+{
+  const size_t segment_size = 256;
+  MessageStore store(directory, segment_size, 4 * segment_size, 0, false);
+  ASSERT_TRUE(store.open());
+  for (int i = 0; i < 100; i++)
+  {
+    append(store, "t", std::to_string(i));
+  }
+  EXPECT_GT(store.getDroppedCount(), 0u);
+  EXPECT_EQ(store.getDroppedCount() + store.getBacklogCount(), 100u);
+
+  // the newest messages are kept
+  auto messages = drain(store);
+  ASSERT_FALSE(messages.empty());
+  EXPECT_EQ(messages.back(), "t=99");
+  EXPECT_NE(messages.front(), "t=0");
+}
+
+TEST_F(MessageStoreTest, CompactionKeepsLatestMessagePerTopic)
+{
+  MessageStore store(directory, 4096, 0, 0, true);
+  ASSERT_TRUE(store.open());
+  append(store, "a", "1");
+  append(store, "b", "1");
+  append(store, "a", "2");
+  store.compact();
+  EXPECT_EQ(store.getBacklogCount(), 2u);
+  EXPECT_EQ(store.getDroppedCount(), 1u);
+  EXPECT_EQ(drain(store), (std::vector<std::string>{ "b=1", "a=2" }));
+}
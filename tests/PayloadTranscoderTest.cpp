@@ -0,0 +1,207 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "PayloadTranscoder.h"
+#include "TestSchema.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  class PayloadTranscoderTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      schema = test_schema::build();
+      ASSERT_NE(schema, nullptr);
+      is_delivery_blocked = false;
+      blocked_deliveries  = 0;
+    }
+
+    void TearDown() override
+    {
+      unblock();
+      transcoder.reset();
+    }
+
+    void create(size_t worker_count, size_t max_queue_size)
+    {
+      transcoder.reset(new PayloadTranscoder(worker_count, max_queue_size,
+        [this](const std::string& mqtt_topic, const std::string& payload, int /*qos*/, bool /*retain*/, const std::chrono::steady_clock::time_point& /*deadline*/)
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          published.emplace_back(mqtt_topic, payload);
+          cv.notify_all();
+        },
+        [this](const std::string& target, const google::protobuf::Message& message)
+        {
+          std::unique_lock<std::mutex> lock(mtx);
+          // a blocked delivery keeps its worker busy, the following messages stay in the queue
+          blocked_deliveries++;
+          cv.notify_all();
+          cv.wait(lock, [this]() { return !is_delivery_blocked; });
+          delivered.emplace_back(target, message.GetDescriptor());
+          cv.notify_all();
+        }));
+    }
+
+    bool send(const std::string& ecal_topic, const std::string& mqtt_topic, PayloadTranscoder::OutputFormat format, const std::string& message,
+      const std::chrono::steady_clock::time_point& deadline = std::chrono::steady_clock::time_point::max())
+    {
+      const std::string data = test_schema::parse(*schema, message)->SerializeAsString();
+      return transcoder->transcode(ecal_topic, mqtt_topic, format, data.data(), data.size(), 1, false, deadline);
+    }
+
+    /** @return false if the condition is not met within a few seconds */
+    template <typename Condition>
+    bool waitFor(Condition condition)
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      return cv.wait_for(lock, std::chrono::seconds(5), condition);
+    }
+
+    void unblock()
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      is_delivery_blocked = false;
+      cv.notify_all();
+    }
+
+    std::shared_ptr<const ProtobufSchema>                                    schema;
+    std::unique_ptr<PayloadTranscoder>                                       transcoder;
+    std::mutex                                                               mtx;
+    std::condition_variable                                                  cv;
+    std::vector<std::pair<std::string, std::string>>                         published;  // topic and payload
+    std::vector<std::pair<std::string, const google::protobuf::Descriptor*>> delivered;  // target and type
+    bool                                                                     is_delivery_blocked;
+    int                                                                      blocked_deliveries;
+  };
+}
+
+TEST_F(PayloadTranscoderTest, ConvertsToJson)
+{
+  create(1, 0);
+  // the type of a topic is only known once its publisher registered the descriptor
+  EXPECT_FALSE(send("sample", "out/sample", PayloadTranscoder::JSON, "id: 5"));
+  transcoder->setDescriptor("sample", "proto:test.Sample", test_schema::descriptor());
+  ASSERT_TRUE(transcoder->hasDescriptor("sample"));
+
+  ASSERT_TRUE(send("sample", "out/sample", PayloadTranscoder::JSON, "id: 5 name: \"arm\" position { x: 1.5 }"));
+  ASSERT_TRUE(waitFor([this]() { return published.size() == 1; }));
+  EXPECT_EQ(published[0].first, "out/sample");
+  EXPECT_EQ(published[0].second, R"({"id":5,"name":"arm","position":{"x":1.5}})");
+  EXPECT_EQ(transcoder->getStatistics().find("1 converted"), 0u) << transcoder->getStatistics();
+  EXPECT_NE(transcoder->getStatistics().find("1 without descriptor"), std::string::npos) << transcoder->getStatistics();
+}
+
+TEST_F(PayloadTranscoderTest, TopicsOfTheSameTypeShareTheDescriptor)
+{
+  create(2, 0);
+  transcoder->setDescriptor("left", "proto:test.Sample", test_schema::descriptor());
+  transcoder->setDescriptor("right", "proto:test.Sample", test_schema::descriptor());
+  transcoder->setDescriptor("position", "proto:test.Position", test_schema::descriptor());
+
+  ASSERT_TRUE(send("left", "left", PayloadTranscoder::SPARKPLUG, "id: 1"));
+  ASSERT_TRUE(send("right", "right", PayloadTranscoder::SPARKPLUG, "id: 2"));
+  ASSERT_TRUE(send("position", "position", PayloadTranscoder::SPARKPLUG, ""));
+  ASSERT_TRUE(waitFor([this]() { return delivered.size() == 3; }));
+
+  std::map<std::string, const google::protobuf::Descriptor*> types(delivered.begin(), delivered.end());
+  ASSERT_EQ(types.size(), 3u);
+  // one pool and factory for both topics of test.Sample
+  EXPECT_EQ(types["left"], types["right"]);
+  EXPECT_EQ(types["left"]->full_name(), "test.Sample");
+  EXPECT_EQ(types["position"]->full_name(), "test.Position");
+}
+
+TEST_F(PayloadTranscoderTest, KeepsTheOrderOfEveryTopic)
+{
+  const int topic_count   = 8;
+  const int message_count = 200;
+  create(4, 0);
+  for (int topic = 0; topic < topic_count; topic++)
+  {
+    transcoder->setDescriptor("topic" + std::to_string(topic), "proto:test.Sample", test_schema::descriptor());
+  }
+  for (int id = 1; id <= message_count; id++)
+  {
+    for (int topic = 0; topic < topic_count; topic++)
+    {
+      ASSERT_TRUE(send("topic" + std::to_string(topic), "out" + std::to_string(topic), PayloadTranscoder::JSON, "id: " + std::to_string(id)));
+    }
+  }
+  ASSERT_TRUE(waitFor([this, topic_count, message_count]() { return published.size() == static_cast<size_t>(topic_count * message_count); }));
+
+  std::map<std::string, int> last_ids;
+  for (auto const& message : published)
+  {
+    const int id = std::stoi(message.second.substr(message.second.find(':') + 1));
+    EXPECT_EQ(id, last_ids[message.first] + 1) << message.first;
+    last_ids[message.first] = id;
+  }
+  EXPECT_EQ(last_ids.size(), static_cast<size_t>(topic_count));
+}
+
+TEST_F(PayloadTranscoderTest, DropsMessagesBeyondTheQueueSize)
+{
+  create(1, 2);
+  transcoder->setDescriptor("sample", "proto:test.Sample", test_schema::descriptor());
+  is_delivery_blocked = true;
+  ASSERT_TRUE(send("sample", "device", PayloadTranscoder::SPARKPLUG, "id: 1"));
+  ASSERT_TRUE(waitFor([this]() { return blocked_deliveries == 1; }));
+
+  // the worker is busy with the first message, two more fit into its queue
+  EXPECT_TRUE(send("sample", "device", PayloadTranscoder::SPARKPLUG, "id: 2"));
+  EXPECT_TRUE(send("sample", "device", PayloadTranscoder::SPARKPLUG, "id: 3"));
+  EXPECT_FALSE(send("sample", "device", PayloadTranscoder::SPARKPLUG, "id: 4"));
+
+  unblock();
+  ASSERT_TRUE(waitFor([this]() { return delivered.size() == 3; }));
+  EXPECT_NE(transcoder->getStatistics().find("1 queue full"), std::string::npos) << transcoder->getStatistics();
+}
+
+TEST_F(PayloadTranscoderTest, DropsMessagesExpiredInTheQueue)
+{
+  create(1, 0);
+  transcoder->setDescriptor("sample", "proto:test.Sample", test_schema::descriptor());
+  is_delivery_blocked = true;
+  ASSERT_TRUE(send("sample", "device", PayloadTranscoder::SPARKPLUG, "id: 1"));
+  ASSERT_TRUE(waitFor([this]() { return blocked_deliveries == 1; }));
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+  ASSERT_TRUE(send("sample", "expiring", PayloadTranscoder::JSON, "id: 2", deadline));
+  ASSERT_TRUE(send("sample", "kept", PayloadTranscoder::JSON, "id: 3"));
+  std::this_thread::sleep_until(deadline + std::chrono::milliseconds(10));
+
+  unblock();
+  ASSERT_TRUE(waitFor([this]() { return published.size() == 1; }));
+  EXPECT_EQ(published[0].first, "kept");
+  EXPECT_NE(transcoder->getStatistics().find("1 expired in the queue"), std::string::npos) << transcoder->getStatistics();
+}
@@ -0,0 +1,205 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "Retransmission.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  const std::chrono::steady_clock::time_point START;
+
+  std::chrono::steady_clock::time_point at(int ms)
+  {
+    return START + std::chrono::milliseconds(ms);
+  }
+
+  Nack nack(std::vector<std::pair<uint64_t, uint64_t>> ranges)
+  {
+    Nack result;
+    result.sender_id = 1;
+    result.ranges    = std::move(ranges);
+    return result;
+  }
+
+  typedef std::vector<std::pair<uint64_t, uint64_t>> Ranges;
+}
+
+TEST(NackTest, WriteAndReadRoundTrip)
+{
+  std::string output;
+  Nack written = nack({ { 1, 3 }, { 7, 7 }, { 0xffffffff00ULL, 0xffffffffffULL } });
+  written.sender_id = 0x12345678;
+  written.write(output);
+  ASSERT_EQ(output.size(), Nack::HEADER_SIZE + 3 * 16);
+
+  Nack read;
+  ASSERT_TRUE(read.read(output.data(), output.size()));
+  EXPECT_EQ(read.sender_id, written.sender_id);
+  EXPECT_EQ(read.ranges, written.ranges);
+}
+
+TEST(NackTest, RejectsInvalidNacks)
+{
+  std::string output;
+  nack({ { 1, 3 } }).write(output);
+  Nack read;
+  EXPECT_FALSE(read.read(output.data(), Nack::HEADER_SIZE - 1));
+  EXPECT_FALSE(read.read(output.data(), output.size() - 1));
+
+  nack({ { 5, 3 } }).write(output);
+  EXPECT_FALSE(read.read(output.data(), output.size()));
+
+  nack({}).write(output);
+  output[0] = 'x';
+  EXPECT_FALSE(read.read(output.data(), output.size()));
+}
+
+TEST(RetransmitBufferTest, CollectsRequestedMessagesOnce)
+{
+  RetransmitBuffer buffer;
+  buffer.setLimit(1000);
+  for (uint64_t sequence = 10; sequence < 20; sequence++)
+  {
+    const std::string message = "m" + std::to_string(sequence);
+    buffer.add(sequence, message.data(), message.size());
+  }
+
+  std::vector<std::string> output;
+  buffer.collect(nack({ { 12, 13 }, { 13, 14 }, { 19, 19 } }), output);
+  EXPECT_EQ(output, std::vector<std::string>({ "m12", "m13", "m14", "m19" }));
+}
+
+TEST(RetransmitBufferTest, CountsMessagesNoLongerBuffered)
+{
+  RetransmitBuffer buffer;
+  buffer.setLimit(6);
+  for (uint64_t sequence = 0; sequence < 5; sequence++)
+  {
+    buffer.add(sequence, "ab", 2);
+  }
+  EXPECT_EQ(buffer.toString(), "3 messages buffered (6 bytes), 0 retransmitted, 0 requested but no longer buffered");
+
+  // 0 and 1 were dropped, 5 and later were never sent
+  std::vector<std::string> output;
+  buffer.collect(nack({ { 0, 2 }, { 4, 1000 } }), output);
+  EXPECT_EQ(output.size(), 2u);
+  EXPECT_EQ(buffer.toString(), "3 messages buffered (6 bytes), 2 retransmitted, 2 requested but no longer buffered");
+}
+
+TEST(RetransmitBufferTest, HugeRangesAreClampedToTheBuffer)
+{
+  RetransmitBuffer buffer;
+  buffer.setLimit(1000);
+  buffer.add(5, "a", 1);
+  buffer.add(6, "b", 1);
+  std::vector<std::string> output;
+  buffer.collect(nack({ { 5, UINT64_MAX } }), output);
+  EXPECT_EQ(output, std::vector<std::string>({ "a", "b" }));
+}
+
+TEST(RetransmitBufferTest, RestartedSequenceClearsTheBuffer)
+{
+  RetransmitBuffer buffer;
+  buffer.setLimit(1000);
+  buffer.add(5, "a", 1);
+  buffer.add(6, "b", 1);
+  buffer.add(0, "c", 1);
+  std::vector<std::string> output;
+  buffer.collect(nack({ { 0, 6 } }), output);
+  EXPECT_EQ(output, std::vector<std::string>({ "c" }));
+}
+
+TEST(NackTrackerTest, RequestsGapsAtOnceAndRetries)
+{
+  NackTracker tracker;
+  tracker.setLimits(std::chrono::milliseconds(100), 1);
+  tracker.received(1, 0);
+  tracker.received(1, 4);
+  tracker.received(1, 6);
+
+  Nack due;
+  ASSERT_TRUE(tracker.getDueNack(at(0), due));
+  EXPECT_EQ(due.sender_id, 1u);
+  EXPECT_EQ(due.ranges, Ranges({ { 1, 3 }, { 5, 5 } }));
+  EXPECT_FALSE(tracker.getDueNack(at(50), due));
+
+  // recovered messages are not requested again
+  tracker.received(1, 2);
+  ASSERT_TRUE(tracker.getDueNack(at(100), due));
+  EXPECT_EQ(due.ranges, Ranges({ { 1, 1 }, { 3, 3 }, { 5, 5 } }));
+
+  // the retries are used up
+  EXPECT_FALSE(tracker.getDueNack(at(200), due));
+  EXPECT_EQ(tracker.toString(), "0 missing, 2 NACKs sent for 7 messages, 1 recovered, 3 given up");
+}
+
+TEST(NackTrackerTest, LargeGapsTrackOnlyTheMostRecentMessages)
+{
+  NackTracker tracker;
+  tracker.setLimits(std::chrono::milliseconds(100), 0);
+  tracker.received(1, 0);
+  tracker.received(1, 10001);
+
+  Nack due;
+  ASSERT_TRUE(tracker.getDueNack(at(0), due));
+  EXPECT_EQ(due.ranges, Ranges({ { 10001 - 4096, 10000 } }));
+  EXPECT_EQ(tracker.toString(), "4096 missing, 1 NACKs sent for 4096 messages, 0 recovered, 5904 given up");
+}
+
+TEST(NackTrackerTest, SenderRestartGivesUpTheMissingMessages)
+{
+  NackTracker tracker;
+  tracker.setLimits(std::chrono::milliseconds(100), 3);
+  tracker.received(1, 0);
+  tracker.received(1, 3);
+  tracker.received(2, 0);
+
+  Nack due;
+  EXPECT_FALSE(tracker.getDueNack(at(0), due));
+  EXPECT_EQ(tracker.toString(), "0 missing, 0 NACKs sent for 0 messages, 0 recovered, 2 given up");
+
+  tracker.received(2, 2);
+  ASSERT_TRUE(tracker.getDueNack(at(0), due));
+  EXPECT_EQ(due.sender_id, 2u);
+  EXPECT_EQ(due.ranges, Ranges({ { 1, 1 } }));
+}
+
+TEST(NackTrackerTest, TooManyRangesAreSplitOverSeveralNacks)
+{
+  NackTracker tracker;
+  tracker.setLimits(std::chrono::milliseconds(100), 0);
+  // every second message is missing: 300 ranges of one message
+  for (uint64_t sequence = 0; sequence <= 600; sequence += 2)
+  {
+    tracker.received(1, sequence);
+  }
+  Nack due;
+  ASSERT_TRUE(tracker.getDueNack(at(0), due));
+  EXPECT_EQ(due.ranges.size(), 256u);
+  ASSERT_TRUE(tracker.getDueNack(at(0), due));
+  EXPECT_EQ(due.ranges.size(), 44u);
+  EXPECT_EQ(due.ranges.front().first, 513u);
+}
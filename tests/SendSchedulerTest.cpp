@@ -0,0 +1,329 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "SendScheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const size_t QUEUE_LIMIT = 1024 * 1024;
+
+  /** @brief Stands in for the broker connection, records the messages and holds them back while it is busy */
+  class SendSchedulerTest : public ::testing::Test
+  {
+  protected:
+    SendSchedulerTest()
+      : is_connected(true)
+      , is_storing(false)
+      , is_idle(false)
+      , next_mid(1)
+    {
+      output.publish = [this](const std::string& topic, const char* data, size_t size, int qos, bool, const std::chrono::steady_clock::time_point&, int& mid, int& sent_qos)
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        PublishResult result = PUBLISH_SENT;
+        if (!results.empty())
+        {
+          result = results.front();
+          results.erase(results.begin());
+        }
+        if (result == PUBLISH_SENT)
+        {
+          published.emplace_back(topic, std::string(data, size));
+          mid      = next_mid++;
+          sent_qos = qos;
+        }
+        return result;
+      };
+      output.is_connected = [this]() { return is_connected.load(); };
+      output.is_storing   = [this]() { return is_storing.load(); };
+      output.is_idle      = [this]() { return is_idle.load(); };
+    }
+
+    /** @brief Lets the scheduler send, the messages queued so far are sent by priority */
+    void open(SendScheduler& scheduler)
+    {
+      is_idle = true;
+      scheduler.wake();
+    }
+
+    /** @return true once the scheduler has sent the given number of messages, false after a second */
+    bool waitForPublished(size_t count)
+    {
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+      while (std::chrono::steady_clock::now() < deadline)
+      {
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          if (published.size() >= count)
+          {
+            return true;
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return false;
+    }
+
+    std::vector<std::string> publishedTopics()
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      std::vector<std::string> topics;
+      for (auto const& message : published)
+      {
+        topics.push_back(message.first);
+      }
+      return topics;
+    }
+
+    static std::map<std::string, SendScheduler::Route> routes(SendScheduler::Priority priority, size_t chunk_size = 0, int weight = 1)
+    {
+      return { { "topic", { "route", priority, chunk_size, weight } } };
+    }
+
+    SendScheduler::Output                            output;
+    std::atomic<bool>                                is_connected;
+    std::atomic<bool>                                is_storing;
+    std::atomic<bool>                                is_idle;
+    std::mutex                                       mtx;
+    std::vector<PublishResult>                       results;     // returned by the next publishes, then PUBLISH_SENT
+    std::vector<std::pair<std::string, std::string>> published;   // topic and payload
+    int                                              next_mid;
+  };
+}
+
+TEST(SendSchedulerPriorityTest, ParsesThePriorityNames)
+{
+  EXPECT_EQ(SendScheduler::parsePriority("high"), SendScheduler::HIGH);
+  EXPECT_EQ(SendScheduler::parsePriority("normal"), SendScheduler::NORMAL);
+  EXPECT_EQ(SendScheduler::parsePriority("low"), SendScheduler::LOW);
+  EXPECT_EQ(SendScheduler::parsePriority("urgent"), SendScheduler::NORMAL);
+}
+
+TEST_F(SendSchedulerTest, IsOnlyUsedByQueuedRoutesOrABandwidthLimit)
+{
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  EXPECT_FALSE(scheduler.isUsed());
+  scheduler.setRoutes(routes(SendScheduler::NORMAL));
+  EXPECT_FALSE(scheduler.isUsed());
+  scheduler.setRoutes(routes(SendScheduler::HIGH));
+  EXPECT_TRUE(scheduler.isUsed());
+  scheduler.setRoutes({});
+  scheduler.setBandwidthLimit(8000, 1000);
+  EXPECT_TRUE(scheduler.isUsed());
+}
+
+TEST_F(SendSchedulerTest, SendsTheHighestPriorityFirst)
+{
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes({ { "high", { "high", SendScheduler::HIGH, 0, 1 } }, { "low", { "low", SendScheduler::LOW, 0, 1 } } });
+  const auto deadline = std::chrono::steady_clock::time_point::max();
+  scheduler.queue("low", "1", 1, 1, false, deadline);
+  scheduler.queue("normal", "2", 1, 1, false, deadline);
+  scheduler.queue("high", "3", 1, 1, false, deadline);
+  open(scheduler);
+
+  ASSERT_TRUE(waitForPublished(3));
+  EXPECT_EQ(publishedTopics(), (std::vector<std::string>{ "high", "normal", "low" }));
+  auto statistics = scheduler.getPriorityStatistics();
+  EXPECT_EQ(statistics["high"].find("1 sent, 0 queued, 0 dropped"), 0u);
+}
+
+TEST_F(SendSchedulerTest, TopicsShareTheBandwidthByTheirWeight)
+{
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes({ { "heavy", { "heavy", SendScheduler::NORMAL, 0, 3 } }, { "light", { "light", SendScheduler::NORMAL, 0, 1 } } });
+  const std::string payload(100, 'x');
+  for (int i = 0; i < 20; i++)
+  {
+    scheduler.queue("heavy", payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+    scheduler.queue("light", payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+  }
+  open(scheduler);
+
+  ASSERT_TRUE(waitForPublished(40));
+  auto topics = publishedTopics();
+  const auto heavy = std::count(topics.begin(), topics.begin() + 16, "heavy");
+  EXPECT_GE(heavy, 11);
+  EXPECT_LE(heavy, 13);
+}
+
+TEST_F(SendSchedulerTest, SplitsLargeMessagesIntoChunks)
+{
+  SendScheduler scheduler(QUEUE_LIMIT, 0x1234, output);
+  scheduler.setRoutes(routes(SendScheduler::NORMAL, 10));
+  std::string payload;
+  for (int i = 0; i < 25; i++)
+  {
+    payload += static_cast<char>('a' + i);
+  }
+  scheduler.queue("topic", payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+  open(scheduler);
+
+  ASSERT_TRUE(waitForPublished(3));
+  ChunkReassembler reassembler(std::chrono::milliseconds(1000), 1024);
+  const char* complete = nullptr;
+  size_t      complete_size = 0;
+  std::lock_guard<std::mutex> lock(mtx);
+  for (size_t i = 0; i < published.size(); i++)
+  {
+    ChunkHeader header;
+    ASSERT_TRUE(header.read(published[i].second.data(), published[i].second.size()));
+    EXPECT_EQ(header.sender_id, 0x1234u);
+    EXPECT_EQ(header.index, i);
+    EXPECT_EQ(header.count, 3u);
+    EXPECT_EQ(reassembler.add("topic", published[i].second.data(), published[i].second.size(), complete, complete_size), i == 2);
+  }
+  EXPECT_EQ(std::string(complete, complete_size), payload);
+  EXPECT_EQ(scheduler.getChunkStatistics(), "1 messages sent in 3 chunks, 0 dropped");
+}
+
+TEST_F(SendSchedulerTest, FullQueueDropsLowerPrioritiesFirst)
+{
+  SendScheduler scheduler(100, 1, output);
+  scheduler.setRoutes({ { "high", { "high", SendScheduler::HIGH, 0, 1 } }, { "low", { "low", SendScheduler::LOW, 0, 1 } } });
+  const std::string payload(60, 'x');
+  scheduler.queue("low", payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+  scheduler.queue("high", payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+  // nothing of a lower priority left to drop, the message itself is dropped
+  scheduler.queue("high", payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+  open(scheduler);
+
+  ASSERT_TRUE(waitForPublished(1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(publishedTopics(), std::vector<std::string>{ "high" });
+  auto statistics = scheduler.getPriorityStatistics();
+  EXPECT_EQ(statistics["high"].find("1 sent, 0 queued, 1 dropped"), 0u);
+  EXPECT_EQ(statistics["low"].find("0 sent, 0 queued, 1 dropped"), 0u);
+}
+
+TEST_F(SendSchedulerTest, DropsExpiredMessages)
+{
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes(routes(SendScheduler::HIGH));
+  scheduler.queue("topic", "old", 3, 1, false, std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  scheduler.queue("topic", "new", 3, 1, false, std::chrono::steady_clock::time_point::max());
+  open(scheduler);
+
+  ASSERT_TRUE(waitForPublished(1));
+  EXPECT_EQ(scheduler.getExpiredCount(), 1u);
+  std::lock_guard<std::mutex> lock(mtx);
+  EXPECT_EQ(published.front().second, "new");
+}
+
+TEST_F(SendSchedulerTest, RetriesOnlyTransientErrors)
+{
+  results = { PUBLISH_RETRY, PUBLISH_FAILED };
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes(routes(SendScheduler::HIGH));
+  scheduler.queue("topic", "1", 1, 1, false, std::chrono::steady_clock::time_point::max());
+  scheduler.queue("topic", "2", 1, 1, false, std::chrono::steady_clock::time_point::max());
+  open(scheduler);
+
+  // the first message is retried and then rejected, the second one is sent
+  ASSERT_TRUE(waitForPublished(1));
+  std::lock_guard<std::mutex> lock(mtx);
+  ASSERT_EQ(published.size(), 1u);
+  EXPECT_EQ(published.front().second, "2");
+  EXPECT_TRUE(results.empty());
+}
+
+TEST_F(SendSchedulerTest, SendWindowLimitsUnwrittenQos0Messages)
+{
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes(routes(SendScheduler::HIGH));
+  for (int i = 0; i < 6; i++)
+  {
+    scheduler.queue("topic", "x", 1, 0, false, std::chrono::steady_clock::time_point::max());
+  }
+  open(scheduler);
+
+  ASSERT_TRUE(waitForPublished(4));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(publishedTopics().size(), 4u);
+  scheduler.onPublished(1);
+  ASSERT_TRUE(waitForPublished(5));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(publishedTopics().size(), 5u);
+  // mosquitto does not report the messages it could not write before a disconnect
+  scheduler.onDisconnected();
+  ASSERT_TRUE(waitForPublished(6));
+}
+
+TEST_F(SendSchedulerTest, StoresTheMessagesWhileTheStoreIsUsed)
+{
+  std::vector<std::string> stored;
+  output.store = [&](const std::string&, const char* data, size_t size, int, bool, const std::chrono::steady_clock::time_point&)
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stored.emplace_back(data, size);
+  };
+  is_connected = false;
+  is_storing   = true;
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes(routes(SendScheduler::HIGH));
+  scheduler.queue("topic", "1", 1, 1, false, std::chrono::steady_clock::time_point::max());
+  scheduler.queue("topic", "2", 1, 1, false, std::chrono::steady_clock::time_point::max());
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (stored.size() == 2)
+      {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::lock_guard<std::mutex> lock(mtx);
+  EXPECT_EQ(stored, (std::vector<std::string>{ "1", "2" }));
+  EXPECT_TRUE(published.empty());
+}
+
+TEST_F(SendSchedulerTest, DropsTheQueueWhileDisconnectedWithoutStore)
+{
+  is_connected = false;
+  SendScheduler scheduler(QUEUE_LIMIT, 1, output);
+  scheduler.setRoutes(routes(SendScheduler::HIGH));
+  scheduler.queue("topic", "1", 1, 1, false, std::chrono::steady_clock::time_point::max());
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (std::chrono::steady_clock::now() < deadline && scheduler.getPriorityStatistics()["high"].find("1 dropped") == std::string::npos)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(scheduler.getPriorityStatistics()["high"].find("0 sent, 0 queued, 1 dropped"), 0u);
+  is_connected = true;
+  open(scheduler);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_TRUE(publishedTopics().empty());
+}
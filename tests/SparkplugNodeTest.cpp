@@ -0,0 +1,322 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "SparkplugNode.h"
+#include "TestSchema.h"
+
+#include <gtest/gtest.h>
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/text_format.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  /**
+   * The parts of sparkplug_b.proto the edge node writes, to decode its output
+   * independently of its encoder.
+   */
+  const char* const SPARKPLUG_FILE = R"(
+    name: "sparkplug_b.proto"
+    package: "org.eclipse.tahu.protobuf"
+    syntax: "proto2"
+    message_type {
+      name: "Payload"
+      field { name: "timestamp" number: 1 label: LABEL_OPTIONAL type: TYPE_UINT64 }
+      field { name: "metrics" number: 2 label: LABEL_REPEATED type: TYPE_MESSAGE type_name: ".org.eclipse.tahu.protobuf.Payload.Metric" }
+      field { name: "seq" number: 3 label: LABEL_OPTIONAL type: TYPE_UINT64 }
+      nested_type {
+        name: "Metric"
+        field { name: "name" number: 1 label: LABEL_OPTIONAL type: TYPE_STRING }
+        field { name: "alias" number: 2 label: LABEL_OPTIONAL type: TYPE_UINT64 }
+        field { name: "timestamp" number: 3 label: LABEL_OPTIONAL type: TYPE_UINT64 }
+        field { name: "datatype" number: 4 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+        field { name: "int_value" number: 10 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+        field { name: "long_value" number: 11 label: LABEL_OPTIONAL type: TYPE_UINT64 }
+        field { name: "float_value" number: 12 label: LABEL_OPTIONAL type: TYPE_FLOAT }
+        field { name: "double_value" number: 13 label: LABEL_OPTIONAL type: TYPE_DOUBLE }
+        field { name: "boolean_value" number: 14 label: LABEL_OPTIONAL type: TYPE_BOOL }
+        field { name: "string_value" number: 15 label: LABEL_OPTIONAL type: TYPE_STRING }
+        field { name: "bytes_value" number: 16 label: LABEL_OPTIONAL type: TYPE_BYTES }
+      }
+    }
+  )";
+
+  struct Metric
+  {
+    std::string name;      // empty in data messages
+    bool        has_alias;
+    uint64_t    alias;
+    uint32_t    datatype;  // 0 in data messages
+    std::string value;     // in protobuf text format, e.g. "int_value: 5"
+  };
+
+  struct Published
+  {
+    std::string         topic;
+    uint64_t            seq;
+    std::vector<Metric> metrics;
+
+    const Metric* find(const std::string& name) const
+    {
+      for (auto const& metric : metrics)
+      {
+        if (metric.name == name)
+        {
+          return &metric;
+        }
+      }
+      return nullptr;
+    }
+  };
+
+  class SparkplugNodeTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      google::protobuf::FileDescriptorSet file_set;
+      ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(SPARKPLUG_FILE, file_set.add_file()));
+      payload_schema = ProtobufSchema::build("proto:org.eclipse.tahu.protobuf.Payload", file_set.SerializeAsString());
+      ASSERT_NE(payload_schema, nullptr);
+      sample_schema = test_schema::build();
+      ASSERT_NE(sample_schema, nullptr);
+
+      node.reset(new SparkplugNode("plant", "bridge", [this](const std::string& topic, const std::string& payload)
+        {
+          published.push_back(decode(topic, payload));
+        }));
+    }
+
+    Published decode(const std::string& topic, const std::string& data) const
+    {
+      std::unique_ptr<google::protobuf::Message> payload(payload_schema->prototype->New());
+      EXPECT_TRUE(payload->ParseFromString(data));
+      const google::protobuf::Descriptor* descriptor = payload->GetDescriptor();
+      const google::protobuf::Reflection* reflection = payload->GetReflection();
+
+      Published result;
+      result.topic = topic;
+      result.seq   = reflection->GetUInt64(*payload, descriptor->FindFieldByName("seq"));
+      const google::protobuf::FieldDescriptor* metrics_field = descriptor->FindFieldByName("metrics");
+      for (int i = 0; i < reflection->FieldSize(*payload, metrics_field); i++)
+      {
+        const google::protobuf::Message& entry = reflection->GetRepeatedMessage(*payload, metrics_field, i);
+        const google::protobuf::Descriptor* metric_descriptor = entry.GetDescriptor();
+        const google::protobuf::Reflection* metric_reflection = entry.GetReflection();
+        Metric metric;
+        metric.name      = metric_reflection->GetString(entry, metric_descriptor->FindFieldByName("name"));
+        metric.has_alias = metric_reflection->HasField(entry, metric_descriptor->FindFieldByName("alias"));
+        metric.alias     = metric_reflection->GetUInt64(entry, metric_descriptor->FindFieldByName("alias"));
+        metric.datatype  = metric_reflection->GetUInt32(entry, metric_descriptor->FindFieldByName("datatype"));
+        for (int field = 10; field <= 16; field++)
+        {
+          if (metric_reflection->HasField(entry, metric_descriptor->FindFieldByNumber(field)))
+          {
+            google::protobuf::TextFormat::PrintFieldValueToString(entry, metric_descriptor->FindFieldByNumber(field), -1, &metric.value);
+            metric.value = metric_descriptor->FindFieldByNumber(field)->name() + ": " + metric.value;
+          }
+        }
+        result.metrics.push_back(metric);
+      }
+      return result;
+    }
+
+    void update(const std::string& device_id, const std::string& message)
+    {
+      node->update(device_id, *test_schema::parse(*sample_schema, message));
+    }
+
+    /** @return the bdSeq of the NDEATH the node currently sets as will */
+    std::string deathBdSeq() const
+    {
+      const Published death = decode(node->getDeathTopic(), node->getDeathPayload());
+      const Metric* bd_seq = death.find("bdSeq");
+      return bd_seq ? bd_seq->value : std::string();
+    }
+
+    std::shared_ptr<const ProtobufSchema> payload_schema;
+    std::shared_ptr<const ProtobufSchema> sample_schema;
+    std::unique_ptr<SparkplugNode>        node;
+    std::vector<Published>                published;
+  };
+}
+
+TEST_F(SparkplugNodeTest, BirthsAnnounceTheMetricsWithTheirAliases)
+{
+  node->setDevices({ { "robot", {} } });
+  node->publishBirth();
+  ASSERT_EQ(published.size(), 1u);
+  EXPECT_EQ(published[0].topic, "spBv1.0/plant/NBIRTH/bridge");
+  EXPECT_EQ(published[0].seq, 0u);
+  ASSERT_NE(published[0].find("bdSeq"), nullptr);
+  EXPECT_EQ(published[0].find("bdSeq")->value, "long_value: 0");
+  ASSERT_NE(published[0].find("Node Control/Rebirth"), nullptr);
+  EXPECT_EQ(published[0].find("Node Control/Rebirth")->value, "boolean_value: false");
+
+  // a device is born with its first message
+  update("robot", "id: 5 name: \"arm\" position { x: 1.5 y: 2 } values: 7 counters { key: \"cycles\" value: 3 }");
+  ASSERT_EQ(published.size(), 2u);
+  const Published& birth = published[1];
+  EXPECT_EQ(birth.topic, "spBv1.0/plant/DBIRTH/bridge/robot");
+  EXPECT_EQ(birth.seq, 1u);
+
+  const std::map<std::string, std::pair<uint32_t, std::string>> expected = {
+    { "id",              { 3, "int_value: 5" } },
+    { "name",            { 12, "string_value: \"arm\"" } },
+    { "mode",            { 12, "string_value: \"MODE_OFF\"" } },
+    { "position/x",      { 10, "double_value: 1.5" } },
+    { "position/y",      { 10, "double_value: 2" } },
+    { "values/0",        { 3, "int_value: 7" } },
+    { "counters/cycles", { 3, "int_value: 3" } },
+  };
+  for (auto const& metric : expected)
+  {
+    const Metric* born = birth.find(metric.first);
+    ASSERT_NE(born, nullptr) << metric.first;
+    EXPECT_TRUE(born->has_alias) << metric.first;
+    EXPECT_EQ(born->datatype, metric.second.first) << metric.first;
+    EXPECT_EQ(born->value, metric.second.second) << metric.first;
+  }
+  std::map<uint64_t, std::string> aliases;
+  for (auto const& metric : birth.metrics)
+  {
+    EXPECT_TRUE(aliases.emplace(metric.alias, metric.name).second) << metric.name << " has the alias of " << aliases[metric.alias];
+  }
+}
+
+TEST_F(SparkplugNodeTest, DataCarriesOnlyTheChangedMetrics)
+{
+  node->setDevices({ { "robot", {} } });
+  node->publishBirth();
+  update("robot", "id: 5 value: 1.5 name: \"arm\"");
+  ASSERT_EQ(published.size(), 2u);
+  const Metric* id = published[1].find("id");
+  ASSERT_NE(id, nullptr);
+
+  update("robot", "id: 6 value: 1.5 name: \"arm\"");
+  ASSERT_EQ(published.size(), 3u);
+  EXPECT_EQ(published[2].topic, "spBv1.0/plant/DDATA/bridge/robot");
+  EXPECT_EQ(published[2].seq, 2u);
+  ASSERT_EQ(published[2].metrics.size(), 1u);
+  // data messages refer to the metric by its alias only
+  EXPECT_TRUE(published[2].metrics[0].name.empty());
+  EXPECT_EQ(published[2].metrics[0].alias, id->alias);
+  EXPECT_EQ(published[2].metrics[0].value, "int_value: 6");
+
+  // nothing changed, nothing is sent
+  update("robot", "id: 6 value: 1.5 name: \"arm\"");
+  EXPECT_EQ(published.size(), 3u);
+}
+
+TEST_F(SparkplugNodeTest, DeadbandsSuppressSmallChanges)
+{
+  node->setDevices({ { "robot", { { "value", 0.5 } } } });
+  node->publishBirth();
+  update("robot", "id: 1 value: 1.0");
+  ASSERT_EQ(published.size(), 2u);
+
+  // within the deadband of the last reported value, the other metric has none
+  update("robot", "id: 1 value: 1.3");
+  update("robot", "id: 1 value: 1.5");
+  EXPECT_EQ(published.size(), 2u);
+  update("robot", "id: 2 value: 1.4");
+  ASSERT_EQ(published.size(), 3u);
+  ASSERT_EQ(published[2].metrics.size(), 1u);
+  EXPECT_EQ(published[2].metrics[0].value, "int_value: 2");
+
+  update("robot", "id: 2 value: 1.6");
+  ASSERT_EQ(published.size(), 4u);
+  ASSERT_EQ(published[3].metrics.size(), 1u);
+  EXPECT_EQ(published[3].metrics[0].value, "double_value: 1.6");
+}
+
+TEST_F(SparkplugNodeTest, NewMetricTriggersADeviceBirth)
+{
+  node->setDevices({ { "robot", {} } });
+  node->publishBirth();
+  update("robot", "values: 1");
+  ASSERT_EQ(published.size(), 2u);
+  EXPECT_EQ(published[1].find("values/1"), nullptr);
+
+  update("robot", "values: 1 values: 2");
+  ASSERT_EQ(published.size(), 3u);
+  EXPECT_EQ(published[2].topic, "spBv1.0/plant/DBIRTH/bridge/robot");
+  ASSERT_NE(published[2].find("values/0"), nullptr);
+  ASSERT_NE(published[2].find("values/1"), nullptr);
+  EXPECT_EQ(published[2].find("values/1")->value, "int_value: 2");
+  // the aliases of the known metrics stay
+  EXPECT_EQ(published[2].find("values/0")->alias, published[1].find("values/0")->alias);
+}
+
+TEST_F(SparkplugNodeTest, SeqAndBdSeqWrapAt256)
+{
+  node->setDevices({ { "robot", {} } });
+  node->publishBirth();
+  for (int id = 0; id < 257; id++)
+  {
+    update("robot", "id: " + std::to_string(id));
+  }
+  // NBIRTH, DBIRTH and 256 DDATA
+  ASSERT_EQ(published.size(), 258u);
+  for (size_t i = 0; i < published.size(); i++)
+  {
+    EXPECT_EQ(published[i].seq, i % 256);
+  }
+
+  // every lost connection counts the bdSeq of the next one
+  EXPECT_EQ(deathBdSeq(), "long_value: 0");
+  for (int connection = 1; connection <= 256; connection++)
+  {
+    node->setOffline();
+    // a second setOffline, e.g. by the on_disconnect after a deliberate disconnect, does not count
+    node->setOffline();
+    EXPECT_EQ(deathBdSeq(), "long_value: " + std::to_string(connection % 256));
+    node->publishBirth();
+  }
+  // the NBIRTH restarts the seq and carries the bdSeq of the will
+  EXPECT_EQ(published.back().topic, "spBv1.0/plant/DBIRTH/bridge/robot");
+  const Published& birth = published[published.size() - 2];
+  EXPECT_EQ(birth.topic, "spBv1.0/plant/NBIRTH/bridge");
+  EXPECT_EQ(birth.seq, 0u);
+  EXPECT_EQ(birth.find("bdSeq")->value, "long_value: 0");
+}
+
+TEST_F(SparkplugNodeTest, RecognizesRebirthRequests)
+{
+  auto command = [this](const std::string& metric)
+  {
+    std::unique_ptr<google::protobuf::Message> payload(payload_schema->prototype->New());
+    EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString("timestamp: 1 metrics { " + metric + " }", payload.get()));
+    return payload->SerializeAsString();
+  };
+  const std::string rebirth    = command("name: \"Node Control/Rebirth\" datatype: 11 boolean_value: true");
+  const std::string no_rebirth = command("name: \"Node Control/Rebirth\" datatype: 11 boolean_value: false");
+  const std::string other      = command("name: \"Node Control/Reboot\" datatype: 11 boolean_value: true");
+  EXPECT_TRUE(SparkplugNode::isRebirthRequest(rebirth.data(), rebirth.size()));
+  EXPECT_FALSE(SparkplugNode::isRebirthRequest(no_rebirth.data(), no_rebirth.size()));
+  EXPECT_FALSE(SparkplugNode::isRebirthRequest(other.data(), other.size()));
+  EXPECT_FALSE(SparkplugNode::isRebirthRequest("\x12\x05\x0a", 3));
+}
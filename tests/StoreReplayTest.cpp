@@ -0,0 +1,170 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "StoreReplay.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+namespace
+{
+  class StoreReplayTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      char path[] = "/tmp/store_replay_test_XXXXXX";
+      ASSERT_NE(mkdtemp(path), nullptr);
+      directory = path;
+      is_connected = false;
+    }
+
+    void TearDown() override
+    {
+      replay.reset();
+      if (DIR* dir = opendir(directory.c_str()))
+      {
+        while (struct dirent* entry = readdir(dir))
+        {
+          unlink((directory + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+      }
+      rmdir(directory.c_str());
+    }
+
+    void createReplay()
+    {
+      std::unique_ptr<MessageStore> store(new MessageStore(directory, 64 * 1024, 0, 0, false));
+      ASSERT_TRUE(store->open());
+      replay.reset(new StoreReplay(std::move(store), 0, bandwidth, [this](const std::string& topic, const char* data, size_t size, int, bool, const std::chrono::steady_clock::time_point&)
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          PublishResult result = PUBLISH_SENT;
+          if (!results.empty())
+          {
+            result = results.front();
+            results.pop_front();
+          }
+          if (result == PUBLISH_SENT)
+          {
+            published.push_back(topic + "=" + std::string(data, size));
+          }
+          attempts++;
+          return result;
+        }, [this]() { return is_connected.load(); }));
+    }
+
+    void append(const std::string& topic, const std::string& payload)
+    {
+      replay->append(topic, payload.data(), payload.size(), 1, false, std::chrono::steady_clock::time_point::max());
+    }
+
+    bool waitForDrained()
+    {
+      for (int i = 0; i < 500 && replay->hasBacklog(); i++)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      return !replay->hasBacklog();
+    }
+
+    std::string                   directory;
+    TokenBucket                   bandwidth;
+    std::atomic<bool>             is_connected;
+    std::unique_ptr<StoreReplay>  replay;
+
+    std::mutex                    mtx;
+    std::deque<PublishResult>     results;   // of the next publish calls, then PUBLISH_SENT
+    std::vector<std::string>      published;
+    int                           attempts = 0;
+  };
+}
+
+TEST_F(StoreReplayTest, SendsTheStoredMessagesInOrderAfterTheConnect)
+{
+  createReplay();
+  replay->start();
+  append("a", "1");
+  append("b", "2");
+  append("a", "3");
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_TRUE(replay->hasBacklog());
+
+  is_connected = true;
+  replay->wake();
+  ASSERT_TRUE(waitForDrained());
+  std::lock_guard<std::mutex> lock(mtx);
+  EXPECT_EQ(published, (std::vector<std::string>{ "a=1", "b=2", "a=3" }));
+}
+
+TEST_F(StoreReplayTest, RetriesTransientErrorsAndDropsRejectedMessages)
+{
+  createReplay();
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    results = { PUBLISH_RETRY, PUBLISH_RETRY, PUBLISH_FAILED };
+  }
+  append("a", "1");
+  append("a", "2");
+  is_connected = true;
+  replay->start();
+  ASSERT_TRUE(waitForDrained());
+
+  // the first message was retried until it was rejected, the second one was sent
+  std::lock_guard<std::mutex> lock(mtx);
+  EXPECT_EQ(attempts, 4);
+  EXPECT_EQ(published, std::vector<std::string>{ "a=2" });
+}
+
+TEST_F(StoreReplayTest, KeepsTheMessagesWhenStopped)
+{
+  createReplay();
+  append("a", "1");
+  replay->start();
+  replay->stop();
+  EXPECT_TRUE(replay->hasBacklog());
+
+  // a new replay recovers them from the segment files
+  replay.reset();
+  createReplay();
+  EXPECT_TRUE(replay->hasBacklog());
+}
+
+TEST_F(StoreReplayTest, ConvertsTheDeadlinesToTheWallClock)
+{
+  EXPECT_EQ(StoreReplay::toStoreDeadline(std::chrono::steady_clock::time_point::max()), 0);
+  EXPECT_EQ(StoreReplay::fromStoreDeadline(0), std::chrono::steady_clock::time_point::max());
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  const auto converted = StoreReplay::fromStoreDeadline(StoreReplay::toStoreDeadline(deadline));
+  EXPECT_LT(converted, deadline + std::chrono::milliseconds(100));
+  EXPECT_GT(converted, deadline - std::chrono::milliseconds(100));
+}
@@ -0,0 +1,106 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#pragma once
+
+#include "ProtobufSchema.h"
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/text_format.h>
+
+#include <memory>
+#include <string>
+
+/**
+ * The message types used by the tests, built at runtime like the descriptors
+ * that eCAL registers for a topic:
+ *
+ *   package test;
+ *   enum Mode { MODE_OFF = 0; MODE_ON = 1; }
+ *   message Position { double x = 1; double y = 2; }
+ *   message Sample {
+ *     int32 id = 1;  int64 stamp = 2;  uint32 count = 3;  double value = 4;
+ *     float ratio = 5;  bool valid = 6;  string name = 7;  bytes data = 8;
+ *     Mode mode = 9;  Position position = 10;  repeated int32 values = 11;
+ *     repeated Position track = 12;  map<string, int32> counters = 13;
+ *     sint32 delta = 14;
+ *   }
+ */
+namespace test_schema
+{
+  inline const char* sampleFile()
+  {
+    return R"(
+      name: "test/sample.proto"
+      package: "test"
+      syntax: "proto3"
+      enum_type { name: "Mode" value { name: "MODE_OFF" number: 0 } value { name: "MODE_ON" number: 1 } }
+      message_type {
+        name: "Position"
+        field { name: "x" number: 1 label: LABEL_OPTIONAL type: TYPE_DOUBLE json_name: "x" }
+        field { name: "y" number: 2 label: LABEL_OPTIONAL type: TYPE_DOUBLE json_name: "y" }
+      }
+      message_type {
+        name: "Sample"
+        field { name: "id" number: 1 label: LABEL_OPTIONAL type: TYPE_INT32 json_name: "id" }
+        field { name: "stamp" number: 2 label: LABEL_OPTIONAL type: TYPE_INT64 json_name: "stamp" }
+        field { name: "count" number: 3 label: LABEL_OPTIONAL type: TYPE_UINT32 json_name: "count" }
+        field { name: "value" number: 4 label: LABEL_OPTIONAL type: TYPE_DOUBLE json_name: "value" }
+        field { name: "ratio" number: 5 label: LABEL_OPTIONAL type: TYPE_FLOAT json_name: "ratio" }
+        field { name: "valid" number: 6 label: LABEL_OPTIONAL type: TYPE_BOOL json_name: "valid" }
+        field { name: "name" number: 7 label: LABEL_OPTIONAL type: TYPE_STRING json_name: "name" }
+        field { name: "data" number: 8 label: LABEL_OPTIONAL type: TYPE_BYTES json_name: "data" }
+        field { name: "mode" number: 9 label: LABEL_OPTIONAL type: TYPE_ENUM type_name: ".test.Mode" json_name: "mode" }
+        field { name: "position" number: 10 label: LABEL_OPTIONAL type: TYPE_MESSAGE type_name: ".test.Position" json_name: "position" }
+        field { name: "values" number: 11 label: LABEL_REPEATED type: TYPE_INT32 json_name: "values" }
+        field { name: "track" number: 12 label: LABEL_REPEATED type: TYPE_MESSAGE type_name: ".test.Position" json_name: "track" }
+        field { name: "counters" number: 13 label: LABEL_REPEATED type: TYPE_MESSAGE type_name: ".test.Sample.CountersEntry" json_name: "counters" }
+        field { name: "delta_value" number: 14 label: LABEL_OPTIONAL type: TYPE_SINT32 json_name: "deltaValue" }
+        nested_type {
+          name: "CountersEntry"
+          field { name: "key" number: 1 label: LABEL_OPTIONAL type: TYPE_STRING json_name: "key" }
+          field { name: "value" number: 2 label: LABEL_OPTIONAL type: TYPE_INT32 json_name: "value" }
+          options { map_entry: true }
+        }
+      }
+    )";
+  }
+
+  /** @return the serialized FileDescriptorSet of the test types */
+  inline std::string descriptor()
+  {
+    google::protobuf::FileDescriptorSet file_set;
+    google::protobuf::TextFormat::ParseFromString(sampleFile(), file_set.add_file());
+    return file_set.SerializeAsString();
+  }
+
+  /** @param type_name e.g. "proto:test.Sample" */
+  inline std::shared_ptr<const ProtobufSchema> build(const std::string& type_name = "proto:test.Sample")
+  {
+    return ProtobufSchema::build(type_name, descriptor());
+  }
+
+  /** @return a message of the schema's type, parsed from protobuf text format */
+  inline std::unique_ptr<google::protobuf::Message> parse(const ProtobufSchema& schema, const std::string& text)
+  {
+    std::unique_ptr<google::protobuf::Message> message(schema.prototype->New());
+    google::protobuf::TextFormat::ParseFromString(text, message.get());
+    return message;
+  }
+}
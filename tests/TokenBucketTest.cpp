@@ -0,0 +1,106 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "TokenBucket.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+// the rates are low, so the refills while a test runs do not matter
+
+TEST(TokenBucketTest, UnlimitedNeverWaits)
+{
+  TokenBucket bucket;
+  EXPECT_FALSE(bucket.isLimited());
+  EXPECT_EQ(bucket.take(1 << 30).count(), 0);
+  bucket.refund(100);
+  EXPECT_EQ(bucket.take(1 << 30).count(), 0);
+}
+
+TEST(TokenBucketTest, StartsFullAndWaitsForTheMissingTokens)
+{
+  TokenBucket bucket;
+  bucket.setRate(1000, 1000);
+  EXPECT_TRUE(bucket.isLimited());
+  EXPECT_EQ(bucket.take(600).count(), 0);
+
+  // 200 bytes are missing, at 1000 bytes/s that is 200 ms
+  const auto wait = bucket.take(600);
+  EXPECT_GT(wait, std::chrono::milliseconds(150));
+  EXPECT_LE(wait, std::chrono::milliseconds(200));
+}
+
+TEST(TokenBucketTest, RefillsAtTheRate)
+{
+  TokenBucket bucket;
+  bucket.setRate(10000, 100);
+  EXPECT_EQ(bucket.take(100).count(), 0);
+  EXPECT_GT(bucket.take(100).count(), 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(bucket.take(100).count(), 0);
+}
+
+TEST(TokenBucketTest, LargeMessagesNeedAFullBucketAndLeaveADebt)
+{
+  TokenBucket bucket;
+  bucket.setRate(1000, 100);
+  EXPECT_EQ(bucket.take(50).count(), 0);
+  EXPECT_GT(bucket.take(5000).count(), 0);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  EXPECT_EQ(bucket.take(5000).count(), 0);
+
+  // the debt of 4900 bytes is paid first
+  EXPECT_GT(bucket.take(1), std::chrono::milliseconds(4500));
+}
+
+TEST(TokenBucketTest, RefundGivesBackTheTokensUpToTheBurst)
+{
+  TokenBucket bucket;
+  bucket.setRate(1000, 1000);
+  EXPECT_EQ(bucket.take(1000).count(), 0);
+  EXPECT_GT(bucket.take(500).count(), 0);
+  bucket.refund(1000);
+  EXPECT_EQ(bucket.take(1000).count(), 0);
+
+  // more than the burst is not kept
+  bucket.refund(5000);
+  EXPECT_EQ(bucket.take(1000).count(), 0);
+  EXPECT_GT(bucket.take(500).count(), 0);
+}
+
+TEST(TokenBucketTest, ChangingTheRateKeepsTheTokens)
+{
+  TokenBucket bucket;
+  bucket.setRate(1000, 1000);
+  EXPECT_EQ(bucket.take(900).count(), 0);
+
+  // a smaller burst caps the tokens, a higher rate shortens the wait
+  bucket.setRate(100000, 50);
+  EXPECT_EQ(bucket.take(50).count(), 0);
+  const auto wait = bucket.take(50);
+  EXPECT_GT(wait.count(), 0);
+  EXPECT_LE(wait, std::chrono::microseconds(500));
+
+  bucket.setRate(0, 0);
+  EXPECT_FALSE(bucket.isLimited());
+  EXPECT_EQ(bucket.take(1 << 20).count(), 0);
+}
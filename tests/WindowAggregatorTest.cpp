@@ -0,0 +1,195 @@
+/* ========================= MQTT2eCAL LICENSE =================================
+ *
+ * Copyright (C) 2016 - 2019 Continental Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ========================= MQTT2eCAL LICENSE =================================
+*/
+
+#include "WindowAggregator.h"
+#include "TestSchema.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+  class WindowAggregatorTest : public ::testing::Test
+  {
+  protected:
+    void SetUp() override
+    {
+      schema = test_schema::build();
+      ASSERT_NE(schema, nullptr);
+    }
+
+    std::shared_ptr<WindowAggregator> compile(const std::vector<std::string>& paths, int64_t window_us, int64_t step_us, int functions = WindowAggregator::ALL)
+    {
+      std::string error;
+      auto aggregator = WindowAggregator::compile(schema, paths, window_us, step_us, functions, error);
+      EXPECT_NE(aggregator, nullptr) << error;
+      return aggregator;
+    }
+
+    // adds a message in text format and returns the windows it closed
+    std::vector<std::string> add(WindowAggregator& aggregator, const std::string& message, int64_t time_us)
+    {
+      const std::string data = test_schema::parse(*schema, message)->SerializeAsString();
+      std::vector<std::string> windows;
+      EXPECT_TRUE(aggregator.add(data.data(), data.size(), time_us, windows));
+      return windows;
+    }
+
+    std::shared_ptr<const ProtobufSchema> schema;
+  };
+}
+
+TEST(WindowAggregatorFunctionsTest, ParsesFunctionNames)
+{
+  int functions = 0;
+  ASSERT_TRUE(WindowAggregator::parseFunctions({}, functions));
+  EXPECT_EQ(functions, WindowAggregator::ALL);
+  ASSERT_TRUE(WindowAggregator::parseFunctions({ "min", "last" }, functions));
+  EXPECT_EQ(functions, WindowAggregator::MIN | WindowAggregator::LAST);
+  EXPECT_FALSE(WindowAggregator::parseFunctions({ "median" }, functions));
+}
+
+TEST_F(WindowAggregatorTest, TumblingWindowClosesWithTheNextWindow)
+{
+  auto aggregator = compile({ "value", "position.x" }, 1000, 1000);
+  ASSERT_NE(aggregator, nullptr);
+  EXPECT_TRUE(add(*aggregator, "value: 1 position { x: 10 }", 0).empty());
+  EXPECT_TRUE(add(*aggregator, "value: 4 position { x: -2 }", 400).empty());
+  EXPECT_TRUE(add(*aggregator, "value: 2", 999).empty());
+
+  auto windows = add(*aggregator, "value: 100", 1000);
+  ASSERT_EQ(windows.size(), 1u);
+  EXPECT_EQ(windows[0], R"({"start":0,"end":1000,"count":3,"fields":{"value":{"min":1,"max":4,"mean":2.3333333333333335,"last":2},"position.x":{"min":-2,"max":10,"mean":2.6666666666666665,"last":0}}})");
+}
+
+TEST_F(WindowAggregatorTest, SlidingWindowsShareTheirSteps)
+{
+  auto aggregator = compile({ "value" }, 3000, 1000, WindowAggregator::COUNT | WindowAggregator::MEAN | WindowAggregator::LAST);
+  ASSERT_NE(aggregator, nullptr);
+  EXPECT_TRUE(add(*aggregator, "value: 1", 0).empty());
+
+  auto windows = add(*aggregator, "value: 2", 1000);
+  ASSERT_EQ(windows.size(), 1u);
+  EXPECT_EQ(windows[0], R"({"start":-2000,"end":1000,"count":1,"fields":{"value":{"mean":1,"last":1}}})");
+
+  windows = add(*aggregator, "value: 3", 2000);
+  ASSERT_EQ(windows.size(), 1u);
+  EXPECT_EQ(windows[0], R"({"start":-1000,"end":2000,"count":2,"fields":{"value":{"mean":1.5,"last":2}}})");
+
+  windows = add(*aggregator, "value: 4", 3000);
+  ASSERT_EQ(windows.size(), 1u);
+  EXPECT_EQ(windows[0], R"({"start":0,"end":3000,"count":3,"fields":{"value":{"mean":2,"last":3}}})");
+
+  // a jump closes every window that still covers a step with samples, and no empty ones
+  windows = add(*aggregator, "value: 5", 10000);
+  ASSERT_EQ(windows.size(), 3u);
+  EXPECT_EQ(windows[0], R"({"start":1000,"end":4000,"count":3,"fields":{"value":{"mean":3,"last":4}}})");
+  EXPECT_EQ(windows[1], R"({"start":2000,"end":5000,"count":2,"fields":{"value":{"mean":3.5,"last":4}}})");
+  EXPECT_EQ(windows[2], R"({"start":3000,"end":6000,"count":1,"fields":{"value":{"mean":4,"last":4}}})");
+}
+
+TEST_F(WindowAggregatorTest, LateSamplesAreDropped)
+{
+  auto aggregator = compile({ "id" }, 1000, 1000, WindowAggregator::COUNT);
+  ASSERT_NE(aggregator, nullptr);
+  add(*aggregator, "id: 1", 5000);
+  EXPECT_TRUE(add(*aggregator, "id: 2", 4999).empty());
+
+  auto windows = add(*aggregator, "id: 3", 6000);
+  ASSERT_EQ(windows.size(), 1u);
+  EXPECT_EQ(windows[0], R"({"start":5000,"end":6000,"count":1,"fields":{"id":{}}})");
+  EXPECT_NE(aggregator->getStatistics().find("1 late"), std::string::npos) << aggregator->getStatistics();
+}
+
+TEST_F(WindowAggregatorTest, FlushIdleClosesTheOpenWindows)
+{
+  auto aggregator = compile({ "count" }, 2000, 1000, WindowAggregator::MAX);
+  ASSERT_NE(aggregator, nullptr);
+  add(*aggregator, "count: 7", 500);
+
+  std::vector<std::string> windows;
+  aggregator->flushIdle(std::chrono::steady_clock::now(), windows);
+  EXPECT_TRUE(windows.empty());
+
+  aggregator->flushIdle(std::chrono::steady_clock::now() + std::chrono::seconds(1), windows);
+  ASSERT_EQ(windows.size(), 2u);
+  EXPECT_EQ(windows[0], R"({"start":-1000,"end":1000,"fields":{"count":{"max":7}}})");
+  EXPECT_EQ(windows[1], R"({"start":0,"end":2000,"fields":{"count":{"max":7}}})");
+
+  // the flushed windows are closed, their samples are late now
+  EXPECT_TRUE(add(*aggregator, "count: 1", 1500).empty());
+  EXPECT_NE(aggregator->getStatistics().find("1 late"), std::string::npos) << aggregator->getStatistics();
+}
+
+TEST_F(WindowAggregatorTest, IdleDeadlineIsAWindowAfterTheLastSample)
+{
+  auto aggregator = compile({ "count" }, 2000, 1000, WindowAggregator::MAX);
+  ASSERT_NE(aggregator, nullptr);
+  const auto now = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  // without open windows a sample added from now on is closed a window later at the earliest
+  EXPECT_EQ(aggregator->getIdleDeadline(now), now + std::chrono::milliseconds(2));
+
+  const auto before = std::chrono::steady_clock::now();
+  add(*aggregator, "count: 7", 500);
+  const auto deadline = aggregator->getIdleDeadline(now);
+  EXPECT_GE(deadline, before + std::chrono::milliseconds(2));
+  EXPECT_LE(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(2));
+
+  std::vector<std::string> windows;
+  aggregator->flushIdle(deadline, windows);
+  EXPECT_EQ(windows.size(), 2u);
+  EXPECT_EQ(aggregator->getIdleDeadline(now), now + std::chrono::milliseconds(2));
+}
+
+TEST_F(WindowAggregatorTest, AggregatesSignedBoolAndEnumFields)
+{
+  auto aggregator = compile({ "deltaValue", "valid", "mode", "stamp" }, 1000, 1000, WindowAggregator::MIN);
+  ASSERT_NE(aggregator, nullptr);
+  add(*aggregator, "delta_value: -3 valid: true mode: MODE_ON stamp: -9000000000", 0);
+  auto windows = add(*aggregator, "", 1000);
+  ASSERT_EQ(windows.size(), 1u);
+  EXPECT_EQ(windows[0], R"({"start":0,"end":1000,"fields":{"deltaValue":{"min":-3},"valid":{"min":1},"mode":{"min":1},"stamp":{"min":-9000000000}}})");
+}
+
+TEST_F(WindowAggregatorTest, RejectsInvalidConfigurations)
+{
+  std::string error;
+  EXPECT_EQ(WindowAggregator::compile(schema, { "value" }, 1000, 300, WindowAggregator::ALL, error), nullptr);
+  EXPECT_EQ(WindowAggregator::compile(schema, {}, 1000, 1000, WindowAggregator::ALL, error), nullptr);
+  for (auto const& path : { "unknown", "name", "values", "position", "id.x" })
+  {
+    error.clear();
+    EXPECT_EQ(WindowAggregator::compile(schema, { path }, 1000, 1000, WindowAggregator::ALL, error), nullptr) << path;
+    EXPECT_FALSE(error.empty()) << path;
+  }
+}
+
+TEST_F(WindowAggregatorTest, RejectsMalformedMessages)
+{
+  auto aggregator = compile({ "position.x" }, 1000, 1000);
+  ASSERT_NE(aggregator, nullptr);
+  std::vector<std::string> windows;
+  EXPECT_FALSE(aggregator->add("\x52\x10\x09", 3, 0, windows));
+  EXPECT_FALSE(aggregator->add("\x0f\x01", 2, 0, windows));
+  EXPECT_NE(aggregator->getStatistics().find("2 malformed"), std::string::npos) << aggregator->getStatistics();
+}
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# ========================= MQTT2eCAL LICENSE =================================
+#
+# Copyright (C) 2016 - 2019 Continental Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# ========================= MQTT2eCAL LICENSE =================================
+
+"""Writes a settings.yaml with many brokers and routes, used to check the time needed by --check-config."""
+
+import argparse
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--brokers", type=int, default=10, help="number of brokers")
+    parser.add_argument("--routes", type=int, default=100000, help="number of routes, half in each direction")
+    parser.add_argument("--output", required=True, help="path of the yaml file")
+    args = parser.parse_args()
+
+    lines = ["gateway:", "  ecal_process_name: check_config", "  brokers:"]
+    for broker in range(args.brokers):
+        lines += [
+            "    - broker_%d:" % broker,
+            "      host: 127.0.0.1",
+            "      port: %d" % (1883 + broker),
+            "      id: bridge_%d" % broker,
+            "      default_qos: 1",
+            "      default_retain_flag: true",
+        ]
+
+    # the routes are spread round robin over the brokers, every second one without qos to apply the broker default
+    lines.append("  mqtt2ecal:")
+    for route in range(args.routes // 2):
+        lines += [
+            "    - mqtt_to_ecal_%d:" % route,
+            "      broker_name: broker_%d" % (route % args.brokers),
+            "      mqtt_payload_name: devices/%d/in/payload" % route,
+            "      static_ecal_type_name: proto:pb.Bench.Sample",
+            "      ecal_out_topic_name: in_%d" % route,
+        ]
+        if route % 2:
+            lines.append("      qos: 2")
+
+    lines.append("  ecal2mqtt:")
+    for route in range(args.routes - args.routes // 2):
+        lines += [
+            "    - ecal_to_mqtt_%d:" % route,
+            "      broker_name: broker_%d" % (route % args.brokers),
+            "      ecal_topic_name: out_%d" % route,
+            "      mqtt_out_payload_name: devices/%d/out/payload" % route,
+        ]
+        if route % 2:
+            lines += ["      qos: 0", "      retain_flag: false"]
+
+    with open(args.output, "w") as output:
+        output.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()